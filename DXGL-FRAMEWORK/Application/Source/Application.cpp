@@ -14,17 +14,27 @@
 #include "SceneDemo.h"
 #include "KeyboardController.h"
 #include "MouseController.h"
+#include "InputQueue.h"
 #include "AudioManager.h"
+#include "Profiler.h"
+#include "MemoryTracker.h"
+#include "FrameArena.h"
+#include "ResourceManager.h"
+#include "JobSystem.h"
 
 GLFWwindow* m_window;
-const unsigned char FPS = 60; // FPS of this game
-const unsigned int frameTime = 1000 / FPS; // time for each frame
+const double FPS = 60; // FPS of this game, 0 = uncapped
+const FramePacer::MODE FRAME_MODE = FramePacer::CAPPED; // CAPPED limits to FPS, VSYNC lets the swap wait for the display
+const Application::LOOP_MODE GAME_LOOP = Application::VARIABLE; // see Application::LOOP_MODE, the FIXED modes judder unless the scene interpolates with its alpha
+const double TICK_RATE = 60; // Update() calls per second in the FIXED loop modes
+const int MAX_TICKS_PER_FRAME = 5; // after a long frame (loading, breakpoint) the lost time is dropped instead of catching up
+const bool LATE_LATCH = false; // waits for the frame's deadline before polling input instead of after, most useful with CAPPED
 
 //Define an error callback
 static void error_callback(int error, const char* description)
 {
 	fputs(description, stderr);
-	_fgetchar();
+	getchar();
 }
 
 //Define the key input callback
@@ -52,6 +62,19 @@ static void mousescroll_callback(GLFWwindow* window, double xoffset, double yoff
 	MouseController::GetInstance()->UpdateMouseScroll(xoffset, yoffset);
 }
 
+//Define the cursor position callback, every move is queued instead of reading the position once per frame
+static void cursorpos_callback(GLFWwindow* window, double xpos, double ypos)
+{
+	MouseController::GetInstance()->UpdateMousePosition(xpos, ypos);
+}
+
+//Define the focus callback, keys released while another window had focus never send their release
+static void focus_callback(GLFWwindow* window, int focused)
+{
+	if (!focused)
+		KeyboardController::GetInstance()->Reset();
+}
+
 void resize_callback(GLFWwindow* window, int w, int h)
 {
 	glViewport(0, 0, w, h); //update opengl the new window size
@@ -77,7 +100,8 @@ void Application::Init()
 	}
 
 	//Set the GLFW window creation hints - these are optional
-	glfwWindowHint(GLFW_SAMPLES, 4); //Request 4x antialiasing
+	// no multisampled window, PostProcess renders the scene into its own MSAA or FXAA target and only the UI goes straight to the window
+	glfwWindowHint(GLFW_SAMPLES, 0);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3); //Request a specific OpenGL version
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3); //Request a specific OpenGL version
 	//glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // To make MacOS happy; should not be needed
@@ -109,6 +133,10 @@ void Application::Init()
 	//Sets the mouse scroll callback
 	glfwSetScrollCallback(m_window, mousescroll_callback);
 
+	//Sets the cursor position and focus callbacks
+	glfwSetCursorPosCallback(m_window, cursorpos_callback);
+	glfwSetWindowFocusCallback(m_window, focus_callback);
+
 	if (enablePointer == false)
 		glfwSetInputMode(m_window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 	else if (showPointer == false)
@@ -128,6 +156,9 @@ void Application::Init()
 		//return -1;
 	}
 
+	// 1 worker per spare hardware thread
+	JobSystem::GetInstance().Init();
+
 	// audio init
 	AudioManager::GetInstance().InitSystem();
 	AudioManager::GetInstance().OpenMixer();
@@ -139,40 +170,139 @@ void Application::Run()
 	Scene *scene = new SceneDemo();
 	scene->Init();
 
+	m_framePacer.SetMode(FRAME_MODE);
+	m_framePacer.SetTargetRate(FPS);
+	glfwSwapInterval(m_framePacer.GetMode() == FramePacer::VSYNC ? 1 : 0);
+
+	if (GAME_LOOP != VARIABLE) {
+		// the first Render() needs a simulated state to draw
+		UpdateInput();
+		scene->Update(1.0 / TICK_RATE);
+	}
+
 	m_timer.startTimer();    // Start timer to calculate how long it takes to render this frame
+	m_framePacer.Start();
 	while (!glfwWindowShouldClose(m_window) && !KeyboardController::GetInstance()->IsKeyPressed(GLFW_KEY_ESCAPE))
 	{
-		scene->Update(m_timer.getElapsedTime());
-		scene->Render();
-		//Swap buffers
-		glfwSwapBuffers(m_window);
-
-		KeyboardController::GetInstance()->PostUpdate();
-
-		MouseController::GetInstance()->PostUpdate();
-		double mouse_x, mouse_y;
-		glfwGetCursorPos(m_window, &mouse_x, &mouse_y);
-		MouseController::GetInstance()->UpdateMousePosition(mouse_x, mouse_y);
-		if (MouseController::GetInstance()->GetMouseEnabled())
-			glfwSetInputMode(m_window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
-		else
-			glfwSetInputMode(m_window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-
-		//Get and organize events, like keyboard and mouse input, window resizing, etc...
-		glfwPollEvents();
-        m_timer.waitUntil(frameTime);       // Frame rate limiter. Limits each frame to a specified time in ms.   
+		PROFILE_BEGIN_FRAME();
+		MEMORY_BEGIN_FRAME();
+		// everything allocated from it last frame is dead by now
+		FrameArena::GetInstance().Reset();
+
+		if (LATE_LATCH) {
+			// sleep first, so the input below is as fresh as it can be when the frame is built
+			{
+				PROFILE_ZONE("Wait");
+				m_framePacer.WaitForNextFrame();
+			}
+			glfwPollEvents();
+		}
+
+		double elapsed = m_timer.getElapsedTime();
+		scene->SetFrameTime(elapsed);
+
+		if (GAME_LOOP == VARIABLE) {
+			PROFILE_ZONE("Update");
+			MEMORY_TAG(MemoryTracker::SCENE);
+			UpdateInput();
+			scene->Update(elapsed);
+		}
+		else if (GAME_LOOP == FIXED) {
+			PROFILE_ZONE("Update");
+			MEMORY_TAG(MemoryTracker::SCENE);
+			RunTicks(scene, elapsed);
+		}
+		{
+			PROFILE_ZONE("Render");
+			MEMORY_TAG(MemoryTracker::RENDER);
+			scene->Render();
+		}
+		if (GAME_LOOP == FIXED_RENDER_AHEAD) {
+			// hand the frame to the driver now, the swap below would otherwise be the first flush and the gpu would sit idle during the ticks
+			glFlush();
+			PROFILE_ZONE("Update");
+			MEMORY_TAG(MemoryTracker::SCENE);
+			RunTicks(scene, elapsed);
+		}
+		{
+			PROFILE_ZONE("Audio");
+			MEMORY_TAG(MemoryTracker::AUDIO);
+			// after the scene so sounds played this frame start this frame
+			AudioManager::GetInstance().Update();
+		}
+		{
+			PROFILE_ZONE("Swap");
+			//Swap buffers
+			glfwSwapBuffers(m_window);
+			if (InputQueue::GetInstance().GetMeasureLatency() || LATE_LATCH) {
+				// the driver would otherwise queue frames ahead, adding their time to the latency and hiding it from the timestamp below
+				glFinish();
+				InputQueue::GetInstance().MarkPresented(InputQueue::Now());
+			}
+		}
+
+		if (!LATE_LATCH) {
+			//Get and organize events, like keyboard and mouse input, window resizing, etc...
+			glfwPollEvents();
+			{
+				PROFILE_ZONE("Wait");
+				m_framePacer.WaitForNextFrame();       // Frame rate limiter, sleeps then spins until the next frame's deadline
+			}
+		}
+
+		MEMORY_END_FRAME();
+		PROFILE_END_FRAME();
 
 	} //Check if the ESC key had been pressed or if the window had been closed
 	scene->Exit();
 	delete scene;
 }
 
+int Application::RunTicks(Scene* scene, double elapsed)
+{
+	const double tick = 1.0 / TICK_RATE;
+
+	m_tickAccumulator += elapsed;
+	if (m_tickAccumulator > tick * MAX_TICKS_PER_FRAME)
+		m_tickAccumulator = tick * MAX_TICKS_PER_FRAME;
+
+	int ticks = 0;
+	while (m_tickAccumulator >= tick) {
+		UpdateInput();
+		scene->Update(tick);
+		m_tickAccumulator -= tick;
+		ticks++;
+	}
+
+	// in FIXED_RENDER_AHEAD this is used by the next frame's Render(), which is also when the time it covers has passed
+	scene->SetInterpolationAlpha(m_tickAccumulator / tick);
+	return ticks;
+}
+
+void Application::UpdateInput()
+{
+	// every event queued so far, so a tap shorter than a tick still shows up as pressed and released
+	InputQueue::GetInstance().NextSnapshot(InputQueue::Now());
+
+	if (MouseController::GetInstance()->GetMouseEnabled())
+		glfwSetInputMode(m_window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
+	else
+		glfwSetInputMode(m_window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+}
+
 void Application::Exit()
 {
 	KeyboardController::DestroyInstance();
 
+	JobSystem::GetInstance().Shutdown();
+
 	AudioManager::GetInstance().CloseMixer();
 	AudioManager::GetInstance().ExitSystem();
+
+	// textures, meshes and queries must be freed while the context is still alive
+	ResourceManager::GetInstance().Clear();
+	Profiler::GetInstance().Clear();
+	FrameArena::GetInstance().Release();
 	
 	//Close OpenGL window and terminate GLFW
 	glfwDestroyWindow(m_window);
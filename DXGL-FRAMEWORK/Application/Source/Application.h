@@ -3,6 +3,9 @@
 #define APPLICATION_H
 
 #include "timer.h"
+#include "FramePacer.h"
+
+class Scene;
 
 class Application
 {
@@ -17,10 +20,27 @@ public:
 	static constexpr float SCREEN_HEIGHT = 900.f;
 	static constexpr float ASPECT_RATIO = SCREEN_WIDTH / SCREEN_HEIGHT;
 
+	enum LOOP_MODE {
+		// 1 Update() with the frame's dt, then Render()
+		VARIABLE,
+		// Update() runs at TICK_RATE with a fixed dt, Render() runs every frame with an interpolation alpha
+		// the scene has to blend the last 2 ticks with Scene::GetInterpolationAlpha(), SceneDemo does not, so it steps 0 or 2 ticks on some frames
+		FIXED,
+		// like FIXED, but the next frame's ticks run after Render() has been submitted and before the swap, so the cpu works while the gpu draws
+		FIXED_RENDER_AHEAD,
+	};
+
 private:
 
 	//Declare a window object
 	StopWatch m_timer;
+	FramePacer m_framePacer;
+	double m_tickAccumulator = 0;
+
+	// runs as many fixed ticks as the time since the last call allows, returns how many ran
+	int RunTicks(Scene* scene, double elapsed);
+	// builds the input snapshot the next Update() reads, edges and deltas are consumed once per Update(), not once per frame
+	void UpdateInput();
 
 	bool enablePointer = true;
 	bool showPointer = true;
@@ -1,9 +1,9 @@
 #ifndef ATMOSPHERE_H
 #define ATMOSPHERE_H
 
-#include <glm\glm.hpp>
-#include <glm\gtc\matrix_transform.hpp>
-#include <glm\gtc\type_ptr.hpp>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
 
 struct Atmosphere {
 	glm::vec3 color;
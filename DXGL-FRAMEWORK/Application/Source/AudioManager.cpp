@@ -1,6 +1,10 @@
 
 #include "AudioManager.h"
 #include "Utils.h"
+#include "MemoryTracker.h"
+
+#include <algorithm>
+#include <chrono>
 
 
 
@@ -36,35 +40,79 @@ void AudioManager::OpenMixer() {
         SDL_Log("openMixer: Mix_OpenAudio Error: %s", Mix_GetError());
 
     Mix_AllocateChannels(TOTAL_SFX_CHANNEL);
+    Mix_QuerySpec(&mixerFrequency, &mixerFormat, &mixerChannels);
+
+    Mix_ChannelFinished(&AudioManager::ChannelFinishedCallback);
+    Mix_SetPostMix(&AudioManager::PostMix, this);
+
+    decodeThreadRunning = true;
+    decodeThread = std::thread(&AudioManager::DecodeLoop, this);
 }
 
-void AudioManager::LoadSFX(unsigned key, const char* filename) {
-    sfxList[key] = Mix_LoadWAV((directorySFX + filename).c_str());
-    if (!sfxList[key])
-        SDL_Log("loadSFX: Mix_LoadWAV Error: %s", Mix_GetError());
+void AudioManager::LoadSFX(unsigned key, const char* filename, bool hot) {
+    UnloadSFX(key);
+
+    SFX& sfx = sfxList[key];
+    sfx.path = directorySFX + filename;
+    sfx.hot = hot;
+    sfx.generation = ++nextGeneration;
+
+    if (hot)
+        RequestDecode(key, sfx);
 }
 
 void AudioManager::LoadMUS(const char* filename, double durationInSeconds) {
+    UnloadMUS();
+
+    // Mix_Music streams from the file in small chunks, only the headers are read here
     music = Mix_LoadMUS((directoryMusic + filename).c_str());
-    if (music == NULL)
-        music = nullptr;
-    if (!music)
+    if (!music) {
         SDL_Log("loadMUS: Mix_LoadMUS Error: %s", Mix_GetError());
-    else
-        musicDuration = durationInSeconds;
+        return;
+    }
+
+    musicDuration = Mix_MusicDuration(music);
+    if (musicDuration <= 0) {
+        if (durationInSeconds < 0)
+            SDL_Log("loadMUS: %s does not store its duration, pass it in to LoadMUS()", filename);
+        musicDuration = std::max(durationInSeconds, 0.0);
+    }
+}
+
+void AudioManager::Update() {
+    auto start = std::chrono::steady_clock::now();
+
+    CollectDecodes();
+    CollectFinishedChannels();
+    UpdateVoices();
+    EvictOverBudget();
+
+    stats.lastUpdateMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    stats.maxUpdateMs = std::max(stats.maxUpdateMs, stats.lastUpdateMs);
 }
 
 void AudioManager::UnloadSFX(unsigned key) {
-    if (sfxList[key]) {
-        Mix_FreeChunk(sfxList[key]);
-        sfxList.erase(key);
+    auto it = sfxList.find(key);
+    if (it == sfxList.end())
+        return;
+
+    for (unsigned i = 0; i < voiceList.size();) {
+        if (voiceList[i].key == key)
+            RemoveVoice(i);
+        else
+            i++;
     }
+
+    FreeSFX(it->second);
+    sfxList.erase(it);
 }
 
 void AudioManager::UnloadSFXAll() {
+    while (!voiceList.empty())
+        RemoveVoice(static_cast<unsigned>(voiceList.size()) - 1);
+
     for (auto& pair : sfxList)
-        if (pair.second)
-            Mix_FreeChunk(pair.second);
+        FreeSFX(pair.second);
     sfxList.clear();
 }
 
@@ -73,6 +121,14 @@ void AudioManager::UnloadMUS() {
         if (PlayingMUS()) {
             PauseMUS();
         }
+        // queued music commands still point at it
+        FlushCommands();
+        {
+            // PostMix() samples the position under the same lock
+            std::lock_guard<std::mutex> lock(drainMutex);
+            positionMusic = nullptr;
+        }
+        musicPosition.store(0);
         Mix_FreeMusic(music);
         music = nullptr;
     }
@@ -83,20 +139,72 @@ void AudioManager::UnloadAll() {
     UnloadMUS();
 }
 
-// | channel : -1 = find first free channel | loops : -1 = loop forever
-void AudioManager::PlaySFX(unsigned key, int channel, int loops) {
-    auto it = sfxList.find(key);
-    if (it != sfxList.end() && it->second)
-        Mix_PlayChannel(channel, sfxList[key], loops);
+// | channel : -1 = any channel, otherwise pinned to that channel | loops : -1 = loop forever | priority : higher steals channels from lower
+unsigned AudioManager::PlaySFX(unsigned key, int channel, int loops, int priority) {
+    Voice voice;
+    voice.key = key;
+    voice.loops = loops;
+    voice.priority = priority;
+    if (channel >= 0 && channel < static_cast<int>(TOTAL_SFX_CHANNEL))
+        voice.pinnedChannel = channel;
+    return StartVoice(voice);
+}
+
+unsigned AudioManager::PlaySFX3D(unsigned key, glm::vec3 sourcePosition, int priority, int loops, float maxDistance) {
+    Voice voice;
+    voice.key = key;
+    voice.loops = loops;
+    voice.priority = priority;
+    voice.positional = true;
+    voice.position = sourcePosition;
+    voice.maxDistance = maxDistance;
+    return StartVoice(voice);
+}
+
+void AudioManager::SetListener(glm::vec3 hearPosition, glm::vec3 hearFacingDirection) {
+    listenerPosition = hearPosition;
+    if (glm::dot(hearFacingDirection, hearFacingDirection) > 0)
+        listenerFacing = glm::normalize(hearFacingDirection);
+}
+
+void AudioManager::SetVoicePosition(unsigned voice, glm::vec3 sourcePosition) {
+    if (Voice* found = FindVoice(voice))
+        found->position = sourcePosition;
+}
+
+void AudioManager::StopVoice(unsigned voice) {
+    for (unsigned i = 0; i < voiceList.size(); i++) {
+        if (voiceList[i].handle == voice) {
+            RemoveVoice(i);
+            return;
+        }
+    }
+}
+
+bool AudioManager::VoiceActive(unsigned voice) const {
+    for (const Voice& found : voiceList)
+        if (found.handle == voice)
+            return true;
+    return false;
+}
+
+unsigned AudioManager::GetAudibleVoiceCount() const {
+    unsigned count = 0;
+    for (unsigned handle : channelVoice)
+        if (handle)
+            count++;
+    return count;
 }
 
 // | loops : -1 = loop forever | type : 0 = no fade, 1 = fade in
 void AudioManager::PlayMUS(int loops, unsigned type, int duration_ms) {
     if (music) {
-        if (type)
-            Mix_FadeInMusic(music, loops, duration_ms);
-        else
-            Mix_PlayMusic(music, loops);
+        Command command;
+        command.type = type ? CMD_FADE_IN_MUSIC : CMD_PLAY_MUSIC;
+        command.music = music;
+        command.channel = loops;
+        command.value = duration_ms;
+        Send(command);
         musicPlaying = true;
     }
 }
@@ -104,10 +212,27 @@ void AudioManager::PlayMUS(int loops, unsigned type, int duration_ms) {
 // channel : -1 = set all channels | volume : range from 0 - 1, -1 to get current volume
 float AudioManager::VolumeChannel(int channel, float volume) {
     int volume_int = static_cast<int>(volume * 128);
-    if (volume < 0)
-        volume_int = -1;
+    if (volume < 0) {
+        if (channel < 0 || channel >= static_cast<int>(TOTAL_SFX_CHANNEL)) {
+            int total = 0;
+            for (int eachVolume : channelVolume)
+                total += eachVolume;
+            return total / static_cast<float>(TOTAL_SFX_CHANNEL) / 128.f;
+        }
+        return channelVolume[channel] / 128.f;
+    }
 
-    return Mix_Volume(channel, volume_int) / 128.f;
+    float previous = VolumeChannel(channel, -1);
+    for (int i = 0; i < static_cast<int>(TOTAL_SFX_CHANNEL); i++)
+        if (channel < 0 || channel == i)
+            channelVolume[i] = volume_int;
+
+    Command command;
+    command.type = CMD_VOLUME_CHANNEL;
+    command.channel = channel;
+    command.value = volume_int;
+    Send(command);
+    return previous;
 }
 
 // | volume : range from 0 - 1, -1 to get current volume
@@ -117,9 +242,24 @@ float AudioManager::VolumeSFX(unsigned key, float volume) {
         volume_int = -1;
 
     auto it = sfxList.find(key);
-    if (it != sfxList.end() && it->second)
-        return Mix_VolumeChunk(sfxList[key], volume_int) / 128.f;
-    return -1;
+    if (it == sfxList.end())
+        return -1;
+
+    SFX& sfx = it->second;
+    // chunks are decoded at full volume, so an sfx that was never set is at MIX_MAX_VOLUME
+    float previous = (sfx.volume < 0 ? MIX_MAX_VOLUME : sfx.volume) / 128.f;
+    if (volume_int >= 0) {
+        sfx.volume = volume_int;
+        // not decoded yet, CollectDecodes() applies it before the first play
+        if (sfx.chunk) {
+            Command command;
+            command.type = CMD_VOLUME_CHUNK;
+            command.chunk = sfx.chunk;
+            command.value = volume_int;
+            Send(command);
+        }
+    }
+    return previous;
 }
 
 // | volume : range from 0 - 1, -1 to get current volume
@@ -128,42 +268,84 @@ float AudioManager::VolumeMUS(float volume) {
     if (volume < 0)
         volume_int = -1;
 
-    if (music)
-        return Mix_VolumeMusic(volume_int) / 128.f;
-    return -1;
+    if (!music)
+        return -1;
+
+    float previous = musicVolume / 128.f;
+    if (volume_int >= 0) {
+        musicVolume = volume_int;
+
+        Command command;
+        command.type = CMD_VOLUME_MUSIC;
+        command.value = volume_int;
+        Send(command);
+    }
+    return previous;
 }
 
 // channel : -1 = stop all channels
 void AudioManager::StopChannel(int channel) {
-    Mix_HaltChannel(channel);
+    // stopping drops the voices as well, otherwise they would take the channel back next Update()
+    for (unsigned i = 0; i < voiceList.size();) {
+        if (channel < 0 || voiceList[i].channel == channel)
+            RemoveVoice(i);
+        else
+            i++;
+    }
 }
 
 // return playback position in seconds
 double AudioManager::GetMUSPosition() {
-    return Mix_GetMusicPosition(music);
+    return musicPosition.load();
 }
 
 void AudioManager::SetMUSPosition(double postionInSeconds) {
-    postionInSeconds = Clamp(postionInSeconds, 0, musicDuration);
-    Mix_SetMusicPosition(postionInSeconds);
+    Command command;
+    command.type = CMD_MUSIC_POSITION;
+    command.position = Clamp(postionInSeconds, 0, musicDuration);
+    Send(command);
+    // seeking twice before the next buffer starts from the first seek
+    musicPosition.store(command.position);
 }
 
 double AudioManager::GetMUSDUration() {
     return musicDuration;
 }
 
+double AudioManager::GetSFXDuration(unsigned key) {
+    auto it = sfxList.find(key);
+    if (it == sfxList.end() || !it->second.chunk)
+        return -1;
+
+    return ChunkDuration(it->second.chunk);
+}
+
+void AudioManager::SetSFXBudget(size_t bytes) {
+    sfxBudget = bytes;
+    EvictOverBudget();
+}
+
 void AudioManager::SetSFXPosition(int channel, glm::vec3 hearFacingDirection, glm::vec3 hearPosition, glm::vec3 sourcePosition, float maxDistance) {
 
     glm::vec3 hearToSource = sourcePosition - hearPosition;
     float distance = glm::length(hearToSource);
 
-    float dotProduct = glm::dot(hearFacingDirection, hearToSource) / glm::dot(hearToSource, hearToSource);
-    dotProduct = Clamp(dotProduct, 0, 1);
-    float thetaRad = acos(dotProduct);
+    // sdl mixer angles go clockwise from the front, 90 = right
+    float thetaRad = 0;
+    glm::vec3 right = glm::cross(hearFacingDirection, glm::vec3(0, 1, 0));
+    if (distance > 0 && glm::dot(right, right) > 0)
+        thetaRad = atan2(glm::dot(hearToSource, glm::normalize(right)), glm::dot(hearToSource, glm::normalize(hearFacingDirection)));
 
     float t = Clamp(distance / maxDistance, 0, 1);
     float volume = 1 - t * t * (3 - 2 * t);
-    Mix_SetPosition(channel, glm::degrees(thetaRad), volume);
+    Command command;
+    command.type = CMD_SET_POSITION;
+    command.channel = channel;
+    // atan2 gives -180 - 180, Mix_SetPosition() only folds angles with abs() % 360, so the left side would pan right
+    command.value = (static_cast<int>(glm::degrees(thetaRad)) + 360) % 360;
+    // distance is 0 (loudest) - 255 (quietest)
+    command.extra = static_cast<unsigned>((1 - volume) * 255);
+    Send(command);
 }
 
 int AudioManager::PlayingMUS() {
@@ -171,30 +353,63 @@ int AudioManager::PlayingMUS() {
 }
 
 int AudioManager::PlayingSFX(int channel) {
-    return Mix_Playing(channel);
+    if (channel >= 0 && channel < static_cast<int>(TOTAL_SFX_CHANNEL))
+        return channelVoice[channel] != 0;
+    return static_cast<int>(GetAudibleVoiceCount());
 }
 
 void AudioManager::PauseMUS() {
-    Mix_PauseMusic();
+    Command command;
+    command.type = CMD_PAUSE_MUSIC;
+    Send(command);
     musicPlaying = false;
 }
 
 void AudioManager::ResumeMUS() {
-    Mix_ResumeMusic();
+    Command command;
+    command.type = CMD_RESUME_MUSIC;
+    Send(command);
     musicPlaying = true;
 }
 
 void AudioManager::RewindMUS() {
-    Mix_RewindMusic();
+    Command command;
+    command.type = CMD_REWIND_MUSIC;
+    Send(command);
     musicPlaying = true;
 }
 
 void AudioManager::FadeOutMUS(int duration_ms) {
-    Mix_FadeOutMusic(duration_ms);
+    Command command;
+    command.type = CMD_FADE_OUT_MUSIC;
+    command.value = duration_ms;
+    Send(command);
 }
 
 void AudioManager::CloseMixer() {
+    // from here on commands run right away on this thread
+    Mix_SetPostMix(nullptr, nullptr);
+    FlushCommands();
+
+    if (decodeThreadRunning) {
+        {
+            std::lock_guard<std::mutex> lock(decodeMutex);
+            decodeThreadRunning = false;
+            decodeRequests.clear();
+        }
+        decodeCondition.notify_one();
+        decodeThread.join();
+    }
+
     UnloadAll();
+    FlushCommands();
+    Mix_ChannelFinished(nullptr);
+    // decodes that finished after the last Update()
+    for (DecodeResult& result : decodeResults)
+        if (result.chunk)
+            Mix_FreeChunk(result.chunk);
+    decodeResults.clear();
+
     Mix_CloseAudio();
     sfxList.clear();
 }
@@ -204,5 +419,449 @@ void AudioManager::ExitSystem() {
     SDL_Quit();
 }
 
+AudioManager::AudioManager() {
+    for (int& volume : channelVolume)
+        volume = MIX_MAX_VOLUME;
+}
+
 AudioManager::~AudioManager() {}
 
+
+/********************************* sfx streaming *********************************/
+
+void AudioManager::DecodeLoop() {
+    MEMORY_TAG(MemoryTracker::AUDIO);
+    std::unique_lock<std::mutex> lock(decodeMutex);
+
+    while (true) {
+        decodeCondition.wait(lock, [this] { return !decodeThreadRunning || !decodeRequests.empty(); });
+        if (!decodeThreadRunning)
+            return;
+
+        DecodeRequest request = std::move(decodeRequests.front());
+        decodeRequests.pop_front();
+
+        // the decode is the slow part, do not hold the lock for it
+        lock.unlock();
+        Mix_Chunk* chunk = Mix_LoadWAV(request.path.c_str());
+        if (!chunk)
+            SDL_Log("loadSFX: Mix_LoadWAV Error: %s", Mix_GetError());
+        lock.lock();
+
+        decodeResults.push_back({ request.key, request.generation, chunk });
+    }
+}
+
+void AudioManager::RequestDecode(unsigned key, SFX& sfx) {
+    sfx.state = SFX_DECODING;
+
+    {
+        std::lock_guard<std::mutex> lock(decodeMutex);
+        decodeRequests.push_back({ key, sfx.generation, sfx.path });
+    }
+    decodeCondition.notify_one();
+}
+
+void AudioManager::CollectDecodes() {
+    std::vector<DecodeResult> results;
+    {
+        std::lock_guard<std::mutex> lock(decodeMutex);
+        results.swap(decodeResults);
+    }
+
+    for (DecodeResult& result : results) {
+        auto it = sfxList.find(result.key);
+        if (it == sfxList.end() || it->second.generation != result.generation || it->second.state != SFX_DECODING) {
+            // unloaded or reloaded while decoding
+            if (result.chunk)
+                Mix_FreeChunk(result.chunk);
+            continue;
+        }
+
+        SFX& sfx = it->second;
+        // failed decodes stay resident with no chunk so plays do not keep retrying, their voices are dropped in UpdateVoices()
+        sfx.chunk = result.chunk;
+        sfx.state = SFX_RESIDENT;
+        if (!sfx.chunk)
+            continue;
+
+        // nothing plays the chunk yet, so this does not have to go through the queue
+        if (sfx.volume >= 0)
+            Mix_VolumeChunk(sfx.chunk, sfx.volume);
+        if (!sfx.hot)
+            sfxResidentBytes += sfx.chunk->alen;
+    }
+}
+
+void AudioManager::EvictOverBudget() {
+    while (sfxResidentBytes > sfxBudget) {
+        // least recently played cold sfx that is not playing right now
+        SFX* oldest = nullptr;
+        for (auto& pair : sfxList) {
+            SFX& sfx = pair.second;
+            if (sfx.hot || !sfx.chunk || sfx.voiceCount > 0)
+                continue;
+            if (!oldest || sfx.lastPlayedTick < oldest->lastPlayedTick)
+                oldest = &sfx;
+        }
+
+        if (!oldest)
+            return;
+        FreeSFX(*oldest);
+    }
+}
+
+void AudioManager::FreeSFX(SFX& sfx) {
+    if (sfx.chunk) {
+        // queued plays still point at the chunk
+        FlushCommands();
+        if (!sfx.hot)
+            sfxResidentBytes -= sfx.chunk->alen;
+        Mix_FreeChunk(sfx.chunk);
+        sfx.chunk = nullptr;
+    }
+    // a decode still in flight is thrown away when collected because the state no longer matches
+    sfx.state = SFX_UNLOADED;
+}
+
+void AudioManager::PlayChunk(SFX& sfx, int channel, int loops, unsigned playID) {
+    if (!sfx.chunk)
+        return;
+
+    Command command;
+    command.type = CMD_PLAY_CHANNEL;
+    command.channel = channel;
+    command.chunk = sfx.chunk;
+    command.value = loops;
+    command.extra = playID;
+    Send(command);
+    sfx.lastPlayedTick = SDL_GetTicks();
+}
+
+
+/********************************* voices *********************************/
+
+unsigned AudioManager::StartVoice(Voice voice) {
+    auto it = sfxList.find(voice.key);
+    if (it == sfxList.end())
+        return 0;
+
+    SFX& sfx = it->second;
+    if (sfx.state == SFX_RESIDENT && !sfx.chunk)
+        return 0;
+
+    if (voiceList.size() >= MAX_VOICE) {
+        // make room by dropping the lowest priority voice, unless this one is the lowest
+        unsigned lowest = 0;
+        for (unsigned i = 1; i < voiceList.size(); i++)
+            if (voiceList[i].priority < voiceList[lowest].priority)
+                lowest = i;
+        if (voiceList[lowest].priority >= voice.priority)
+            return 0;
+        RemoveVoice(lowest);
+    }
+
+    // a cold sfx starts decoding now, the voice waits virtual until it is resident
+    if (sfx.state == SFX_UNLOADED)
+        RequestDecode(voice.key, sfx);
+
+    voice.handle = ++nextVoiceHandle;
+    if (voice.handle == 0)
+        voice.handle = ++nextVoiceHandle;
+    sfx.voiceCount++;
+    voiceList.push_back(voice);
+    return voice.handle;
+}
+
+void AudioManager::UpdateVoices() {
+    Uint32 now = SDL_GetTicks();
+
+    // drop voices that finished on their channel, or that would have finished while virtual
+    for (unsigned i = 0; i < voiceList.size();) {
+        Voice& voice = voiceList[i];
+        SFX& sfx = sfxList[voice.key];
+        bool finished = false;
+
+        if (sfx.state == SFX_RESIDENT && !sfx.chunk)
+            finished = true;
+        else if (voice.channel >= 0)
+            finished = voice.playID == 0;
+        else if (voice.startTick != 0 && voice.loops >= 0)
+            finished = now - voice.startTick > (voice.loops + 1) * ChunkDuration(sfx.chunk) * 1000;
+
+        if (finished)
+            RemoveVoice(i);
+        else
+            i++;
+    }
+
+    // rank, pinned first, then priority, then how loud it would be
+    std::vector<unsigned> ranked;
+    ranked.reserve(voiceList.size());
+    for (unsigned i = 0; i < voiceList.size(); i++) {
+        Voice& voice = voiceList[i];
+        if (!sfxList[voice.key].chunk)
+            continue;
+
+        if (voice.startTick == 0)
+            voice.startTick = now;
+
+        voice.audibility = Audibility(voice);
+        // already playing voices get a bit of headroom so two similar voices do not keep swapping
+        if (voice.channel >= 0 && voice.audibility > 0)
+            voice.audibility += 0.1f;
+
+        bool restartable = voice.channel >= 0 || voice.loops != 0 || now - voice.startTick <= VOICE_RESTART_WINDOW_MS;
+        if (voice.audibility > 0 && restartable)
+            ranked.push_back(i);
+    }
+    std::sort(ranked.begin(), ranked.end(), [this](unsigned a, unsigned b) {
+        const Voice& voiceA = voiceList[a];
+        const Voice& voiceB = voiceList[b];
+        if ((voiceA.pinnedChannel >= 0) != (voiceB.pinnedChannel >= 0))
+            return voiceA.pinnedChannel >= 0;
+        if (voiceA.priority != voiceB.priority)
+            return voiceA.priority > voiceB.priority;
+        return voiceA.audibility > voiceB.audibility;
+        });
+
+    // the top TOTAL_SFX_CHANNEL voices win a channel, only 1 voice per pinned channel
+    std::vector<bool> winner(voiceList.size(), false);
+    bool pinnedTaken[TOTAL_SFX_CHANNEL] = {};
+    unsigned winnerCount = 0;
+    for (unsigned index : ranked) {
+        if (winnerCount >= TOTAL_SFX_CHANNEL)
+            break;
+
+        int pinned = voiceList[index].pinnedChannel;
+        if (pinned >= 0) {
+            if (pinnedTaken[pinned])
+                continue;
+            pinnedTaken[pinned] = true;
+        }
+        winner[index] = true;
+        winnerCount++;
+    }
+
+    // virtualize voices that lost, or that sit on a channel a pinned voice needs
+    for (unsigned i = 0; i < voiceList.size(); i++) {
+        Voice& voice = voiceList[i];
+        if (voice.channel < 0)
+            continue;
+        if (winner[i] && (!pinnedTaken[voice.channel] || voice.pinnedChannel == voice.channel))
+            continue;
+
+        HaltChannel(voice.channel);
+        channelVoice[voice.channel] = 0;
+        voice.channel = -1;
+    }
+
+    // start the winners that do not have a channel yet
+    for (unsigned i = 0; i < voiceList.size(); i++) {
+        Voice& voice = voiceList[i];
+        if (!winner[i] || voice.channel >= 0)
+            continue;
+
+        int channel = voice.pinnedChannel;
+        for (int c = 0; channel < 0 && c < static_cast<int>(TOTAL_SFX_CHANNEL); c++)
+            if (channelVoice[c] == 0 && !pinnedTaken[c])
+                channel = c;
+        if (channel < 0)
+            break;
+
+        voice.playID = ++nextPlayID;
+        if (voice.playID == 0)
+            voice.playID = ++nextPlayID;
+        PlayChunk(sfxList[voice.key], channel, voice.loops, voice.playID);
+        voice.channel = channel;
+        channelVoice[channel] = voice.handle;
+    }
+
+    // positional voices follow the listener
+    for (Voice& voice : voiceList) {
+        if (voice.channel >= 0 && voice.positional)
+            SetSFXPosition(voice.channel, listenerFacing, listenerPosition, voice.position, voice.maxDistance);
+    }
+}
+
+void AudioManager::RemoveVoice(unsigned index) {
+    Voice& voice = voiceList[index];
+    if (voice.channel >= 0) {
+        HaltChannel(voice.channel);
+        channelVoice[voice.channel] = 0;
+    }
+
+    auto it = sfxList.find(voice.key);
+    if (it != sfxList.end() && it->second.voiceCount > 0)
+        it->second.voiceCount--;
+
+    // order does not matter, ranking happens every update
+    voiceList[index] = voiceList.back();
+    voiceList.pop_back();
+}
+
+AudioManager::Voice* AudioManager::FindVoice(unsigned handle) {
+    for (Voice& voice : voiceList)
+        if (voice.handle == handle)
+            return &voice;
+    return nullptr;
+}
+
+float AudioManager::Audibility(const Voice& voice) const {
+    if (!voice.positional)
+        return 1;
+
+    float distance = glm::length(voice.position - listenerPosition);
+    if (distance >= voice.maxDistance)
+        return 0;
+
+    float t = distance / voice.maxDistance;
+    return 1 - t * t * (3 - 2 * t);
+}
+
+double AudioManager::ChunkDuration(const Mix_Chunk* chunk) const {
+    if (!chunk)
+        return 0;
+
+    // chunks are converted to the device format on load, so alen is in device frames
+    unsigned bytesPerFrame = (SDL_AUDIO_BITSIZE(mixerFormat) / 8) * mixerChannels;
+    return static_cast<double>(chunk->alen) / bytesPerFrame / mixerFrequency;
+}
+
+
+/********************************* command queue *********************************/
+
+void AudioManager::Send(const Command& command) {
+    stats.commands++;
+
+    if (!commandQueue.Push(command)) {
+        // the audio thread is behind (or not running), run everything queued so far here instead of dropping it
+        stats.flushes++;
+        FlushCommands();
+        if (!commandQueue.Push(command)) {
+            std::lock_guard<std::mutex> lock(drainMutex);
+            Execute(command);
+            return;
+        }
+    }
+
+    stats.maxQueueDepth = std::max(stats.maxQueueDepth, static_cast<unsigned>(commandQueue.size()));
+}
+
+void AudioManager::HaltChannel(int channel) {
+    Command command;
+    command.type = CMD_HALT_CHANNEL;
+    command.channel = channel;
+    Send(command);
+}
+
+void AudioManager::DrainCommands() {
+    Command command;
+    while (commandQueue.Pop(command))
+        Execute(command);
+}
+
+void AudioManager::FlushCommands() {
+    std::lock_guard<std::mutex> lock(drainMutex);
+    DrainCommands();
+}
+
+void AudioManager::Execute(const Command& command) {
+    switch (command.type) {
+    case CMD_PLAY_CHANNEL:
+        // the id has to be in place before a short chunk can finish on the audio thread, so it is stored before the play,
+        // and whatever still plays on the channel is halted first so its finish goes out with its own id,
+        // SDL_mixer 2 does not export Mix_LockAudio(), the channel is idle between the halt and the play so nothing can finish in between
+        Mix_HaltChannel(command.channel);
+        channelPlayID[command.channel].store(command.extra, std::memory_order_release);
+        // nothing will ever finish, the game thread releases the voice instead of leaving it on the channel
+        if (Mix_PlayChannel(command.channel, command.chunk, command.value) < 0)
+            channelLostPlayID[command.channel].store(command.extra, std::memory_order_release);
+        break;
+    case CMD_HALT_CHANNEL:
+        Mix_HaltChannel(command.channel);
+        break;
+    case CMD_SET_POSITION:
+        Mix_SetPosition(command.channel, static_cast<Sint16>(command.value), static_cast<Uint8>(command.extra));
+        break;
+    case CMD_VOLUME_CHANNEL:
+        Mix_Volume(command.channel, command.value);
+        break;
+    case CMD_VOLUME_CHUNK:
+        Mix_VolumeChunk(command.chunk, command.value);
+        break;
+    case CMD_PLAY_MUSIC:
+        Mix_PlayMusic(command.music, command.channel);
+        positionMusic = command.music;
+        break;
+    case CMD_FADE_IN_MUSIC:
+        Mix_FadeInMusic(command.music, command.channel, command.value);
+        positionMusic = command.music;
+        break;
+    case CMD_FADE_OUT_MUSIC:
+        Mix_FadeOutMusic(command.value);
+        break;
+    case CMD_PAUSE_MUSIC:
+        Mix_PauseMusic();
+        break;
+    case CMD_RESUME_MUSIC:
+        Mix_ResumeMusic();
+        break;
+    case CMD_REWIND_MUSIC:
+        Mix_RewindMusic();
+        break;
+    case CMD_MUSIC_POSITION:
+        Mix_SetMusicPosition(command.position);
+        break;
+    case CMD_VOLUME_MUSIC:
+        Mix_VolumeMusic(command.value);
+        break;
+    }
+}
+
+void AudioManager::CollectFinishedChannels() {
+    ChannelFinished finished;
+    while (finishedQueue.Pop(finished)) {
+        unsigned handle = channelVoice[finished.channel];
+        Voice* voice = handle ? FindVoice(handle) : nullptr;
+        // halts of plays that were already replaced come back too, only the current play counts
+        if (voice && voice->playID == finished.playID)
+            voice->playID = 0;
+    }
+
+    // plays the mixer refused and finishes the full queue could not take, matched by play id like the queue so the order between them does not matter
+    for (unsigned channel = 0; channel < TOTAL_SFX_CHANNEL; channel++) {
+        unsigned playID = channelLostPlayID[channel].exchange(0, std::memory_order_acquire);
+        unsigned handle = playID ? channelVoice[channel] : 0;
+        Voice* voice = handle ? FindVoice(handle) : nullptr;
+        if (voice && voice->playID == playID)
+            voice->playID = 0;
+    }
+    stats.finishedOverflows = finishedOverflows.load(std::memory_order_relaxed);
+}
+
+void AudioManager::PostMix(void* userdata, Uint8* stream, int length) {
+    AudioManager* audioManager = static_cast<AudioManager*>(userdata);
+
+    // the game thread is flushing, pick the rest up next buffer instead of waiting
+    if (!audioManager->drainMutex.try_lock())
+        return;
+    audioManager->DrainCommands();
+    // already inside the audio callback, so this does not wait on the device lock like it would on the game thread
+    if (audioManager->positionMusic)
+        audioManager->musicPosition.store(Mix_GetMusicPosition(audioManager->positionMusic));
+    audioManager->drainMutex.unlock();
+}
+
+void AudioManager::ChannelFinishedCallback(int channel) {
+    // called with the audio device locked, either on the audio thread or inside a mixer call
+    AudioManager& audioManager = GetInstance();
+    if (channel < 0 || channel >= static_cast<int>(TOTAL_SFX_CHANNEL))
+        return;
+    unsigned playID = audioManager.channelPlayID[channel].load(std::memory_order_acquire);
+    if (!audioManager.finishedQueue.Push({ channel, playID })) {
+        // Update() has not run for a while, dropping it would leave the voice holding the channel forever
+        audioManager.channelLostPlayID[channel].store(playID, std::memory_order_release);
+        audioManager.finishedOverflows.fetch_add(1, std::memory_order_relaxed);
+    }
+}
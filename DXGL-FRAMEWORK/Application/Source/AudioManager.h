@@ -7,12 +7,64 @@
 
 #include <map>
 #include <string>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
 
 #include <glm/glm.hpp>
 
+#include "SPSCQueue.h"
+
 
 enum class SFX_TYPE : int;
 
+/* how to use | AudioManager streaming:
+* || music
+* music is streamed by sdl mixer, only a small decode buffer is resident no matter how long the track is
+* AudioManager::GetInstance().LoadMUS("Wheel_Chill.ogg"); // duration is read from the file, pass it in only for formats that do not store it
+*
+* || sfx
+* sfx are decoded on a background thread, so loading does not wait for the decode
+* AudioManager::GetInstance().LoadSFX(KEY, "hit.wav"); // hot, decoded right away in the background and always kept resident
+* AudioManager::GetInstance().LoadSFX(KEY, "rare_voice_line.wav", false); // cold, decoded on first play and evicted when over budget
+* AudioManager::GetInstance().SetSFXBudget(16 * 1024 * 1024); // in bytes, only cold sfx count towards eviction
+*
+* notes:
+* - PlaySFX() on a sfx that is still decoding plays it as soon as the decode finishes
+* - Update() has to be called once per frame to pick up finished decodes, Application does this
+*/
+
+/* how to use | AudioManager voices:
+* every PlaySFX() starts a virtual voice, there can be up to MAX_VOICE of them but only TOTAL_SFX_CHANNEL are heard at once
+* each Update(), the voices with the highest priority (then loudest) get the real channels, the rest keep their place and take a channel back when one frees up
+*
+* unsigned voice = AudioManager::GetInstance().PlaySFX(KEY, -1, 0, 10); // priority 10 steals a channel from anything lower when all channels are busy
+* unsigned voice = AudioManager::GetInstance().PlaySFX3D(KEY, sourcePosition, 5); // voices past maxDistance are culled, positions are applied from the listener every frame
+* AudioManager::GetInstance().SetVoicePosition(voice, newPosition); // for moving sources
+* AudioManager::GetInstance().SetListener(camera.GetFinalPosition(), camera.GetFinalTarget() - camera.GetFinalPosition()); // once per frame, usually by the scene
+*
+* notes:
+* - a voice that loses its channel restarts from the beginning when it gets one back (sdl mixer cannot seek a chunk),
+*   so one shot voices that were already playing for a while are dropped instead
+* - passing in a channel pins the voice to it, pinned voices always keep their channel
+*/
+
+/* how to use | AudioManager command queue:
+* nothing to do, every call that changes what the mixer is doing (play, halt, volume, position, music) is pushed into a lock free queue
+* and run by the audio thread after it mixes the next buffer, so the game thread never waits on the audio device lock
+* queries answer from state cached on the game thread, GetMUSPosition() is sampled by the audio thread after every buffer
+*
+* const AudioManager::Stats& stats = AudioManager::GetInstance().GetStats(); // commands sent, queue depth, time spent in Update()
+*
+* notes:
+* - commands take effect on the next mixed buffer, which is at most 1 buffer (2048 frames) later
+* - if the queue fills up, the game thread drains it itself (counted in stats.flushes), nothing is dropped
+* - channel finishes come back through a queue too, if it is full the last finish of each channel is kept aside instead (counted in stats.finishedOverflows)
+*/
+
 class AudioManager {
 public:
 
@@ -27,16 +79,33 @@ public:
     void InitSystem();
     void OpenMixer();
 
-    void LoadSFX(unsigned key, const char* filename);
-    void LoadMUS(const char* filename, double totalMusicDuration);
+    // | hot : true = decode now and never evict, false = decode on first play and evict when over budget
+    void LoadSFX(unsigned key, const char* filename, bool hot = true);
+    // | totalMusicDuration : only used if the file does not store its duration
+    void LoadMUS(const char* filename, double totalMusicDuration = -1);
+
+    // picks up finished decodes and evicts cold sfx, call once per frame
+    void Update();
 
     void UnloadSFX(unsigned key);
     void UnloadSFXAll();
     void UnloadMUS();
     void UnloadAll();
 
-    // | channel : -1 = find first free channel | loops : -1 = loop forever
-    void PlaySFX(unsigned key, int channel = -1, int loops = 0);
+    // | channel : -1 = any channel, otherwise pinned to that channel | loops : -1 = loop forever | priority : higher steals channels from lower
+    // returns the voice, 0 if it could not be started
+    unsigned PlaySFX(unsigned key, int channel = -1, int loops = 0, int priority = 0);
+    // positional voice, volume and panning follow the listener automatically
+    unsigned PlaySFX3D(unsigned key, glm::vec3 sourcePosition, int priority = 0, int loops = 0, float maxDistance = 25);
+
+    void SetListener(glm::vec3 hearPosition, glm::vec3 hearFacingDirection);
+    void SetVoicePosition(unsigned voice, glm::vec3 sourcePosition);
+    void StopVoice(unsigned voice);
+    // true while the voice is playing or waiting for a channel
+    bool VoiceActive(unsigned voice) const;
+    unsigned GetVoiceCount() const { return static_cast<unsigned>(voiceList.size()); }
+    // voices that currently have a real channel
+    unsigned GetAudibleVoiceCount() const;
     // | loops : -1 = loop forever | type : 0 = no fade, 1 = fade in
     void PlayMUS(int loops = 0, unsigned type = 0, int duration_ms = 0);
 
@@ -50,10 +119,15 @@ public:
     // channel : -1 = stop all channels
     void StopChannel(int channel = -1);
 
-    // return playback position in seconds
+    // return playback position in seconds, as of the last mixed buffer or SetMUSPosition()
     double GetMUSPosition();
     void SetMUSPosition(double postionInSeconds);
     double GetMUSDUration();
+    // returns -1 if the sfx is not decoded yet
+    double GetSFXDuration(unsigned key);
+
+    void SetSFXBudget(size_t bytes);
+    size_t GetSFXResidentBytes() const { return sfxResidentBytes; }
 
     
     void SetSFXPosition(int channel, glm::vec3 hearFacingDirection, glm::vec3 hearPosition, glm::vec3 sourcePosition, float maxDistance = 25);
@@ -70,18 +144,191 @@ public:
     void CloseMixer();
     void ExitSystem();
 
+    struct Stats {
+        unsigned commands = 0;
+        // times the game thread had to drain a full queue itself
+        unsigned flushes = 0;
+        unsigned maxQueueDepth = 0;
+        // channel finishes that did not fit in the finished queue
+        unsigned finishedOverflows = 0;
+        double lastUpdateMs = 0;
+        double maxUpdateMs = 0;
+    };
+    const Stats& GetStats() const { return stats; }
+    void ResetStats() { stats = Stats(); finishedOverflows = 0; }
+
 private:
 
+    enum COMMAND_TYPE {
+        CMD_PLAY_CHANNEL,
+        CMD_HALT_CHANNEL,
+        CMD_SET_POSITION,
+        CMD_VOLUME_CHANNEL,
+        CMD_VOLUME_CHUNK,
+        CMD_PLAY_MUSIC,
+        CMD_FADE_IN_MUSIC,
+        CMD_FADE_OUT_MUSIC,
+        CMD_PAUSE_MUSIC,
+        CMD_RESUME_MUSIC,
+        CMD_REWIND_MUSIC,
+        CMD_MUSIC_POSITION,
+        CMD_VOLUME_MUSIC,
+    };
+
+    struct Command {
+        COMMAND_TYPE type;
+        int channel = -1;
+        // loops, volume, fade ms or angle depending on the type
+        int value = 0;
+        // distance for CMD_SET_POSITION, play id for CMD_PLAY_CHANNEL
+        unsigned extra = 0;
+        double position = 0;
+        Mix_Chunk* chunk = nullptr;
+        Mix_Music* music = nullptr;
+    };
+
+    // sent back from the audio thread when a channel stops, playID tells apart a halt of an old play from the current one
+    struct ChannelFinished {
+        int channel;
+        unsigned playID;
+    };
+
+    enum SFX_STATE {
+        SFX_UNLOADED,
+        SFX_DECODING,
+        SFX_RESIDENT,
+    };
+
+    struct SFX {
+        std::string path;
+        SFX_STATE state = SFX_UNLOADED;
+        Mix_Chunk* chunk = nullptr;
+        bool hot = true;
+        // -1 = leave the chunk's volume as it is
+        int volume = -1;
+        Uint32 lastPlayedTick = 0;
+        // voices (playing or virtual) using this sfx, it cannot be evicted while this is above 0
+        unsigned voiceCount = 0;
+        // unique per load, decodes finishing after an unload or reload are thrown away
+        unsigned generation = 0;
+    };
+
+    struct DecodeRequest {
+        unsigned key;
+        unsigned generation;
+        std::string path;
+    };
+
+    struct DecodeResult {
+        unsigned key;
+        unsigned generation;
+        Mix_Chunk* chunk;
+    };
+
+    struct Voice {
+        unsigned handle;
+        unsigned key;
+        int priority = 0;
+        int loops = 0;
+        // -1 = any channel
+        int pinnedChannel = -1;
+        // -1 = virtual
+        int channel = -1;
+
+        bool positional = false;
+        glm::vec3 position = glm::vec3(0);
+        float maxDistance = 25;
+
+        // matches ChannelFinished::playID for the play currently on channel
+        unsigned playID = 0;
+        // 0 until the sfx is decoded, then the tick it started (or would have started) playing
+        Uint32 startTick = 0;
+        float audibility = 1;
+    };
+
     static constexpr unsigned TOTAL_SFX_CHANNEL = 32;
-    std::map<int, Mix_Chunk*> sfxList;
+    static constexpr unsigned MAX_VOICE = 512;
+    // one shot voices that lose their channel after playing this long are dropped instead of restarting
+    static constexpr Uint32 VOICE_RESTART_WINDOW_MS = 250;
+    std::map<unsigned, SFX> sfxList;
     Mix_Music* music = nullptr;
-    double musicDuration;
+    double musicDuration = 0;
     bool musicPlaying = false;
 
+    std::vector<Voice> voiceList;
+    // handle of the voice on each channel, 0 = free
+    unsigned channelVoice[TOTAL_SFX_CHANNEL] = {};
+    unsigned nextVoiceHandle = 0;
+    glm::vec3 listenerPosition = glm::vec3(0);
+    glm::vec3 listenerFacing = glm::vec3(0, 0, -1);
+
+    size_t sfxBudget = 32 * 1024 * 1024;
+    size_t sfxResidentBytes = 0;
+
+    // decode thread, requests go in and results come out under the same mutex
+    std::thread decodeThread;
+    std::mutex decodeMutex;
+    std::condition_variable decodeCondition;
+    std::deque<DecodeRequest> decodeRequests;
+    std::vector<DecodeResult> decodeResults;
+    bool decodeThreadRunning = false;
+    unsigned nextGeneration = 0;
+
+    // game thread -> audio thread, drained in PostMix(), or by the game thread under drainMutex when full
+    SPSCQueue<Command, 1024> commandQueue;
+    std::mutex drainMutex;
+    // audio thread -> game thread, pushed from ChannelFinishedCallback()
+    SPSCQueue<ChannelFinished, 256> finishedQueue;
+    static_assert(decltype(finishedQueue)::capacity() >= TOTAL_SFX_CHANNEL, "every channel has to be able to finish between 2 Update()");
+    unsigned nextPlayID = 0;
+    // written when a play command runs, read by ChannelFinishedCallback()
+    std::atomic<unsigned> channelPlayID[TOTAL_SFX_CHANNEL] = {};
+    // finishes that did not go through finishedQueue, plays Mix_PlayChannel() refused or finishes while the queue was full,
+    // only the last one per channel is kept since older plays no longer own a voice, 0 once CollectFinishedChannels() took it
+    std::atomic<unsigned> channelLostPlayID[TOTAL_SFX_CHANNEL] = {};
+    std::atomic<unsigned> finishedOverflows{ 0 };
+
+    // music PostMix() samples the position of, set by the music play commands, only touched under drainMutex
+    Mix_Music* positionMusic = nullptr;
+    std::atomic<double> musicPosition{ 0 };
+
+    // cached so the game thread never has to ask the mixer
+    int channelVolume[TOTAL_SFX_CHANNEL];
+    int musicVolume = MIX_MAX_VOLUME;
+    int mixerFrequency = 44100;
+    Uint16 mixerFormat = MIX_DEFAULT_FORMAT;
+    int mixerChannels = 2;
+
+    Stats stats;
+
+    void Send(const Command& command);
+    void HaltChannel(int channel);
+    void DrainCommands();
+    void FlushCommands();
+    void Execute(const Command& command);
+    void CollectFinishedChannels();
+    static void PostMix(void* userdata, Uint8* stream, int length);
+    static void ChannelFinishedCallback(int channel);
+
+    void DecodeLoop();
+    void RequestDecode(unsigned key, SFX& sfx);
+    void CollectDecodes();
+    void EvictOverBudget();
+    void FreeSFX(SFX& sfx);
+    void PlayChunk(SFX& sfx, int channel, int loops, unsigned playID);
+
+    unsigned StartVoice(Voice voice);
+    void UpdateVoices();
+    void RemoveVoice(unsigned index);
+    Voice* FindVoice(unsigned handle);
+    // 0 - 1 from the listener, 0 = culled
+    float Audibility(const Voice& voice) const;
+    double ChunkDuration(const Mix_Chunk* chunk) const;
+
     std::string directoryMusic;
     std::string directorySFX;
 
-    AudioManager() = default;
+    AudioManager();
     ~AudioManager();
     AudioManager(const AudioManager&) = delete;
     AudioManager& operator=(const AudioManager&) = delete;
@@ -1,5 +1,6 @@
 #define _USE_MATH_DEFINES
 #include <cmath>
+#include <algorithm>
 
 #include "BaseScene.h"
 
@@ -8,10 +9,10 @@
 //Include GLFW
 #include <GLFW/glfw3.h>
 
-#include <glm\glm.hpp>
-#include <glm\gtc\matrix_transform.hpp>
-#include <glm\gtc\type_ptr.hpp>
-#include <glm\gtc\matrix_inverse.hpp>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/matrix_inverse.hpp>
 
 #include "Light.h"
 #include "shader.hpp"
@@ -21,8 +22,11 @@
 #include "MouseController.h"
 #include "KeyboardController.h"
 #include "AudioManager.h"
+#include "Profiler.h"
 #include "DataManager.h"
 #include "PhysicsManager.h"
+#include "ResourceManager.h"
+#include "Console.h"
 
 #include "Utils.h"
 
@@ -33,12 +37,19 @@ using glm::vec3;
 using glm::mat4;
 using std::string;
 
+// taken by reference, C++14 needs the definitions
+constexpr float BaseScene::NEAR_PLANE;
+constexpr float BaseScene::FAR_PLANE;
+constexpr unsigned BaseScene::SHADING_LOD_TOTAL;
+
 
 /*****************************************************************************************************************************************************************************************/
 /************************************************************************************ scene functions ************************************************************************************/
 /*****************************************************************************************************************************************************************************************/
 
 BaseScene::BaseScene() {
+	for (auto& mesh : meshList)
+		mesh = nullptr;
 }
 
 BaseScene::~BaseScene() {
@@ -66,59 +77,79 @@ void BaseScene::Init()
 	glGenVertexArrays(1, &m_vertexArrayID);
 	glBindVertexArray(m_vertexArrayID);
 
-	// Load the shader programs
-	m_programID = LoadShaders("Shader//Texture.vertexshader", "Shader//Text_Atmospheric.fragmentshader");
-	glUseProgram(m_programID);
+	// Load the shader programs, every feature combination is its own program instead of bool uniforms branched on per pixel
+	shaderVariants.Load("Shader//Texture.vertexshader", "Shader//Text_Atmospheric.fragmentshader", "ShaderCache");
 
 	// init prespective
-	perspective = glm::perspective(45.f, App::ASPECT_RATIO, 0.1f, 1000.f);
+	perspective = glm::perspective(45.f, App::ASPECT_RATIO, NEAR_PLANE, FAR_PLANE);
 	ortho = glm::ortho(0.f, App::SCREEN_WIDTH, 0.f, App::SCREEN_HEIGHT, -1000.f, 1000.f);
 
-	// Init uniforms
+	// uniform blocks, atmosphere used to be a glUniform call per member, now it is 1 buffer update when it changes
 	{
-	    // Get a handle for our "MVP" uniform
-		m_parameters[U_MVP] = glGetUniformLocation(m_programID, "MVP");
-		m_parameters[U_MODELVIEW] = glGetUniformLocation(m_programID, "MV");
-		m_parameters[U_MODELVIEW_INVERSE_TRANSPOSE] = glGetUniformLocation(m_programID, "MV_inverse_transpose");
-		m_parameters[U_MATERIAL_AMBIENT] = glGetUniformLocation(m_programID, "material.kAmbient");
-		m_parameters[U_MATERIAL_DIFFUSE] = glGetUniformLocation(m_programID, "material.kDiffuse");
-		m_parameters[U_MATERIAL_SPECULAR] = glGetUniformLocation(m_programID, "material.kSpecular");
-		m_parameters[U_MATERIAL_SHININESS] = glGetUniformLocation(m_programID, "material.kShininess");
-
-		m_parameters[U_LIGHT_ENABLED] = glGetUniformLocation(m_programID, "lightEnabled");
-		m_parameters[U_LIGHT_NUMLIGHTS] = glGetUniformLocation(m_programID, "numLights");
-
-		m_parameters[U_ATMOSPHERE_ENABLED] = glGetUniformLocation(m_programID, "atmosphereEnabled");
-
-		m_parameters[U_COLOR_TEXTURE_ENABLED] = glGetUniformLocation(m_programID, "colorTextureEnabled");
-		m_parameters[U_COLOR_TEXTURE] = glGetUniformLocation(m_programID, "colorTexture");
-		m_parameters[U_LIGHT_ENABLED] = glGetUniformLocation(m_programID, "lightEnabled");
-		m_parameters[U_TEXT_ENABLED] = glGetUniformLocation(m_programID, "textEnabled");
-		m_parameters[U_TEXT_COLOR] = glGetUniformLocation(m_programID, "textColor");
-
-		Mesh::SetMaterialLoc(m_parameters[U_MATERIAL_AMBIENT], m_parameters[U_MATERIAL_DIFFUSE], m_parameters[U_MATERIAL_SPECULAR], m_parameters[U_MATERIAL_SHININESS]);
-	
-		for (unsigned lightIndex = 0; lightIndex < MAX_LIGHT; lightIndex++) {
-			string param;
-			param.reserve(30);
-			lightUniformLocations[lightIndex][U_LIGHT_TYPE] = glGetUniformLocation(m_programID, param.assign("lights[" + std::to_string(lightIndex) + "].type").c_str());
-			lightUniformLocations[lightIndex][U_LIGHT_POSITION] = glGetUniformLocation(m_programID, param.assign("lights[" + std::to_string(lightIndex) + "].position_cameraspace").c_str());
-			lightUniformLocations[lightIndex][U_LIGHT_COLOR] = glGetUniformLocation(m_programID, param.assign("lights[" + std::to_string(lightIndex) + "].color").c_str());
-			lightUniformLocations[lightIndex][U_LIGHT_POWER] = glGetUniformLocation(m_programID, param.assign("lights[" + std::to_string(lightIndex) + "].power").c_str());
-			lightUniformLocations[lightIndex][U_LIGHT_KC] = glGetUniformLocation(m_programID, param.assign("lights[" + std::to_string(lightIndex) + "].kC").c_str());
-			lightUniformLocations[lightIndex][U_LIGHT_KL] = glGetUniformLocation(m_programID, param.assign("lights[" + std::to_string(lightIndex) + "].kL").c_str());
-			lightUniformLocations[lightIndex][U_LIGHT_KQ] = glGetUniformLocation(m_programID, param.assign("lights[" + std::to_string(lightIndex) + "].kQ").c_str());
-			lightUniformLocations[lightIndex][U_LIGHT_SPOTDIRECTION] = glGetUniformLocation(m_programID, param.assign("lights[" + std::to_string(lightIndex) + "].spotDirection").c_str());
-			lightUniformLocations[lightIndex][U_LIGHT_COSCUTOFF] = glGetUniformLocation(m_programID, param.assign("lights[" + std::to_string(lightIndex) + "].cosCutoff").c_str());
-			lightUniformLocations[lightIndex][U_LIGHT_COSINNER] = glGetUniformLocation(m_programID, param.assign("lights[" + std::to_string(lightIndex) + "].cosInner").c_str());
+		atmosphereBlock.Create(UBO_ATMOSPHERE);
+		frameBlock.Create(UBO_FRAME);
+
+		frameBlock.Set(frameBlock.Get().nearPlane, NEAR_PLANE);
+		frameBlock.Set(frameBlock.Get().farPlane, FAR_PLANE);
+		frameBlock.Set(frameBlock.Get().viewportSize, glm::vec2(App::SCREEN_WIDTH, App::SCREEN_HEIGHT));
+	}
+
+	// clustered lights, the fragment shader finds its cluster's lights through 3 texture buffers
+	lightClusters.Create(MAX_LIGHT, perspective, NEAR_PLANE, FAR_PLANE);
+
+	// shadow maps of every shadow casting light share 1 depth atlas
+	shadowAtlas.Create(UBO_SHADOW);
+
+	// HDR scene target, MSAA or FXAA, bloom and dynamic resolution, the targets are made on the first Render()
+	postProcess.Create(static_cast<unsigned>(App::SCREEN_WIDTH), static_cast<unsigned>(App::SCREEN_HEIGHT));
+
+	// hierarchical depth for occlusion culling, see SetOcclusionMode()
+	occlusionCuller.Create(static_cast<unsigned>(App::SCREEN_WIDTH), static_cast<unsigned>(App::SCREEN_HEIGHT));
+
+	// depth pre-pass, position only
+	depthProgramID = LoadShaders("Shader//Depth.vertexshader", "Shader//Depth.fragmentshader", "", "ShaderCache");
+	depthMVPLocation = glGetUniformLocation(depthProgramID, "MVP");
+
+	// Init uniforms, locations, block bindings and samplers are per program so every variant gets them
+	for (unsigned variant : ShaderVariants::GetVariants())
+	{
+		unsigned programID = shaderVariants.GetProgram(variant);
+		auto& parameters = variantParameters[variant];
+		glUseProgram(programID);
+
+		// Get a handle for our "MVP" uniform
+		parameters[U_MVP] = glGetUniformLocation(programID, "MVP");
+		parameters[U_MODELVIEW] = glGetUniformLocation(programID, "MV");
+		parameters[U_MODELVIEW_INVERSE_TRANSPOSE] = glGetUniformLocation(programID, "MV_inverse_transpose");
+		parameters[U_MATERIAL_AMBIENT] = glGetUniformLocation(programID, "material.kAmbient");
+		parameters[U_MATERIAL_DIFFUSE] = glGetUniformLocation(programID, "material.kDiffuse");
+		parameters[U_MATERIAL_SPECULAR] = glGetUniformLocation(programID, "material.kSpecular");
+		parameters[U_MATERIAL_SHININESS] = glGetUniformLocation(programID, "material.kShininess");
+
+		parameters[U_COLOR_TEXTURE] = glGetUniformLocation(programID, "colorTexture");
+		parameters[U_TEXT_COLOR] = glGetUniformLocation(programID, "textColor");
+		parameters[U_BLOOM] = glGetUniformLocation(programID, "bloom");
+
+		// unlit variants read neither block, glsl drops them
+		if (variant & ShaderVariants::LIGHTING) {
+			if (!UniformBuffer::BindBlock(programID, "FrameBlock", UBO_FRAME))
+				Error("BaseScene: FrameBlock is not active in shader variant " + std::to_string(variant));
+			if ((variant & ShaderVariants::ATMOSPHERE) && !UniformBuffer::BindBlock(programID, "AtmosphereBlock", UBO_ATMOSPHERE))
+				Error("BaseScene: AtmosphereBlock is not active in shader variant " + std::to_string(variant));
+			// Gouraud shading skips shadows
+			if (!(variant & ShaderVariants::VERTEX_SHADING) && !UniformBuffer::BindBlock(programID, "ShadowBlock", UBO_SHADOW))
+				Error("BaseScene: ShadowBlock is not active in shader variant " + std::to_string(variant));
+			glUniform1i(glGetUniformLocation(programID, "shadowAtlas"), UNIT_SHADOW_ATLAS);
 		}
 
-		atmosphereUniformLocations[U_ATMOSPHERE_COLOR] = glGetUniformLocation(m_programID, "atmosphere.color");
-		atmosphereUniformLocations[U_ATMOSPHERE_FOG_DENSITY] = glGetUniformLocation(m_programID, "atmosphere.fogDensity");
-		atmosphereUniformLocations[U_ATMOSPHERE_FOG_VISIBILITY] = glGetUniformLocation(m_programID, "atmosphere.fogVisibility");
-		atmosphereUniformLocations[U_ATMOSPHERE_LIGHTEST_RANGE] = glGetUniformLocation(m_programID, "atmosphere.lightestRange");
-		atmosphereUniformLocations[U_ATMOSPHERE_DENSEST_RANGE] = glGetUniformLocation(m_programID, "atmosphere.densestRange");
+		glUniform1i(parameters[U_COLOR_TEXTURE], UNIT_COLOR);
+		glUniform1i(glGetUniformLocation(programID, "lightData"), UNIT_LIGHT_DATA);
+		glUniform1i(glGetUniformLocation(programID, "lightClusters"), UNIT_LIGHT_DATA + 1);
+		glUniform1i(glGetUniformLocation(programID, "lightIndices"), UNIT_LIGHT_DATA + 2);
+		glUniform2fv(glGetUniformLocation(programID, "clusterDepthScaleBias"), 1, glm::value_ptr(lightClusters.GetDepthScaleBias()));
 	}
+	currentVariant = ShaderVariants::MASK_COUNT;
+	UseShaderVariant(0);
 
 	// init physics
 	{
@@ -138,8 +169,23 @@ void BaseScene::Update(double dt) {
 
 void BaseScene::Render()
 {
-	// clear screens
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	// binds and clears the scene target, the viewport is the render resolution from here to ResolveScene()
+	postProcess.BeginScene();
+	// the light clusters are found from gl_FragCoord, which runs over the render resolution
+	frameBlock.Set(frameBlock.Get().viewportSize, glm::vec2(postProcess.GetRenderWidth(), postProcess.GetRenderHeight()));
+
+	// anything could have been bound since the last frame
+	boundTextureID = 0;
+	currentVariant = ShaderVariants::MASK_COUNT;
+	shaderSwitches = 0;
+	shadingLodCounts.fill(0);
+	meshLodCounts.fill(0);
+	frameTrianglesStart = Mesh::drawnTriangles;
+	depthPrePassDraws = 0;
+	ReadShadedSamples();
+	UseShaderVariant(0);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, 0);
 
 	// Define the model matrix and set it to identity
 	modelStack.Clear();
@@ -154,37 +200,39 @@ void BaseScene::Render()
 	viewStack.LoadMatrix(view);
 
 	// Calculate the light position in camera space
-	auto& light = LightObject::lightList;
-	for (unsigned i = 0; i < LightObject::lightList.size(); i++) {
-		auto lightObj = light[i].lock();
-		auto& lightProperties = lightObj->lightProperties;
-
-		if (lightProperties.type == Light::LIGHT_DIRECTIONAL) {
-			// use light pos as the dire of light
-			glm::vec3 lightPos_local = lightProperties.position;
-			lightProperties.position = viewStack.Top() * glm::vec4(lightProperties.position, 0); // lightDirection_cameraspace
-			UpdateLightUniform(lightObj, U_LIGHT_POSITION);
-			lightProperties.position = lightPos_local;
+	{
+		PROFILE_ZONE("Light clusters");
+		auto& light = LightObject::lightList;
+		lightClusters.SetLightCount(static_cast<unsigned>(light.size()));
+		for (unsigned i = 0; i < light.size(); i++) {
+			auto lightObj = light[i].lock();
+			if (!lightObj || lightObj->lightIndex >= MAX_LIGHT)
+				continue;
+			const auto& lightProperties = lightObj->lightProperties;
+			LightClusters::LightData data = lightClusters.GetLight(lightObj->lightIndex);
+
+			if (lightProperties.type == Light::LIGHT_DIRECTIONAL) {
+				// use light pos as the dire of light
+				data.position_cameraspace = vec3(view * glm::vec4(lightProperties.position, 0)); // lightDirection_cameraspace
+			}
+			else if (lightProperties.type == Light::LIGHT_SPOT) {
+				data.position_cameraspace = vec3(view * glm::vec4(lightProperties.position, 1)); // lightPosition_cameraspace
+				data.spotDirection = vec3(-view * glm::vec4(lightProperties.spotDirection, 0)); // spotDirection_cameraspace
+			}
+			else {
+				data.position_cameraspace = vec3(view * glm::vec4(lightProperties.position, 1)); // lightPosition_cameraspace
+			}
+			// RenderShadows() hands out the tiles
+			data.shadow = -1;
+			lightClusters.SetLight(lightObj->lightIndex, data);
 		}
-		else if (lightProperties.type == Light::LIGHT_SPOT) {
 
-			glm::vec3 lightPos_local = lightProperties.position;
-			lightProperties.position = viewStack.Top() * glm::vec4(lightProperties.position, 1); // lightPosition_cameraspace
-			UpdateLightUniform(lightObj, U_LIGHT_POSITION);
-			lightProperties.position = lightPos_local;
+		if (enabledShadows)
+			RenderShadows(view);
 
-			glm::vec3 spotDire_local = lightProperties.spotDirection;
-			lightProperties.spotDirection = -viewStack.Top() * glm::vec4(lightProperties.spotDirection, 0);// spotDirection_cameraspace
-			UpdateLightUniform(lightObj, U_LIGHT_SPOTDIRECTION);
-			lightProperties.spotDirection = spotDire_local;
-		}
-		else {
-			// Calculate the light position in camera space
-			glm::vec3 lightPos_local = lightProperties.position;
-			lightProperties.position = viewStack.Top() * glm::vec4(lightProperties.position, 1); // lightPosition_cameraspace
-			UpdateLightUniform(lightObj, U_LIGHT_POSITION);
-			lightProperties.position = lightPos_local;
-		}
+		lightClusters.Build();
+		lightClusters.Upload();
+		lightClusters.Bind(UNIT_LIGHT_DATA);
 	}
 
 	// Define the projection matrix
@@ -197,14 +245,36 @@ void BaseScene::Render()
 	glm::mat4 MVP = projectionStack.Top() * viewStack.Top() * modelStack.Top();
 	glUniformMatrix4fv(m_parameters[U_MVP], 1, GL_FALSE, glm::value_ptr(MVP));
 
+	frameBlock.Set(frameBlock.Get().view, view);
+	frameBlock.Set(frameBlock.Get().projection, projectionStack.Top());
+	frameBlock.Set(frameBlock.Get().cameraPosition_worldspace, glm::vec4(camera.GetFinalPosition(), 1));
+
+	// what the world list is tested against, the readback of an earlier frame or this frame's occluders drawn on the cpu
+	{
+		PROFILE_ZONE("Occlusion");
+		occlusionCuller.BeginFrame(projectionStack.Top() * view, camera.GetFinalPosition());
+		if (occlusionCuller.GetMode() == OcclusionCuller::MODE_CPU) {
+			for (auto& obj_wptr : RObj::worldList) {
+				auto obj = obj_wptr.lock();
+				if (obj && obj->occluder && obj->allowRender && meshList[obj->geometryType])
+					occlusionCuller.RasterizeOccluder(*meshList[obj->geometryType], obj->model);
+			}
+			occlusionCuller.EndOccluders();
+		}
+	}
+
+	// everything Update() and the code above changed, 1 upload per block at most
+	atmosphereBlock.Upload();
+	frameBlock.Upload();
 }
 
 void BaseScene::Exit()
 {
-	// Cleanup VBO here
-	for (auto& mesh : meshList)
-		if (mesh)
-			delete mesh;
+	// Cleanup VBO here, shared meshes stay resident in ResourceManager until evicted
+	for (auto& mesh : meshList) {
+		ResourceManager::GetInstance().ReleaseMesh(mesh);
+		mesh = nullptr;
+	}
 
 	DataManager::GetInstance().SaveData();
 
@@ -217,60 +287,378 @@ void BaseScene::Exit()
 
 	PhysicsManager::GetInstance().CleanUp();
 
+	lightClusters.Destroy();
+	shadowAtlas.Destroy();
+	postProcess.Destroy();
+	occlusionCuller.Destroy();
+	atmosphereBlock.Destroy();
+	frameBlock.Destroy();
+
 	glDeleteVertexArrays(1, &m_vertexArrayID);
-	glDeleteProgram(m_programID);
+	shaderVariants.Release();
+	if (depthProgramID != 0)
+		glDeleteProgram(depthProgramID);
+	depthProgramID = 0;
+	for (auto& queries : sampleQueries) {
+		if (!queries.empty())
+			glDeleteQueries(static_cast<GLsizei>(queries.size()), queries.data());
+		queries.clear();
+	}
 }
 
 
 /*********************************************************************************************************************************************************************************/
 /************************************************************************************ helpers ************************************************************************************/
+
+void BaseScene::BindTexture(unsigned textureID)
+{
+	if (textureID == boundTextureID)
+		return;
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, textureID);
+	boundTextureID = textureID;
+}
+
+void BaseScene::UseShaderVariant(unsigned mask)
+{
+	unsigned variant = ShaderVariants::Normalize(mask);
+	if (variant == currentVariant)
+		return;
+
+	glUseProgram(shaderVariants.GetProgram(variant));
+	std::copy(variantParameters[variant].begin(), variantParameters[variant].end(), m_parameters);
+	Mesh::SetMaterialLoc(m_parameters[U_MATERIAL_AMBIENT], m_parameters[U_MATERIAL_DIFFUSE], m_parameters[U_MATERIAL_SPECULAR], m_parameters[U_MATERIAL_SHININESS]);
+	currentVariant = variant;
+	shaderSwitches++;
+}
+
+void BaseScene::BeginDepthPrePass()
+{
+	// only the shaded draws are counted
+	if (sampleQueryActive)
+		EndSampleQuery();
+
+	glUseProgram(depthProgramID);
+	// multi material meshes set their material per draw, the depth program has none
+	Mesh::SetMaterialLoc(static_cast<unsigned>(-1), static_cast<unsigned>(-1), static_cast<unsigned>(-1), static_cast<unsigned>(-1));
+	currentVariant = ShaderVariants::MASK_COUNT;
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	glDepthMask(GL_TRUE);
+	glDepthFunc(GL_LESS);
+}
+
+void BaseScene::RenderDepth(Mesh* mesh, const glm::mat4& MVP, unsigned lod)
+{
+	glUniformMatrix4fv(depthMVPLocation, 1, GL_FALSE, glm::value_ptr(MVP));
+	// the same level as the shaded draw, GL_EQUAL only passes on identical triangles
+	mesh->RenderLod(lod);
+	depthPrePassDraws++;
+}
+
+void BaseScene::EndDepthPrePass()
+{
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	// the depth is already final, writing it again is wasted bandwidth
+	glDepthMask(GL_FALSE);
+	glDepthFunc(GL_EQUAL);
+
+	if (countingSamples)
+		BeginSampleQuery();
+}
+
+void BaseScene::EndDepthEqualPass()
+{
+	glDepthMask(GL_TRUE);
+	glDepthFunc(GL_LESS);
+}
+
+void BaseScene::BeginShadedSamples()
+{
+	if (!countShadedSamples || countingSamples)
+		return;
+	countingSamples = true;
+	BeginSampleQuery();
+}
+
+void BaseScene::EndShadedSamples()
+{
+	if (sampleQueryActive)
+		EndSampleQuery();
+	countingSamples = false;
+}
+
+void BaseScene::BeginSampleQuery()
+{
+	std::vector<unsigned>& queries = sampleQueries[sampleQueryFrame];
+	unsigned& used = usedSampleQueries[sampleQueryFrame];
+	if (used == queries.size()) {
+		unsigned query;
+		glGenQueries(1, &query);
+		queries.push_back(query);
+	}
+	glBeginQuery(GL_SAMPLES_PASSED, queries[used++]);
+	sampleQueryActive = true;
+}
+
+void BaseScene::EndSampleQuery()
+{
+	glEndQuery(GL_SAMPLES_PASSED);
+	sampleQueryActive = false;
+}
+
+bool BaseScene::IsOccluded(const std::shared_ptr<RenderObject>& obj, const glm::mat4& model)
+{
+	const Mesh* mesh = meshList[obj->geometryType];
+	if (!mesh || mesh->boundsRadius <= 0)
+		return false;
+	return occlusionCuller.IsOccluded(mesh->boundsMin, mesh->boundsMax, model);
+}
+
+void BaseScene::CaptureOcclusionDepth()
+{
+	if (occlusionCuller.GetMode() != OcclusionCuller::MODE_GPU)
+		return;
+	occlusionCuller.CaptureDepth(postProcess.GetSceneTarget(), postProcess.GetRenderWidth(), postProcess.GetRenderHeight());
+
+	// the reduction program and the depth copy were bound in between
+	boundTextureID = 0;
+	currentVariant = ShaderVariants::MASK_COUNT;
+	UseShaderVariant(0);
+}
+
+void BaseScene::ResolveScene()
+{
+	PROFILE_ZONE("Post process");
+	PROFILE_GPU_ZONE("Post");
+	postProcess.EndScene();
+
+	// the post programs and textures were bound in between
+	boundTextureID = 0;
+	currentVariant = ShaderVariants::MASK_COUNT;
+	UseShaderVariant(0);
+}
+
+void BaseScene::ReadShadedSamples()
+{
+	if (sampleQueryActive)
+		EndSampleQuery();
+	countingSamples = false;
+
+	// the other frame's queries were issued 2 frames ago, long done by now
+	sampleQueryFrame = 1 - sampleQueryFrame;
+	unsigned& used = usedSampleQueries[sampleQueryFrame];
+	if (used == 0) {
+		if (!countShadedSamples)
+			shadedSamples = 0;
+		return;
+	}
+	unsigned long long total = 0;
+	for (unsigned i = 0; i < used; i++) {
+		GLuint samples = 0;
+		glGetQueryObjectuiv(sampleQueries[sampleQueryFrame][i], GL_QUERY_RESULT, &samples);
+		total += samples;
+	}
+	shadedSamples = total;
+	used = 0;
+}
+
+unsigned BaseScene::GetShadingLod(const Mesh* mesh, const glm::mat4& modelView) const
+{
+	if (shadingQuality == SHADING_HIGH)
+		return 0;
+	if (shadingQuality == SHADING_VERTEX_ONLY)
+		return ShaderVariants::VERTEX_SHADING;
+	// meshes without bounds, e.g. the physics debug lines, are never simplified
+	if (!mesh || mesh->boundsRadius <= 0)
+		return 0;
+
+	glm::vec3 center = vec3(modelView * glm::vec4(mesh->boundsCenter, 1));
+	float scale = std::max(glm::length(vec3(modelView[0])), std::max(glm::length(vec3(modelView[1])), glm::length(vec3(modelView[2]))));
+	float radius = mesh->boundsRadius * scale;
+	float distance = glm::length(center);
+	// the camera is inside it
+	if (distance <= radius)
+		return 0;
+
+	// perspective[1][1] is 1 / tan(fov / 2), so this is the sphere's share of the screen height in pixels
+	float pixels = radius / distance * perspective[1][1] * App::SCREEN_HEIGHT;
+	float thresholdScale = shadingQuality == SHADING_LOW ? 2.f : 1.f;
+	if (pixels < vertexShadingPixels * thresholdScale)
+		return ShaderVariants::VERTEX_SHADING;
+	if (pixels < reducedShadingPixels * thresholdScale)
+		return ShaderVariants::REDUCED_SHADING;
+	return 0;
+}
+
+void BaseScene::CountShadingLod(unsigned lod)
+{
+	if (lod & ShaderVariants::VERTEX_SHADING)
+		shadingLodCounts[2]++;
+	else if (lod & ShaderVariants::REDUCED_SHADING)
+		shadingLodCounts[1]++;
+	else
+		shadingLodCounts[0]++;
+}
+
+unsigned BaseScene::SelectLod(const Mesh* mesh, const glm::mat4& modelView, unsigned previous) const
+{
+	if (!enabledMeshLod || !mesh || mesh->GetLodCount() == 1 || mesh->boundsRadius <= 0)
+		return 0;
+
+	glm::vec3 center = vec3(modelView * glm::vec4(mesh->boundsCenter, 1));
+	float scale = std::max(glm::length(vec3(modelView[0])), std::max(glm::length(vec3(modelView[1])), glm::length(vec3(modelView[2]))));
+	float distance = glm::length(center);
+	// the camera is inside it
+	if (distance <= mesh->boundsRadius * scale)
+		return 0;
+
+	// pixels a model space unit covers at the sphere's distance, perspective[1][1] is 1 / tan(fov / 2)
+	float pixelsPerUnit = scale / distance * perspective[1][1] * App::SCREEN_HEIGHT * 0.5f;
+	unsigned level = std::min(previous, mesh->GetLodCount() - 1);
+	while (level > 0 && mesh->GetLodError(level) * pixelsPerUnit > lodPixelError)
+		level--;
+	while (level + 1 < mesh->GetLodCount() && mesh->GetLodError(level + 1) * pixelsPerUnit < lodPixelError * LOD_HYSTERESIS)
+		level++;
+	return level;
+}
+
+void BaseScene::CountMeshLod(unsigned level)
+{
+	meshLodCounts[std::min(level, Mesh::MAX_LODS - 1)]++;
+}
+
+const char* BaseScene::GetShadingQualityName(SHADING_QUALITY quality)
+{
+	switch (quality) {
+	case SHADING_HIGH: return "high";
+	case SHADING_MEDIUM: return "medium";
+	case SHADING_LOW: return "low";
+	case SHADING_VERTEX_ONLY: return "vertex";
+	default: return "unknown";
+	}
+}
+
+void BaseScene::RenderShadows(const glm::mat4& view)
+{
+	PROFILE_ZONE("Shadows");
+
+	// casting lights, in light list order so the same lights keep the same tiles
+	shadowLights.clear();
+	for (auto& light_wptr : LightObject::lightList) {
+		auto lightObj = light_wptr.lock();
+		if (!lightObj || lightObj->lightIndex >= MAX_LIGHT)
+			continue;
+		const Light& properties = lightObj->lightProperties;
+		if (!properties.castShadows || (properties.type != Light::LIGHT_DIRECTIONAL && properties.type != Light::LIGHT_SPOT))
+			continue;
+
+		ShadowAtlas::ShadowLight light;
+		light.lightIndex = lightObj->lightIndex;
+		light.directional = properties.type == Light::LIGHT_DIRECTIONAL;
+		light.position = properties.position;
+		// a directional light's position is the direction towards it
+		light.direction = light.directional ? -properties.position : properties.spotDirection;
+		light.coneAngle = properties.cosCutoff * 2;
+		light.range = LightClusters::GetInfluenceRange(lightClusters.GetLight(lightObj->lightIndex));
+		// too weak to light anything, so nothing to shadow either
+		if (light.range == 0)
+			continue;
+		shadowLights.push_back(light);
+	}
+	if (shadowLights.empty())
+		return;
+
+	// anything lit and solid in the world may cast, the atlas culls them per tile
+	shadowCasters.clear();
+	for (auto& obj_wptr : RObj::worldList) {
+		auto obj = obj_wptr.lock();
+		if (!obj || !obj->allowRender || !obj->castShadows || obj->hasTransparency || obj->material.type == Material::NO_LIGHT)
+			continue;
+		if (std::dynamic_pointer_cast<LightObject>(obj) || std::dynamic_pointer_cast<TextObject>(obj))
+			continue;
+		Mesh* mesh = meshList[obj->geometryType];
+		if (!mesh || mesh->boundsRadius <= 0 || mesh->mode == Mesh::DRAW_LINES)
+			continue;
+
+		ShadowAtlas::Caster caster;
+		caster.id = obj.get();
+		caster.mesh = mesh;
+		// last frame's level, SceneDemo picks this frame's after the shadows are drawn
+		caster.lod = obj->lodLevel;
+		caster.model = obj->model;
+		caster.center = vec3(obj->model * glm::vec4(mesh->boundsCenter, 1));
+		float scale = std::max(glm::length(vec3(obj->model[0])), std::max(glm::length(vec3(obj->model[1])), glm::length(vec3(obj->model[2]))));
+		caster.radius = mesh->boundsRadius * scale;
+		shadowCasters.push_back(caster);
+	}
+
+	shadowAtlas.Render(view, perspective, shadowLights, shadowCasters);
+	shadowAtlas.Bind(UNIT_SHADOW_ATLAS);
+
+	for (const ShadowAtlas::ShadowLight& light : shadowLights) {
+		if (light.slot < 0)
+			continue;
+		LightClusters::LightData data = lightClusters.GetLight(light.lightIndex);
+		data.shadow = static_cast<float>(light.slot);
+		lightClusters.SetLight(light.lightIndex, data);
+	}
+
+	// the depth program was bound in between, and the material locations went with it
+	currentVariant = ShaderVariants::MASK_COUNT;
+	UseShaderVariant(0);
+}
 /*********************************************************************************************************************************************************************************/
 
 void BaseScene::UpdateLightUniform(const std::shared_ptr<LightObject>& lightObj, LIGHT_UNIFORM_TYPE uniform) {
+	if (!lightObj || lightObj->lightIndex >= MAX_LIGHT)
+		return;
 	const auto& lightProperties = lightObj->lightProperties;
-	const auto& lightIndex = lightObj->lightIndex;
+	LightClusters::LightData data = lightClusters.GetLight(lightObj->lightIndex);
 
 	switch (uniform) {
-	case U_LIGHT_TYPE: glUniform1i(lightUniformLocations[lightIndex][U_LIGHT_TYPE], lightProperties.type); break;
-	case U_LIGHT_POSITION: glUniform3fv(lightUniformLocations[lightIndex][U_LIGHT_POSITION], 1, glm::value_ptr(lightProperties.position)); break;
-	case U_LIGHT_COLOR: glUniform3fv(lightUniformLocations[lightIndex][U_LIGHT_COLOR], 1, glm::value_ptr(lightProperties.color)); break;
-	case U_LIGHT_POWER: glUniform1f(lightUniformLocations[lightIndex][U_LIGHT_POWER], lightProperties.power); break;
-	case U_LIGHT_KC: glUniform1f(lightUniformLocations[lightIndex][U_LIGHT_KC], lightProperties.kC); break;
-	case U_LIGHT_KL:glUniform1f(lightUniformLocations[lightIndex][U_LIGHT_KL], lightProperties.kL); break;
-	case U_LIGHT_KQ: glUniform1f(lightUniformLocations[lightIndex][U_LIGHT_KQ], lightProperties.kQ); break;
-	case U_LIGHT_SPOTDIRECTION: glUniform3fv(lightUniformLocations[lightIndex][U_LIGHT_SPOTDIRECTION], 1, glm::value_ptr(lightProperties.spotDirection)); break;
-	case U_LIGHT_COSCUTOFF: glUniform1f(lightUniformLocations[lightIndex][U_LIGHT_COSCUTOFF], cosf(glm::radians<float>(lightProperties.cosCutoff))); break;
-	case U_LIGHT_COSINNER: glUniform1f(lightUniformLocations[lightIndex][U_LIGHT_COSINNER], cosf(glm::radians<float>(lightProperties.cosInner))); break;
+	case U_LIGHT_TYPE: data.type = static_cast<float>(lightProperties.type); break;
+	case U_LIGHT_COLOR: data.color = lightProperties.color; break;
+	case U_LIGHT_POWER: data.power = lightProperties.power; break;
+	case U_LIGHT_KC: data.kC = lightProperties.kC; break;
+	case U_LIGHT_KL: data.kL = lightProperties.kL; break;
+	case U_LIGHT_KQ: data.kQ = lightProperties.kQ; break;
+	case U_LIGHT_COSCUTOFF: data.cosCutoff = cosf(glm::radians<float>(lightProperties.cosCutoff)); break;
+	case U_LIGHT_COSINNER: data.cosInner = cosf(glm::radians<float>(lightProperties.cosInner)); break;
+	// camera space, Render() writes them
+	case U_LIGHT_POSITION:
+	case U_LIGHT_SPOTDIRECTION:
+		break;
 	default:
-		glUniform1i(m_parameters[U_LIGHT_NUMLIGHTS], LightObject::lightList.size());
-		glUniform1i(lightUniformLocations[lightIndex][U_LIGHT_TYPE], lightProperties.type);
-		glUniform3fv(lightUniformLocations[lightIndex][U_LIGHT_POSITION], 1, glm::value_ptr(lightProperties.position));
-		glUniform3fv(lightUniformLocations[lightIndex][U_LIGHT_COLOR], 1, glm::value_ptr(lightProperties.color));
-		glUniform1f(lightUniformLocations[lightIndex][U_LIGHT_POWER], lightProperties.power);
-		glUniform1f(lightUniformLocations[lightIndex][U_LIGHT_KC], lightProperties.kC);
-		glUniform1f(lightUniformLocations[lightIndex][U_LIGHT_KL], lightProperties.kL);
-		glUniform1f(lightUniformLocations[lightIndex][U_LIGHT_KQ], lightProperties.kQ);
-		glUniform3fv(lightUniformLocations[lightIndex][U_LIGHT_SPOTDIRECTION], 1, glm::value_ptr(lightProperties.spotDirection));
-		glUniform1f(lightUniformLocations[lightIndex][U_LIGHT_COSCUTOFF], cosf(glm::radians<float>(lightProperties.cosCutoff)));
-		glUniform1f(lightUniformLocations[lightIndex][U_LIGHT_COSINNER], cosf(glm::radians<float>(lightProperties.cosInner)));
+		data.type = static_cast<float>(lightProperties.type);
+		data.color = lightProperties.color;
+		data.power = lightProperties.power;
+		data.kC = lightProperties.kC;
+		data.kL = lightProperties.kL;
+		data.kQ = lightProperties.kQ;
+		data.cosCutoff = cosf(glm::radians<float>(lightProperties.cosCutoff));
+		data.cosInner = cosf(glm::radians<float>(lightProperties.cosInner));
 	}
+	lightClusters.SetLight(lightObj->lightIndex, data);
 }
 
 
 void BaseScene::UpdateAtmosphereUniform(ATMOSPHERE_UNIFORM_TYPE uniform) {
+	const AtmosphereBlock& data = atmosphereBlock.Get();
+
 	switch (uniform) {
-	case U_ATMOSPHERE_COLOR: glUniform3fv(atmosphereUniformLocations[U_ATMOSPHERE_COLOR], 1, glm::value_ptr(atmosphere.color)); break;
-	case U_ATMOSPHERE_FOG_DENSITY: glUniform1f(atmosphereUniformLocations[U_ATMOSPHERE_FOG_DENSITY], atmosphere.fogDensity); break;
-	case U_ATMOSPHERE_FOG_VISIBILITY: glUniform1f(atmosphereUniformLocations[U_ATMOSPHERE_FOG_VISIBILITY], atmosphere.fogVisibility); break;
-	case U_ATMOSPHERE_LIGHTEST_RANGE: glUniform1f(atmosphereUniformLocations[U_ATMOSPHERE_LIGHTEST_RANGE], atmosphere.lightestRange); break;
-	case U_ATMOSPHERE_DENSEST_RANGE: glUniform1f(atmosphereUniformLocations[U_ATMOSPHERE_DENSEST_RANGE], atmosphere.densestRange); break;
+	case U_ATMOSPHERE_COLOR: atmosphereBlock.Set(data.color, atmosphere.color); break;
+	case U_ATMOSPHERE_FOG_DENSITY: atmosphereBlock.Set(data.fogDensity, atmosphere.fogDensity); break;
+	case U_ATMOSPHERE_FOG_VISIBILITY: atmosphereBlock.Set(data.fogVisibility, atmosphere.fogVisibility); break;
+	case U_ATMOSPHERE_LIGHTEST_RANGE: atmosphereBlock.Set(data.lightestRange, atmosphere.lightestRange); break;
+	case U_ATMOSPHERE_DENSEST_RANGE: atmosphereBlock.Set(data.densestRange, atmosphere.densestRange); break;
+	case U_ATMOSPHERE_TARGET_POS_CAMERASPACE: atmosphereBlock.Set(data.targetPosition_cameraspace, atmosphereTargetPosition); break;
 	default:
-		glUniform1i(m_parameters[U_ATMOSPHERE_ENABLED], enabledAtmosphere);
-		glUniform3fv(atmosphereUniformLocations[U_ATMOSPHERE_COLOR], 1, glm::value_ptr(atmosphere.color));
-		glUniform1f(atmosphereUniformLocations[U_ATMOSPHERE_FOG_DENSITY], atmosphere.fogDensity);
-		glUniform1f(atmosphereUniformLocations[U_ATMOSPHERE_FOG_VISIBILITY], atmosphere.fogVisibility);
-		glUniform1f(atmosphereUniformLocations[U_ATMOSPHERE_LIGHTEST_RANGE], atmosphere.lightestRange);
-		glUniform1f(atmosphereUniformLocations[U_ATMOSPHERE_DENSEST_RANGE], atmosphere.densestRange);
+		atmosphereBlock.Set(data.color, atmosphere.color);
+		atmosphereBlock.Set(data.fogDensity, atmosphere.fogDensity);
+		atmosphereBlock.Set(data.fogVisibility, atmosphere.fogVisibility);
+		atmosphereBlock.Set(data.lightestRange, atmosphere.lightestRange);
+		atmosphereBlock.Set(data.densestRange, atmosphere.densestRange);
+		atmosphereBlock.Set(data.targetPosition_cameraspace, atmosphereTargetPosition);
 	}
 }
-
@@ -13,13 +13,19 @@
 #include "MatrixStack.h"
 #include "Light.h"
 #include "Atmosphere.h"
+#include "UniformBuffer.h"
+#include "LightClusters.h"
+#include "ShaderVariants.h"
+#include "ShadowAtlas.h"
+#include "PostProcess.h"
+#include "OcclusionCuller.h"
 
 #include "RenderObject.h"
 #include "EnumArray.h"
 #include "Player.h"
 
 
-enum GEOMETRY_TYPE;
+enum GEOMETRY_TYPE : int;
 
 class BaseScene : public Scene
 {
@@ -37,17 +43,13 @@ public:
 		U_MATERIAL_SPECULAR,
 		U_MATERIAL_SHININESS,
 
-		U_LIGHT_ENABLED,
-		U_LIGHT_NUMLIGHTS,
-
-		U_ATMOSPHERE_ENABLED,
-
-		U_COLOR_TEXTURE_ENABLED,
 		U_COLOR_TEXTURE,
 
-		U_TEXT_ENABLED,
 		U_TEXT_COLOR,
 
+		// 1 writes the fragment into PostProcess's glow attachment too
+		U_BLOOM,
+
 		U_TOTAL,
 	};
 
@@ -79,6 +81,36 @@ public:
 		U_ATMOSPHERE_TOTAL,
 	};
 
+	// binding points of the uniform blocks, the same in every program
+	enum UNIFORM_BLOCK_BINDING {
+		UBO_ATMOSPHERE = 0,
+		UBO_FRAME,
+		UBO_SHADOW,
+	};
+
+	// how lit objects are shaded, the LOD tiers pick ShaderVariants::REDUCED_SHADING / VERTEX_SHADING by screen size
+	enum SHADING_QUALITY {
+		// everything per pixel with every light
+		SHADING_HIGH = 0,
+		SHADING_MEDIUM,
+		// LOD like MEDIUM with twice the screen size thresholds
+		SHADING_LOW,
+		// everything Gouraud
+		SHADING_VERTEX_ONLY,
+
+		SHADING_QUALITY_TOTAL,
+	};
+	// per pixel, per pixel reduced, per vertex
+	static constexpr unsigned SHADING_LOD_TOTAL = 3;
+
+	// texture units, colorTexture stays on 0
+	enum TEXTURE_UNIT {
+		UNIT_COLOR = 0,
+		// lightData, lightClusters and lightIndices, see LightClusters::Bind()
+		UNIT_LIGHT_DATA,
+		UNIT_SHADOW_ATLAS = UNIT_LIGHT_DATA + 3,
+	};
+
 	BaseScene();
 	virtual~BaseScene() = 0;
 
@@ -87,22 +119,124 @@ public:
 	virtual void Render();
 	virtual void Exit();
 
+	// program switches since the start of this frame's Render()
+	unsigned GetShaderSwitches() const { return shaderSwitches; }
+	const ShaderVariants::Stats& GetShaderStats() const { return shaderVariants.GetStats(); }
+	const ShadowAtlas::Stats& GetShadowStats() const { return shadowAtlas.GetStats(); }
+
+	void SetShadingQuality(SHADING_QUALITY quality) { shadingQuality = quality; }
+	SHADING_QUALITY GetShadingQuality() const { return shadingQuality; }
+	static const char* GetShadingQualityName(SHADING_QUALITY quality);
+	// lit draws per shading LOD since the start of this frame's Render()
+	const std::array<unsigned, SHADING_LOD_TOTAL>& GetShadingLodCounts() const { return shadingLodCounts; }
+
+	// off draws level 0 of every mesh, see SelectLod()
+	void SetMeshLod(bool enabled) { enabledMeshLod = enabled; }
+	bool GetMeshLod() const { return enabledMeshLod; }
+	// how many pixels a level's error may cover on screen before a finer level is drawn
+	void SetLodPixelError(float pixels) { lodPixelError = pixels; }
+	float GetLodPixelError() const { return lodPixelError; }
+	// shaded draws per mesh LOD level, and triangles drawn by every pass, since the start of this frame's Render()
+	const std::array<unsigned, Mesh::MAX_LODS>& GetMeshLodCounts() const { return meshLodCounts; }
+	unsigned long long GetDrawnTriangles() const { return Mesh::drawnTriangles - frameTrianglesStart; }
+
+	void SetDepthPrePass(bool enabled) { enabledDepthPrePass = enabled; }
+	bool GetDepthPrePass() const { return enabledDepthPrePass; }
+	// GL_SAMPLES_PASSED between BeginShadedSamples() and EndShadedSamples(), pre-pass draws left out, read back 2 frames late so it never stalls
+	void SetCountShadedSamples(bool enabled) { countShadedSamples = enabled; }
+	unsigned long long GetShadedSamples() const { return shadedSamples; }
+	// draws made by the depth pre-pass since the start of this frame's Render()
+	unsigned GetDepthPrePassDraws() const { return depthPrePassDraws; }
+
+	// MODE_GPU tests against the scene depth of a few frames ago, MODE_CPU against this frame's RenderObject::occluder objects
+	void SetOcclusionMode(OcclusionCuller::MODE mode) { occlusionCuller.SetMode(mode); }
+	OcclusionCuller::MODE GetOcclusionMode() const { return occlusionCuller.GetMode(); }
+	// boxes tested and culled since the start of this frame's Render()
+	const OcclusionCuller::Stats& GetOcclusionStats() const { return occlusionCuller.GetStats(); }
+
+	// targets that no longer fit are made again at the start of the next Render()
+	void SetPostProcessSettings(const PostProcess::Settings& settings) { postProcess.SetSettings(settings); }
+	const PostProcess::Settings& GetPostProcessSettings() const { return postProcess.GetSettings(); }
+	const PostProcess::Stats& GetPostProcessStats() const { return postProcess.GetStats(); }
+
 protected:
 
 	static constexpr bool ALLOW_PHYSICS_DEBUG = true;
 
+	// locations in the current shader variant, UseShaderVariant() swaps them
 	unsigned m_parameters[U_TOTAL];
+
+	// | mask : ShaderVariants::FEATURE bits, switches program only when the normalized variant changes
+	void UseShaderVariant(unsigned mask);
+
+	// ShaderVariants::REDUCED_SHADING, VERTEX_SHADING or 0 for a lit mesh drawn with modelView, by the screen height of its bounding sphere
+	unsigned GetShadingLod(const Mesh* mesh, const glm::mat4& modelView) const;
+	// counts a lit draw for GetShadingLodCounts()
+	void CountShadingLod(unsigned lod);
+	// Mesh LOD level for a mesh drawn with modelView, previous is the level it had last frame
+	// a level is kept until it is off by more than lodPixelError on screen, or the next one is under lodPixelError * LOD_HYSTERESIS,
+	// so an object sitting at a threshold does not swap levels every frame
+	unsigned SelectLod(const Mesh* mesh, const glm::mat4& modelView, unsigned previous) const;
+	// counts a shaded draw for GetMeshLodCounts()
+	void CountMeshLod(unsigned level);
+	static constexpr float LOD_HYSTERESIS = 0.75f;
+	// || depth pre-pass, opaque lists go
+	// BeginDepthPrePass(); RenderDepth(mesh, MVP) for each; EndDepthPrePass(); the shaded draws, which now only pass on GL_EQUAL; EndDepthEqualPass();
+	// so the expensive fragment shader runs once per pixel instead of once per overlapping surface
+	void BeginDepthPrePass();
+	void RenderDepth(Mesh* mesh, const glm::mat4& MVP, unsigned lod = 0);
+	void EndDepthPrePass();
+	void EndDepthEqualPass();
+	bool enabledDepthPrePass = true;
+
+	// the shaded passes to count for GetShadedSamples(), nothing when counting is off
+	void BeginShadedSamples();
+	void EndShadedSamples();
+
+	// true if obj's mesh, drawn with model, is surely hidden, Render() readied the culler for the world list
+	// meshes without bounds are never hidden
+	bool IsOccluded(const std::shared_ptr<RenderObject>& obj, const glm::mat4& model);
+	// after the opaque world list and before anything view space, MODE_GPU reads this depth back a few frames later
+	void CaptureOcclusionDepth();
+
+	// Render() draws into PostProcess's HDR target at the render resolution, this resolves it onto the screen at full size,
+	// call it after the 3D lists and before the screen list, which then goes straight into the default framebuffer
+	void ResolveScene();
+
+	// bounding sphere diameter in pixels under which a mesh drops to REDUCED_SHADING / VERTEX_SHADING at SHADING_MEDIUM
+	float reducedShadingPixels = 96.f;
+	float vertexShadingPixels = 24.f;
 	
 	// Geometry/Shader members
 	static constexpr int MAX_GEOMETRY = 100;
 	EnumArray<Mesh*, GEOMETRY_TYPE, MAX_GEOMETRY> meshList;
 
 	// uniforms for shader
-	static constexpr int MAX_LIGHT = 12;
+	// lights are culled per cluster, so this only bounds the light buffer, LightObject::maxLight matches it
+	static constexpr int MAX_LIGHT = 1024;
+	// these only write the cpu copies of the light buffer and uniform blocks, Render() uploads what changed once per frame
+	// position and spotDirection are left to Render(), which writes them in camera space
 	void UpdateLightUniform(const std::shared_ptr<LightObject>& lightObj, LIGHT_UNIFORM_TYPE uniform = U_LIGHT_TOTAL);
 
 	void UpdateAtmosphereUniform(ATMOSPHERE_UNIFORM_TYPE uniform = U_ATMOSPHERE_TOTAL);
+	// picks the ATMOSPHERE shader variant for lit meshes, the fog is compiled out otherwise
 	bool enabledAtmosphere = true;
+	// camera space, 0 is the camera itself
+	glm::vec3 atmosphereTargetPosition = glm::vec3(0);
+
+	static constexpr float NEAR_PLANE = 0.1f;
+	static constexpr float FAR_PLANE = 1000.f;
+
+	LightClusters lightClusters;
+
+	// Light::castShadows lights get a tile of the atlas, off skips the shadow pass and every light reads as unshadowed
+	bool enabledShadows = true;
+	ShadowAtlas shadowAtlas;
+
+	PostProcess postProcess;
+
+	// off by default, the demo is an open field where nearly nothing is hidden
+	OcclusionCuller occlusionCuller;
 
 	// Matrix Stack & projection members
 	MatrixStack modelStack, viewStack, projectionStack;
@@ -120,16 +254,81 @@ protected:
 	glm::mat4 perspective;
 	glm::mat4 ortho;
 
+	// skips the bind if the texture is already bound to unit 0, meshes sharing an atlas only bind once per frame
+	void BindTexture(unsigned textureID);
+
 private:
 
 	// Geometry/Shader members
 	unsigned m_vertexArrayID;
 
 	// uniforms for shader
-	unsigned m_programID;
+	// 1 program per feature combination of Text_Atmospheric.fragmentshader, each with its own uniform locations
+	ShaderVariants shaderVariants;
+	std::array<std::array<unsigned, U_TOTAL>, ShaderVariants::MASK_COUNT> variantParameters;
+	unsigned currentVariant = ShaderVariants::MASK_COUNT;
+	unsigned shaderSwitches = 0;
+
+	SHADING_QUALITY shadingQuality = SHADING_MEDIUM;
+	std::array<unsigned, SHADING_LOD_TOTAL> shadingLodCounts = {};
+
+	bool enabledMeshLod = true;
+	float lodPixelError = 1.f;
+	std::array<unsigned, Mesh::MAX_LODS> meshLodCounts = {};
+	unsigned long long frameTrianglesStart = 0;
+
+	// Depth.vertexshader, shared with nothing so its MVP location stays put
+	unsigned depthProgramID = 0;
+	int depthMVPLocation = -1;
+	unsigned depthPrePassDraws = 0;
+
+	// a query per counted stretch, 2 frames of them so the ones read back are always finished
+	bool countShadedSamples = false;
+	std::array<std::vector<unsigned>, 2> sampleQueries;
+	std::array<unsigned, 2> usedSampleQueries = {};
+	unsigned sampleQueryFrame = 0;
+	// counting was asked for and a query is running, or would be if the pre-pass had not paused it
+	bool countingSamples = false;
+	bool sampleQueryActive = false;
+	unsigned long long shadedSamples = 0;
+
+	void ReadShadedSamples();
+	void BeginSampleQuery();
+	void EndSampleQuery();
+
+	// std140 copies of the blocks in Text_Atmospheric.fragmentshader, member for member
+	// a vec3 followed by a scalar shares 1 16 byte slot, so every struct is a multiple of 16 bytes like std140 wants
+	struct AtmosphereBlock {
+		glm::vec3 color;
+		float fogDensity;
+		glm::vec3 targetPosition_cameraspace;
+		float fogVisibility;
+		float lightestRange;
+		float densestRange;
+		float padding[2];
+	};
+	struct FrameBlock {
+		glm::mat4 view;
+		glm::mat4 projection;
+		glm::vec4 cameraPosition_worldspace;
+		glm::vec2 viewportSize;
+		float nearPlane;
+		float farPlane;
+	};
+
+	static_assert(sizeof(AtmosphereBlock) == 48, "AtmosphereBlock does not match the std140 AtmosphereBlock");
+	static_assert(sizeof(FrameBlock) == 160, "FrameBlock does not match the std140 FrameBlock");
+
+	UniformBlock<AtmosphereBlock> atmosphereBlock;
+	UniformBlock<FrameBlock> frameBlock;
+
+	unsigned boundTextureID = 0;
+
+	// reused every frame
+	std::vector<ShadowAtlas::ShadowLight> shadowLights;
+	std::vector<ShadowAtlas::Caster> shadowCasters;
 
-	std::array<std::array<unsigned, U_LIGHT_TOTAL>, MAX_LIGHT> lightUniformLocations;
-	std::array<unsigned, U_ATMOSPHERE_TOTAL> atmosphereUniformLocations;
+	void RenderShadows(const glm::mat4& view);
 
 };
 
@@ -6,8 +6,8 @@
 //Include GLFW
 #include <GLFW/glfw3.h>
 
-#include <glm\gtc\matrix_transform.hpp>
-#include <glm\gtc\type_ptr.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
 
 using glm::vec3;
 
@@ -2,7 +2,7 @@
 #define FP_CAMERA_H
 
 // GLM Headers
-#include <glm\glm.hpp>
+#include <glm/glm.hpp>
 
 /* required functions for minimum functionality:
 * Init
@@ -0,0 +1,73 @@
+#include "FrameArena.h"
+
+#include <algorithm>
+#include <cstdint>
+
+// std::max() takes it by reference, C++14 needs the definition
+constexpr size_t FrameArena::DEFAULT_CAPACITY;
+
+void* FrameArena::Allocate(size_t bytes, size_t alignment) {
+	if (blocks.empty())
+		AddBlock(std::max(DEFAULT_CAPACITY, bytes + alignment));
+
+	Block* block = &blocks.back();
+	uintptr_t address = reinterpret_cast<uintptr_t>(block->memory.get()) + block->used;
+	size_t padding = (alignment - address % alignment) % alignment;
+
+	if (block->used + padding + bytes > block->size) {
+		// at least double so a frame that keeps growing does not add a block per allocation
+		AddBlock(std::max(block->size * 2, bytes + alignment));
+		overflowed = true;
+
+		block = &blocks.back();
+		address = reinterpret_cast<uintptr_t>(block->memory.get());
+		padding = (alignment - address % alignment) % alignment;
+	}
+
+	void* memory = block->memory.get() + block->used + padding;
+	block->used += padding + bytes;
+	usedBytes += padding + bytes;
+	return memory;
+}
+
+void FrameArena::Reset() {
+	peakBytes = std::max(peakBytes, usedBytes);
+	usedBytes = 0;
+
+	if (overflowed) {
+		overflowCount++;
+		overflowed = false;
+	}
+
+	if (blocks.size() > 1) {
+		// 1 block as big as all of them, the next frame of the same size fits without overflowing
+		size_t capacity = GetCapacity();
+		blocks.clear();
+		AddBlock(capacity);
+	}
+	else if (!blocks.empty()) {
+		blocks.back().used = 0;
+	}
+}
+
+void FrameArena::Release() {
+	blocks.clear();
+	blocks.shrink_to_fit();
+	usedBytes = 0;
+	overflowed = false;
+}
+
+size_t FrameArena::GetCapacity() const {
+	size_t capacity = 0;
+	for (const Block& block : blocks)
+		capacity += block.size;
+	return capacity;
+}
+
+void FrameArena::AddBlock(size_t size) {
+	Block block;
+	block.memory.reset(new unsigned char[size]);
+	block.size = size;
+	block.used = 0;
+	blocks.push_back(std::move(block));
+}
@@ -0,0 +1,101 @@
+#ifndef FRAME_ARENA_H
+#define FRAME_ARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+/* how to use | FrameArena:
+* || raw memory
+* FrameArena& arena = FrameArena::GetInstance();
+* glm::mat4* matrices = arena.Allocate<glm::mat4>(count); // valid until the next Reset(), never freed by hand
+*
+* || containers
+* FrameVector<ListInfo> queue; // a std::vector whose storage comes from the arena
+* queue.reserve(objectCount); // growing leaves the old storage behind until Reset(), reserve when the size is known
+*
+* || frames
+* Application::Run() calls Reset() at the start of every frame
+*
+* notes:
+* - main thread only, like GL, jobs keep using the normal heap
+* - anything holding arena memory must be gone before the next Reset(), destructors still run but free nothing
+* - a frame that outgrows the block takes extra blocks from the heap, the next Reset() merges them into 1 block that fits,
+*   so after a few frames a steady scene does not touch the heap at all
+*/
+
+class FrameArena {
+public:
+
+	static FrameArena& GetInstance() {
+		static FrameArena arena;
+		return arena;
+	}
+
+	static constexpr size_t DEFAULT_CAPACITY = 256 * 1024;
+
+	// | alignment : power of 2
+	void* Allocate(size_t bytes, size_t alignment = alignof(std::max_align_t));
+	template<typename T>
+	T* Allocate(size_t count) { return static_cast<T*>(Allocate(sizeof(T) * count, alignof(T))); }
+
+	// frees every allocation at once
+	void Reset();
+	// gives the blocks back to the heap, the next Allocate() starts over at DEFAULT_CAPACITY
+	void Release();
+
+	// this frame so far
+	size_t GetUsedBytes() const { return usedBytes; }
+	// most used by a single frame
+	size_t GetPeakBytes() const { return peakBytes; }
+	size_t GetCapacity() const;
+	// frames that ran out of block and took another one from the heap
+	unsigned GetOverflowCount() const { return overflowCount; }
+
+private:
+
+	struct Block {
+		std::unique_ptr<unsigned char[]> memory;
+		size_t size;
+		size_t used;
+	};
+
+	// only the last block is allocated from, the others are full
+	std::vector<Block> blocks;
+	size_t usedBytes = 0;
+	size_t peakBytes = 0;
+	unsigned overflowCount = 0;
+	bool overflowed = false;
+
+	void AddBlock(size_t size);
+
+	FrameArena() = default;
+	~FrameArena() = default;
+	FrameArena(const FrameArena&) = delete;
+	FrameArena& operator=(const FrameArena&) = delete;
+};
+
+// STL allocator on top of FrameArena, deallocate() does nothing
+template<typename T>
+class FrameAllocator {
+public:
+
+	using value_type = T;
+
+	FrameAllocator() = default;
+	template<typename U>
+	FrameAllocator(const FrameAllocator<U>&) {}
+
+	T* allocate(size_t count) { return FrameArena::GetInstance().Allocate<T>(count); }
+	void deallocate(T*, size_t) {}
+
+	template<typename U>
+	bool operator==(const FrameAllocator<U>&) const { return true; }
+	template<typename U>
+	bool operator!=(const FrameAllocator<U>&) const { return false; }
+};
+
+template<typename T>
+using FrameVector = std::vector<T, FrameAllocator<T>>;
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+/* how to use | Frustum:
+* Frustum frustum(projection * view); // planes come out in the space the matrix takes its input in, world space here
+* if (!frustum.Intersects(center, radius)) continue; // bounding sphere in that same space
+*
+* notes:
+* - conservative, a sphere near a corner can pass without touching the frustum, nothing inside is ever rejected
+*/
+
+struct Frustum {
+
+	// left, right, bottom, top, near, far, xyz is the normal pointing inward, w the distance
+	glm::vec4 planes[6];
+
+	Frustum() = default;
+	explicit Frustum(const glm::mat4& matrix) {
+		// rows of the matrix, glm is column major
+		glm::vec4 row0(matrix[0][0], matrix[1][0], matrix[2][0], matrix[3][0]);
+		glm::vec4 row1(matrix[0][1], matrix[1][1], matrix[2][1], matrix[3][1]);
+		glm::vec4 row2(matrix[0][2], matrix[1][2], matrix[2][2], matrix[3][2]);
+		glm::vec4 row3(matrix[0][3], matrix[1][3], matrix[2][3], matrix[3][3]);
+
+		planes[0] = row3 + row0;
+		planes[1] = row3 - row0;
+		planes[2] = row3 + row1;
+		planes[3] = row3 - row1;
+		planes[4] = row3 + row2;
+		planes[5] = row3 - row2;
+		for (glm::vec4& plane : planes)
+			plane /= glm::length(glm::vec3(plane));
+	}
+
+	bool Intersects(const glm::vec3& center, float radius) const {
+		for (const glm::vec4& plane : planes) {
+			if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+				return false;
+		}
+		return true;
+	}
+};
+
+#endif
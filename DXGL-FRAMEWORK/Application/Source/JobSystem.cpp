@@ -0,0 +1,185 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+
+#include "Console.h"
+#include "MemoryTracker.h"
+
+namespace {
+	// index into JobSystem::queues of the thread running this code
+	thread_local unsigned threadQueueIndex = 0;
+}
+
+void JobSystem::Init(int workerCount) {
+	if (running)
+		Shutdown();
+
+	if (workerCount < 0) {
+		int hardwareThreads = static_cast<int>(std::thread::hardware_concurrency());
+		workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+	}
+
+	queues.clear();
+	for (int i = 0; i <= workerCount; i++)
+		queues.push_back(std::make_unique<WorkQueue>());
+
+	running = true;
+	threadQueueIndex = 0;
+	for (int i = 1; i <= workerCount; i++)
+		workers.emplace_back(&JobSystem::WorkerLoop, this, static_cast<unsigned>(i));
+
+	Print("JobSystem: " + std::to_string(workerCount) + " workers", 1);
+}
+
+void JobSystem::Shutdown() {
+	if (!running)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		running = false;
+	}
+	wake.notify_all();
+	for (std::thread& worker : workers)
+		worker.join();
+	workers.clear();
+
+	// nothing should be left if every counter was waited on, run the rest here so no counter is left pending
+	while (TryRunJob());
+	queues.clear();
+}
+
+
+/********************************* submitting *********************************/
+
+void JobSystem::Submit(std::function<void()> task, JobCounter* counter, JobCounter* dependency) {
+	if (queues.empty()) {
+		// not initialised, every earlier job already ran inline so the dependency is done too
+		task();
+		return;
+	}
+
+	if (counter)
+		counter->pending.fetch_add(1, std::memory_order_relaxed);
+
+	Job job{ std::move(task), counter };
+	if (dependency && !dependency->IsDone()) {
+		std::lock_guard<std::mutex> lock(dependency->mutex);
+		// checked again under the lock, Finish() drains the continuations under the same lock
+		if (!dependency->IsDone()) {
+			dependency->continuations.push_back(std::move(job));
+			return;
+		}
+	}
+	Enqueue(std::move(job));
+}
+
+void JobSystem::ParallelFor(unsigned count, unsigned batchSize, const std::function<void(unsigned, unsigned)>& task, JobCounter* counter, JobCounter* dependency) {
+	if (count == 0)
+		return;
+	batchSize = std::max(batchSize, 1u);
+
+	// 1 copy shared by every batch instead of 1 per batch
+	auto sharedTask = std::make_shared<std::function<void(unsigned, unsigned)>>(task);
+	for (unsigned begin = 0; begin < count; begin += batchSize) {
+		unsigned end = std::min(begin + batchSize, count);
+		Submit([sharedTask, begin, end] { (*sharedTask)(begin, end); }, counter, dependency);
+	}
+}
+
+void JobSystem::Wait(JobCounter& counter) {
+	while (!counter.IsDone()) {
+		if (!TryRunJob())
+			std::this_thread::yield();
+	}
+	// the job that brought pending to 0 may still be holding the lock, the counter can only be destroyed after it let go
+	std::lock_guard<std::mutex> lock(counter.mutex);
+}
+
+
+/********************************* running *********************************/
+
+void JobSystem::WorkerLoop(unsigned queueIndex) {
+	threadQueueIndex = queueIndex;
+	MEMORY_TAG(MemoryTracker::JOBS);
+
+	while (running) {
+		if (TryRunJob())
+			continue;
+
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		wake.wait(lock, [this] { return queuedJobs.load() > 0 || !running; });
+	}
+}
+
+void JobSystem::Enqueue(Job job) {
+	unsigned queueIndex = threadQueueIndex < queues.size() ? threadQueueIndex : 0;
+	{
+		std::lock_guard<std::mutex> lock(queues[queueIndex]->mutex);
+		queues[queueIndex]->jobs.push_back(std::move(job));
+	}
+
+	{
+		// taken so the increment cannot land between a worker checking the wait condition and falling asleep
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		queuedJobs.fetch_add(1);
+	}
+	wake.notify_one();
+}
+
+bool JobSystem::TryRunJob() {
+	if (queues.empty())
+		return false;
+
+	unsigned queueCount = static_cast<unsigned>(queues.size());
+	unsigned ownIndex = threadQueueIndex < queueCount ? threadQueueIndex : 0;
+
+	Job job;
+	bool found = false;
+
+	// newest job of its own queue first, its data is most likely still in cache
+	{
+		WorkQueue& own = *queues[ownIndex];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if (!own.jobs.empty()) {
+			job = std::move(own.jobs.back());
+			own.jobs.pop_back();
+			found = true;
+		}
+	}
+
+	// otherwise steal the oldest job of another queue, starting from the next one so thieves spread out
+	for (unsigned i = 1; i < queueCount && !found; i++) {
+		WorkQueue& victim = *queues[(ownIndex + i) % queueCount];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.jobs.empty()) {
+			job = std::move(victim.jobs.front());
+			victim.jobs.pop_front();
+			found = true;
+		}
+	}
+
+	if (!found)
+		return false;
+
+	queuedJobs.fetch_sub(1);
+	job.task();
+	Finish(job.counter);
+	return true;
+}
+
+void JobSystem::Finish(JobCounter* counter) {
+	if (!counter)
+		return;
+
+	std::vector<Job> ready;
+	{
+		std::lock_guard<std::mutex> lock(counter->mutex);
+		if (counter->pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			ready.swap(counter->continuations);
+	}
+
+	// the counter may already be destroyed here, only the local copy is used
+	for (Job& job : ready)
+		Enqueue(std::move(job));
+}
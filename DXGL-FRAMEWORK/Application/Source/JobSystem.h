@@ -0,0 +1,118 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* how to use | JobSystem:
+* || jobs
+* JobSystem& jobs = JobSystem::GetInstance();
+* JobCounter done;
+* jobs.Submit([&] { ... }, &done);
+* jobs.Submit([&] { ... }, &done);
+* jobs.Wait(done); // the waiting thread runs queued jobs too instead of blocking
+*
+* || parallel for
+* jobs.ParallelFor(list.size(), 16, [&](unsigned begin, unsigned end) {
+*     for (unsigned i = begin; i < end; i++) ...
+* }, &done); // 1 job per 16 items
+*
+* || dependencies
+* JobCounter transforms, lights;
+* jobs.ParallelFor(objectCount, 8, updateTransforms, &transforms);
+* jobs.ParallelFor(lightCount, 4, updateLights, &lights, &transforms); // queued once every job counted by transforms finished
+* jobs.Wait(transforms);
+* jobs.Wait(lights);
+*
+* notes:
+* - Application calls Init() and Shutdown(), with 0 workers (1 core) every job runs inside Wait()
+* - GL calls and PROFILE_ZONE are main thread only, keep them out of jobs
+* - always Wait() on a counter before it goes out of scope, even if IsDone() already returned true
+* - each worker has its own queue, idle workers steal the oldest job from the others
+*/
+
+class JobCounter;
+
+struct Job {
+	std::function<void()> task;
+	JobCounter* counter = nullptr;
+};
+
+class JobCounter {
+public:
+
+	JobCounter() = default;
+	JobCounter(const JobCounter&) = delete;
+	JobCounter& operator=(const JobCounter&) = delete;
+
+	bool IsDone() const { return pending.load(std::memory_order_acquire) == 0; }
+
+private:
+
+	friend class JobSystem;
+
+	std::atomic<unsigned> pending{ 0 };
+	// guards continuations, also held while pending reaches 0 so Wait() can tell the last job is completely done with this counter
+	std::mutex mutex;
+	// jobs submitted with this counter as their dependency while it was still pending
+	std::vector<Job> continuations;
+};
+
+class JobSystem {
+public:
+
+	static JobSystem& GetInstance() {
+		static JobSystem jobSystem;
+		return jobSystem;
+	}
+
+	// | workerCount : threads besides the calling one, -1 = hardware threads - 1
+	void Init(int workerCount = -1);
+	void Shutdown();
+
+	// | counter : optional, counts this job until it finished
+	// | dependency : optional, the job is only queued once every job counted by dependency finished
+	void Submit(std::function<void()> task, JobCounter* counter = nullptr, JobCounter* dependency = nullptr);
+	// splits 0 - count into jobs of batchSize items, task gets [begin, end)
+	void ParallelFor(unsigned count, unsigned batchSize, const std::function<void(unsigned, unsigned)>& task, JobCounter* counter = nullptr, JobCounter* dependency = nullptr);
+	// runs queued jobs until every job counted by counter finished
+	void Wait(JobCounter& counter);
+
+	// workers + the thread that called Init()
+	unsigned GetThreadCount() const { return static_cast<unsigned>(workers.size()) + 1; }
+
+private:
+
+	struct WorkQueue {
+		std::mutex mutex;
+		std::deque<Job> jobs;
+	};
+
+	// queues[0] belongs to the thread that called Init(), and to any other thread that is not a worker
+	std::vector<std::unique_ptr<WorkQueue>> queues;
+	std::vector<std::thread> workers;
+	std::atomic<bool> running{ false };
+
+	// jobs sitting in a queue, lets sleeping workers know when to wake up
+	std::atomic<unsigned> queuedJobs{ 0 };
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+
+	void WorkerLoop(unsigned queueIndex);
+	void Enqueue(Job job);
+	bool TryRunJob();
+	void Finish(JobCounter* counter);
+
+	JobSystem() = default;
+	~JobSystem() { Shutdown(); }
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+};
+
+#endif
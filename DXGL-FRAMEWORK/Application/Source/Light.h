@@ -1,9 +1,9 @@
 #ifndef LIGHT_H
 #define LIGHT_H
 
-#include <glm\glm.hpp>
-#include <glm\gtc\matrix_transform.hpp>
-#include <glm\gtc\type_ptr.hpp>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
 
 struct Light
 {
@@ -26,7 +26,10 @@ struct Light
 	float cosCutoff;
 	float cosInner;
 
-	Light() : position(0.f, 20.f, 0.f), color(1.f, 1.f, 1.f), power(1.f), kC(1.f), kL(0.1f), kQ(0.001f), type(LIGHT_POINT), spotDirection(1.f), cosCutoff(45.f), cosInner(30.f) {}
+	// directional and spot lights only, BaseScene gives them a ShadowAtlas tile each frame while there are tiles left
+	bool castShadows;
+
+	Light() : position(0.f, 20.f, 0.f), color(1.f, 1.f, 1.f), power(1.f), kC(1.f), kL(0.1f), kQ(0.001f), type(LIGHT_POINT), spotDirection(1.f), cosCutoff(45.f), cosInner(30.f), castShadows(false) {}
 };
 
 #endif
@@ -0,0 +1,314 @@
+#include "LightClusters.h"
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#include "Light.h"
+#include "Console.h"
+
+LightClusters::~LightClusters() {
+	if (lightBuffer.bufferID != 0)
+		Error("LightClusters: destroyed without Destroy(), its buffers leaked");
+}
+
+void LightClusters::Create(unsigned maxLights, const glm::mat4& projection, float nearPlane, float farPlane) {
+	Destroy();
+
+	lights.assign(maxLights, LightData());
+	lightCount = 0;
+	dirtyBegin = dirtyEnd = 0;
+	this->projection = projection;
+	this->nearPlane = nearPlane;
+	this->farPlane = farPlane;
+
+	// slice = floor(log(depth / near) / log(far / near) * SLICES), split so the shader does 1 log and 1 multiply-add
+	float scale = SLICES / std::log(farPlane / nearPlane);
+	depthScaleBias = glm::vec2(scale, -std::log(nearPlane) * scale);
+
+	// view space boxes, x / y of a tile grow with depth so the box spans the tile at both ends of its slice
+	clusterBounds.resize(CLUSTER_COUNT);
+	for (unsigned slice = 0; slice < SLICES; slice++) {
+		float depthNear = nearPlane * std::pow(farPlane / nearPlane, static_cast<float>(slice) / SLICES);
+		float depthFar = nearPlane * std::pow(farPlane / nearPlane, static_cast<float>(slice + 1) / SLICES);
+		for (unsigned y = 0; y < TILES_Y; y++) {
+			float ndcY0 = 2.f * y / TILES_Y - 1.f;
+			float ndcY1 = 2.f * (y + 1) / TILES_Y - 1.f;
+			for (unsigned x = 0; x < TILES_X; x++) {
+				float ndcX0 = 2.f * x / TILES_X - 1.f;
+				float ndcX1 = 2.f * (x + 1) / TILES_X - 1.f;
+
+				Bounds& bounds = clusterBounds[x + y * TILES_X + slice * TILES_X * TILES_Y];
+				bounds.min.x = std::min(ndcX0 * depthNear, ndcX0 * depthFar) / projection[0][0];
+				bounds.max.x = std::max(ndcX1 * depthNear, ndcX1 * depthFar) / projection[0][0];
+				bounds.min.y = std::min(ndcY0 * depthNear, ndcY0 * depthFar) / projection[1][1];
+				bounds.max.y = std::max(ndcY1 * depthNear, ndcY1 * depthFar) / projection[1][1];
+				// view space looks down -z
+				bounds.min.z = -depthFar;
+				bounds.max.z = -depthNear;
+			}
+		}
+	}
+
+	// a texture buffer past the limit fails to sample, the index list is the only one that can get near it
+	GLint maxTexels = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+	maxIndices = std::min(MAX_INDICES, static_cast<unsigned>(std::max(maxTexels, 65536)));
+
+	pairs.clear();
+	pairs.reserve(maxIndices);
+	clusterRanges.assign(CLUSTER_COUNT, glm::uvec2(0));
+	lightIndices.clear();
+	lightIndices.reserve(maxIndices);
+
+	CreateBuffer(lightBuffer, sizeof(LightData) * maxLights, GL_RGBA32F);
+	CreateBuffer(clusterBuffer, sizeof(glm::uvec2) * CLUSTER_COUNT, GL_RG32UI);
+	CreateBuffer(indexBuffer, sizeof(uint16_t) * maxIndices, GL_R16UI);
+	stats = Stats();
+}
+
+void LightClusters::Destroy() {
+	DestroyBuffer(lightBuffer);
+	DestroyBuffer(clusterBuffer);
+	DestroyBuffer(indexBuffer);
+}
+
+void LightClusters::CreateBuffer(Buffer& buffer, size_t bytes, unsigned format) {
+	glGenBuffers(1, &buffer.bufferID);
+	glBindBuffer(GL_TEXTURE_BUFFER, buffer.bufferID);
+	glBufferData(GL_TEXTURE_BUFFER, bytes, nullptr, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	glGenTextures(1, &buffer.textureID);
+	glBindTexture(GL_TEXTURE_BUFFER, buffer.textureID);
+	glTexBuffer(GL_TEXTURE_BUFFER, format, buffer.bufferID);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+void LightClusters::DestroyBuffer(Buffer& buffer) {
+	if (buffer.textureID != 0)
+		glDeleteTextures(1, &buffer.textureID);
+	if (buffer.bufferID != 0)
+		glDeleteBuffers(1, &buffer.bufferID);
+	buffer = Buffer();
+}
+
+
+/********************************* lights *********************************/
+
+void LightClusters::SetLight(unsigned index, const LightData& data) {
+	if (index >= lights.size())
+		return;
+	if (std::memcmp(&lights[index], &data, sizeof(LightData)) == 0)
+		return;
+
+	lights[index] = data;
+	if (dirtyBegin >= dirtyEnd) {
+		dirtyBegin = index;
+		dirtyEnd = index + 1;
+	}
+	else {
+		dirtyBegin = std::min(dirtyBegin, index);
+		dirtyEnd = std::max(dirtyEnd, index + 1);
+	}
+}
+
+void LightClusters::SetLightCount(unsigned count) {
+	lightCount = std::min(count, static_cast<unsigned>(lights.size()));
+}
+
+float LightClusters::GetInfluenceRange(const LightData& data) {
+	if (static_cast<int>(data.type) == Light::LIGHT_DIRECTIONAL)
+		return -1;
+
+	// the shader's attenuation is 1 / max(1, kC + kL * d + kQ * d * d), solve for where power * attenuation == cutoff
+	float limit = data.power / INFLUENCE_CUTOFF;
+	if (data.kC >= limit || limit <= 1.f)
+		return 0;
+	if (data.kQ > 0) {
+		float discriminant = data.kL * data.kL - 4.f * data.kQ * (data.kC - limit);
+		return (-data.kL + std::sqrt(discriminant)) / (2.f * data.kQ);
+	}
+	if (data.kL > 0)
+		return (limit - data.kC) / data.kL;
+	return -1;
+}
+
+
+/********************************* binning *********************************/
+
+unsigned LightClusters::GetSlice(float depth) const {
+	float slice = std::log(std::max(depth, nearPlane)) * depthScaleBias.x + depthScaleBias.y;
+	return std::min(static_cast<unsigned>(std::max(slice, 0.f)), SLICES - 1);
+}
+
+void LightClusters::AddPairs(unsigned light, const LightData& data) {
+	float range = GetInfluenceRange(data);
+	if (range == 0)
+		return;
+
+	unsigned added = 0;
+	if (range < 0) {
+		for (uint32_t cluster = 0; cluster < CLUSTER_COUNT; cluster++)
+			pairs.emplace_back(cluster, static_cast<uint16_t>(light));
+		added = CLUSTER_COUNT;
+	}
+	else {
+		const glm::vec3& center = data.position_cameraspace;
+		float depthMin = std::max(-center.z - range, nearPlane);
+		float depthMax = std::min(-center.z + range, farPlane);
+		if (depthMin > depthMax)
+			return;
+
+		auto toTile = [](float ndc, unsigned tiles) {
+			int tile = static_cast<int>(std::floor((ndc + 1.f) * 0.5f * tiles));
+			return static_cast<unsigned>(std::max(0, std::min(tile, static_cast<int>(tiles) - 1)));
+		};
+
+		float rangeSquared = range * range;
+		unsigned slice0 = GetSlice(depthMin), slice1 = GetSlice(depthMax);
+		for (unsigned slice = slice0; slice <= slice1; slice++) {
+			// the part of the sphere's box inside this slice, a rect per slice is much tighter than 1 for the whole sphere
+			const Bounds& sliceBounds = clusterBounds[slice * TILES_X * TILES_Y];
+			float sliceNear = std::max(depthMin, -sliceBounds.max.z);
+			float sliceFar = std::min(depthMax, -sliceBounds.min.z);
+
+			// screen rect of that box, the extremes of x / depth sit on its corners
+			float ndcMin[2] = { 1.f, 1.f }, ndcMax[2] = { -1.f, -1.f };
+			for (int axis = 0; axis < 2; axis++) {
+				float scale = projection[axis][axis];
+				for (float edge : { center[axis] - range, center[axis] + range }) {
+					for (float depth : { sliceNear, sliceFar }) {
+						float ndc = scale * edge / depth;
+						ndcMin[axis] = std::min(ndcMin[axis], ndc);
+						ndcMax[axis] = std::max(ndcMax[axis], ndc);
+					}
+				}
+			}
+			if (ndcMin[0] > 1.f || ndcMax[0] < -1.f || ndcMin[1] > 1.f || ndcMax[1] < -1.f)
+				continue;
+
+			unsigned x0 = toTile(ndcMin[0], TILES_X), x1 = toTile(ndcMax[0], TILES_X);
+			unsigned y0 = toTile(ndcMin[1], TILES_Y), y1 = toTile(ndcMax[1], TILES_Y);
+			for (unsigned y = y0; y <= y1; y++) {
+				for (unsigned x = x0; x <= x1; x++) {
+					uint32_t cluster = x + y * TILES_X + slice * TILES_X * TILES_Y;
+					// the rect is loose at the corners, the exact sphere / box test drops those clusters
+					const Bounds& bounds = clusterBounds[cluster];
+					glm::vec3 closest = glm::clamp(center, bounds.min, bounds.max);
+					glm::vec3 offset = closest - center;
+					if (glm::dot(offset, offset) > rangeSquared)
+						continue;
+					pairs.emplace_back(cluster, static_cast<uint16_t>(light));
+					added++;
+				}
+			}
+		}
+	}
+
+	if (added > 0)
+		stats.visibleLights++;
+}
+
+void LightClusters::Build() {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	stats.lights = lightCount;
+	stats.visibleLights = 0;
+	stats.droppedIndices = 0;
+
+	pairs.clear();
+	for (unsigned i = 0; i < lightCount; i++) {
+		if (lights[i].power < 0.0001f)
+			continue;
+		AddPairs(i, lights[i]);
+	}
+
+	// counting sort by cluster, the lights of a cluster stay in light order
+	for (glm::uvec2& range : clusterRanges)
+		range = glm::uvec2(0);
+	for (const auto& pair : pairs)
+		clusterRanges[pair.first].y++;
+
+	// too many, cut every cluster to the highest light count per cluster that still fits,
+	// so only the crowded clusters lose lights instead of the last lights losing every cluster
+	unsigned clusterCap = ~0u;
+	if (pairs.size() > maxIndices) {
+		auto total = [this](unsigned cap) {
+			size_t sum = 0;
+			for (const glm::uvec2& range : clusterRanges)
+				sum += std::min(range.y, cap);
+			return sum;
+		};
+		unsigned low = 0, high = 0;
+		for (const glm::uvec2& range : clusterRanges)
+			high = std::max(high, range.y);
+		while (low < high) {
+			unsigned cap = (low + high + 1) / 2;
+			if (total(cap) <= maxIndices)
+				low = cap;
+			else
+				high = cap - 1;
+		}
+		clusterCap = low;
+		for (glm::uvec2& range : clusterRanges) {
+			stats.droppedIndices += range.y - std::min(range.y, clusterCap);
+			range.y = std::min(range.y, clusterCap);
+		}
+	}
+
+	unsigned offset = 0;
+	stats.maxLightsPerCluster = 0;
+	for (glm::uvec2& range : clusterRanges) {
+		range.x = offset;
+		offset += range.y;
+		stats.maxLightsPerCluster = std::max(stats.maxLightsPerCluster, range.y);
+		// reused as the write cursor below, restored after
+		range.y = 0;
+	}
+
+	lightIndices.resize(offset);
+	for (const auto& pair : pairs) {
+		glm::uvec2& range = clusterRanges[pair.first];
+		// the first clusterCap lights of the cluster, in light order
+		if (range.y == clusterCap)
+			continue;
+		lightIndices[range.x + range.y] = pair.second;
+		range.y++;
+	}
+	stats.indices = static_cast<unsigned>(lightIndices.size());
+	stats.buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void LightClusters::Upload() {
+	if (lightBuffer.bufferID == 0)
+		return;
+
+	if (dirtyBegin < dirtyEnd) {
+		glBindBuffer(GL_TEXTURE_BUFFER, lightBuffer.bufferID);
+		glBufferSubData(GL_TEXTURE_BUFFER, sizeof(LightData) * dirtyBegin, sizeof(LightData) * (dirtyEnd - dirtyBegin), &lights[dirtyBegin]);
+		dirtyBegin = dirtyEnd = 0;
+	}
+
+	// rebuilt every frame, orphaning lets the driver hand out fresh storage instead of waiting on last frame's draws
+	glBindBuffer(GL_TEXTURE_BUFFER, clusterBuffer.bufferID);
+	glBufferData(GL_TEXTURE_BUFFER, sizeof(glm::uvec2) * CLUSTER_COUNT, clusterRanges.data(), GL_STREAM_DRAW);
+
+	glBindBuffer(GL_TEXTURE_BUFFER, indexBuffer.bufferID);
+	glBufferData(GL_TEXTURE_BUFFER, sizeof(uint16_t) * maxIndices, nullptr, GL_STREAM_DRAW);
+	if (!lightIndices.empty())
+		glBufferSubData(GL_TEXTURE_BUFFER, 0, sizeof(uint16_t) * lightIndices.size(), lightIndices.data());
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void LightClusters::Bind(unsigned firstUnit) const {
+	glActiveTexture(GL_TEXTURE0 + firstUnit);
+	glBindTexture(GL_TEXTURE_BUFFER, lightBuffer.textureID);
+	glActiveTexture(GL_TEXTURE0 + firstUnit + 1);
+	glBindTexture(GL_TEXTURE_BUFFER, clusterBuffer.textureID);
+	glActiveTexture(GL_TEXTURE0 + firstUnit + 2);
+	glBindTexture(GL_TEXTURE_BUFFER, indexBuffer.textureID);
+	glActiveTexture(GL_TEXTURE0);
+}
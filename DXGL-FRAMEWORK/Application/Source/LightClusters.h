@@ -0,0 +1,144 @@
+#ifndef LIGHT_CLUSTERS_H
+#define LIGHT_CLUSTERS_H
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+/* how to use | LightClusters:
+* || setup, BaseScene does this in Init()
+* lightClusters.Create(MAX_LIGHT, projection, NEAR_PLANE, FAR_PLANE);
+* glUniform1i(glGetUniformLocation(programID, "lightData"), LIGHT_DATA_UNIT); // same for lightClusters and lightIndices
+*
+* || every frame, BaseScene::Render()
+* LightClusters::LightData data = lightClusters.GetLight(index);
+* data.position_cameraspace = ...;
+* lightClusters.SetLight(index, data); // only marks the light dirty if it changed
+* lightClusters.SetLightCount(count);
+* lightClusters.Build(); // bins every light into the froxels its sphere of influence touches, cpu only
+* lightClusters.Upload(); // changed lights, cluster ranges and index list, 3 buffer updates in total
+* lightClusters.Bind(LIGHT_DATA_UNIT); // 3 texture buffers on the unit given and the 2 after it
+*
+* notes:
+* - the view frustum is split into TILES_X * TILES_Y tiles on screen and SLICES exponential depth slices,
+*   a fragment only shades the lights listed for its cluster instead of every light in the scene
+* - the influence of a point / spot light ends where power * attenuation drops under INFLUENCE_CUTOFF,
+*   spot lights are binned by that sphere too, their cone is not used for culling
+* - directional lights and lights without distance attenuation are listed in every cluster
+* - past GetMaxIndices() the fullest clusters lose their last lights first, a light is only missing where a cluster overflowed,
+*   never from the whole screen
+* - the grid assumes the perspective projection given to Create(), clusters are not rebuilt for ortho
+*/
+
+class LightClusters {
+public:
+
+	static constexpr unsigned TILES_X = 16;
+	static constexpr unsigned TILES_Y = 9;
+	static constexpr unsigned SLICES = 24;
+	static constexpr unsigned CLUSTER_COUNT = TILES_X * TILES_Y * SLICES;
+	// index list capacity asked for, Create() lowers it to GL_MAX_TEXTURE_BUFFER_SIZE, GL 3.3 only promises 65536 texels
+	static constexpr unsigned MAX_INDICES = CLUSTER_COUNT * 64;
+	static constexpr float INFLUENCE_CUTOFF = 1.f / 256.f;
+
+	// 5 RGBA32F texels per light, fetched by the fragment shader as lightData[index * 5 + n]
+	struct LightData {
+		glm::vec3 position_cameraspace;
+		float power;
+		glm::vec3 color;
+		float kC;
+		glm::vec3 spotDirection;
+		float kL;
+		float kQ;
+		float cosCutoff;
+		float cosInner;
+		// Light::LIGHT_TYPE, kept as float since the texture holds floats
+		float type;
+		// first ShadowAtlas tile of the light, -1 without shadows, float for the same reason
+		float shadow = -1;
+		glm::vec3 padding;
+	};
+	static_assert(sizeof(LightData) == 80, "LightData has to be 5 vec4 texels");
+
+	struct Stats {
+		unsigned lights = 0;
+		// lights that touched at least 1 cluster
+		unsigned visibleLights = 0;
+		unsigned indices = 0;
+		unsigned maxLightsPerCluster = 0;
+		unsigned droppedIndices = 0;
+		double buildMs = 0;
+	};
+
+	LightClusters() = default;
+	~LightClusters();
+	LightClusters(const LightClusters&) = delete;
+	LightClusters& operator=(const LightClusters&) = delete;
+
+	void Create(unsigned maxLights, const glm::mat4& projection, float nearPlane, float farPlane);
+	void Destroy();
+
+	const LightData& GetLight(unsigned index) const { return lights[index]; }
+	void SetLight(unsigned index, const LightData& data);
+	void SetLightCount(unsigned count);
+	unsigned GetLightCount() const { return lightCount; }
+	unsigned GetMaxLights() const { return static_cast<unsigned>(lights.size()); }
+	// MAX_INDICES or what the driver allows, whichever is lower
+	unsigned GetMaxIndices() const { return maxIndices; }
+
+	void Build();
+	void Upload();
+	// | firstUnit : lightData, lightClusters and lightIndices go on firstUnit, + 1 and + 2, leaves GL_TEXTURE0 active
+	void Bind(unsigned firstUnit) const;
+
+	// slice = log(depth) * x + y, for the shader's clusterDepthScaleBias
+	glm::vec2 GetDepthScaleBias() const { return depthScaleBias; }
+	const Stats& GetStats() const { return stats; }
+
+	// distance where power * attenuation drops under INFLUENCE_CUTOFF, < 0 if it never does
+	static float GetInfluenceRange(const LightData& data);
+
+private:
+
+	struct Buffer {
+		unsigned bufferID = 0;
+		unsigned textureID = 0;
+	};
+
+	struct Bounds {
+		glm::vec3 min;
+		glm::vec3 max;
+	};
+
+	std::vector<LightData> lights;
+	unsigned lightCount = 0;
+	unsigned maxIndices = MAX_INDICES;
+	// [dirtyBegin, dirtyEnd) in lights
+	unsigned dirtyBegin = 0;
+	unsigned dirtyEnd = 0;
+
+	glm::mat4 projection;
+	float nearPlane = 0;
+	float farPlane = 0;
+	glm::vec2 depthScaleBias;
+	// view space box of every cluster, built once in Create()
+	std::vector<Bounds> clusterBounds;
+
+	// (cluster, light) pairs of this frame, counting sorted into clusterRanges and lightIndices
+	std::vector<std::pair<uint32_t, uint16_t>> pairs;
+	// offset, count per cluster
+	std::vector<glm::uvec2> clusterRanges;
+	std::vector<uint16_t> lightIndices;
+
+	Buffer lightBuffer, clusterBuffer, indexBuffer;
+	Stats stats;
+
+	void CreateBuffer(Buffer& buffer, size_t bytes, unsigned format);
+	void DestroyBuffer(Buffer& buffer);
+	unsigned GetSlice(float depth) const;
+	void AddPairs(unsigned light, const LightData& data);
+};
+
+#endif
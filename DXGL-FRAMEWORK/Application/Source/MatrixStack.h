@@ -1,11 +1,12 @@
 #ifndef MATRIXSTACK_H
 #define MATRIXSTACK_H
 
-#include <glm\glm.hpp>
-#include <glm\gtc\matrix_transform.hpp>
-#include <glm\gtc\type_ptr.hpp>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
 
 #include <stack>
+#include <vector>
 
 class MatrixStack
 {
@@ -26,7 +27,8 @@ public:
 	void Frustum(double left, double right, double bottom, double top, double near, double far);
 	void LookAt(double eyeX, double eyeY, double eyeZ, double centerX, double centerY, double centerZ, double upX, double upY, double upZ);
 private:
-	std::stack<glm::mat4> ms;
+	// vector backed, keeps its capacity so pushing after the first frame never allocates (a deque frees and allocates chunks)
+	std::stack<glm::mat4, std::vector<glm::mat4>> ms;
 };
 
 #endif
\ No newline at end of file
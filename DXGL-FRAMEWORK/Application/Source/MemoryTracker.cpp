@@ -0,0 +1,256 @@
+#include "MemoryTracker.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#include "Console.h"
+
+namespace {
+	// tag of the thread running this code, trivially initialised so reading it inside operator new never allocates
+	thread_local MemoryTracker::TAG threadTag = MemoryTracker::UNTAGGED;
+
+	// failing frames printed by EndFrame(), the rest are only counted
+	const unsigned long long MAX_REPORTED_FRAMES = 10;
+
+	std::string FormatBytes(double bytes) {
+		char buffer[32];
+		if (bytes >= 1024.0 * 1024.0)
+			std::snprintf(buffer, sizeof(buffer), "%.1f MB", bytes / (1024.0 * 1024.0));
+		else if (bytes >= 1024.0)
+			std::snprintf(buffer, sizeof(buffer), "%.1f KB", bytes / 1024.0);
+		else
+			std::snprintf(buffer, sizeof(buffer), "%.0f B", bytes);
+		return buffer;
+	}
+}
+
+
+/********************************* frames *********************************/
+
+void MemoryTracker::BeginFrame() {
+	frameStart = Snapshot();
+	frameStart.index = frameIndex;
+	frameOpen = true;
+}
+
+void MemoryTracker::EndFrame() {
+	if (!frameOpen)
+		return;
+
+	FrameStats end = Snapshot();
+	lastFrame.index = frameIndex;
+	lastFrame.allocations = end.allocations - frameStart.allocations;
+	lastFrame.bytes = end.bytes - frameStart.bytes;
+	for (int i = 0; i < TAG_COUNT; i++) {
+		lastFrame.tagAllocations[i] = end.tagAllocations[i] - frameStart.tagAllocations[i];
+		lastFrame.tagBytes[i] = end.tagBytes[i] - frameStart.tagBytes[i];
+	}
+	if (lastFrame.allocations > worstFrame.allocations)
+		worstFrame = lastFrame;
+
+	frameIndex++;
+	frameOpen = false;
+
+	if (assertNoAlloc && lastFrame.allocations > 0) {
+		failedFrames++;
+		if (failedFrames > MAX_REPORTED_FRAMES)
+			return;
+
+		int worstTag = 0;
+		for (int i = 1; i < TAG_COUNT; i++) {
+			if (lastFrame.tagAllocations[i] > lastFrame.tagAllocations[worstTag])
+				worstTag = i;
+		}
+		// printed after the frame was measured, so the strings built here are not counted against it
+		Error("MemoryTracker: frame " + std::to_string(lastFrame.index) + " allocated " + std::to_string(lastFrame.allocations) + " times (" + FormatBytes(static_cast<double>(lastFrame.bytes)) +
+			"), mostly " + GetTagName(static_cast<TAG>(worstTag)));
+	}
+}
+
+
+/********************************* counting *********************************/
+
+void MemoryTracker::OnAllocate(size_t bytes, TAG tag) {
+	Add(tags[tag], bytes);
+	Add(total, bytes);
+}
+
+void MemoryTracker::OnFree(size_t bytes, TAG tag) {
+	Remove(tags[tag], bytes);
+	Remove(total, bytes);
+}
+
+void MemoryTracker::Add(Counters& counters, size_t bytes) {
+	counters.allocations.fetch_add(1, std::memory_order_relaxed);
+	counters.bytes.fetch_add(bytes, std::memory_order_relaxed);
+	long long live = counters.liveBytes.fetch_add(static_cast<long long>(bytes), std::memory_order_relaxed) + static_cast<long long>(bytes);
+
+	long long peak = counters.peakBytes.load(std::memory_order_relaxed);
+	while (live > peak && !counters.peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed));
+}
+
+void MemoryTracker::Remove(Counters& counters, size_t bytes) {
+	counters.liveBytes.fetch_sub(static_cast<long long>(bytes), std::memory_order_relaxed);
+}
+
+MemoryTracker::TagStats MemoryTracker::Read(const Counters& counters) {
+	TagStats stats;
+	stats.allocations = counters.allocations.load(std::memory_order_relaxed);
+	stats.bytes = counters.bytes.load(std::memory_order_relaxed);
+	stats.liveBytes = counters.liveBytes.load(std::memory_order_relaxed);
+	stats.peakBytes = counters.peakBytes.load(std::memory_order_relaxed);
+	return stats;
+}
+
+MemoryTracker::FrameStats MemoryTracker::Snapshot() const {
+	FrameStats snapshot;
+	snapshot.allocations = total.allocations.load(std::memory_order_relaxed);
+	snapshot.bytes = total.bytes.load(std::memory_order_relaxed);
+	for (int i = 0; i < TAG_COUNT; i++) {
+		snapshot.tagAllocations[i] = tags[i].allocations.load(std::memory_order_relaxed);
+		snapshot.tagBytes[i] = tags[i].bytes.load(std::memory_order_relaxed);
+	}
+	return snapshot;
+}
+
+
+/********************************* results *********************************/
+
+MemoryTracker::TagStats MemoryTracker::GetTagStats(TAG tag) const {
+	return Read(tags[tag]);
+}
+
+MemoryTracker::TagStats MemoryTracker::GetTotalStats() const {
+	return Read(total);
+}
+
+std::vector<std::string> MemoryTracker::GetOverlayLines() const {
+	std::vector<std::string> lines;
+#ifdef ENABLE_MEMORY_TRACKER
+	TagStats totalStats = GetTotalStats();
+	lines.push_back("alloc/frame: " + std::to_string(lastFrame.allocations) + " (" + FormatBytes(static_cast<double>(lastFrame.bytes)) + "), worst " + std::to_string(worstFrame.allocations));
+	lines.push_back("heap: " + FormatBytes(static_cast<double>(totalStats.liveBytes)) + ", peak " + FormatBytes(static_cast<double>(totalStats.peakBytes)));
+
+	std::string tagLine = "alloc/frame by tag:";
+	for (int i = 0; i < TAG_COUNT; i++) {
+		if (lastFrame.tagAllocations[i] > 0)
+			tagLine += std::string(" ") + GetTagName(static_cast<TAG>(i)) + " " + std::to_string(lastFrame.tagAllocations[i]);
+	}
+	lines.push_back(tagLine);
+#endif
+	return lines;
+}
+
+const char* MemoryTracker::GetTagName(TAG tag) {
+	switch (tag) {
+	case UNTAGGED: return "untagged";
+	case SCENE: return "scene";
+	case RENDER: return "render";
+	case PHYSICS: return "physics";
+	case AUDIO: return "audio";
+	case TEXT: return "text";
+	case RESOURCES: return "resources";
+	case JOBS: return "jobs";
+	default: return "unknown";
+	}
+}
+
+MemoryTracker::TAG MemoryTracker::GetThreadTag() {
+	return threadTag;
+}
+
+void MemoryTracker::SetThreadTag(TAG tag) {
+	threadTag = tag;
+}
+
+void MemoryTracker::ResetPeaks() {
+	for (Counters& counters : tags)
+		counters.peakBytes.store(counters.liveBytes.load());
+	total.peakBytes.store(total.liveBytes.load());
+	worstFrame = FrameStats();
+}
+
+
+/********************************* operator new / delete *********************************/
+
+#ifdef ENABLE_MEMORY_TRACKER
+
+namespace {
+	// stays a multiple of the strictest fundamental alignment so the block after it is aligned like malloc's
+	struct BlockHeader {
+		size_t bytes;
+		MemoryTracker::TAG tag;
+	};
+	constexpr size_t HEADER_SIZE = (sizeof(BlockHeader) + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t);
+
+	void* TrackedAllocate(size_t bytes) {
+		if (bytes > SIZE_MAX - HEADER_SIZE)
+			return nullptr;
+		void* block = std::malloc(HEADER_SIZE + bytes);
+		if (!block)
+			return nullptr;
+
+		BlockHeader* header = static_cast<BlockHeader*>(block);
+		header->bytes = bytes;
+		header->tag = threadTag;
+		MemoryTracker::GetInstance().OnAllocate(bytes, header->tag);
+		return static_cast<char*>(block) + HEADER_SIZE;
+	}
+
+	void TrackedFree(void* memory) {
+		if (!memory)
+			return;
+
+		BlockHeader* header = reinterpret_cast<BlockHeader*>(static_cast<char*>(memory) - HEADER_SIZE);
+		MemoryTracker::GetInstance().OnFree(header->bytes, header->tag);
+		std::free(header);
+	}
+}
+
+void* operator new(size_t bytes) {
+	if (void* memory = TrackedAllocate(bytes))
+		return memory;
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t bytes) {
+	if (void* memory = TrackedAllocate(bytes))
+		return memory;
+	throw std::bad_alloc();
+}
+
+void* operator new(size_t bytes, const std::nothrow_t&) noexcept {
+	return TrackedAllocate(bytes);
+}
+
+void* operator new[](size_t bytes, const std::nothrow_t&) noexcept {
+	return TrackedAllocate(bytes);
+}
+
+void operator delete(void* memory) noexcept {
+	TrackedFree(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+	TrackedFree(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+	TrackedFree(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept {
+	TrackedFree(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept {
+	TrackedFree(memory);
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) noexcept {
+	TrackedFree(memory);
+}
+
+#endif
@@ -0,0 +1,151 @@
+#ifndef MEMORY_TRACKER_H
+#define MEMORY_TRACKER_H
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/* how to use | MemoryTracker:
+* || tags
+* void Foo() {
+*     MEMORY_TAG(MemoryTracker::PHYSICS); // heap allocations of this thread are counted under PHYSICS until the end of the scope
+*     ...
+* }
+* tags nest, the innermost one wins, JobSystem workers count under JOBS
+*
+* || frames
+* Application::Run() already calls MEMORY_BEGIN_FRAME() and MEMORY_END_FRAME() next to the profiler's
+* MemoryTracker::GetInstance().GetLastFrame().allocations; // every thread, between the 2 calls
+* MemoryTracker::GetInstance().GetTagStats(MemoryTracker::TEXT).peakBytes; // high-water mark of the live bytes
+* MemoryTracker::GetInstance().GetOverlayLines(); // SceneDemo shows them through AddDebugText() in debug mode
+*
+* || no allocation assertion
+* MemoryTracker::GetInstance().SetAssertNoAlloc(true); // from now on every frame that allocates is reported through Error()
+* MemoryTracker::GetInstance().GetFailedFrames(); // Benchmark --assert-no-alloc fails the run when this is not 0
+*
+* notes:
+* - global operator new / delete are only replaced when ENABLE_MEMORY_TRACKER is defined, otherwise every count stays 0,
+*   Debug builds and the Benchmark define it, Release builds of the demo leave the hook out
+* - each block carries a small header with its size and tag, so freeing from another tag or thread still balances
+* - the hooks never allocate or print, Error() is only called from EndFrame()
+*/
+
+#ifdef ENABLE_MEMORY_TRACKER
+#define MEMORY_TRACKER_CONCAT_INNER(a, b) a##b
+#define MEMORY_TRACKER_CONCAT(a, b) MEMORY_TRACKER_CONCAT_INNER(a, b)
+#define MEMORY_TAG(tag) MemoryTagScope MEMORY_TRACKER_CONCAT(memoryTag, __LINE__)(tag)
+#define MEMORY_BEGIN_FRAME() MemoryTracker::GetInstance().BeginFrame()
+#define MEMORY_END_FRAME() MemoryTracker::GetInstance().EndFrame()
+#else
+#define MEMORY_TAG(tag)
+#define MEMORY_BEGIN_FRAME()
+#define MEMORY_END_FRAME()
+#endif
+
+class MemoryTracker {
+public:
+
+	static MemoryTracker& GetInstance() {
+		static MemoryTracker tracker;
+		return tracker;
+	}
+
+	enum TAG {
+		UNTAGGED,
+		SCENE,
+		RENDER,
+		PHYSICS,
+		AUDIO,
+		TEXT,
+		RESOURCES,
+		JOBS,
+		TAG_COUNT
+	};
+
+	struct TagStats {
+		// since the start of the program
+		unsigned long long allocations = 0;
+		unsigned long long bytes = 0;
+		long long liveBytes = 0;
+		// highest liveBytes since the start or ResetPeaks()
+		long long peakBytes = 0;
+	};
+
+	struct FrameStats {
+		unsigned long long index = 0;
+		unsigned long long allocations = 0;
+		unsigned long long bytes = 0;
+		unsigned long long tagAllocations[TAG_COUNT] = {};
+		unsigned long long tagBytes[TAG_COUNT] = {};
+	};
+
+	void BeginFrame();
+	void EndFrame();
+
+	// called by the operator new / delete hooks
+	void OnAllocate(size_t bytes, TAG tag);
+	void OnFree(size_t bytes, TAG tag);
+
+	TagStats GetTagStats(TAG tag) const;
+	// every tag together
+	TagStats GetTotalStats() const;
+	const FrameStats& GetLastFrame() const { return lastFrame; }
+	// the frame with the most allocations since the start or ResetPeaks()
+	const FrameStats& GetWorstFrame() const { return worstFrame; }
+	std::vector<std::string> GetOverlayLines() const;
+	static const char* GetTagName(TAG tag);
+
+	// the tag new allocations of the calling thread are counted under, MEMORY_TAG() sets it for a scope
+	static TAG GetThreadTag();
+	static void SetThreadTag(TAG tag);
+
+	void SetAssertNoAlloc(bool enabled) { assertNoAlloc = enabled; }
+	bool GetAssertNoAlloc() const { return assertNoAlloc; }
+	// frames that allocated while SetAssertNoAlloc(true)
+	unsigned long long GetFailedFrames() const { return failedFrames; }
+
+	void ResetPeaks();
+
+private:
+
+	struct Counters {
+		std::atomic<unsigned long long> allocations{ 0 };
+		std::atomic<unsigned long long> bytes{ 0 };
+		std::atomic<long long> liveBytes{ 0 };
+		std::atomic<long long> peakBytes{ 0 };
+	};
+
+	// written from every thread by the hooks, the rest of the members only from the frame's thread
+	Counters tags[TAG_COUNT];
+	Counters total;
+
+	unsigned long long frameIndex = 0;
+	bool frameOpen = false;
+	// counters when BeginFrame() was called
+	FrameStats frameStart;
+	FrameStats lastFrame;
+	FrameStats worstFrame;
+
+	bool assertNoAlloc = false;
+	unsigned long long failedFrames = 0;
+
+	static void Add(Counters& counters, size_t bytes);
+	static void Remove(Counters& counters, size_t bytes);
+	static TagStats Read(const Counters& counters);
+	FrameStats Snapshot() const;
+
+	// trivial on purpose, frees that run after static destruction still land in valid memory
+	MemoryTracker() = default;
+	~MemoryTracker() = default;
+	MemoryTracker(const MemoryTracker&) = delete;
+	MemoryTracker& operator=(const MemoryTracker&) = delete;
+};
+
+struct MemoryTagScope {
+	MemoryTagScope(MemoryTracker::TAG tag) : previous(MemoryTracker::GetThreadTag()) { MemoryTracker::SetThreadTag(tag); }
+	~MemoryTagScope() { MemoryTracker::SetThreadTag(previous); }
+	MemoryTracker::TAG previous;
+};
+
+#endif
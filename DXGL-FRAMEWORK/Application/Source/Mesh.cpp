@@ -1,7 +1,10 @@
 
 #include "Mesh.h"
-#include "GL\glew.h"
+#include "GL/glew.h"
 #include "Vertex.h"
+#include "ResourceManager.h"
+#include <algorithm>
+#include <cmath>
 
 /******************************************************************************/
 /*!
@@ -15,6 +18,10 @@ Mesh::Mesh(const std::string &meshName)
 	: name(meshName)
 	, mode(DRAW_TRIANGLES)
 	, textureID(0)
+	, boundsCenter(0)
+	, boundsRadius(-1)
+	, boundsMin(0)
+	, boundsMax(0)
 {
 	glGenBuffers(1, &vertexBuffer);
 	glGenBuffers(1, &indexBuffer);
@@ -30,11 +37,116 @@ Mesh::~Mesh()
 {
 	glDeleteBuffers(1, &vertexBuffer);
 	glDeleteBuffers(1, &indexBuffer);
+	for (Lod& lod : lods)
+	{
+		if (lod.vertexBuffer != 0)
+			glDeleteBuffers(1, &lod.vertexBuffer);
+		glDeleteBuffers(1, &lod.indexBuffer);
+	}
 
-	if (textureID > 0)
+	// shared textures are only deleted once nothing else references them
+	ResourceManager::GetInstance().ReleaseTexture(textureID);
+}
+
+/******************************************************************************/
+/*!
+\brief
+Bounding sphere around the center of the vertices' box, not the tightest but close enough to cull with
+
+\param vertices - the vertices uploaded to vertexBuffer
+*/
+/******************************************************************************/
+void Mesh::SetBounds(const std::vector<Vertex>& vertices)
+{
+	if (vertices.empty())
+	{
+		boundsCenter = glm::vec3(0);
+		boundsRadius = -1;
+		boundsMin = boundsMax = glm::vec3(0);
+		return;
+	}
+	glm::vec3 minimum = vertices[0].pos, maximum = vertices[0].pos;
+	for (const Vertex& v : vertices)
+	{
+		minimum = glm::min(minimum, v.pos);
+		maximum = glm::max(maximum, v.pos);
+	}
+	boundsCenter = (minimum + maximum) * 0.5f;
+	boundsMin = minimum;
+	boundsMax = maximum;
+	float radiusSquared = 0;
+	for (const Vertex& v : vertices)
+	{
+		glm::vec3 offset = v.pos - boundsCenter;
+		radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+	}
+	boundsRadius = std::sqrt(radiusSquared);
+}
+
+/******************************************************************************/
+/*!
+\brief
+Positions of a triangle list, drawn on the cpu by OcclusionCuller when an object with this mesh is an occluder
+
+\param vertices - the vertices uploaded to vertexBuffer
+\param indices - 3 per triangle, into vertices
+*/
+/******************************************************************************/
+void Mesh::SetOccluder(const std::vector<Vertex>& vertices, const std::vector<unsigned>& indices)
+{
+	occluderVertices.clear();
+	occluderVertices.reserve(vertices.size());
+	for (const Vertex& v : vertices)
+		occluderVertices.push_back(v.pos);
+	occluderIndices.assign(indices.begin(), indices.begin() + indices.size() / 3 * 3);
+}
+
+/******************************************************************************/
+/*!
+\brief
+Upload a coarser level of this mesh, drawn with the same mode, texture and materials
+
+\param vertices - its own vertices, or empty to index into vertexBuffer
+\param indices - drawn with mode
+\param error - model space distance from level 0's surface, what picks the level
+\param materialSizes - index count per material when materials is not empty
+*/
+/******************************************************************************/
+void Mesh::AddLod(const std::vector<Vertex>& vertices, const std::vector<unsigned>& indices, float error, const std::vector<unsigned>& materialSizes)
+{
+	if (indices.empty() || GetLodCount() >= MAX_LODS)
+		return;
+
+	Lod lod;
+	if (!vertices.empty())
 	{
-		glDeleteTextures(1, &textureID);
+		glGenBuffers(1, &lod.vertexBuffer);
+		glBindBuffer(GL_ARRAY_BUFFER, lod.vertexBuffer);
+		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
 	}
+	glGenBuffers(1, &lod.indexBuffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, lod.indexBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), &indices[0], GL_STATIC_DRAW);
+	lod.indexSize = indices.size();
+	lod.materialSizes = materialSizes;
+	lod.error = error;
+	lods.push_back(lod);
+}
+
+float Mesh::GetLodError(unsigned level) const
+{
+	if (level == 0 || lods.empty())
+		return 0;
+	return lods[std::min<size_t>(level, lods.size()) - 1].error;
+}
+
+unsigned Mesh::CountTriangles(DRAW_MODE mode, unsigned indexCount)
+{
+	if (mode == DRAW_LINES)
+		return 0;
+	if (mode == DRAW_TRIANGLE_STRIP)
+		return indexCount > 2 ? indexCount - 2 : 0;
+	return indexCount / 3;
 }
 
 /******************************************************************************/
@@ -45,6 +157,13 @@ OpenGL render code
 /******************************************************************************/
 void Mesh::Render()
 {
+	RenderLod(0);
+}
+
+void Mesh::RenderLod(unsigned level)
+{
+	const Lod* lod = level == 0 || lods.empty() ? nullptr : &lods[std::min<size_t>(level, lods.size()) - 1];
+
 	glEnableVertexAttribArray(0); // 1st attribute buffer : positions
 	glEnableVertexAttribArray(1); // 2nd attribute buffer : colors
 	glEnableVertexAttribArray(2); // 3rd attribute buffer: normal
@@ -53,7 +172,7 @@ void Mesh::Render()
 		glEnableVertexAttribArray(3); // 4th attribute buffer: texture coordinates
 	}
 
-	glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, lod && lod->vertexBuffer != 0 ? lod->vertexBuffer : vertexBuffer);
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
 	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)sizeof(glm::vec3));
 	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(sizeof(glm::vec3) + sizeof(glm::vec3)));
@@ -61,40 +180,45 @@ void Mesh::Render()
 	{
 		glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(sizeof(glm::vec3) + sizeof(glm::vec3) + sizeof(glm::vec3)));
 	}
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, lod ? lod->indexBuffer : indexBuffer);
+	unsigned drawIndexSize = lod ? lod->indexSize : indexSize;
+	drawCalls += materials.size() == 0 ? 1 : materials.size();
 	if (materials.size() == 0)
 	{
+		drawnTriangles += CountTriangles(mode, drawIndexSize);
 		if (mode == DRAW_TRIANGLE_STRIP)
-			glDrawElements(GL_TRIANGLE_STRIP, indexSize, GL_UNSIGNED_INT, 0);
+			glDrawElements(GL_TRIANGLE_STRIP, drawIndexSize, GL_UNSIGNED_INT, 0);
 		else if (mode == DRAW_LINES)
-			glDrawElements(GL_LINES, indexSize, GL_UNSIGNED_INT, 0);
+			glDrawElements(GL_LINES, drawIndexSize, GL_UNSIGNED_INT, 0);
 		else
-			glDrawElements(GL_TRIANGLES, indexSize, GL_UNSIGNED_INT, 0);
+			glDrawElements(GL_TRIANGLES, drawIndexSize, GL_UNSIGNED_INT, 0);
 	}
 	else
 	{
 		for (unsigned i = 0, offset = 0; i < materials.size(); ++i)
 		{
 			Material& material = materials[i];
+			unsigned size = lod && i < lod->materialSizes.size() ? lod->materialSizes[i] : material.size;
 			glUniform3fv(locationKa, 1, &material.kAmbient.r);
 			glUniform3fv(locationKd, 1, &material.kDiffuse.r);
 			glUniform3fv(locationKs, 1, &material.kSpecular.r);
 			glUniform1f(locationNs, material.kShininess);
 
+			drawnTriangles += CountTriangles(mode, size);
 			if (mode == DRAW_TRIANGLE_STRIP)
 			{
-				glDrawElements(GL_TRIANGLE_STRIP, material.size, GL_UNSIGNED_INT, (void*)(offset * sizeof(unsigned)));
+				glDrawElements(GL_TRIANGLE_STRIP, size, GL_UNSIGNED_INT, (void*)(offset * sizeof(unsigned)));
 			}
 			else if (mode == DRAW_LINES)
 			{
-				glDrawElements(GL_LINES, material.size, GL_UNSIGNED_INT, (void*)(offset * sizeof(unsigned)));
+				glDrawElements(GL_LINES, size, GL_UNSIGNED_INT, (void*)(offset * sizeof(unsigned)));
 			}
 			else
 			{
-				glDrawElements(GL_TRIANGLES, material.size, GL_UNSIGNED_INT, (void*)(offset * sizeof(unsigned)));
+				glDrawElements(GL_TRIANGLES, size, GL_UNSIGNED_INT, (void*)(offset * sizeof(unsigned)));
 			}
 
-			offset += material.size;
+			offset += size;
 		}
 	}
 
@@ -111,6 +235,8 @@ unsigned Mesh::locationKa;
 unsigned Mesh::locationKd;
 unsigned Mesh::locationKs;
 unsigned Mesh::locationNs;
+unsigned long long Mesh::drawCalls = 0;
+unsigned long long Mesh::drawnTriangles = 0;
 
 void Mesh::SetMaterialLoc(unsigned kA, unsigned kD, unsigned kS, unsigned nS)
 {
@@ -141,6 +267,8 @@ void Mesh::Render(unsigned offset, unsigned count)
 	}
 
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+	drawCalls++;
+	drawnTriangles += CountTriangles(mode, count);
 
 	if (mode == DRAW_LINES)
 	{
@@ -173,6 +301,7 @@ void Mesh::RenderPhysicsWorld() {
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
 	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)sizeof(glm::vec3));
 
+	drawCalls++;
 	glDrawArrays(GL_LINES, 0, indexSize);
 
 	glDisableVertexAttribArray(0);
@@ -4,6 +4,9 @@
 #include "Material.h"
 #include <string>
 #include <vector>
+#include <glm/glm.hpp>
+
+struct Vertex;
 
 /******************************************************************************/
 /*!
@@ -21,12 +24,39 @@ public:
 		DRAW_LINES,
 		DRAW_MODE_LAST,
 	};
+	// level 0 included
+	static constexpr unsigned MAX_LODS = 5;
+
+	// a coarser version of the same mesh, drawn in place of level 0 when it is small on screen
+	struct Lod
+	{
+		// 0 to draw from the mesh's vertexBuffer, simplified OBJ levels only need new indices
+		unsigned vertexBuffer = 0;
+		unsigned indexBuffer = 0;
+		unsigned indexSize = 0;
+		// index count of each entry of materials, in the same order
+		std::vector<unsigned> materialSizes;
+		// how far, in model space, the surface may be from level 0's
+		float error = 0;
+	};
+
 	Mesh(const std::string &meshName);
 	~Mesh();
 	void Render();
+	// level 0 is Render(), past the coarsest level draws the coarsest level
+	void RenderLod(unsigned level);
 	static void SetMaterialLoc(unsigned kA, unsigned kD, unsigned kS, unsigned nS);
 	void Render(unsigned offset, unsigned count);
 	void RenderPhysicsWorld();
+	// model space bounding sphere and box, MeshBuilder calls this with the vertices it uploads
+	void SetBounds(const std::vector<Vertex>& vertices);
+	// keeps the positions of a triangle list for OcclusionCuller's software rasterizer, only worth it for big closed shapes
+	void SetOccluder(const std::vector<Vertex>& vertices, const std::vector<unsigned>& indices);
+	// appended after the levels already there, so add them finest first, vertices empty to share vertexBuffer
+	void AddLod(const std::vector<Vertex>& vertices, const std::vector<unsigned>& indices, float error, const std::vector<unsigned>& materialSizes = std::vector<unsigned>());
+	unsigned GetLodCount() const { return static_cast<unsigned>(lods.size()) + 1; }
+	// 0 for level 0
+	float GetLodError(unsigned level) const;
 
 	std::vector<Material> materials;
 	static unsigned locationKa;
@@ -34,6 +64,11 @@ public:
 	static unsigned locationKs;
 	static unsigned locationNs;
 
+	// glDraw* calls made through any mesh, never reset here, read the difference between 2 points
+	static unsigned long long drawCalls;
+	// triangles those calls drew, strips count their degenerate joins too
+	static unsigned long long drawnTriangles;
+
 	const std::string name;
 	DRAW_MODE mode;
 	unsigned vertexBuffer;
@@ -42,6 +77,22 @@ public:
 
 	Material material;
 	unsigned textureID;
+
+	// radius is negative until SetBounds() is called
+	glm::vec3 boundsCenter;
+	float boundsRadius;
+	glm::vec3 boundsMin;
+	glm::vec3 boundsMax;
+
+	// model space triangle list, empty unless SetOccluder() was called
+	std::vector<glm::vec3> occluderVertices;
+	std::vector<unsigned> occluderIndices;
+
+	// level 1 onwards
+	std::vector<Lod> lods;
+
+private:
+	static unsigned CountTriangles(DRAW_MODE mode, unsigned indexCount);
 };
 
 #endif
\ No newline at end of file
@@ -1,14 +1,23 @@
 #include "MeshBuilder.h"
-#include <GL\glew.h>
+#include <GL/glew.h>
 #include <vector>
+#include <algorithm>
+#include <cmath>
 
-#include "glm\glm.hpp"
-#include <glm\gtc\matrix_transform.hpp>
-#include <glm\gtc\type_ptr.hpp>
+#include "glm/glm.hpp"
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
 
 #include <reactphysics3d/reactphysics3d.h>
 
 #include "Utils.h"
+#include "ResourceManager.h"
+#include "Console.h"
+#include "MeshSimplifier.h"
+
+// taken by reference, C++14 needs the definitions
+constexpr unsigned MeshBuilder::MIN_LOD_SLICES;
+constexpr unsigned MeshBuilder::MIN_LOD_STACKS;
 
 /******************************************************************************/
 /*!
@@ -51,6 +60,7 @@ Mesh* MeshBuilder::GenerateAxes(const std::string &meshName, float lengthX, floa
 
 	glBindBuffer(GL_ARRAY_BUFFER, mesh->vertexBuffer);
 	glBufferData(GL_ARRAY_BUFFER, vertex_buffer_data.size() * sizeof(Vertex), &vertex_buffer_data[0], GL_STATIC_DRAW);
+	mesh->SetBounds(vertex_buffer_data);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->indexBuffer);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_buffer_data.size() * sizeof(GLuint), &index_buffer_data[0], GL_STATIC_DRAW);
 
@@ -74,11 +84,11 @@ Then generate the VBO/IBO and store them in Mesh object
 */
 /******************************************************************************/
 
-Mesh* MeshBuilder::GenerateSphere(const std::string& meshName, glm::vec3 color, float radius, unsigned int slices, unsigned int stacks, int textureID, unsigned int mode)
+void MeshBuilder::BuildSphere(std::vector<Vertex>& vertex_buffer_data, std::vector<unsigned>& index_buffer_data, glm::vec3 color, float radius, unsigned int slices, unsigned int stacks, unsigned int mode)
 {
+	vertex_buffer_data.clear();
+	index_buffer_data.clear();
 	Vertex v; // Vertex definition
-	std::vector<Vertex> vertex_buffer_data; // Vertex Buffer Objects
-	std::vector<GLuint> index_buffer_data; // Element Buffer Objects
 	v.color = color;
 
 	float degreePerStack = glm::pi<float>() / stacks;
@@ -124,12 +134,20 @@ Mesh* MeshBuilder::GenerateSphere(const std::string& meshName, glm::vec3 color,
 			}
 		}
 	}
+}
+
+Mesh* MeshBuilder::GenerateSphere(const std::string& meshName, glm::vec3 color, float radius, unsigned int slices, unsigned int stacks, int textureID, unsigned int mode)
+{
+	std::vector<Vertex> vertex_buffer_data;
+	std::vector<GLuint> index_buffer_data;
+	BuildSphere(vertex_buffer_data, index_buffer_data, color, radius, slices, stacks, mode);
 
 	// Create the new mesh
 	Mesh* mesh = new Mesh(meshName);
 
 	glBindBuffer(GL_ARRAY_BUFFER, mesh->vertexBuffer);
 	glBufferData(GL_ARRAY_BUFFER, vertex_buffer_data.size() * sizeof(Vertex), &vertex_buffer_data[0], GL_STATIC_DRAW);
+	mesh->SetBounds(vertex_buffer_data);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->indexBuffer);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_buffer_data.size() * sizeof(GLuint), &index_buffer_data[0], GL_STATIC_DRAW);
 
@@ -138,6 +156,13 @@ Mesh* MeshBuilder::GenerateSphere(const std::string& meshName, glm::vec3 color,
 	if (textureID != -1)
 		mesh->textureID = textureID;
 
+	// each level halves slices and stacks, its error is the sagitta of the widest step around the sphere
+	for (unsigned lodSlices = slices / 2, lodStacks = std::max(stacks / 2, MIN_LOD_STACKS); lodSlices >= MIN_LOD_SLICES && mesh->GetLodCount() < Mesh::MAX_LODS; lodSlices /= 2, lodStacks = std::max(lodStacks / 2, MIN_LOD_STACKS))
+	{
+		BuildSphere(vertex_buffer_data, index_buffer_data, color, radius, lodSlices, lodStacks, mode);
+		mesh->AddLod(vertex_buffer_data, index_buffer_data, ChordError(radius, std::max(glm::two_pi<float>() / lodSlices, glm::pi<float>() / lodStacks)));
+	}
+
 	return mesh;
 }
 
@@ -243,6 +268,7 @@ Mesh* MeshBuilder::GenerateCone(const std::string& meshName, glm::vec3 color, in
 
 	glBindBuffer(GL_ARRAY_BUFFER, mesh->vertexBuffer);
 	glBufferData(GL_ARRAY_BUFFER, vertex_buffer_data.size() * sizeof(Vertex), &vertex_buffer_data[0], GL_STATIC_DRAW);
+	mesh->SetBounds(vertex_buffer_data);
 
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->indexBuffer);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_buffer_data.size() * sizeof(GLuint), &index_buffer_data[0], GL_STATIC_DRAW);
@@ -253,11 +279,11 @@ Mesh* MeshBuilder::GenerateCone(const std::string& meshName, glm::vec3 color, in
 	return mesh;
 }
 
-Mesh* MeshBuilder::GenerateTorus(const std::string& meshName, glm::vec3 color, float width, float radius, unsigned int slices, unsigned int stacks, unsigned int mode) {
-
+void MeshBuilder::BuildTorus(std::vector<Vertex>& vertex_buffer_data, std::vector<unsigned>& index_buffer_data, glm::vec3 color, float width, float radius, unsigned int slices, unsigned int stacks, unsigned int mode)
+{
+	vertex_buffer_data.clear();
+	index_buffer_data.clear();
 	Vertex v; // Vertex definition
-	std::vector<Vertex> vertex_buffer_data; // Vertex Buffer Objects
-	std::vector<GLuint> index_buffer_data; // Element Buffer Objects
 	v.color = color;
 
 	width /= 2;
@@ -305,27 +331,41 @@ Mesh* MeshBuilder::GenerateTorus(const std::string& meshName, glm::vec3 color, f
 			}
 		}
 	}
+}
+
+Mesh* MeshBuilder::GenerateTorus(const std::string& meshName, glm::vec3 color, float width, float radius, unsigned int slices, unsigned int stacks, unsigned int mode) {
+	std::vector<Vertex> vertex_buffer_data;
+	std::vector<GLuint> index_buffer_data;
+	BuildTorus(vertex_buffer_data, index_buffer_data, color, width, radius, slices, stacks, mode);
 
 	// Create the new mesh
 	Mesh* mesh = new Mesh(meshName);
 
 	glBindBuffer(GL_ARRAY_BUFFER, mesh->vertexBuffer);
 	glBufferData(GL_ARRAY_BUFFER, vertex_buffer_data.size() * sizeof(Vertex), &vertex_buffer_data[0], GL_STATIC_DRAW);
+	mesh->SetBounds(vertex_buffer_data);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->indexBuffer);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_buffer_data.size() * sizeof(GLuint), &index_buffer_data[0], GL_STATIC_DRAW);
 
 	mesh->indexSize = index_buffer_data.size();
 	mesh->mode = Mesh::DRAW_TRIANGLE_STRIP;
 
+	// slices go around the tube, stacks around the ring, the outer edge of the ring is where a step cuts deepest
+	for (unsigned lodSlices = slices / 2, lodStacks = stacks / 2; lodSlices >= MIN_LOD_SLICES && lodStacks >= MIN_LOD_SLICES && mesh->GetLodCount() < Mesh::MAX_LODS; lodSlices /= 2, lodStacks /= 2)
+	{
+		BuildTorus(vertex_buffer_data, index_buffer_data, color, width, radius, lodSlices, lodStacks, mode);
+		mesh->AddLod(vertex_buffer_data, index_buffer_data, std::max(ChordError(width / 2, glm::two_pi<float>() / lodSlices), ChordError(radius + width / 2, glm::two_pi<float>() / lodStacks)));
+	}
+
 	return mesh;
 
 }
 
-Mesh* MeshBuilder::GenerateFrustum(const std::string& meshName, glm::vec3 color, float baseRadius, float topRadius, float height, float numSlice)
+void MeshBuilder::BuildFrustum(std::vector<Vertex>& vertex_buffer_data, std::vector<unsigned>& index_buffer_data, glm::vec3 color, float baseRadius, float topRadius, float height, float numSlice)
 {
+	vertex_buffer_data.clear();
+	index_buffer_data.clear();
 	Vertex v, temp, frustHypo, frustHeight;
-	std::vector<Vertex> vertex_buffer_data;
-	std::vector<GLuint> index_buffer_data;
 
 	v.color = color;
 
@@ -390,12 +430,19 @@ Mesh* MeshBuilder::GenerateFrustum(const std::string& meshName, glm::vec3 color,
 		index_buffer_data.push_back(topStartIndex + slice + 1);
 		index_buffer_data.push_back(topStartIndex);
 	}
-	
+}
+
+Mesh* MeshBuilder::GenerateFrustum(const std::string& meshName, glm::vec3 color, float baseRadius, float topRadius, float height, float numSlice)
+{
+	std::vector<Vertex> vertex_buffer_data;
+	std::vector<GLuint> index_buffer_data;
+	BuildFrustum(vertex_buffer_data, index_buffer_data, color, baseRadius, topRadius, height, numSlice);
 
 	Mesh* mesh = new Mesh(meshName);
 
 	glBindBuffer(GL_ARRAY_BUFFER, mesh->vertexBuffer);
 	glBufferData(GL_ARRAY_BUFFER, vertex_buffer_data.size() * sizeof(Vertex), &vertex_buffer_data[0], GL_STATIC_DRAW);
+	mesh->SetBounds(vertex_buffer_data);
 
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->indexBuffer);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_buffer_data.size() * sizeof(GLuint), &index_buffer_data[0], GL_STATIC_DRAW);
@@ -403,10 +450,30 @@ Mesh* MeshBuilder::GenerateFrustum(const std::string& meshName, glm::vec3 color,
 	mesh->indexSize = index_buffer_data.size();
 	mesh->mode = Mesh::DRAW_TRIANGLE_STRIP;
 
+	// 360 slices by default, far more than a frustum a few pixels wide needs
+	for (unsigned lodSlices = static_cast<unsigned>(numSlice) / 2; lodSlices >= MIN_LOD_SLICES && mesh->GetLodCount() < Mesh::MAX_LODS; lodSlices /= 2)
+	{
+		BuildFrustum(vertex_buffer_data, index_buffer_data, color, baseRadius, topRadius, height, static_cast<float>(lodSlices));
+		mesh->AddLod(vertex_buffer_data, index_buffer_data, ChordError(std::max(baseRadius, topRadius), glm::two_pi<float>() / lodSlices));
+	}
+
 	return mesh;
 }
 
 Mesh* MeshBuilder::GenerateQuad(const std::string& meshName, glm::vec3 color, float width, float height, int textureID)
+{
+	return GenerateQuad(meshName, color, width, height, textureID, nullptr);
+}
+
+Mesh* MeshBuilder::GenerateQuad(const std::string& meshName, glm::vec3 color, float width, float height, const TextureAtlas& atlas, const std::string& regionName)
+{
+	const TextureAtlas::Region* region = atlas.GetRegion(regionName);
+	if (!region)
+		return GenerateQuad(meshName, color, width, height, -1, nullptr);
+	return GenerateQuad(meshName, color, width, height, static_cast<int>(atlas.AcquireTexture()), region);
+}
+
+Mesh* MeshBuilder::GenerateQuad(const std::string& meshName, glm::vec3 color, float width, float height, int textureID, const TextureAtlas::Region* region)
 {
 	Vertex v;
 	std::vector<Vertex> vertex_buffer_data;
@@ -438,10 +505,13 @@ Mesh* MeshBuilder::GenerateQuad(const std::string& meshName, glm::vec3 color, fl
 	index_buffer_data.push_back(2);
 	index_buffer_data.push_back(3);
 
+	RemapUV(meshName, vertex_buffer_data, region);
+
 	Mesh* mesh = new Mesh(meshName);
 
 	glBindBuffer(GL_ARRAY_BUFFER, mesh->vertexBuffer);
 	glBufferData(GL_ARRAY_BUFFER, vertex_buffer_data.size() * sizeof(Vertex), &vertex_buffer_data[0], GL_STATIC_DRAW);
+	mesh->SetBounds(vertex_buffer_data);
 
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->indexBuffer);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_buffer_data.size() * sizeof(GLuint), &index_buffer_data[0], GL_STATIC_DRAW);
@@ -627,12 +697,15 @@ Mesh* MeshBuilder::GenerateCube(const std::string& meshName, glm::vec3 color, fl
 
 	glBindBuffer(GL_ARRAY_BUFFER, mesh->vertexBuffer);
 	glBufferData(GL_ARRAY_BUFFER, vertex_buffer_data.size() * sizeof(Vertex), &vertex_buffer_data[0], GL_STATIC_DRAW);
+	mesh->SetBounds(vertex_buffer_data);
 
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->indexBuffer);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_buffer_data.size() * sizeof(GLuint), &index_buffer_data[0], GL_STATIC_DRAW);
 
 	mesh->indexSize = index_buffer_data.size();
 	mesh->mode = Mesh::DRAW_TRIANGLES;
+	// closed boxes, walls and crates are what hides things
+	mesh->SetOccluder(vertex_buffer_data, index_buffer_data);
 
 	return mesh;
 }
@@ -748,12 +821,15 @@ Mesh* MeshBuilder::GenerateTrap(const std::string& meshName, glm::vec3 color, fl
 
 	glBindBuffer(GL_ARRAY_BUFFER, mesh->vertexBuffer);
 	glBufferData(GL_ARRAY_BUFFER, vertex_buffer_data.size() * sizeof(Vertex), &vertex_buffer_data[0], GL_STATIC_DRAW);
+	mesh->SetBounds(vertex_buffer_data);
 
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->indexBuffer);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_buffer_data.size() * sizeof(GLuint), &index_buffer_data[0], GL_STATIC_DRAW);
 
 	mesh->indexSize = index_buffer_data.size();
 	mesh->mode = Mesh::DRAW_TRIANGLES;
+	// as closed as the cube, 12 triangles for the rasterizer
+	mesh->SetOccluder(vertex_buffer_data, index_buffer_data);
 
 	return mesh;
 }
@@ -815,6 +891,7 @@ Mesh* MeshBuilder::GenerateHemisphere(const std::string& meshName, glm::vec3 col
 
 	glBindBuffer(GL_ARRAY_BUFFER, mesh->vertexBuffer);
 	glBufferData(GL_ARRAY_BUFFER, vertex_buffer_data.size() * sizeof(Vertex), &vertex_buffer_data[0], GL_STATIC_DRAW);
+	mesh->SetBounds(vertex_buffer_data);
 
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->indexBuffer);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_buffer_data.size() * sizeof(GLuint), &index_buffer_data[0], GL_STATIC_DRAW);
@@ -825,11 +902,11 @@ Mesh* MeshBuilder::GenerateHemisphere(const std::string& meshName, glm::vec3 col
 	return mesh;
 }
 
-Mesh* MeshBuilder::GenerateCylinder(const std::string& meshName, glm::vec3 color, int numSlice, float radius, float height)
+void MeshBuilder::BuildCylinder(std::vector<Vertex>& vertex_buffer_data, std::vector<unsigned>& index_buffer_data, glm::vec3 color, int numSlice, float radius, float height)
 {
+	vertex_buffer_data.clear();
+	index_buffer_data.clear();
 	Vertex v;
-	std::vector<Vertex> vertex_buffer_data;
-	std::vector<GLuint> index_buffer_data;
 
 	v.color = color;
 
@@ -900,11 +977,19 @@ Mesh* MeshBuilder::GenerateCylinder(const std::string& meshName, glm::vec3 color
 		index_buffer_data.push_back(topStartIndex + slice + 1);
 		index_buffer_data.push_back(topStartIndex);
 	}
+}
+
+Mesh* MeshBuilder::GenerateCylinder(const std::string& meshName, glm::vec3 color, int numSlice, float radius, float height)
+{
+	std::vector<Vertex> vertex_buffer_data;
+	std::vector<GLuint> index_buffer_data;
+	BuildCylinder(vertex_buffer_data, index_buffer_data, color, numSlice, radius, height);
 
 	Mesh* mesh = new Mesh(meshName);
 
 	glBindBuffer(GL_ARRAY_BUFFER, mesh->vertexBuffer);
 	glBufferData(GL_ARRAY_BUFFER, vertex_buffer_data.size() * sizeof(Vertex), &vertex_buffer_data[0], GL_STATIC_DRAW);
+	mesh->SetBounds(vertex_buffer_data);
 
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->indexBuffer);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_buffer_data.size() * sizeof(GLuint), &index_buffer_data[0], GL_STATIC_DRAW);
@@ -912,10 +997,33 @@ Mesh* MeshBuilder::GenerateCylinder(const std::string& meshName, glm::vec3 color
 	mesh->indexSize = index_buffer_data.size();
 	mesh->mode = Mesh::DRAW_TRIANGLE_STRIP;
 
+	for (int lodSlices = numSlice / 2; lodSlices >= static_cast<int>(MIN_LOD_SLICES) && mesh->GetLodCount() < Mesh::MAX_LODS; lodSlices /= 2)
+	{
+		BuildCylinder(vertex_buffer_data, index_buffer_data, color, lodSlices, radius, height);
+		mesh->AddLod(vertex_buffer_data, index_buffer_data, ChordError(radius, glm::two_pi<float>() / lodSlices));
+	}
+
 	return mesh;
 }
 
 Mesh* MeshBuilder::GenerateOBJ(const std::string& meshName, const std::string& file_path, int textureID)
+{
+	return GenerateOBJ(meshName, file_path, textureID, nullptr);
+}
+
+Mesh* MeshBuilder::GenerateOBJ(const std::string& meshName, const std::string& file_path, const TextureAtlas& atlas, const std::string& regionName)
+{
+	const TextureAtlas::Region* region = atlas.GetRegion(regionName);
+	if (!region)
+		return GenerateOBJ(meshName, file_path, -1, nullptr);
+
+	Mesh* mesh = GenerateOBJ(meshName, file_path, static_cast<int>(atlas.AcquireTexture()), region);
+	if (!mesh)
+		ResourceManager::GetInstance().ReleaseTexture(atlas.GetTextureID());
+	return mesh;
+}
+
+Mesh* MeshBuilder::GenerateOBJ(const std::string& meshName, const std::string& file_path, int textureID, const TextureAtlas::Region* region)
 {
 	// Read vertices, texcoords & normals from OBJ
 	std::vector<glm::vec3> vertices;
@@ -929,11 +1037,13 @@ Mesh* MeshBuilder::GenerateOBJ(const std::string& meshName, const std::string& f
 	std::vector<Vertex> vertex_buffer_data;
 	std::vector<GLuint> index_buffer_data;
 	ModelLoader::IndexVBO(vertices, uvs, normals, index_buffer_data, vertex_buffer_data);
+	RemapUV(meshName, vertex_buffer_data, region);
 
 	Mesh* mesh = new Mesh(meshName);
 
 	glBindBuffer(GL_ARRAY_BUFFER, mesh->vertexBuffer);
 	glBufferData(GL_ARRAY_BUFFER, vertex_buffer_data.size() * sizeof(Vertex), &vertex_buffer_data[0], GL_STATIC_DRAW);
+	mesh->SetBounds(vertex_buffer_data);
 
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->indexBuffer);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_buffer_data.size() * sizeof(GLuint), &index_buffer_data[0], GL_STATIC_DRAW);
@@ -942,11 +1052,29 @@ Mesh* MeshBuilder::GenerateOBJ(const std::string& meshName, const std::string& f
 	mesh->mode = Mesh::DRAW_TRIANGLES;
 	if (textureID != -1)
 		mesh->textureID = textureID;
+	AddSimplifiedLods(mesh, vertex_buffer_data, index_buffer_data);
 
 	return mesh;
 }
 
 Mesh* MeshBuilder::GenerateOBJMTL(const std::string& meshName, const std::string& file_path, const std::string& mtl_path, int textureID)
+{
+	return GenerateOBJMTL(meshName, file_path, mtl_path, textureID, nullptr);
+}
+
+Mesh* MeshBuilder::GenerateOBJMTL(const std::string& meshName, const std::string& file_path, const std::string& mtl_path, const TextureAtlas& atlas, const std::string& regionName)
+{
+	const TextureAtlas::Region* region = atlas.GetRegion(regionName);
+	if (!region)
+		return GenerateOBJMTL(meshName, file_path, mtl_path, -1, nullptr);
+
+	Mesh* mesh = GenerateOBJMTL(meshName, file_path, mtl_path, static_cast<int>(atlas.AcquireTexture()), region);
+	if (!mesh)
+		ResourceManager::GetInstance().ReleaseTexture(atlas.GetTextureID());
+	return mesh;
+}
+
+Mesh* MeshBuilder::GenerateOBJMTL(const std::string& meshName, const std::string& file_path, const std::string& mtl_path, int textureID, const TextureAtlas::Region* region)
 {
 	//Read vertices, texcoords & normals from OBJ
 	std::vector<glm::vec3> vertices;
@@ -961,6 +1089,7 @@ Mesh* MeshBuilder::GenerateOBJMTL(const std::string& meshName, const std::string
 	std::vector<Vertex> vertex_buffer_data;
 	std::vector<GLuint> index_buffer_data;
 	ModelLoader::IndexVBO(vertices, uvs, normals, index_buffer_data, vertex_buffer_data);
+	RemapUV(meshName, vertex_buffer_data, region);
 
 	Mesh* mesh = new Mesh(meshName);
 	for (Material& material : materials)
@@ -971,6 +1100,7 @@ Mesh* MeshBuilder::GenerateOBJMTL(const std::string& meshName, const std::string
 
 	glBindBuffer(GL_ARRAY_BUFFER, mesh->vertexBuffer);
 	glBufferData(GL_ARRAY_BUFFER, vertex_buffer_data.size() * sizeof(Vertex), &vertex_buffer_data[0], GL_STATIC_DRAW);
+	mesh->SetBounds(vertex_buffer_data);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->indexBuffer);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_buffer_data.size() * sizeof(GLuint), &index_buffer_data[0], GL_STATIC_DRAW);
 
@@ -978,6 +1108,7 @@ Mesh* MeshBuilder::GenerateOBJMTL(const std::string& meshName, const std::string
 	mesh->mode = Mesh::DRAW_TRIANGLES;
 	if (textureID != -1)
 		mesh->textureID = textureID;
+	AddSimplifiedLods(mesh, vertex_buffer_data, index_buffer_data);
 
 	return mesh;
 }
@@ -1030,6 +1161,7 @@ Mesh* MeshBuilder::GenerateText(const std::string& meshName, unsigned numRow, un
 
 	glBindBuffer(GL_ARRAY_BUFFER, mesh->vertexBuffer);
 	glBufferData(GL_ARRAY_BUFFER, vertex_buffer_data.size() * sizeof(Vertex), &vertex_buffer_data[0], GL_STATIC_DRAW);
+	mesh->SetBounds(vertex_buffer_data);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->indexBuffer);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_buffer_data.size() * sizeof(GLuint), &index_buffer_data[0], GL_STATIC_DRAW);
 
@@ -1160,6 +1292,7 @@ Mesh* MeshBuilder::GenerateSkybox(const std::string& meshName, unsigned textureI
 
 	glBindBuffer(GL_ARRAY_BUFFER, mesh->vertexBuffer);
 	glBufferData(GL_ARRAY_BUFFER, vertex_buffer_data.size() * sizeof(Vertex), &vertex_buffer_data[0], GL_STATIC_DRAW);
+	mesh->SetBounds(vertex_buffer_data);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->indexBuffer);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_buffer_data.size() * sizeof(GLuint), &index_buffer_data[0], GL_STATIC_DRAW);
 
@@ -1211,6 +1344,7 @@ Mesh* MeshBuilder::GenerateGround(const std::string& meshName, float size, float
 
 	glBindBuffer(GL_ARRAY_BUFFER, mesh->vertexBuffer);
 	glBufferData(GL_ARRAY_BUFFER, vertex_buffer_data.size() * sizeof(Vertex), &vertex_buffer_data[0], GL_STATIC_DRAW);
+	mesh->SetBounds(vertex_buffer_data);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->indexBuffer);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_buffer_data.size() * sizeof(GLuint), &index_buffer_data[0], GL_STATIC_DRAW);
 
@@ -1238,6 +1372,7 @@ Mesh* MeshBuilder::GenerateLine(const std::string& meshName, float length) {
 
 	glBindBuffer(GL_ARRAY_BUFFER, mesh->vertexBuffer);
 	glBufferData(GL_ARRAY_BUFFER, vertex_buffer_data.size() * sizeof(Vertex), &vertex_buffer_data[0], GL_STATIC_DRAW);
+	mesh->SetBounds(vertex_buffer_data);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->indexBuffer);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_buffer_data.size() * sizeof(GLuint), &index_buffer_data[0], GL_STATIC_DRAW);
 
@@ -1290,6 +1425,7 @@ Mesh* MeshBuilder::GenratePhysicsWorld(const reactphysics3d::DebugRenderer* debu
 
 	glBindBuffer(GL_ARRAY_BUFFER, mesh->vertexBuffer);
 	glBufferData(GL_ARRAY_BUFFER, vertex_buffer_data.size() * sizeof(Vertex), &vertex_buffer_data[0], GL_STATIC_DRAW);
+	mesh->SetBounds(vertex_buffer_data);
 
 	mesh->indexSize = vertex_buffer_data.size();
 	mesh->mode = Mesh::DRAW_LINES;
@@ -1297,3 +1433,39 @@ Mesh* MeshBuilder::GenratePhysicsWorld(const reactphysics3d::DebugRenderer* debu
 	return mesh;
 }
 
+float MeshBuilder::ChordError(float radius, float angle)
+{
+	// how far the middle of a straight edge spanning angle sits inside the curve
+	return radius * (1.f - std::cos(angle * 0.5f));
+}
+
+void MeshBuilder::AddSimplifiedLods(Mesh* mesh, const std::vector<Vertex>& vertices, const std::vector<unsigned>& indices)
+{
+	std::vector<unsigned> materialSizes;
+	for (const Material& material : mesh->materials)
+		materialSizes.push_back(material.size);
+
+	// half the triangles of the level before, the simplifier stops early once a model will not go lower
+	std::vector<float> ratios;
+	for (float ratio = 0.5f; ratios.size() + 1 < Mesh::MAX_LODS; ratio *= 0.5f)
+		ratios.push_back(ratio);
+	for (const MeshSimplifier::Level& level : MeshSimplifier::Simplify(vertices, indices, materialSizes, ratios))
+		mesh->AddLod(std::vector<Vertex>(), level.indices, level.error, level.materialSizes);
+}
+
+void MeshBuilder::RemapUV(const std::string& meshName, std::vector<Vertex>& vertices, const TextureAtlas::Region* region)
+{
+	if (!region)
+		return;
+
+	bool outOfRange = false;
+	for (Vertex& vertex : vertices) {
+		glm::vec2 uv = vertex.texCoord;
+		if (uv.x < -0.001f || uv.x > 1.001f || uv.y < -0.001f || uv.y > 1.001f)
+			outOfRange = true;
+		vertex.texCoord = region->Remap(glm::clamp(uv, 0.f, 1.f));
+	}
+
+	if (outOfRange)
+		Print("MeshBuilder: " + meshName + " has uv outside 0 - 1, it will be clamped because atlas regions cannot repeat", 1);
+}
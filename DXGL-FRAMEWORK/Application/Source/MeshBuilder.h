@@ -4,11 +4,18 @@
 #include "Mesh.h"
 #include "Vertex.h"
 #include "ModelLoader.h"
+#include "TextureAtlas.h"
 
 namespace reactphysics3d {
 	class DebugRenderer;
 }
 
+/* how to use | MeshBuilder LODs:
+* GenerateSphere, GenerateTorus, GenerateFrustum and GenerateCylinder add coarser tessellations to the mesh, halving
+* slices (and stacks) per level down to MIN_LOD_SLICES, GenerateOBJ / GenerateOBJMTL add MeshSimplifier levels
+* mesh->RenderLod(level); // BaseScene::SelectLod() picks the level from how big the mesh is on screen
+*/
+
 /******************************************************************************/
 /*!
 		Class MeshBuilder:
@@ -26,6 +33,8 @@ public:
 	static Mesh* GenerateTorus(const std::string& meshName, glm::vec3 color = glm::vec3(1.f), float width = 1.f, float radius = 1.f, unsigned int slices = 16, unsigned int stacks = 16, unsigned int mode = 0);
 	static Mesh* GenerateFrustum(const std::string& meshName, glm::vec3 color, float baseRadius, float topRadius, float height, float numSlice = 360);
 	static Mesh* GenerateQuad(const std::string& meshName, glm::vec3 color, float width, float height, int textureID = -1);
+	// uv is remapped into the region and the mesh holds a reference on the atlas texture
+	static Mesh* GenerateQuad(const std::string& meshName, glm::vec3 color, float width, float height, const TextureAtlas& atlas, const std::string& regionName);
 	static Mesh* GenerateCube(const std::string& meshName, glm::vec3 color, float length);
 	static Mesh* GenerateTrap(const std::string& meshName, glm::vec3 color, float baseLength, float baseWidth, float topLength, float topWidth, float height);
 	static Mesh* GenerateHemisphere(const std::string& meshName, glm::vec3 color, int numStack, int numSlice, float radius);
@@ -33,6 +42,9 @@ public:
 
 	static Mesh* GenerateOBJ(const std::string& meshName, const std::string& file_path, int textureID = -1);
 	static Mesh* GenerateOBJMTL(const std::string& meshName, const std::string& file_path, const std::string& mtl_path, int textureID = -1);
+	// only for models with uv in 0 - 1, a warning is printed if the model relies on repeating
+	static Mesh* GenerateOBJ(const std::string& meshName, const std::string& file_path, const TextureAtlas& atlas, const std::string& regionName);
+	static Mesh* GenerateOBJMTL(const std::string& meshName, const std::string& file_path, const std::string& mtl_path, const TextureAtlas& atlas, const std::string& regionName);
 
 	static Mesh* GenerateText(const std::string& meshName, unsigned numRow, unsigned numCol, float advanceWidth, unsigned textureID);
 
@@ -42,6 +54,25 @@ public:
 	static Mesh* GenerateLine(const std::string& meshName, float length);
 
 	static Mesh* GenratePhysicsWorld(const reactphysics3d::DebugRenderer* debugRenderer);
+
+	// fewer slices around than this look like a polygon at any size worth drawing
+	static constexpr unsigned MIN_LOD_SLICES = 6;
+	static constexpr unsigned MIN_LOD_STACKS = 2;
+
+private:
+	static Mesh* GenerateQuad(const std::string& meshName, glm::vec3 color, float width, float height, int textureID, const TextureAtlas::Region* region);
+	static Mesh* GenerateOBJ(const std::string& meshName, const std::string& file_path, int textureID, const TextureAtlas::Region* region);
+	static Mesh* GenerateOBJMTL(const std::string& meshName, const std::string& file_path, const std::string& mtl_path, int textureID, const TextureAtlas::Region* region);
+
+	// vertices and indices of the strips the Generate functions upload, for every level
+	static void BuildSphere(std::vector<Vertex>& vertex_buffer_data, std::vector<unsigned>& index_buffer_data, glm::vec3 color, float radius, unsigned int slices, unsigned int stacks, unsigned int mode);
+	static void BuildTorus(std::vector<Vertex>& vertex_buffer_data, std::vector<unsigned>& index_buffer_data, glm::vec3 color, float width, float radius, unsigned int slices, unsigned int stacks, unsigned int mode);
+	static void BuildFrustum(std::vector<Vertex>& vertex_buffer_data, std::vector<unsigned>& index_buffer_data, glm::vec3 color, float baseRadius, float topRadius, float height, float numSlice);
+	static void BuildCylinder(std::vector<Vertex>& vertex_buffer_data, std::vector<unsigned>& index_buffer_data, glm::vec3 color, int numSlice, float radius, float height);
+	static float ChordError(float radius, float angle);
+	static void AddSimplifiedLods(Mesh* mesh, const std::vector<Vertex>& vertices, const std::vector<unsigned>& indices);
+
+	static void RemapUV(const std::string& meshName, std::vector<Vertex>& vertices, const TextureAtlas::Region* region);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,273 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <queue>
+#include <unordered_map>
+#include <utility>
+
+namespace {
+
+	// symmetric 4x4 of the planes around a position, Evaluate(p) is the summed squared distance of p to them
+	struct Quadric {
+		double a2 = 0, ab = 0, ac = 0, ad = 0, b2 = 0, bc = 0, bd = 0, c2 = 0, cd = 0, d2 = 0;
+
+		void AddPlane(const glm::dvec3& n, double d) {
+			a2 += n.x * n.x; ab += n.x * n.y; ac += n.x * n.z; ad += n.x * d;
+			b2 += n.y * n.y; bc += n.y * n.z; bd += n.y * d;
+			c2 += n.z * n.z; cd += n.z * d;
+			d2 += d * d;
+		}
+
+		Quadric& operator+=(const Quadric& other) {
+			a2 += other.a2; ab += other.ab; ac += other.ac; ad += other.ad;
+			b2 += other.b2; bc += other.bc; bd += other.bd;
+			c2 += other.c2; cd += other.cd;
+			d2 += other.d2;
+			return *this;
+		}
+
+		double Evaluate(const glm::vec3& p) const {
+			double x = p.x, y = p.y, z = p.z;
+			return a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x
+				+ b2 * y * y + 2 * bc * y * z + 2 * bd * y
+				+ c2 * z * z + 2 * cd * z
+				+ d2;
+		}
+	};
+
+	// from moves onto to, the versions go stale once either end takes part in another collapse
+	struct Collapse {
+		double cost;
+		unsigned from, to;
+		unsigned fromVersion, toVersion;
+		bool operator>(const Collapse& other) const { return cost > other.cost; }
+	};
+
+	struct PositionHash {
+		size_t operator()(const glm::vec3& p) const {
+			uint32_t bits[3];
+			std::memcpy(bits, &p, sizeof(bits));
+			return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+		}
+	};
+
+	glm::vec3 TriangleNormal(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c) {
+		return glm::cross(b - a, c - a);
+	}
+}
+
+std::vector<MeshSimplifier::Level> MeshSimplifier::Simplify(const std::vector<Vertex>& vertices, const std::vector<unsigned>& indices,
+	const std::vector<unsigned>& materialSizes, const std::vector<float>& ratios) {
+	std::vector<Level> levels;
+	unsigned triangleCount = static_cast<unsigned>(indices.size() / 3);
+	unsigned vertexCount = static_cast<unsigned>(vertices.size());
+	if (triangleCount == 0 || ratios.empty())
+		return levels;
+
+	// IndexVBO splits a position into several vertices wherever its uv or normal changes, topology and error live on positions
+	std::vector<unsigned> positionOf(vertexCount);
+	std::vector<std::vector<unsigned>> verticesAt;
+	{
+		std::unordered_map<glm::vec3, unsigned, PositionHash> firstAt;
+		for (unsigned v = 0; v < vertexCount; v++) {
+			auto inserted = firstAt.emplace(vertices[v].pos, static_cast<unsigned>(verticesAt.size()));
+			if (inserted.second)
+				verticesAt.emplace_back();
+			positionOf[v] = inserted.first->second;
+			verticesAt[positionOf[v]].push_back(v);
+		}
+	}
+
+	std::vector<unsigned> triangles(indices.begin(), indices.begin() + triangleCount * 3);
+	std::vector<bool> removed(triangleCount, false);
+	std::vector<std::vector<unsigned>> trianglesOf(vertexCount);
+	std::vector<Quadric> quadrics(verticesAt.size());
+	// triangles per undirected position edge, anything but 2 is an open border or a non manifold fan
+	std::unordered_map<uint64_t, unsigned> edgeUses;
+	unsigned liveTriangles = 0;
+
+	for (unsigned t = 0; t < triangleCount; t++) {
+		const unsigned* corners = &triangles[t * 3];
+		unsigned p0 = positionOf[corners[0]], p1 = positionOf[corners[1]], p2 = positionOf[corners[2]];
+		if (p0 == p1 || p1 == p2 || p2 == p0) {
+			removed[t] = true;
+			continue;
+		}
+		liveTriangles++;
+		for (unsigned k = 0; k < 3; k++) {
+			trianglesOf[corners[k]].push_back(t);
+			unsigned a = positionOf[corners[k]], b = positionOf[corners[(k + 1) % 3]];
+			edgeUses[static_cast<uint64_t>(std::min(a, b)) << 32 | std::max(a, b)]++;
+		}
+
+		glm::dvec3 normal = TriangleNormal(vertices[corners[0]].pos, vertices[corners[1]].pos, vertices[corners[2]].pos);
+		double length = glm::length(normal);
+		if (length == 0)
+			continue;
+		normal /= length;
+		double d = -glm::dot(normal, glm::dvec3(vertices[corners[0]].pos));
+		quadrics[p0].AddPlane(normal, d);
+		quadrics[p1].AddPlane(normal, d);
+		quadrics[p2].AddPlane(normal, d);
+	}
+
+	std::vector<bool> lockedPosition(verticesAt.size(), false);
+	for (const auto& edge : edgeUses) {
+		if (edge.second != 2) {
+			lockedPosition[static_cast<unsigned>(edge.first >> 32)] = true;
+			lockedPosition[static_cast<unsigned>(edge.first & 0xFFFFFFFFu)] = true;
+		}
+	}
+	// a vertex moves only if it is the sole vertex at its position and not on a border, it can still be moved onto
+	std::vector<bool> locked(vertexCount);
+	for (unsigned v = 0; v < vertexCount; v++)
+		locked[v] = lockedPosition[positionOf[v]] || verticesAt[positionOf[v]].size() > 1;
+
+	std::vector<unsigned> version(vertexCount, 0);
+	std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> queue;
+	auto push = [&](unsigned from, unsigned to) {
+		if (locked[from])
+			return;
+		double cost = quadrics[positionOf[from]].Evaluate(vertices[to].pos) + quadrics[positionOf[to]].Evaluate(vertices[to].pos);
+		queue.push({ cost, from, to, version[from], version[to] });
+	};
+	for (unsigned t = 0; t < triangleCount; t++) {
+		if (removed[t])
+			continue;
+		for (unsigned k = 0; k < 3; k++) {
+			push(triangles[t * 3 + k], triangles[t * 3 + (k + 1) % 3]);
+			push(triangles[t * 3 + (k + 1) % 3], triangles[t * 3 + k]);
+		}
+	}
+
+	auto touches = [&](unsigned t, unsigned position) {
+		return positionOf[triangles[t * 3]] == position || positionOf[triangles[t * 3 + 1]] == position || positionOf[triangles[t * 3 + 2]] == position;
+	};
+	std::vector<unsigned> fromRing, toRing;
+	auto canCollapse = [&](unsigned from, unsigned to) {
+		unsigned fromPosition = positionOf[from], toPosition = positionOf[to];
+
+		// the positions around both ends may only share the 2 opposite corners of the edge, more would pinch the surface
+		fromRing.clear();
+		toRing.clear();
+		for (unsigned t : trianglesOf[from]) {
+			for (unsigned k = 0; k < 3; k++)
+				fromRing.push_back(positionOf[triangles[t * 3 + k]]);
+		}
+		for (unsigned v : verticesAt[toPosition]) {
+			for (unsigned t : trianglesOf[v]) {
+				for (unsigned k = 0; k < 3; k++)
+					toRing.push_back(positionOf[triangles[t * 3 + k]]);
+			}
+		}
+		std::sort(fromRing.begin(), fromRing.end());
+		fromRing.erase(std::unique(fromRing.begin(), fromRing.end()), fromRing.end());
+		std::sort(toRing.begin(), toRing.end());
+		toRing.erase(std::unique(toRing.begin(), toRing.end()), toRing.end());
+		if (!std::binary_search(fromRing.begin(), fromRing.end(), toPosition))
+			return false;
+		unsigned shared = 0;
+		for (unsigned position : fromRing) {
+			if (position != fromPosition && position != toPosition && std::binary_search(toRing.begin(), toRing.end(), position))
+				shared++;
+		}
+		if (shared != 2)
+			return false;
+
+		// the triangles that stay must not turn over or fold to a sliver
+		for (unsigned t : trianglesOf[from]) {
+			if (touches(t, toPosition))
+				continue;
+			glm::vec3 corners[3], moved[3];
+			for (unsigned k = 0; k < 3; k++) {
+				corners[k] = vertices[triangles[t * 3 + k]].pos;
+				moved[k] = triangles[t * 3 + k] == from ? vertices[to].pos : corners[k];
+			}
+			glm::vec3 before = TriangleNormal(corners[0], corners[1], corners[2]);
+			glm::vec3 after = TriangleNormal(moved[0], moved[1], moved[2]);
+			float beforeLength = glm::length(before), afterLength = glm::length(after);
+			if (beforeLength == 0)
+				continue;
+			if (afterLength == 0 || glm::dot(before, after) < 0.2f * beforeLength * afterLength)
+				return false;
+		}
+		return true;
+	};
+
+	auto collapse = [&](unsigned from, unsigned to) {
+		unsigned toPosition = positionOf[to];
+		for (unsigned t : trianglesOf[from]) {
+			unsigned* corners = &triangles[t * 3];
+			if (touches(t, toPosition)) {
+				removed[t] = true;
+				liveTriangles--;
+				for (unsigned k = 0; k < 3; k++) {
+					if (corners[k] == from)
+						continue;
+					std::vector<unsigned>& list = trianglesOf[corners[k]];
+					list.erase(std::remove(list.begin(), list.end(), t), list.end());
+				}
+				continue;
+			}
+			for (unsigned k = 0; k < 3; k++) {
+				if (corners[k] == from)
+					corners[k] = to;
+			}
+			trianglesOf[to].push_back(t);
+		}
+		trianglesOf[from].clear();
+		quadrics[toPosition] += quadrics[positionOf[from]];
+		version[from]++;
+		version[to]++;
+
+		for (unsigned t : trianglesOf[to]) {
+			for (unsigned k = 0; k < 3; k++) {
+				unsigned corner = triangles[t * 3 + k];
+				if (corner == to)
+					continue;
+				push(corner, to);
+				push(to, corner);
+			}
+		}
+	};
+
+	double maxCost = 0;
+	unsigned previousCount = liveTriangles;
+	for (float ratio : ratios) {
+		unsigned target = static_cast<unsigned>(triangleCount * ratio);
+		while (liveTriangles > target && !queue.empty()) {
+			Collapse next = queue.top();
+			queue.pop();
+			if (next.fromVersion != version[next.from] || next.toVersion != version[next.to])
+				continue;
+			if (!canCollapse(next.from, next.to))
+				continue;
+			maxCost = std::max(maxCost, next.cost);
+			collapse(next.from, next.to);
+		}
+		if (liveTriangles > previousCount * (1.f - MIN_REDUCTION))
+			break;
+
+		Level level;
+		level.indices.reserve(liveTriangles * 3);
+		level.materialSizes.assign(materialSizes.size(), 0);
+		unsigned material = 0, materialStart = 0;
+		for (unsigned t = 0; t < triangleCount; t++) {
+			while (material < materialSizes.size() && t * 3 >= materialStart + materialSizes[material])
+				materialStart += materialSizes[material++];
+			if (removed[t])
+				continue;
+			level.indices.insert(level.indices.end(), triangles.begin() + t * 3, triangles.begin() + t * 3 + 3);
+			if (material < materialSizes.size())
+				level.materialSizes[material] += 3;
+		}
+		level.error = static_cast<float>(std::sqrt(std::max(maxCost, 0.0)));
+		levels.push_back(std::move(level));
+		previousCount = liveTriangles;
+	}
+	return levels;
+}
@@ -0,0 +1,42 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <vector>
+
+#include "Vertex.h"
+
+/* how to use | MeshSimplifier:
+* std::vector<unsigned> materialSizes; // index count per material, empty for a single range
+* std::vector<MeshSimplifier::Level> levels = MeshSimplifier::Simplify(vertices, indices, materialSizes, { 0.5f, 0.25f, 0.125f });
+* for (const MeshSimplifier::Level& level : levels)
+*     mesh->AddLod(std::vector<Vertex>(), level.indices, level.error, level.materialSizes); // indices into the same vertices
+*
+* notes:
+* - quadric error metric edge collapses (Garland & Heckbert), a vertex collapses onto a neighbour that already exists,
+*   so every level indexes the original vertex buffer and only needs an index buffer of its own
+* - vertices on open borders and on uv / normal seams never move, the silhouette and texture mapping hold,
+*   a model that is all seams (flat shaded, every face its own normals) barely simplifies
+* - collapses that would flip a triangle or pinch the surface into a non manifold edge are refused
+* - triangles keep their order, so each material stays 1 contiguous range and materialSizes follow it
+* - a level that removes less than MIN_REDUCTION of the previous level's triangles is not returned, nor anything after it
+* - triangle lists only, strips have to be converted first
+*/
+
+class MeshSimplifier {
+public:
+
+	static constexpr float MIN_REDUCTION = 0.1f;
+
+	struct Level {
+		std::vector<unsigned> indices;
+		std::vector<unsigned> materialSizes;
+		// square root of the largest quadric error accepted so far, about how far the surface moved in model space
+		float error = 0;
+	};
+
+	// ratios are triangle counts relative to the input, largest first
+	static std::vector<Level> Simplify(const std::vector<Vertex>& vertices, const std::vector<unsigned>& indices,
+		const std::vector<unsigned>& materialSizes, const std::vector<float>& ratios);
+};
+
+#endif
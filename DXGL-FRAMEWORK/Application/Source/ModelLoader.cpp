@@ -1,5 +1,10 @@
+// the _s versions are MSVC only, every format here reads numbers and buf + 7 always fits the 256 byte buffers
+#define _CRT_SECURE_NO_WARNINGS
+
 #include <iostream>
 #include <fstream>
+#include <cstdio>
+#include <cstring>
 
 #include "ModelLoader.h"
 
@@ -39,26 +44,26 @@ bool ModelLoader::LoadOBJ(
 		if (strncmp("v ", buf, 2) == 0) { 
 			// process vertex glm::vec3
 			glm::vec3 vertex;
-			sscanf_s((buf + 2), "%f%f%f", &vertex.x, &vertex.y, &vertex.z);
+			sscanf((buf + 2), "%f%f%f", &vertex.x, &vertex.y, &vertex.z);
 			temp_vertices.push_back(vertex);
 		}
 		else if (strncmp("vt ", buf, 3) == 0) { 
 			// process texcoord
 			glm::vec2 texCoord;
-			sscanf_s((buf + 3), "%f%f", &texCoord.x, &texCoord.y);
+			sscanf((buf + 3), "%f%f", &texCoord.x, &texCoord.y);
 			temp_uvs.push_back(texCoord);
 		}
 		else if (strncmp("vn ", buf, 3) == 0) { 
 			// process normal
 			glm::vec3 normal;
-			sscanf_s((buf + 3), "%f%f%f", &normal.x, &normal.y, &normal.z);
+			sscanf((buf + 3), "%f%f%f", &normal.x, &normal.y, &normal.z);
 			temp_normals.push_back(normal);
 		}
 		else if (strncmp("f ", buf, 2) == 0) { 
 			// process face
 
 			unsigned int vertexIndex[5], uvIndex[5], normalIndex[5];
-			int matches = sscanf_s((buf + 2), "%d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d\n",
+			int matches = sscanf((buf + 2), "%d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d\n",
 				&vertexIndex[0], &uvIndex[0], &normalIndex[0],
 				&vertexIndex[1], &uvIndex[1], &normalIndex[1],
 				&vertexIndex[2], &uvIndex[2], &normalIndex[2],
@@ -239,7 +244,7 @@ bool ModelLoader::LoadMTL(const char* file_path, std::map<std::string, Material*
 		fileStream.getline(buf, 256);
 		if (strncmp("newmtl ", buf, 7) == 0) { //process newmtl
 			char mtl_name[256];
-			strcpy_s(mtl_name, buf + 7);
+			snprintf(mtl_name, sizeof(mtl_name), "%s", buf + 7);
 			if (mtl_name[strlen(mtl_name) - 1] == '\r')
 				mtl_name[strlen(mtl_name) - 1] = '\0';
 			mtl = nullptr;
@@ -252,25 +257,25 @@ bool ModelLoader::LoadMTL(const char* file_path, std::map<std::string, Material*
 		else if (strncmp("Ka ", buf, 3) == 0) { //process Ka
 			if (mtl != nullptr)
 			{
-				sscanf_s((buf + 3), "%f%f%f", &mtl->kAmbient.r, &mtl->kAmbient.g, &mtl->kAmbient.b);
+				sscanf((buf + 3), "%f%f%f", &mtl->kAmbient.r, &mtl->kAmbient.g, &mtl->kAmbient.b);
 			}
 		}
 		else if (strncmp("Kd ", buf, 3) == 0) { //process Kd
 			if (mtl != nullptr)
 			{
-				sscanf_s((buf + 3), "%f%f%f", &mtl->kDiffuse.r, &mtl->kDiffuse.g, &mtl->kDiffuse.b);
+				sscanf((buf + 3), "%f%f%f", &mtl->kDiffuse.r, &mtl->kDiffuse.g, &mtl->kDiffuse.b);
 			}
 		}
 		else if (strncmp("Ks ", buf, 3) == 0) { //process Ks
 			if (mtl != nullptr)
 			{
-				sscanf_s((buf + 3), "%f%f%f", &mtl->kSpecular.r, &mtl->kSpecular.g, &mtl->kSpecular.b);
+				sscanf((buf + 3), "%f%f%f", &mtl->kSpecular.r, &mtl->kSpecular.g, &mtl->kSpecular.b);
 			}
 		}
 		else if (strncmp("Ns ", buf, 3) == 0) { //process Ns
 			if (mtl != nullptr)
 			{
-				sscanf_s((buf + 3), "%f", &mtl->kShininess);
+				sscanf((buf + 3), "%f", &mtl->kShininess);
 			}
 		}
 	}
@@ -303,30 +308,30 @@ bool ModelLoader::LoadOBJMTL(const char* file_path, const char* mtl_path, std::v
 		if (strncmp("v ", buf, 2) == 0) { 
 			// process vertex glm::vec3
 			glm::vec3 vertex;
-			sscanf_s((buf + 2), "%f%f%f", &vertex.x, &vertex.y, &vertex.z);
+			sscanf((buf + 2), "%f%f%f", &vertex.x, &vertex.y, &vertex.z);
 			temp_vertices.push_back(vertex);
 		}
 		else if (strncmp("vt ", buf, 3) == 0) { 
 			// process texcoord
 			glm::vec3 texCoord;
-			sscanf_s((buf + 3), "%f%f", &texCoord.x, &texCoord.y);
+			sscanf((buf + 3), "%f%f", &texCoord.x, &texCoord.y);
 			temp_uvs.push_back(texCoord);
 		}
 		else if (strncmp("vn ", buf, 3) == 0) { 
 			// process normal
 			glm::vec3 normal;
-			sscanf_s((buf + 3), "%f%f%f", &normal.x, &normal.y, &normal.z);
+			sscanf((buf + 3), "%f%f%f", &normal.x, &normal.y, &normal.z);
 			temp_normals.push_back(normal);
 		}
 		else if (strncmp("mtllib ", buf, 7) == 0) { //process mtllib
 			char mtl_path[256];
-			strcpy_s(mtl_path, buf + 7);
+			snprintf(mtl_path, sizeof(mtl_path), "%s", buf + 7);
 			LoadMTL(mtl_path, materials_map);
 		}
 		else if (strncmp("usemtl ", buf, 7) == 0) { 
 			// process usemtl
 			char mtl_name[256];
-			strcpy_s(mtl_name, buf + 7);
+			snprintf(mtl_name, sizeof(mtl_name), "%s", buf + 7);
 			if (materials_map.find(mtl_name) != materials_map.end())
 			{
 				Material* mtl = materials_map.find(mtl_name)->second;
@@ -338,7 +343,7 @@ bool ModelLoader::LoadOBJMTL(const char* file_path, const char* mtl_path, std::v
 			// process face
 
 			unsigned int vertexIndex[5], uvIndex[5], normalIndex[5];
-			int matches = sscanf_s((buf + 2), "%d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d\n",
+			int matches = sscanf((buf + 2), "%d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d\n",
 				&vertexIndex[0], &uvIndex[0], &normalIndex[0],
 				&vertexIndex[1], &uvIndex[1], &normalIndex[1],
 				&vertexIndex[2], &uvIndex[2], &normalIndex[2],
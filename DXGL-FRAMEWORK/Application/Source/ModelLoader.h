@@ -4,7 +4,7 @@
 #include <string>
 #include <vector>
 #include <map>
-#include <glm\glm.hpp>
+#include <glm/glm.hpp>
 
 #include "Vertex.h"
 #include "Material.h"
@@ -36,6 +36,7 @@ class ModelLoader {
 public:
 
 	static void SetDirectory(const std::string& directoryPath);
+	static const std::string& GetDirectory() { return directory; }
 
 	static bool LoadOBJ(
 		const char* file_path,
@@ -0,0 +1,417 @@
+#include "OcclusionCuller.h"
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "Mesh.h"
+#include "shader.hpp"
+#include "Console.h"
+
+// taken by reference, C++14 needs the definitions
+constexpr unsigned OcclusionCuller::BASE_WIDTH;
+
+namespace {
+	// a box wider or taller than this many cells is tested on a coarser level, so no test reads more than 16 cells
+	const unsigned MAX_TEST_CELLS = 4;
+	// a readback this old means captures were missed, the post process was off or the gpu is far behind
+	const unsigned MAX_DEPTH_AGE = OcclusionCuller::READBACK_FRAMES * 2;
+
+	double MillisecondsSince(std::chrono::steady_clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+}
+
+OcclusionCuller::~OcclusionCuller() {
+	if (vertexArrayID != 0)
+		Error("OcclusionCuller: destroyed without Destroy(), its targets and buffers leaked");
+}
+
+void OcclusionCuller::Create(unsigned width, unsigned height) {
+	Destroy();
+	this->width = width;
+	this->height = height;
+	baseHeight = std::max(1u, static_cast<unsigned>(std::lround(static_cast<double>(BASE_WIDTH) * height / width)));
+
+	levels.clear();
+	levelSizes.clear();
+	glm::uvec2 size(BASE_WIDTH, baseHeight);
+	while (true) {
+		levelSizes.push_back(size);
+		levels.emplace_back(size.x * size.y, 1.f);
+		if (size.x == 1 && size.y == 1)
+			break;
+		size = glm::uvec2((size.x + 1) / 2, (size.y + 1) / 2);
+	}
+
+	programID = LoadShaders("Shader//Post.vertexshader", "Shader//HiZ.fragmentshader", "", "ShaderCache");
+	GLint linked = GL_FALSE;
+	if (programID != 0)
+		glGetProgramiv(programID, GL_LINK_STATUS, &linked);
+	if (linked != GL_TRUE) {
+		Error("OcclusionCuller: HiZ.fragmentshader failed to build, MODE_GPU culls nothing");
+		if (programID != 0)
+			glDeleteProgram(programID);
+		programID = 0;
+	}
+	else {
+		sourceSizeLocation = glGetUniformLocation(programID, "sourceSize");
+		targetSizeLocation = glGetUniformLocation(programID, "targetSize");
+		glUseProgram(programID);
+		glUniform1i(glGetUniformLocation(programID, "source"), 0);
+		glUseProgram(0);
+	}
+	glGenVertexArrays(1, &vertexArrayID);
+
+	RenderTarget::Description depthDescription;
+	depthDescription.width = width;
+	depthDescription.height = height;
+	depthDescription.depth = true;
+	depthDescription.depthTexture = true;
+	depthCopy.Create(depthDescription);
+
+	RenderTarget::Description gridDescription;
+	gridDescription.width = BASE_WIDTH;
+	gridDescription.height = baseHeight;
+	gridDescription.colorFormat = GL_R32F;
+	baseGrid.Create(gridDescription);
+
+	for (Readback& readback : readbacks) {
+		glGenBuffers(1, &readback.pixelBuffer);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.pixelBuffer);
+		glBufferData(GL_PIXEL_PACK_BUFFER, BASE_WIDTH * baseHeight * sizeof(float), nullptr, GL_STREAM_READ);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	readbackSlot = 0;
+
+	frame = 0;
+	stats = Stats();
+	ClearDepth();
+}
+
+void OcclusionCuller::Destroy() {
+	if (programID != 0)
+		glDeleteProgram(programID);
+	programID = 0;
+	if (vertexArrayID != 0)
+		glDeleteVertexArrays(1, &vertexArrayID);
+	vertexArrayID = 0;
+	depthCopy.Destroy();
+	baseGrid.Destroy();
+	for (Readback& readback : readbacks) {
+		if (readback.fence)
+			glDeleteSync(static_cast<GLsync>(readback.fence));
+		if (readback.pixelBuffer != 0)
+			glDeleteBuffers(1, &readback.pixelBuffer);
+		readback = Readback();
+	}
+	ClearDepth();
+}
+
+void OcclusionCuller::SetMode(MODE mode) {
+	if (mode == this->mode)
+		return;
+	this->mode = mode;
+	// captures still in flight belong to the old mode
+	for (Readback& readback : readbacks) {
+		if (readback.fence)
+			glDeleteSync(static_cast<GLsync>(readback.fence));
+		readback.fence = nullptr;
+	}
+	ClearDepth();
+}
+
+const char* OcclusionCuller::GetModeName(MODE mode) {
+	switch (mode) {
+	case MODE_OFF: return "off";
+	case MODE_GPU: return "gpu";
+	case MODE_CPU: return "cpu";
+	default: return "unknown";
+	}
+}
+
+
+/********************************* frame *********************************/
+
+void OcclusionCuller::BeginFrame(const glm::mat4& viewProjection, const glm::vec3& cameraPosition) {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	frame++;
+	frameViewProjection = viewProjection;
+	frameCameraPosition = cameraPosition;
+	stats = Stats();
+	skipTests = true;
+	if (levels.empty())
+		return;
+
+	if (mode == MODE_GPU) {
+		ReadBack();
+		if (hasDepth) {
+			stats.age = static_cast<unsigned>(frame - depthFrame);
+			// turning is fine, the boxes are projected the way the depth was, moving changes what is in front of what
+			bool stale = glm::distance(cameraPosition, depthCameraPosition) > STALE_DISTANCE;
+			skipTests = stats.age > MAX_DEPTH_AGE || stale;
+		}
+	}
+	else if (mode == MODE_CPU) {
+		// the occluders of this frame come next, EndOccluders() turns the tests on
+		std::fill(levels[0].begin(), levels[0].end(), 1.f);
+		depthViewProjection = viewProjection;
+		depthCameraPosition = cameraPosition;
+		depthFrame = frame;
+		hasDepth = false;
+	}
+
+	stats.active = !skipTests;
+	stats.cpuMs += MillisecondsSince(start);
+}
+
+void OcclusionCuller::RasterizeOccluder(const Mesh& mesh, const glm::mat4& model) {
+	if (mode != MODE_CPU || levels.empty() || mesh.occluderIndices.empty())
+		return;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	// x and y in cells, z in window depth, w < 0 for vertices in front of the near plane
+	glm::mat4 MVP = frameViewProjection * model;
+	windowVertices.resize(mesh.occluderVertices.size());
+	for (size_t i = 0; i < mesh.occluderVertices.size(); i++) {
+		glm::vec4 clip = MVP * glm::vec4(mesh.occluderVertices[i], 1);
+		if (clip.w <= 0 || clip.z < -clip.w) {
+			windowVertices[i] = glm::vec4(0, 0, 0, -1);
+			continue;
+		}
+		glm::vec3 ndc = glm::vec3(clip) / clip.w;
+		windowVertices[i] = glm::vec4((ndc.x * 0.5f + 0.5f) * BASE_WIDTH, (ndc.y * 0.5f + 0.5f) * baseHeight, ndc.z * 0.5f + 0.5f, 1);
+	}
+
+	float* depth = levels[0].data();
+	float maxX = static_cast<float>(BASE_WIDTH - 1), maxY = static_cast<float>(baseHeight - 1);
+	for (size_t t = 0; t + 2 < mesh.occluderIndices.size(); t += 3) {
+		const glm::vec4& a = windowVertices[mesh.occluderIndices[t]];
+		const glm::vec4& b = windowVertices[mesh.occluderIndices[t + 1]];
+		const glm::vec4& c = windowVertices[mesh.occluderIndices[t + 2]];
+		// clipping it would be exact, leaving it out only hides less
+		if (a.w < 0 || b.w < 0 || c.w < 0)
+			continue;
+		float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+		if (area == 0)
+			continue;
+		// walls of the next rooms are mostly off screen
+		if (std::max(a.x, std::max(b.x, c.x)) < 0 || std::min(a.x, std::min(b.x, c.x)) > BASE_WIDTH
+			|| std::max(a.y, std::max(b.y, c.y)) < 0 || std::min(a.y, std::min(b.y, c.y)) > baseHeight)
+			continue;
+
+		// clamped as floats first, a vertex just past the near plane can be far off screen
+		int firstX = static_cast<int>(std::floor(std::min(std::max(std::min(a.x, std::min(b.x, c.x)), 0.f), maxX)));
+		int lastX = static_cast<int>(std::ceil(std::min(std::max(std::max(a.x, std::max(b.x, c.x)), 0.f), maxX)));
+		int firstY = static_cast<int>(std::floor(std::min(std::max(std::min(a.y, std::min(b.y, c.y)), 0.f), maxY)));
+		int lastY = static_cast<int>(std::ceil(std::min(std::max(std::max(a.y, std::max(b.y, c.y)), 0.f), maxY)));
+
+		// barycentric weights at cell centres, either winding, closed meshes keep their front faces through the min
+		float inverseArea = 1.f / area;
+		for (int y = firstY; y <= lastY; y++) {
+			float py = y + 0.5f;
+			float* row = depth + y * BASE_WIDTH;
+			for (int x = firstX; x <= lastX; x++) {
+				float px = x + 0.5f;
+				float weightA = ((c.x - b.x) * (py - b.y) - (c.y - b.y) * (px - b.x)) * inverseArea;
+				float weightB = ((a.x - c.x) * (py - c.y) - (a.y - c.y) * (px - c.x)) * inverseArea;
+				float weightC = 1 - weightA - weightB;
+				if (weightA < 0 || weightB < 0 || weightC < 0)
+					continue;
+				row[x] = std::min(row[x], weightA * a.z + weightB * b.z + weightC * c.z);
+			}
+		}
+		stats.occluderTriangles++;
+	}
+	stats.occluders++;
+	stats.cpuMs += MillisecondsSince(start);
+}
+
+void OcclusionCuller::EndOccluders() {
+	if (mode != MODE_CPU || levels.empty() || stats.occluders == 0)
+		return;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	BuildLevels();
+	hasDepth = true;
+	skipTests = false;
+	stats.active = true;
+	stats.cpuMs += MillisecondsSince(start);
+}
+
+bool OcclusionCuller::IsOccluded(const glm::vec3& boundsMin, const glm::vec3& boundsMax, const glm::mat4& model) {
+	if (skipTests)
+		return false;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	stats.tested++;
+
+	glm::mat4 MVP = depthViewProjection * model;
+	glm::vec2 low(INFINITY), high(-INFINITY);
+	float nearest = 1;
+	bool occluded = true;
+	for (unsigned i = 0; i < 8; i++) {
+		glm::vec3 corner(i & 1 ? boundsMax.x : boundsMin.x, i & 2 ? boundsMax.y : boundsMin.y, i & 4 ? boundsMax.z : boundsMin.z);
+		glm::vec4 clip = MVP * glm::vec4(corner, 1);
+		// through the near plane, its projection could cover anything
+		if (clip.w <= 0 || clip.z < -clip.w) {
+			occluded = false;
+			break;
+		}
+		glm::vec3 ndc = glm::vec3(clip) / clip.w;
+		glm::vec2 cell((ndc.x * 0.5f + 0.5f) * BASE_WIDTH, (ndc.y * 0.5f + 0.5f) * baseHeight);
+		low = glm::min(low, cell);
+		high = glm::max(high, cell);
+		nearest = std::min(nearest, ndc.z * 0.5f + 0.5f);
+	}
+	// nothing is known past the edge of the screen
+	if (occluded && (low.x < 0 || low.y < 0 || high.x > BASE_WIDTH || high.y > baseHeight))
+		occluded = false;
+
+	if (occluded) {
+		// 1 more cell around it, occluders are drawn at cell centres and may not cover the whole edge cell
+		int firstX = std::max(static_cast<int>(low.x) - 1, 0), lastX = std::min(static_cast<int>(high.x) + 1, static_cast<int>(BASE_WIDTH) - 1);
+		int firstY = std::max(static_cast<int>(low.y) - 1, 0), lastY = std::min(static_cast<int>(high.y) + 1, static_cast<int>(baseHeight) - 1);
+		unsigned level = 0;
+		while (level + 1 < levels.size()
+			&& (static_cast<unsigned>((lastX >> level) - (firstX >> level)) >= MAX_TEST_CELLS || static_cast<unsigned>((lastY >> level) - (firstY >> level)) >= MAX_TEST_CELLS))
+			level++;
+
+		const std::vector<float>& cells = levels[level];
+		unsigned rowWidth = levelSizes[level].x;
+		for (int y = firstY >> level; y <= lastY >> level && occluded; y++) {
+			for (int x = firstX >> level; x <= lastX >> level; x++) {
+				if (cells[y * rowWidth + x] >= nearest) {
+					occluded = false;
+					break;
+				}
+			}
+		}
+	}
+
+	if (occluded)
+		stats.culled++;
+	stats.cpuMs += MillisecondsSince(start);
+	return occluded;
+}
+
+void OcclusionCuller::CaptureDepth(const RenderTarget& scene, unsigned renderWidth, unsigned renderHeight) {
+	if (mode != MODE_GPU || programID == 0 || !scene.IsCreated() || !scene.GetDescription().depth || !depthCopy.IsCreated() || !baseGrid.IsCreated())
+		return;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	Readback& readback = readbacks[readbackSlot];
+	// BeginFrame() reads it first, a capture still here was never waited for
+	if (readback.fence)
+		glDeleteSync(static_cast<GLsync>(readback.fence));
+	readback.fence = nullptr;
+
+	GLint previousDrawFramebuffer = 0, previousVertexArray = 0;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousDrawFramebuffer);
+	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previousVertexArray);
+	GLint viewport[4] = {};
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	GLint polygonMode[2] = { GL_FILL, GL_FILL };
+	glGetIntegerv(GL_POLYGON_MODE, polygonMode);
+	GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+	GLboolean blend = glIsEnabled(GL_BLEND);
+	GLboolean cullFace = glIsEnabled(GL_CULL_FACE);
+
+	// resolves MSAA by picking a sample, as close as a box test needs
+	scene.ResolveTo(depthCopy, renderWidth, renderHeight, true);
+
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_BLEND);
+	glDisable(GL_CULL_FACE);
+	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+	baseGrid.Bind();
+	glViewport(0, 0, BASE_WIDTH, baseHeight);
+	glUseProgram(programID);
+	glUniform2i(sourceSizeLocation, renderWidth, renderHeight);
+	glUniform2i(targetSizeLocation, BASE_WIDTH, baseHeight);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, depthCopy.GetDepthTexture());
+	glBindVertexArray(vertexArrayID);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	// into the pixel buffer, glReadPixels returns before the copy is done and BeginFrame() maps it READBACK_FRAMES later
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, baseGrid.GetFramebuffer());
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.pixelBuffer);
+	glReadPixels(0, 0, BASE_WIDTH, baseHeight, GL_RED, GL_FLOAT, nullptr);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+	readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	readback.viewProjection = frameViewProjection;
+	readback.cameraPosition = frameCameraPosition;
+	readback.frame = frame;
+	readbackSlot = (readbackSlot + 1) % READBACK_FRAMES;
+
+	glUseProgram(0);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, previousDrawFramebuffer);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	glBindVertexArray(previousVertexArray);
+	glPolygonMode(GL_FRONT_AND_BACK, polygonMode[0]);
+	if (depthTest)
+		glEnable(GL_DEPTH_TEST);
+	if (blend)
+		glEnable(GL_BLEND);
+	if (cullFace)
+		glEnable(GL_CULL_FACE);
+	stats.cpuMs += MillisecondsSince(start);
+}
+
+
+/********************************* helpers *********************************/
+
+void OcclusionCuller::ReadBack() {
+	// the slot CaptureDepth() fills next, filled READBACK_FRAMES frames ago
+	Readback& readback = readbacks[readbackSlot];
+	if (!readback.fence)
+		return;
+	GLsync fence = static_cast<GLsync>(readback.fence);
+	GLenum status = glClientWaitSync(fence, 0, 0);
+	glDeleteSync(fence);
+	readback.fence = nullptr;
+	// a gpu this far behind loses this capture, the depth already here stays until it ages out
+	if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+		return;
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.pixelBuffer);
+	const float* data = static_cast<const float*>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, levels[0].size() * sizeof(float), GL_MAP_READ_BIT));
+	if (data) {
+		std::copy(data, data + levels[0].size(), levels[0].begin());
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		depthViewProjection = readback.viewProjection;
+		depthCameraPosition = readback.cameraPosition;
+		depthFrame = readback.frame;
+		BuildLevels();
+		hasDepth = true;
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void OcclusionCuller::BuildLevels() {
+	for (size_t level = 1; level < levels.size(); level++) {
+		const std::vector<float>& finer = levels[level - 1];
+		glm::uvec2 finerSize = levelSizes[level - 1];
+		std::vector<float>& cells = levels[level];
+		glm::uvec2 size = levelSizes[level];
+		for (unsigned y = 0; y < size.y; y++) {
+			// odd sizes, the last cell covers 1 finer row or column
+			unsigned y0 = y * 2, y1 = std::min(y0 + 1, finerSize.y - 1);
+			for (unsigned x = 0; x < size.x; x++) {
+				unsigned x0 = x * 2, x1 = std::min(x0 + 1, finerSize.x - 1);
+				cells[y * size.x + x] = std::max(std::max(finer[y0 * finerSize.x + x0], finer[y0 * finerSize.x + x1]),
+					std::max(finer[y1 * finerSize.x + x0], finer[y1 * finerSize.x + x1]));
+			}
+		}
+	}
+}
+
+void OcclusionCuller::ClearDepth() {
+	hasDepth = false;
+	skipTests = true;
+	for (std::vector<float>& cells : levels)
+		std::fill(cells.begin(), cells.end(), 1.f);
+}
@@ -0,0 +1,151 @@
+#ifndef OCCLUSION_CULLER_H
+#define OCCLUSION_CULLER_H
+
+#include <array>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "RenderTarget.h"
+
+class Mesh;
+
+/* how to use | OcclusionCuller:
+* || setup, BaseScene does this in Init()
+* occlusionCuller.Create(App::SCREEN_WIDTH, App::SCREEN_HEIGHT); // the program, targets and readback buffers of MODE_GPU
+* occlusionCuller.SetMode(OcclusionCuller::MODE_GPU);
+*
+* || every frame, before the world list
+* occlusionCuller.BeginFrame(projection * view, cameraPosition); // MODE_GPU picks up a finished readback here
+* occlusionCuller.RasterizeOccluder(*mesh, model); // MODE_CPU, every RenderObject::occluder, ignored otherwise
+* occlusionCuller.EndOccluders(); // MODE_CPU builds its levels
+* if (occlusionCuller.IsOccluded(mesh->boundsMin, mesh->boundsMax, model)) continue; // skip the uniforms and the draw
+* ... the opaque world
+* occlusionCuller.CaptureDepth(postProcess.GetSceneTarget(), renderWidth, renderHeight); // MODE_GPU, ignored otherwise
+*
+* notes:
+* - both modes end in the same hierarchical depth: a BASE_WIDTH wide grid of the farthest depth under each cell, then levels of
+*   half the size each keeping the farthest of 4, a box is hidden if its nearest corner is behind everything in the cells it covers
+* - MODE_GPU reduces the scene's depth to the base grid in 1 fragment pass and reads it back through pixel buffers READBACK_FRAMES
+*   later, so it never stalls, and the coarser levels are built on the cpu, GL 3.3 has no compute shaders or indirect draws
+*   that could skip the draws on the gpu, and the uniform uploads have to be skipped on the cpu anyway
+* - that depth is READBACK_FRAMES old, boxes are projected with the matrix it was drawn with, so turning the camera is fine,
+*   moving it further than STALE_DISTANCE since then turns culling off until a newer readback arrives, and things uncovered
+*   in between can show up a few frames late
+* - MODE_CPU rasterizes the occluders of this frame at pixel centres into the base grid, nothing in the frame is old, but only
+*   RenderObject::occluder objects hide anything, for headless runs and drivers that are slow to read back
+* - cells past the edge of the screen are unknown, a box reaching past it is never hidden, neither is one crossing the near plane
+*/
+
+class OcclusionCuller {
+public:
+
+	enum MODE {
+		MODE_OFF = 0,
+		// last frames' scene depth, read back
+		MODE_GPU,
+		// RenderObject::occluder meshes drawn on the cpu
+		MODE_CPU,
+
+		MODE_TOTAL,
+	};
+
+	// cells across the finest level, the height follows the aspect ratio
+	static constexpr unsigned BASE_WIDTH = 256;
+	// frames between capturing a depth buffer and mapping its pixel buffer
+	static constexpr unsigned READBACK_FRAMES = 3;
+	// world units the camera may have moved since the depth in use was drawn
+	static constexpr float STALE_DISTANCE = 1.f;
+
+	struct Stats {
+		// IsOccluded() calls and how many said yes, since BeginFrame()
+		unsigned tested = 0;
+		unsigned culled = 0;
+		// MODE_CPU, RasterizeOccluder() calls and their triangles that were drawn
+		unsigned occluders = 0;
+		unsigned occluderTriangles = 0;
+		// frames since the depth being tested was drawn, 0 for MODE_CPU
+		unsigned age = 0;
+		// there is depth to test against this frame, false while culling is off, waiting or stale
+		bool active = false;
+		// BeginFrame() to the last IsOccluded(), readback, rasterizing and testing
+		double cpuMs = 0;
+	};
+
+	OcclusionCuller() = default;
+	~OcclusionCuller();
+	OcclusionCuller(const OcclusionCuller&) = delete;
+	OcclusionCuller& operator=(const OcclusionCuller&) = delete;
+
+	void Create(unsigned width, unsigned height);
+	void Destroy();
+
+	// drops whatever depth the old mode had
+	void SetMode(MODE mode);
+	MODE GetMode() const { return mode; }
+	static const char* GetModeName(MODE mode);
+
+	void BeginFrame(const glm::mat4& viewProjection, const glm::vec3& cameraPosition);
+	// MODE_CPU only, mesh.occluderVertices transformed by model
+	void RasterizeOccluder(const Mesh& mesh, const glm::mat4& model);
+	void EndOccluders();
+	// model space box, true only if it is behind the depth everywhere it covers
+	bool IsOccluded(const glm::vec3& boundsMin, const glm::vec3& boundsMax, const glm::mat4& model);
+	// MODE_GPU only, the [0, renderWidth) x [0, renderHeight) corner of scene's depth, nothing happens if scene is not created
+	// binds its own program and leaves the framebuffer, viewport, vertex array and capabilities as they were, program 0 bound
+	void CaptureDepth(const RenderTarget& scene, unsigned renderWidth, unsigned renderHeight);
+
+	const Stats& GetStats() const { return stats; }
+	unsigned GetBaseHeight() const { return baseHeight; }
+
+private:
+
+	struct Readback {
+		unsigned pixelBuffer = 0;
+		// GLsync
+		void* fence = nullptr;
+		glm::mat4 viewProjection;
+		glm::vec3 cameraPosition;
+		unsigned long long frame = 0;
+	};
+
+	MODE mode = MODE_OFF;
+	unsigned width = 0;
+	unsigned height = 0;
+	unsigned baseHeight = 0;
+
+	// levels[0] is BASE_WIDTH x baseHeight, window space depth, 1 where nothing was drawn
+	std::vector<std::vector<float>> levels;
+	std::vector<glm::uvec2> levelSizes;
+	bool hasDepth = false;
+	// the matrix and camera levels were drawn with, and when
+	glm::mat4 depthViewProjection;
+	glm::vec3 depthCameraPosition;
+	unsigned long long depthFrame = 0;
+
+	glm::mat4 frameViewProjection;
+	glm::vec3 frameCameraPosition;
+	unsigned long long frame = 0;
+	// IsOccluded() answers no this frame
+	bool skipTests = true;
+
+	// MODE_GPU, a single sampled copy of the scene depth and the base grid it is reduced into
+	RenderTarget depthCopy, baseGrid;
+	unsigned programID = 0;
+	int sourceSizeLocation = -1;
+	int targetSizeLocation = -1;
+	unsigned vertexArrayID = 0;
+	std::array<Readback, READBACK_FRAMES> readbacks;
+	unsigned readbackSlot = 0;
+
+	// MODE_CPU, the vertices of the occluder being drawn, reused
+	std::vector<glm::vec4> windowVertices;
+
+	Stats stats;
+
+	void ReadBack();
+	void BuildLevels();
+	void ClearDepth();
+};
+
+#endif
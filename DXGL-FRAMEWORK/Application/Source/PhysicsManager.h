@@ -22,9 +22,9 @@ public:
     // kinematic: infinite mass with movement
     // dynamic: finite mass with movement
     enum BODY_TYPE {
-        STATIC = static_cast<BODY_TYPE>(rp3d::BodyType::STATIC),
-        KINEMATIC = static_cast<BODY_TYPE>(rp3d::BodyType::KINEMATIC),
-        DYNAMIC = static_cast<BODY_TYPE>(rp3d::BodyType::DYNAMIC),
+        STATIC = static_cast<int>(rp3d::BodyType::STATIC),
+        KINEMATIC = static_cast<int>(rp3d::BodyType::KINEMATIC),
+        DYNAMIC = static_cast<int>(rp3d::BodyType::DYNAMIC),
     };
 
     enum COLLIDER_TYPE {
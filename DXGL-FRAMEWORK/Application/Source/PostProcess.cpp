@@ -0,0 +1,380 @@
+#include "PostProcess.h"
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include "shader.hpp"
+#include "Console.h"
+
+// taken by reference, C++14 needs the definitions
+constexpr unsigned PostProcess::MSAA_SAMPLES;
+constexpr unsigned PostProcess::BLOOM_BLUR_PASSES;
+constexpr unsigned PostProcess::TIMER_FRAMES;
+
+namespace {
+	// render scales are multiples of this, small changes are not worth the blur they bring
+	const float SCALE_STEP = 0.05f;
+	// a scale picked after going over budget aims this far under it
+	const float BUDGET_HEADROOM = 0.9f;
+	// under this share of the budget the scale goes back up a step
+	const float RAISE_BELOW = 0.75f;
+	// a change only shows in the timer TIMER_FRAMES later, waiting longer than that keeps it from overshooting
+	const unsigned COOLDOWN_FRAMES = 10;
+}
+
+PostProcess::~PostProcess() {
+	if (vertexArrayID != 0)
+		Error("PostProcess: destroyed without Destroy(), its targets and programs leaked");
+}
+
+void PostProcess::Create(unsigned width, unsigned height) {
+	Destroy();
+	this->width = width;
+	this->height = height;
+
+	downsample = LoadProgram("Shader//Bloom.fragmentshader", "#define DOWNSAMPLE\n");
+	blur = LoadProgram("Shader//Bloom.fragmentshader", "");
+	tonemap = LoadProgram("Shader//Tonemap.fragmentshader", "");
+	tonemapBloom = LoadProgram("Shader//Tonemap.fragmentshader", "#define BLOOM\n");
+	fxaa = LoadProgram("Shader//FXAA.fragmentshader", "");
+	glUseProgram(0);
+
+	glGenVertexArrays(1, &vertexArrayID);
+	for (auto& queries : timerQueries)
+		glGenQueries(2, queries.data());
+	timerIssued.fill(false);
+	timerFrame = 0;
+
+	stats = Stats();
+	renderScale = settings.renderScale;
+	cooldown = 0;
+	targetsDirty = true;
+}
+
+void PostProcess::Destroy() {
+	DestroyTargets();
+	for (Program* program : { &downsample, &blur, &tonemap, &tonemapBloom, &fxaa }) {
+		if (program->programID != 0)
+			glDeleteProgram(program->programID);
+		*program = Program();
+	}
+	if (vertexArrayID != 0)
+		glDeleteVertexArrays(1, &vertexArrayID);
+	vertexArrayID = 0;
+	for (auto& queries : timerQueries) {
+		if (queries[0] != 0)
+			glDeleteQueries(2, queries.data());
+		queries.fill(0);
+	}
+	targetsDirty = true;
+}
+
+void PostProcess::SetSettings(const Settings& settings) {
+	if (settings.enabled != this->settings.enabled || settings.antiAliasing != this->settings.antiAliasing || settings.bloom != this->settings.bloom)
+		targetsDirty = true;
+	// dynamic resolution starts from the fixed scale
+	if (settings.dynamicResolution && (!this->settings.dynamicResolution || settings.renderScale != this->settings.renderScale)) {
+		renderScale = settings.renderScale;
+		cooldown = 0;
+	}
+	this->settings = settings;
+}
+
+const char* PostProcess::GetAntiAliasingName(ANTI_ALIASING antiAliasing) {
+	switch (antiAliasing) {
+	case AA_NONE: return "none";
+	case AA_MSAA: return "msaa";
+	case AA_FXAA: return "fxaa";
+	default: return "unknown";
+	}
+}
+
+
+/********************************* frame *********************************/
+
+void PostProcess::BeginScene() {
+	ReadTimer();
+	glQueryCounter(timerQueries[timerFrame][0], GL_TIMESTAMP);
+
+	if (targetsDirty)
+		CreateTargets();
+
+	if (!settings.enabled) {
+		stats.renderScale = 1.f;
+		stats.renderWidth = width;
+		stats.renderHeight = height;
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glViewport(0, 0, width, height);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		return;
+	}
+
+	float scale = settings.dynamicResolution ? renderScale : settings.renderScale;
+	stats.renderScale = std::min(std::max(scale, settings.minRenderScale), 1.f);
+	stats.renderWidth = std::max(1u, static_cast<unsigned>(std::lround(width * stats.renderScale)));
+	stats.renderHeight = std::max(1u, static_cast<unsigned>(std::lround(height * stats.renderScale)));
+
+	scene.Bind();
+	glViewport(0, 0, stats.renderWidth, stats.renderHeight);
+	// the clear color into the scene, black into the glow
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	if (scene.GetDescription().colorCount > 1) {
+		const GLfloat black[4] = { 0, 0, 0, 0 };
+		glClearBufferfv(GL_COLOR, 1, black);
+	}
+}
+
+void PostProcess::EndScene() {
+	stats.passes = 0;
+
+	if (settings.enabled && scene.IsCreated()) {
+		GLint previousVertexArray = 0;
+		glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previousVertexArray);
+		GLint polygonMode[2] = { GL_FILL, GL_FILL };
+		glGetIntegerv(GL_POLYGON_MODE, polygonMode);
+		GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+		GLboolean blend = glIsEnabled(GL_BLEND);
+		GLboolean cullFace = glIsEnabled(GL_CULL_FACE);
+		glDisable(GL_DEPTH_TEST);
+		glDisable(GL_BLEND);
+		glDisable(GL_CULL_FACE);
+		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+		glBindVertexArray(vertexArrayID);
+
+		unsigned renderWidth = stats.renderWidth, renderHeight = stats.renderHeight;
+		const RenderTarget* hdr = &scene;
+		if (resolved.IsCreated()) {
+			scene.ResolveTo(resolved, renderWidth, renderHeight);
+			hdr = &resolved;
+		}
+
+		// glow at half resolution, blurred separably
+		unsigned bloomWidth = (renderWidth + 1) / 2, bloomHeight = (renderHeight + 1) / 2;
+		bool hasBloom = bloom[0].IsCreated() && hdr->GetDescription().colorCount > 1;
+		if (hasBloom) {
+			glViewport(0, 0, bloomWidth, bloomHeight);
+			glActiveTexture(GL_TEXTURE0);
+
+			bloom[0].Bind();
+			glUseProgram(downsample.programID);
+			glBindTexture(GL_TEXTURE_2D, hdr->GetColorTexture(1));
+			SetRegion(downsample.uvScale, downsample.uvMax, *hdr, renderWidth, renderHeight);
+			glUniform2f(downsample.texelSize, 1.f / width, 1.f / height);
+			DrawFullscreen();
+
+			glUseProgram(blur.programID);
+			SetRegion(blur.uvScale, blur.uvMax, bloom[0], bloomWidth, bloomHeight);
+			glUniform2f(blur.texelSize, 1.f / bloom[0].GetDescription().width, 1.f / bloom[0].GetDescription().height);
+			for (unsigned i = 0; i < BLOOM_BLUR_PASSES; i++) {
+				bloom[1].Bind();
+				glBindTexture(GL_TEXTURE_2D, bloom[0].GetColorTexture(0));
+				glUniform2f(blur.direction, 1, 0);
+				DrawFullscreen();
+
+				bloom[0].Bind();
+				glBindTexture(GL_TEXTURE_2D, bloom[1].GetColorTexture(0));
+				glUniform2f(blur.direction, 0, 1);
+				DrawFullscreen();
+			}
+		}
+
+		// tone map and stretch the rendered corner over the screen, into ldr when FXAA still has to read it
+		glViewport(0, 0, width, height);
+		if (ldr.IsCreated())
+			ldr.Bind();
+		else
+			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+		const Program& program = hasBloom ? tonemapBloom : tonemap;
+		glUseProgram(program.programID);
+		glUniform1f(program.exposure, settings.exposure);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, hdr->GetColorTexture(0));
+		SetRegion(program.uvScale, program.uvMax, *hdr, renderWidth, renderHeight);
+		if (hasBloom) {
+			glActiveTexture(GL_TEXTURE1);
+			glBindTexture(GL_TEXTURE_2D, bloom[0].GetColorTexture(0));
+			SetRegion(program.bloomScale, program.bloomMax, bloom[0], bloomWidth, bloomHeight);
+			glUniform1f(program.bloomStrength, settings.bloomStrength);
+		}
+		DrawFullscreen();
+
+		if (ldr.IsCreated()) {
+			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+			glUseProgram(fxaa.programID);
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_2D, ldr.GetColorTexture(0));
+			glUniform2f(fxaa.texelSize, 1.f / width, 1.f / height);
+			DrawFullscreen();
+		}
+
+		// nothing the scene samples may stay bound while it is drawn into next frame
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glBindVertexArray(previousVertexArray);
+		glPolygonMode(GL_FRONT_AND_BACK, polygonMode[0]);
+		if (depthTest)
+			glEnable(GL_DEPTH_TEST);
+		if (blend)
+			glEnable(GL_BLEND);
+		if (cullFace)
+			glEnable(GL_CULL_FACE);
+	}
+
+	glQueryCounter(timerQueries[timerFrame][1], GL_TIMESTAMP);
+	timerIssued[timerFrame] = true;
+	timerFrame = (timerFrame + 1) % TIMER_FRAMES;
+}
+
+
+/********************************* helpers *********************************/
+
+void PostProcess::CreateTargets() {
+	DestroyTargets();
+	targetsDirty = false;
+	if (!settings.enabled)
+		return;
+
+	RenderTarget::Description description;
+	description.width = width;
+	description.height = height;
+	description.colorFormat = GL_RGBA16F;
+	description.colorCount = settings.bloom ? 2 : 1;
+	description.depth = true;
+	description.samples = settings.antiAliasing == AA_MSAA ? MSAA_SAMPLES : 0;
+	if (!scene.Create(description) && description.samples > 0) {
+		Error("PostProcess: no multisampled HDR target, using FXAA instead");
+		settings.antiAliasing = AA_FXAA;
+		description.samples = 0;
+		scene.Create(description);
+	}
+	if (!scene.IsCreated()) {
+		Error("PostProcess: no HDR target, drawing straight to the screen");
+		settings.enabled = false;
+		return;
+	}
+
+	if (settings.antiAliasing == AA_MSAA) {
+		description.depth = false;
+		description.samples = 0;
+		resolved.Create(description);
+	}
+
+	if (settings.bloom) {
+		RenderTarget::Description half;
+		half.width = (width + 1) / 2;
+		half.height = (height + 1) / 2;
+		half.colorFormat = GL_RGBA16F;
+		bloom[0].Create(half);
+		bloom[1].Create(half);
+	}
+
+	if (settings.antiAliasing == AA_FXAA) {
+		RenderTarget::Description tonemapped;
+		tonemapped.width = width;
+		tonemapped.height = height;
+		tonemapped.colorFormat = GL_RGBA8;
+		ldr.Create(tonemapped);
+	}
+}
+
+void PostProcess::DestroyTargets() {
+	scene.Destroy();
+	resolved.Destroy();
+	bloom[0].Destroy();
+	bloom[1].Destroy();
+	ldr.Destroy();
+}
+
+void PostProcess::ReadTimer() {
+	if (!timerIssued[timerFrame])
+		return;
+	timerIssued[timerFrame] = false;
+
+	const auto& queries = timerQueries[timerFrame];
+	GLint available = 0;
+	glGetQueryObjectiv(queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+	// a gpu this far behind is over budget anyway, the next timer that is done will say so
+	if (!available)
+		return;
+
+	GLuint64 begin = 0, end = 0;
+	glGetQueryObjectui64v(queries[0], GL_QUERY_RESULT, &begin);
+	glGetQueryObjectui64v(queries[1], GL_QUERY_RESULT, &end);
+	stats.gpuMs = (end - begin) / 1e6;
+	UpdateRenderScale(stats.gpuMs);
+}
+
+void PostProcess::UpdateRenderScale(double gpuMs) {
+	if (!settings.enabled || !settings.dynamicResolution)
+		return;
+	if (cooldown > 0) {
+		cooldown--;
+		return;
+	}
+
+	float budget = settings.frameBudgetMs;
+	float scale = renderScale;
+	if (gpuMs > budget) {
+		// the cost is mostly per pixel and pixels go with the square of the scale, so this lands under budget in 1 step
+		scale = std::floor(renderScale * std::sqrt(budget * BUDGET_HEADROOM / static_cast<float>(gpuMs)) / SCALE_STEP) * SCALE_STEP;
+	}
+	else if (gpuMs < budget * RAISE_BELOW) {
+		scale = std::round(renderScale / SCALE_STEP + 1) * SCALE_STEP;
+	}
+	scale = std::min(std::max(scale, settings.minRenderScale), 1.f);
+
+	if (std::abs(scale - renderScale) > SCALE_STEP / 2) {
+		renderScale = scale;
+		stats.scaleChanges++;
+		cooldown = COOLDOWN_FRAMES;
+	}
+}
+
+PostProcess::Program PostProcess::LoadProgram(const char* fragment_file_path, const char* defines) {
+	Program program;
+	GLuint programID = LoadShaders("Shader//Post.vertexshader", fragment_file_path, defines, "ShaderCache");
+	GLint linked = GL_FALSE;
+	if (programID != 0)
+		glGetProgramiv(programID, GL_LINK_STATUS, &linked);
+	if (linked != GL_TRUE) {
+		Error(std::string("PostProcess: ") + fragment_file_path + " failed to build with\n" + defines);
+		if (programID != 0)
+			glDeleteProgram(programID);
+		return program;
+	}
+
+	program.programID = programID;
+	program.source = glGetUniformLocation(programID, "source");
+	program.uvScale = glGetUniformLocation(programID, "uvScale");
+	program.uvMax = glGetUniformLocation(programID, "uvMax");
+	program.texelSize = glGetUniformLocation(programID, "texelSize");
+	program.direction = glGetUniformLocation(programID, "direction");
+	program.bloomTexture = glGetUniformLocation(programID, "bloomTexture");
+	program.bloomScale = glGetUniformLocation(programID, "bloomScale");
+	program.bloomMax = glGetUniformLocation(programID, "bloomMax");
+	program.bloomStrength = glGetUniformLocation(programID, "bloomStrength");
+	program.exposure = glGetUniformLocation(programID, "exposure");
+
+	glUseProgram(programID);
+	glUniform1i(program.source, 0);
+	glUniform1i(program.bloomTexture, 1);
+	return program;
+}
+
+void PostProcess::SetRegion(int scaleLocation, int maxLocation, const RenderTarget& source, unsigned regionWidth, unsigned regionHeight) {
+	float sourceWidth = static_cast<float>(source.GetDescription().width);
+	float sourceHeight = static_cast<float>(source.GetDescription().height);
+	glUniform2f(scaleLocation, regionWidth / sourceWidth, regionHeight / sourceHeight);
+	glUniform2f(maxLocation, (regionWidth - 0.5f) / sourceWidth, (regionHeight - 0.5f) / sourceHeight);
+}
+
+void PostProcess::DrawFullscreen() {
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	stats.passes++;
+}
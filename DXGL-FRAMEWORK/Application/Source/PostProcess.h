@@ -0,0 +1,151 @@
+#ifndef POST_PROCESS_H
+#define POST_PROCESS_H
+
+#include <array>
+
+#include "RenderTarget.h"
+
+/* how to use | PostProcess:
+* || setup, BaseScene does this in Init()
+* postProcess.Create(App::SCREEN_WIDTH, App::SCREEN_HEIGHT); // programs and timer queries, the targets come with the first BeginScene()
+*
+* || every frame
+* postProcess.BeginScene(); // binds the HDR scene target at the render resolution and clears it
+* ... the 3D scene, fragment output 1 is what glows, see "bloom" in Text_Atmospheric.fragmentshader
+* postProcess.EndScene(); // MSAA resolve, bloom, tone map and FXAA into the default framebuffer at full size
+* ... UI on top, straight into the default framebuffer
+*
+* || settings, any time
+* PostProcess::Settings settings = postProcess.GetSettings();
+* settings.antiAliasing = PostProcess::AA_FXAA;
+* settings.dynamicResolution = true; // holds the gpu time of BeginScene() to EndScene() under frameBudgetMs
+* postProcess.SetSettings(settings); // targets that no longer fit are made again on the next BeginScene()
+*
+* notes:
+* - the scene is RGBA16F, so lights brighter than 1 keep their color until the tone map, and fragment output 1 goes to a second
+*   attachment that only the glowing materials write to, bloom blurs that instead of thresholding the whole picture
+* - AA_MSAA renders into 4x multisampled renderbuffers and resolves them with a blit, AA_FXAA renders single sampled and smooths
+*   edges in 1 fullscreen pass after the tone map, cheaper in memory and bandwidth, softer on text and thin lines
+* - dynamic resolution renders into the bottom left corner of the full size targets, so changing the scale never reallocates,
+*   the tone map pass stretches that corner back over the screen with bilinear filtering
+* - the gpu time comes from GL_TIMESTAMP queries read 3 frames later, so it never stalls and never collides with the
+*   GL_TIME_ELAPSED queries of Profiler's gpu zones
+* - settings.enabled = false draws the scene straight into the default framebuffer, no HDR, no anti-aliasing, no bloom
+*/
+
+class PostProcess {
+public:
+
+	enum ANTI_ALIASING {
+		AA_NONE = 0,
+		AA_MSAA,
+		AA_FXAA,
+
+		AA_TOTAL,
+	};
+
+	static constexpr unsigned MSAA_SAMPLES = 4;
+	// horizontal and vertical blur pairs over the half resolution bloom
+	static constexpr unsigned BLOOM_BLUR_PASSES = 2;
+	// frames between reading a timer and issuing it again
+	static constexpr unsigned TIMER_FRAMES = 3;
+
+	struct Settings {
+		bool enabled = true;
+		ANTI_ALIASING antiAliasing = AA_MSAA;
+		bool bloom = true;
+		float bloomStrength = 1.f;
+		float exposure = 1.f;
+		bool dynamicResolution = false;
+		float frameBudgetMs = 1000.f / 60;
+		float minRenderScale = 0.5f;
+		// the scale when dynamicResolution is off, where it starts when it is on
+		float renderScale = 1.f;
+	};
+
+	struct Stats {
+		float renderScale = 1.f;
+		unsigned renderWidth = 0;
+		unsigned renderHeight = 0;
+		// BeginScene() to EndScene() on the gpu, TIMER_FRAMES frames old, 0 until the first one is read
+		double gpuMs = 0;
+		// times dynamic resolution moved the scale since Create()
+		unsigned scaleChanges = 0;
+		// fullscreen draws of the last EndScene()
+		unsigned passes = 0;
+	};
+
+	PostProcess() = default;
+	~PostProcess();
+	PostProcess(const PostProcess&) = delete;
+	PostProcess& operator=(const PostProcess&) = delete;
+
+	void Create(unsigned width, unsigned height);
+	void Destroy();
+
+	void SetSettings(const Settings& settings);
+	const Settings& GetSettings() const { return settings; }
+	static const char* GetAntiAliasingName(ANTI_ALIASING antiAliasing);
+
+	// leaves the viewport at the render resolution
+	void BeginScene();
+	// leaves the default framebuffer bound at full size, GL_TEXTURE0 active, and its own program bound
+	void EndScene();
+
+	unsigned GetRenderWidth() const { return stats.renderWidth; }
+	unsigned GetRenderHeight() const { return stats.renderHeight; }
+	const Stats& GetStats() const { return stats; }
+	// what BeginScene() binds, not created while settings.enabled is off, multisampled with AA_MSAA
+	const RenderTarget& GetSceneTarget() const { return scene; }
+
+private:
+
+	struct Program {
+		unsigned programID = 0;
+		int source = -1;
+		int uvScale = -1;
+		int uvMax = -1;
+		int texelSize = -1;
+		int direction = -1;
+		int bloomTexture = -1;
+		int bloomScale = -1;
+		int bloomMax = -1;
+		int bloomStrength = -1;
+		int exposure = -1;
+	};
+
+	unsigned width = 0;
+	unsigned height = 0;
+	Settings settings;
+	bool targetsDirty = true;
+	float renderScale = 1.f;
+	unsigned cooldown = 0;
+
+	// scene is multisampled with AA_MSAA and resolved into resolved, the rest are always single sampled
+	RenderTarget scene, resolved;
+	// half resolution ping pong
+	RenderTarget bloom[2];
+	// tone mapped, for FXAA to read
+	RenderTarget ldr;
+
+	Program downsample, blur, tonemap, tonemapBloom, fxaa;
+	// no attributes, the fullscreen triangle comes from gl_VertexID
+	unsigned vertexArrayID = 0;
+
+	std::array<std::array<unsigned, 2>, TIMER_FRAMES> timerQueries = {};
+	std::array<bool, TIMER_FRAMES> timerIssued = {};
+	unsigned timerFrame = 0;
+
+	Stats stats;
+
+	void CreateTargets();
+	void DestroyTargets();
+	void ReadTimer();
+	void UpdateRenderScale(double gpuMs);
+	static Program LoadProgram(const char* fragment_file_path, const char* defines);
+	// the rendered corner of source, as a uv scale and the last texel centre a bilinear read may reach
+	static void SetRegion(int scaleLocation, int maxLocation, const RenderTarget& source, unsigned regionWidth, unsigned regionHeight);
+	void DrawFullscreen();
+};
+
+#endif
@@ -0,0 +1,314 @@
+#include "Profiler.h"
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+
+#include <nlohmann/json.hpp>
+
+#include "Console.h"
+
+using nlohmann::json;
+
+namespace {
+	std::string FormatMs(double ms) {
+		char buffer[32];
+		std::snprintf(buffer, sizeof(buffer), "%.2f", ms);
+		return buffer;
+	}
+}
+
+
+/********************************* recording *********************************/
+
+void Profiler::BeginFrame() {
+	if (frames.empty())
+		frames.resize(FRAME_HISTORY);
+
+	// reuse the zone storage of the frame about to be overwritten so recording does not allocate
+	Frame& slot = frames[frameIndex % FRAME_HISTORY];
+	current.zones.swap(slot.zones);
+	current.zones.clear();
+	current.index = frameIndex;
+	current.startMs = NowMs();
+	current.durationMs = 0;
+
+	openZones.clear();
+	frameOpen = true;
+}
+
+void Profiler::EndFrame() {
+	if (!frameOpen)
+		return;
+
+	current.durationMs = NowMs() - current.startMs;
+	std::swap(frames[frameIndex % FRAME_HISTORY], current);
+	frameIndex++;
+	frameOpen = false;
+
+	ResolveQueries();
+}
+
+void Profiler::BeginZone(const char* name) {
+	if (!frameOpen) {
+		// zones outside a frame (scene Init) are not recorded, -1 keeps EndZone() balanced
+		openZones.push_back(-1);
+		return;
+	}
+
+	int parent = -1;
+	for (auto it = openZones.rbegin(); it != openZones.rend(); ++it) {
+		if (*it >= 0) {
+			parent = *it;
+			break;
+		}
+	}
+
+	unsigned depth = parent >= 0 ? current.zones[parent].depth + 1 : 0;
+	current.zones.push_back({ name, parent, depth, NowMs(), 0, false });
+	openZones.push_back(static_cast<int>(current.zones.size()) - 1);
+}
+
+void Profiler::EndZone() {
+	if (openZones.empty())
+		return;
+
+	int zoneIndex = openZones.back();
+	openZones.pop_back();
+	if (zoneIndex < 0 || !frameOpen)
+		return;
+
+	Zone& zone = current.zones[zoneIndex];
+	zone.durationMs = NowMs() - zone.startMs;
+}
+
+void Profiler::BeginGPUZone(const char* name) {
+	if (!frameOpen || activeQuery != 0) {
+		ignoredGPUZones++;
+		return;
+	}
+
+	if (freeQueries.empty()) {
+		unsigned query;
+		glGenQueries(1, &query);
+		freeQueries.push_back(query);
+	}
+	activeQuery = freeQueries.back();
+	freeQueries.pop_back();
+
+	int parent = openZones.empty() ? -1 : openZones.back();
+	unsigned depth = parent >= 0 ? current.zones[parent].depth + 1 : 0;
+	current.zones.push_back({ name, parent, depth, NowMs(), -1, true });
+	activeGPUZone = static_cast<int>(current.zones.size()) - 1;
+
+	glBeginQuery(GL_TIME_ELAPSED, activeQuery);
+}
+
+void Profiler::EndGPUZone() {
+	if (ignoredGPUZones > 0) {
+		ignoredGPUZones--;
+		return;
+	}
+	if (activeQuery == 0)
+		return;
+
+	glEndQuery(GL_TIME_ELAPSED);
+	pendingQueries.push_back({ activeQuery, current.index, static_cast<unsigned>(activeGPUZone) });
+	activeQuery = 0;
+	activeGPUZone = -1;
+}
+
+void Profiler::ResolveQueries() {
+	// results are usually ready 1 - 3 frames later, checking availability first means this never waits on the gpu
+	for (unsigned i = 0; i < pendingQueries.size();) {
+		PendingQuery& pending = pendingQueries[i];
+
+		GLint available = 0;
+		glGetQueryObjectiv(pending.query, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) {
+			i++;
+			continue;
+		}
+
+		GLuint64 elapsedNs = 0;
+		glGetQueryObjectui64v(pending.query, GL_QUERY_RESULT, &elapsedNs);
+
+		Frame& frame = frames[pending.frameIndex % FRAME_HISTORY];
+		if (frame.index == pending.frameIndex && pending.zoneIndex < frame.zones.size())
+			frame.zones[pending.zoneIndex].durationMs = elapsedNs / 1000000.0;
+
+		freeQueries.push_back(pending.query);
+		pending = pendingQueries.back();
+		pendingQueries.pop_back();
+	}
+}
+
+void Profiler::Clear() {
+	for (unsigned query : freeQueries)
+		glDeleteQueries(1, &query);
+	for (PendingQuery& pending : pendingQueries)
+		glDeleteQueries(1, &pending.query);
+	if (activeQuery != 0)
+		glDeleteQueries(1, &activeQuery);
+
+	freeQueries.clear();
+	pendingQueries.clear();
+	activeQuery = 0;
+	activeGPUZone = -1;
+	ignoredGPUZones = 0;
+
+	frames.clear();
+	frameIndex = 0;
+	current = Frame();
+	frameOpen = false;
+	openZones.clear();
+}
+
+
+/********************************* results *********************************/
+
+double Profiler::GetFramePercentile(double percentile) const {
+	unsigned count = static_cast<unsigned>(std::min<unsigned long long>(frameIndex, FRAME_HISTORY));
+	if (count == 0)
+		return 0;
+
+	std::vector<double> durations;
+	durations.reserve(count);
+	for (unsigned i = 0; i < count; i++)
+		durations.push_back(frames[i].durationMs);
+
+	percentile = std::max(0.0, std::min(percentile, 100.0));
+	size_t nth = static_cast<size_t>(percentile / 100.0 * (count - 1) + 0.5);
+	std::nth_element(durations.begin(), durations.begin() + nth, durations.end());
+	return durations[nth];
+}
+
+double Profiler::GetZoneAverage(const char* name, bool gpu, unsigned frameCount) const {
+	frameCount = static_cast<unsigned>(std::min<unsigned long long>({ frameCount, frameIndex, FRAME_HISTORY }));
+	if (frameCount == 0)
+		return 0;
+
+	double total = 0;
+	unsigned counted = 0;
+	for (unsigned i = 1; i <= frameCount; i++) {
+		const Frame* frame = FindFrame(frameIndex - i);
+		if (!frame)
+			continue;
+
+		bool resolved = true;
+		double frameTotal = 0;
+		for (const Zone& zone : frame->zones) {
+			if (zone.gpu != gpu || std::strcmp(zone.name, name) != 0)
+				continue;
+			if (zone.durationMs < 0)
+				resolved = false;
+			else
+				frameTotal += zone.durationMs;
+		}
+
+		// the newest frames may still be waiting on their gpu queries
+		if (resolved) {
+			total += frameTotal;
+			counted++;
+		}
+	}
+	return counted ? total / counted : 0;
+}
+
+std::vector<std::string> Profiler::GetOverlayLines() const {
+	std::vector<std::string> lines;
+	if (frameIndex == 0)
+		return lines;
+
+	double average = 0;
+	unsigned count = static_cast<unsigned>(std::min<unsigned long long>(frameIndex, FRAME_HISTORY));
+	for (unsigned i = 0; i < count; i++)
+		average += frames[i].durationMs;
+	average /= count;
+
+	lines.push_back("frame ms | avg " + FormatMs(average) + " p50 " + FormatMs(GetFramePercentile(50))
+		+ " p95 " + FormatMs(GetFramePercentile(95)) + " p99 " + FormatMs(GetFramePercentile(99)));
+
+	// top level zones of the last frame, in the order they ran
+	const Frame* last = FindFrame(frameIndex - 1);
+	if (!last)
+		return lines;
+
+	std::string cpuLine = "cpu ms |";
+	std::string gpuLine = "gpu ms |";
+	std::vector<const char*> listed;
+	for (const Zone& zone : last->zones) {
+		if (zone.depth > 0 && !zone.gpu)
+			continue;
+		bool alreadyListed = false;
+		for (const char* name : listed)
+			alreadyListed = alreadyListed || std::strcmp(name, zone.name) == 0;
+		if (alreadyListed)
+			continue;
+		listed.push_back(zone.name);
+
+		std::string entry = std::string(" ") + zone.name + " " + FormatMs(GetZoneAverage(zone.name, zone.gpu));
+		(zone.gpu ? gpuLine : cpuLine) += entry;
+	}
+	lines.push_back(cpuLine);
+	lines.push_back(gpuLine);
+	return lines;
+}
+
+bool Profiler::ExportChromeTrace(const std::string& file_path) const {
+	std::ofstream file(file_path);
+	if (!file.is_open()) {
+		Error("Profiler::ExportChromeTrace(): Impossible to open " + file_path);
+		return false;
+	}
+
+	// oldest frame first
+	json events = json::array();
+	unsigned count = static_cast<unsigned>(std::min<unsigned long long>(frameIndex, FRAME_HISTORY));
+	for (unsigned i = count; i > 0; i--) {
+		const Frame* frame = FindFrame(frameIndex - i);
+		if (!frame)
+			continue;
+
+		events.push_back({
+			{ "name", "Frame " + std::to_string(frame->index) }, { "cat", "frame" }, { "ph", "X" },
+			{ "ts", frame->startMs * 1000 }, { "dur", frame->durationMs * 1000 }, { "pid", 1 }, { "tid", 1 },
+			});
+
+		for (const Zone& zone : frame->zones) {
+			if (zone.durationMs < 0)
+				continue;
+			// gpu zones get their own row, they start at submission time since GL_TIME_ELAPSED only gives a duration
+			events.push_back({
+				{ "name", zone.name }, { "cat", zone.gpu ? "gpu" : "cpu" }, { "ph", "X" },
+				{ "ts", zone.startMs * 1000 }, { "dur", zone.durationMs * 1000 }, { "pid", 1 }, { "tid", zone.gpu ? 2 : 1 },
+				});
+		}
+	}
+
+	json trace;
+	trace["traceEvents"] = std::move(events);
+	trace["displayTimeUnit"] = "ms";
+	file << trace.dump();
+
+	Print("Profiler: exported " + std::to_string(count) + " frames to " + file_path, 1);
+	return true;
+}
+
+
+/********************************* helpers *********************************/
+
+double Profiler::NowMs() const {
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+const Profiler::Frame* Profiler::FindFrame(unsigned long long index) const {
+	// the oldest slot is reused by the frame being recorded
+	if (frames.empty() || index >= frameIndex || frameIndex - index >= FRAME_HISTORY)
+		return nullptr;
+	const Frame& frame = frames[index % FRAME_HISTORY];
+	return frame.index == index ? &frame : nullptr;
+}
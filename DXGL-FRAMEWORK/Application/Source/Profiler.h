@@ -0,0 +1,136 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <string>
+#include <vector>
+#include <chrono>
+
+/* how to use | Profiler:
+* || zones
+* void Foo() {
+*     PROFILE_ZONE("Foo"); // times until the end of the scope, zones opened inside it become its children
+*     PROFILE_GPU_ZONE("Foo pass"); // GL_TIME_ELAPSED query, read back a few frames later so it never stalls
+*     ...
+* }
+* names must be string literals, only the pointer is stored
+*
+* || frames
+* Application::Run() already calls PROFILE_BEGIN_FRAME() and PROFILE_END_FRAME() around each loop
+*
+* || results
+* Profiler::GetInstance().GetOverlayLines(); // a few summary lines, SceneDemo shows them through AddDebugText() in debug mode
+* Profiler::GetInstance().GetFramePercentile(95); // in ms, over the last FRAME_HISTORY frames
+* Profiler::GetInstance().ExportChromeTrace("profile.json"); // open with chrome://tracing or ui.perfetto.dev
+*
+* notes:
+* - everything above compiles to nothing unless ENABLE_PROFILER is defined (it is in Application.vcxproj)
+* - GL_TIME_ELAPSED queries cannot nest, so a gpu zone opened inside another gpu zone is ignored
+*/
+
+#ifdef ENABLE_PROFILER
+#define PROFILER_CONCAT_INNER(a, b) a##b
+#define PROFILER_CONCAT(a, b) PROFILER_CONCAT_INNER(a, b)
+#define PROFILE_ZONE(name) ProfileZone PROFILER_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_GPU_ZONE(name) ProfileGPUZone PROFILER_CONCAT(profileGPUZone, __LINE__)(name)
+#define PROFILE_BEGIN_FRAME() Profiler::GetInstance().BeginFrame()
+#define PROFILE_END_FRAME() Profiler::GetInstance().EndFrame()
+#else
+#define PROFILE_ZONE(name)
+#define PROFILE_GPU_ZONE(name)
+#define PROFILE_BEGIN_FRAME()
+#define PROFILE_END_FRAME()
+#endif
+
+class Profiler {
+public:
+
+	static Profiler& GetInstance() {
+		static Profiler profiler;
+		return profiler;
+	}
+
+	struct Zone {
+		const char* name;
+		// index into Frame::zones, -1 = top level
+		int parent;
+		unsigned depth;
+		double startMs;
+		// -1 until a gpu zone's query is read back
+		double durationMs;
+		bool gpu;
+	};
+
+	struct Frame {
+		unsigned long long index = 0;
+		double startMs = 0;
+		double durationMs = 0;
+		std::vector<Zone> zones;
+	};
+
+	static constexpr unsigned FRAME_HISTORY = 300;
+
+	void BeginFrame();
+	void EndFrame();
+
+	void BeginZone(const char* name);
+	void EndZone();
+	void BeginGPUZone(const char* name);
+	void EndGPUZone();
+
+	// | percentile : 0 - 100, returns frame time in ms
+	double GetFramePercentile(double percentile) const;
+	// average ms per frame of every zone with this name, over the last frameCount frames
+	double GetZoneAverage(const char* name, bool gpu = false, unsigned frameCount = 60) const;
+	std::vector<std::string> GetOverlayLines() const;
+	// nullptr before the first EndFrame()
+	const Frame* GetLastFrame() const { return FindFrame(frameIndex - 1); }
+
+	bool ExportChromeTrace(const std::string& file_path) const;
+	// deletes the gpu queries, call before the GL context is destroyed
+	void Clear();
+
+private:
+
+	struct PendingQuery {
+		unsigned query;
+		unsigned long long frameIndex;
+		unsigned zoneIndex;
+	};
+
+	std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+	// ring buffer, frames[i % FRAME_HISTORY]
+	std::vector<Frame> frames;
+	unsigned long long frameIndex = 0;
+	Frame current;
+	bool frameOpen = false;
+	std::vector<int> openZones;
+
+	std::vector<unsigned> freeQueries;
+	std::vector<PendingQuery> pendingQueries;
+	unsigned activeQuery = 0;
+	int activeGPUZone = -1;
+	// gpu zones opened while another one is active, ignored
+	unsigned ignoredGPUZones = 0;
+
+	double NowMs() const;
+	void ResolveQueries();
+	const Frame* FindFrame(unsigned long long index) const;
+
+	Profiler() = default;
+	~Profiler() = default;
+	Profiler(const Profiler&) = delete;
+	Profiler& operator=(const Profiler&) = delete;
+};
+
+struct ProfileZone {
+	ProfileZone(const char* name) { Profiler::GetInstance().BeginZone(name); }
+	~ProfileZone() { Profiler::GetInstance().EndZone(); }
+};
+
+struct ProfileGPUZone {
+	ProfileGPUZone(const char* name) { Profiler::GetInstance().BeginGPUZone(name); }
+	~ProfileGPUZone() { Profiler::GetInstance().EndGPUZone(); }
+};
+
+#endif
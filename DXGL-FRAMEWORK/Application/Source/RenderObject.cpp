@@ -282,11 +282,12 @@ std::shared_ptr<RenderObject> MeshObject::CloneSelf() const {
 
 /********************************* LightObject *********************************/
 
-int LightObject::maxLight = 12;
+int LightObject::maxLight = 1024; // BaseScene::MAX_LIGHT, the size of the light buffer
 std::vector<std::weak_ptr<LightObject>> LightObject::lightList;
 
 std::shared_ptr<LightObject> LightObject::Create(int geometryType, unsigned UILayer) {
-	if (lightList.size() > maxLight)
+	// lightIndex has to stay below maxLight, it indexes the light buffer
+	if (lightList.size() >= maxLight)
 		return nullptr;
 
 	auto obj = std::make_shared<LightObject>(geometryType, UILayer);
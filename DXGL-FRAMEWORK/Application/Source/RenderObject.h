@@ -5,9 +5,9 @@
 #include <memory>
 #include <vector>
 
-#include <glm\glm.hpp>
-#include <glm\gtc\matrix_transform.hpp>
-#include <glm\gtc\type_ptr.hpp>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
 
 #include "MatrixStack.h"
 #include "Material.h"
@@ -42,6 +42,12 @@ public:
 
 	bool hasTransparency = false;
 	bool allowRender = true;
+	// world objects only, off for things that surround the scene like the skybox, they would shadow everything inside them
+	bool castShadows = true;
+	// world objects only, big opaque things like walls that OcclusionCuller's cpu mode draws into its depth buffer, the mesh needs Mesh::SetOccluder()
+	bool occluder = false;
+	// Mesh LOD level drawn last frame, BaseScene::SelectLod() starts from it
+	unsigned lodLevel = 0;
 	bool relativeTrl = false; // only affect screen render, trl will be from -1 to 1 in relative distance to center and side of the screen, instead of in px
 
 	std::string name = "";
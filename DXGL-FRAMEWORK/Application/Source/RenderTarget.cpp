@@ -0,0 +1,141 @@
+#include "RenderTarget.h"
+
+#include <GL/glew.h>
+
+#include "Console.h"
+
+RenderTarget::~RenderTarget() {
+	if (framebufferID != 0)
+		Error("RenderTarget: destroyed without Destroy(), framebuffer " + std::to_string(framebufferID) + " leaked");
+}
+
+bool RenderTarget::Create(const Description& description) {
+	Destroy();
+	this->description = description;
+	if (this->description.colorFormat == 0)
+		this->description.colorCount = 0;
+	if (this->description.colorCount > MAX_COLOR_ATTACHMENTS)
+		this->description.colorCount = MAX_COLOR_ATTACHMENTS;
+
+	const Description& desc = this->description;
+	glGenFramebuffers(1, &framebufferID);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebufferID);
+
+	GLenum drawBuffers[MAX_COLOR_ATTACHMENTS];
+	for (unsigned i = 0; i < desc.colorCount; i++) {
+		if (IsMultisampled()) {
+			glGenRenderbuffers(1, &colorRenderbufferIDs[i]);
+			glBindRenderbuffer(GL_RENDERBUFFER, colorRenderbufferIDs[i]);
+			glRenderbufferStorageMultisample(GL_RENDERBUFFER, desc.samples, desc.colorFormat, desc.width, desc.height);
+			glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_RENDERBUFFER, colorRenderbufferIDs[i]);
+		}
+		else {
+			glGenTextures(1, &colorTextureIDs[i]);
+			glBindTexture(GL_TEXTURE_2D, colorTextureIDs[i]);
+			// the format and type only describe the missing data, any pair the internal format accepts will do
+			glTexImage2D(GL_TEXTURE_2D, 0, desc.colorFormat, desc.width, desc.height, 0, GL_RGBA, GL_FLOAT, nullptr);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, colorTextureIDs[i], 0);
+		}
+		drawBuffers[i] = GL_COLOR_ATTACHMENT0 + i;
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	if (desc.depth && desc.depthTexture && !IsMultisampled()) {
+		glGenTextures(1, &depthTextureID);
+		glBindTexture(GL_TEXTURE_2D, depthTextureID);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, desc.width, desc.height, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, nullptr);
+		// read with texelFetch, depth values are never filtered or compared
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTextureID, 0);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+	else if (desc.depth) {
+		glGenRenderbuffers(1, &depthRenderbufferID);
+		glBindRenderbuffer(GL_RENDERBUFFER, depthRenderbufferID);
+		if (IsMultisampled())
+			glRenderbufferStorageMultisample(GL_RENDERBUFFER, desc.samples, GL_DEPTH_COMPONENT24, desc.width, desc.height);
+		else
+			glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, desc.width, desc.height);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthRenderbufferID);
+	}
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	if (desc.colorCount > 0) {
+		glDrawBuffers(desc.colorCount, drawBuffers);
+		glReadBuffer(GL_COLOR_ATTACHMENT0);
+	}
+	else {
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+	}
+
+	bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	if (!complete) {
+		Error("RenderTarget: " + std::to_string(desc.width) + "x" + std::to_string(desc.height) + " with " + std::to_string(desc.samples) + " samples is incomplete");
+		Destroy();
+		return false;
+	}
+	return true;
+}
+
+void RenderTarget::Destroy() {
+	if (framebufferID != 0)
+		glDeleteFramebuffers(1, &framebufferID);
+	framebufferID = 0;
+	for (unsigned i = 0; i < MAX_COLOR_ATTACHMENTS; i++) {
+		if (colorTextureIDs[i] != 0)
+			glDeleteTextures(1, &colorTextureIDs[i]);
+		if (colorRenderbufferIDs[i] != 0)
+			glDeleteRenderbuffers(1, &colorRenderbufferIDs[i]);
+		colorTextureIDs[i] = colorRenderbufferIDs[i] = 0;
+	}
+	if (depthRenderbufferID != 0)
+		glDeleteRenderbuffers(1, &depthRenderbufferID);
+	depthRenderbufferID = 0;
+	if (depthTextureID != 0)
+		glDeleteTextures(1, &depthTextureID);
+	depthTextureID = 0;
+}
+
+void RenderTarget::Bind() const {
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebufferID);
+}
+
+void RenderTarget::ResolveTo(const RenderTarget& target, unsigned width, unsigned height, bool resolveDepth) const {
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, framebufferID);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target.framebufferID);
+
+	GLint w = static_cast<GLint>(width), h = static_cast<GLint>(height);
+	unsigned colorCount = description.colorCount < target.description.colorCount ? description.colorCount : target.description.colorCount;
+	// 1 attachment per blit, the read buffer goes into every draw buffer otherwise
+	for (unsigned i = 0; i < colorCount; i++) {
+		glReadBuffer(GL_COLOR_ATTACHMENT0 + i);
+		glDrawBuffer(GL_COLOR_ATTACHMENT0 + i);
+		GLbitfield mask = GL_COLOR_BUFFER_BIT;
+		if (i == 0 && resolveDepth && description.depth && target.description.depth)
+			mask |= GL_DEPTH_BUFFER_BIT;
+		glBlitFramebuffer(0, 0, w, h, 0, 0, w, h, mask, GL_NEAREST);
+	}
+
+	if (colorCount == 0 && resolveDepth && description.depth && target.description.depth)
+		glBlitFramebuffer(0, 0, w, h, 0, 0, w, h, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+	// back to what Create() set up
+	if (colorCount > 0) {
+		glReadBuffer(GL_COLOR_ATTACHMENT0);
+		GLenum drawBuffers[MAX_COLOR_ATTACHMENTS];
+		for (unsigned i = 0; i < target.description.colorCount; i++)
+			drawBuffers[i] = GL_COLOR_ATTACHMENT0 + i;
+		glDrawBuffers(target.description.colorCount, drawBuffers);
+	}
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+}
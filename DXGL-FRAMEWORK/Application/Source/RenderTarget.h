@@ -0,0 +1,77 @@
+#ifndef RENDER_TARGET_H
+#define RENDER_TARGET_H
+
+/* how to use | RenderTarget:
+* RenderTarget::Description description;
+* description.width = 1600; description.height = 900;
+* description.colorFormat = GL_RGBA16F; // 0 for depth only
+* description.colorCount = 2; // MRT, fragment outputs layout(location = 0..colorCount - 1)
+* description.depth = true;
+* description.samples = 4; // multisampled, renderbuffers that have to be resolved into a single sampled target before sampling
+* target.Create(description);
+*
+* target.Bind(); // draw framebuffer, every color attachment is a draw buffer
+* ...
+* target.ResolveTo(resolved, width, height); // the [0, width) x [0, height) corner of every color attachment
+* glBindTexture(GL_TEXTURE_2D, resolved.GetColorTexture(0));
+*
+* notes:
+* - single sampled color attachments are linear filtered, clamped textures, depth is a renderbuffer unless depthTexture asks for
+*   a nearest filtered texture, which only single sampled targets can have
+* - plain GL 3.3 framebuffer objects, nothing here binds the default framebuffer back, the caller knows what comes next
+*/
+
+class RenderTarget {
+public:
+
+	static constexpr unsigned MAX_COLOR_ATTACHMENTS = 2;
+
+	struct Description {
+		unsigned width = 0;
+		unsigned height = 0;
+		// GL internal format of every color attachment, 0 for none
+		unsigned colorFormat = 0;
+		unsigned colorCount = 1;
+		bool depth = false;
+		// depth as a GL_DEPTH_COMPONENT24 texture that can be sampled, ignored for multisampled targets
+		bool depthTexture = false;
+		// 0 or 1 for textures, more for multisampled renderbuffers
+		unsigned samples = 0;
+	};
+
+	RenderTarget() = default;
+	~RenderTarget();
+	RenderTarget(const RenderTarget&) = delete;
+	RenderTarget& operator=(const RenderTarget&) = delete;
+
+	// returns false if the driver refused the combination, the target is destroyed again then
+	bool Create(const Description& description);
+	void Destroy();
+	bool IsCreated() const { return framebufferID != 0; }
+
+	// as the draw framebuffer, with every color attachment as a draw buffer
+	void Bind() const;
+	// blits each color attachment, and depth if asked, into the same attachment of target, which must not be multisampled
+	// leaves target bound as the draw framebuffer
+	void ResolveTo(const RenderTarget& target, unsigned width, unsigned height, bool resolveDepth = false) const;
+
+	unsigned GetFramebuffer() const { return framebufferID; }
+	// 0 for multisampled targets
+	unsigned GetColorTexture(unsigned index) const { return colorTextureIDs[index]; }
+	// 0 unless Description::depthTexture
+	unsigned GetDepthTexture() const { return depthTextureID; }
+	const Description& GetDescription() const { return description; }
+
+private:
+
+	Description description;
+	unsigned framebufferID = 0;
+	unsigned colorTextureIDs[MAX_COLOR_ATTACHMENTS] = {};
+	unsigned colorRenderbufferIDs[MAX_COLOR_ATTACHMENTS] = {};
+	unsigned depthRenderbufferID = 0;
+	unsigned depthTextureID = 0;
+
+	bool IsMultisampled() const { return description.samples > 1; }
+};
+
+#endif
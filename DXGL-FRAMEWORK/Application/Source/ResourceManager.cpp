@@ -0,0 +1,331 @@
+#include "ResourceManager.h"
+
+#include <GL/glew.h>
+
+#include <vector>
+
+#include "Mesh.h"
+#include "TextureLoader.h"
+#include "Console.h"
+#include "MemoryTracker.h"
+
+
+/********************************* textures *********************************/
+
+unsigned ResourceManager::LoadTexture(const char* file_path) {
+	MEMORY_TAG(MemoryTracker::RESOURCES);
+	std::string key = NormalizePath(TextureLoader::GetDirectory() + file_path);
+
+	auto it = textureKeys.find(key);
+	if (it != textureKeys.end()) {
+		Entry& entry = textures[it->second];
+		MarkUsed(entry);
+		entry.refCount++;
+		return it->second;
+	}
+
+	unsigned textureID = TextureLoader::LoadTexture(file_path);
+	if (textureID == 0)
+		return 0;
+
+	Entry& entry = textures[textureID];
+	entry.key = key;
+	entry.refCount = 1;
+	entry.bytes = QueryTextureBytes(textureID);
+	textureKeys[key] = textureID;
+	residentBytes += entry.bytes;
+
+	EvictOverBudget();
+	return textureID;
+}
+
+bool ResourceManager::AddTexture(const std::string& key, unsigned textureID) {
+	if (textureID == 0)
+		return false;
+
+	std::string normalizedKey = NormalizePath(key);
+	auto it = textureKeys.find(normalizedKey);
+	if (it != textureKeys.end()) {
+		Entry& existing = textures[it->second];
+		if (existing.refCount > 0)
+			return false;
+
+		// left resident by an owner that is gone, the new texture takes its place
+		MarkUsed(existing);
+		Evict({ TEXTURE, it->second, nullptr });
+	}
+	if (textures.count(textureID))
+		return false;
+
+	Entry& entry = textures[textureID];
+	entry.key = normalizedKey;
+	entry.refCount = 1;
+	entry.bytes = QueryTextureBytes(textureID);
+	textureKeys[normalizedKey] = textureID;
+	residentBytes += entry.bytes;
+
+	EvictOverBudget();
+	return true;
+}
+
+unsigned ResourceManager::FindTexture(const std::string& key) {
+	auto it = textureKeys.find(NormalizePath(key));
+	if (it == textureKeys.end())
+		return 0;
+
+	Entry& entry = textures[it->second];
+	MarkUsed(entry);
+	entry.refCount++;
+	return it->second;
+}
+
+void ResourceManager::AcquireTexture(unsigned textureID) {
+	auto it = textures.find(textureID);
+	if (it == textures.end())
+		return;
+
+	MarkUsed(it->second);
+	it->second.refCount++;
+}
+
+void ResourceManager::ReleaseTexture(unsigned textureID) {
+	if (textureID == 0)
+		return;
+
+	auto it = textures.find(textureID);
+	if (it == textures.end()) {
+		// not managed, keep the old behaviour of the owner deleting it
+		glDeleteTextures(1, &textureID);
+		return;
+	}
+
+	Entry& entry = it->second;
+	if (entry.refCount > 0 && --entry.refCount == 0) {
+		MarkUnused(entry, { TEXTURE, textureID, nullptr });
+		EvictOverBudget();
+	}
+}
+
+
+/********************************* meshes *********************************/
+
+Mesh* ResourceManager::LoadMesh(const std::string& key, const std::function<Mesh*()>& generator) {
+	MEMORY_TAG(MemoryTracker::RESOURCES);
+	std::string normalizedKey = NormalizePath(key);
+
+	auto it = meshKeys.find(normalizedKey);
+	if (it != meshKeys.end()) {
+		Entry& entry = meshes[it->second];
+		MarkUsed(entry);
+		entry.refCount++;
+		return it->second;
+	}
+
+	Mesh* mesh = generator();
+	if (!mesh)
+		return nullptr;
+
+	Entry& entry = meshes[mesh];
+	entry.key = normalizedKey;
+	entry.refCount = 1;
+	entry.bytes = QueryMeshBytes(mesh);
+	meshKeys[normalizedKey] = mesh;
+	residentBytes += entry.bytes;
+
+	EvictOverBudget();
+	return mesh;
+}
+
+void ResourceManager::ReleaseMesh(Mesh* mesh) {
+	if (!mesh)
+		return;
+
+	auto it = meshes.find(mesh);
+	if (it == meshes.end()) {
+		delete mesh;
+		return;
+	}
+
+	Entry& entry = it->second;
+	if (entry.refCount > 0 && --entry.refCount == 0) {
+		MarkUnused(entry, { MESH, 0, mesh });
+		EvictOverBudget();
+	}
+}
+
+
+/********************************* residency *********************************/
+
+void ResourceManager::SetBudget(size_t bytes) {
+	budget = bytes;
+	EvictOverBudget();
+}
+
+void ResourceManager::UnloadUnused() {
+	// evicting a mesh can release its texture, which gets pushed to the back of the list
+	while (!unusedList.empty()) {
+		UnusedResource resource = unusedList.front();
+		unusedList.pop_front();
+		Evict(resource);
+	}
+}
+
+void ResourceManager::Clear() {
+	auto meshesToDelete = std::move(meshes);
+	meshes.clear();
+	meshKeys.clear();
+	unusedList.clear();
+
+	// deleting meshes releases their textures, so textures go after
+	for (auto& pair : meshesToDelete)
+		delete pair.first;
+
+	for (auto& pair : textures) {
+		unsigned textureID = pair.first;
+		glDeleteTextures(1, &textureID);
+	}
+	textures.clear();
+	textureKeys.clear();
+	unusedList.clear();
+
+	residentBytes = 0;
+}
+
+void ResourceManager::MarkUsed(Entry& entry) {
+	if (entry.unused) {
+		unusedList.erase(entry.unusedIt);
+		entry.unused = false;
+	}
+}
+
+void ResourceManager::MarkUnused(Entry& entry, const UnusedResource& resource) {
+	if (!entry.unused) {
+		entry.unusedIt = unusedList.insert(unusedList.end(), resource);
+		entry.unused = true;
+	}
+}
+
+void ResourceManager::EvictOverBudget() {
+	while (residentBytes > budget && !unusedList.empty()) {
+		UnusedResource resource = unusedList.front();
+		unusedList.pop_front();
+		Evict(resource);
+	}
+}
+
+void ResourceManager::Evict(const UnusedResource& resource) {
+	if (resource.type == TEXTURE) {
+		auto it = textures.find(resource.textureID);
+		if (it == textures.end())
+			return;
+
+		residentBytes -= it->second.bytes;
+		textureKeys.erase(it->second.key);
+		textures.erase(it);
+
+		unsigned textureID = resource.textureID;
+		glDeleteTextures(1, &textureID);
+	}
+	else {
+		auto it = meshes.find(resource.mesh);
+		if (it == meshes.end())
+			return;
+
+		residentBytes -= it->second.bytes;
+		meshKeys.erase(it->second.key);
+		meshes.erase(it);
+
+		delete resource.mesh;
+	}
+}
+
+
+/********************************* helpers *********************************/
+
+std::string ResourceManager::NormalizePath(const std::string& path) {
+	std::vector<std::string> parts;
+	std::string part;
+
+	auto pushPart = [&]() {
+		if (part == ".." && !parts.empty() && parts.back() != "..")
+			parts.pop_back();
+		else if (!part.empty() && part != ".")
+			parts.push_back(part);
+		part.clear();
+		};
+
+	for (char c : path) {
+		if (c == '/' || c == '\\')
+			pushPart();
+		else
+			part += c;
+	}
+	pushPart();
+
+	std::string normalized;
+	normalized.reserve(path.size());
+	for (unsigned i = 0; i < parts.size(); i++) {
+		if (i > 0)
+			normalized += '/';
+		normalized += parts[i];
+	}
+	return normalized;
+}
+
+size_t ResourceManager::QueryTextureBytes(unsigned textureID) {
+	size_t bytes = 0;
+
+	glBindTexture(GL_TEXTURE_2D, textureID);
+	// every level that was uploaded or generated, a level that does not exist reports a width of 0
+	for (GLint level = 0; level < 32; level++) {
+		GLint width = 0, height = 0;
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_WIDTH, &width);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_HEIGHT, &height);
+		if (width == 0 || height == 0)
+			break;
+
+		GLint compressed = GL_FALSE;
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_COMPRESSED, &compressed);
+		if (compressed) {
+			GLint imageSize = 0;
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &imageSize);
+			bytes += static_cast<size_t>(imageSize);
+			continue;
+		}
+
+		// the sizes the driver actually stores, so GL_R8 is 1 byte and GL_RGBA16F is 8
+		GLint bits = 0;
+		for (GLenum component : { GL_TEXTURE_RED_SIZE, GL_TEXTURE_GREEN_SIZE, GL_TEXTURE_BLUE_SIZE, GL_TEXTURE_ALPHA_SIZE, GL_TEXTURE_DEPTH_SIZE, GL_TEXTURE_STENCIL_SIZE }) {
+			GLint componentBits = 0;
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, level, component, &componentBits);
+			bits += componentBits;
+		}
+		bytes += static_cast<size_t>(width) * height * ((bits + 7) / 8);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	return bytes;
+}
+
+size_t ResourceManager::QueryMeshBytes(const Mesh* mesh) {
+	GLint vertexBytes = 0, indexBytes = 0;
+
+	glBindBuffer(GL_ARRAY_BUFFER, mesh->vertexBuffer);
+	glGetBufferParameteriv(GL_ARRAY_BUFFER, GL_BUFFER_SIZE, &vertexBytes);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->indexBuffer);
+	glGetBufferParameteriv(GL_ELEMENT_ARRAY_BUFFER, GL_BUFFER_SIZE, &indexBytes);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	size_t bytes = static_cast<size_t>(vertexBytes) + static_cast<size_t>(indexBytes);
+
+	for (const Mesh::Lod& lod : mesh->lods) {
+		GLint lodVertexBytes = 0;
+		if (lod.vertexBuffer != 0) {
+			glBindBuffer(GL_ARRAY_BUFFER, lod.vertexBuffer);
+			glGetBufferParameteriv(GL_ARRAY_BUFFER, GL_BUFFER_SIZE, &lodVertexBytes);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+		}
+		bytes += static_cast<size_t>(lodVertexBytes) + lod.indexSize * sizeof(GLuint);
+	}
+	return bytes;
+}
@@ -0,0 +1,111 @@
+#ifndef RESOURCE_MANAGER_H
+#define RESOURCE_MANAGER_H
+
+#include <string>
+#include <list>
+#include <unordered_map>
+#include <functional>
+
+class Mesh;
+
+/* how to use | ResourceManager:
+* || textures
+* unsigned textureID = ResourceManager::GetInstance().LoadTexture("color.tga"); // same rules as TextureLoader::LoadTexture(), loading the same file again returns the same id without decoding or uploading again
+* ResourceManager::GetInstance().ReleaseTexture(textureID); // Mesh::~Mesh() does this for you, a mesh owns the reference it was given
+*
+* || meshes
+* meshList[FLASHLIGHT] = ResourceManager::GetInstance().LoadMesh(ModelLoader::GetDirectory() + "flashlight.obj", [] { return MeshBuilder::GenerateOBJ(...); }); // generator only runs if the key is not loaded yet
+* ResourceManager::GetInstance().ReleaseMesh(mesh); // BaseScene::Exit() does this for every mesh in meshList, meshes not loaded through here are deleted right away
+*
+* || residency
+* resources with no references left stay resident so the next scene can reuse them for free,
+* until the total resident size goes over the budget, then the least recently used ones get evicted first
+* ResourceManager::GetInstance().SetBudget(64 * 1024 * 1024); // in bytes
+*/
+
+class ResourceManager {
+public:
+
+	static ResourceManager& GetInstance() {
+		static ResourceManager resourceManager;
+		return resourceManager;
+	}
+
+	// key is the normalized path of TextureLoader's directory + file_path
+	unsigned LoadTexture(const char* file_path);
+	// takes over a texture created elsewhere (atlases, generated textures) with 1 reference, returns false if the key is still referenced,
+	// a key with no references left is evicted and replaced, e.g. the same atlas built again by the next scene
+	bool AddTexture(const std::string& key, unsigned textureID);
+	// returns 0 if the key is not loaded, otherwise adds a reference like LoadTexture()
+	unsigned FindTexture(const std::string& key);
+	// adds a reference to an already loaded texture, use this if the same id is given to more than 1 mesh
+	void AcquireTexture(unsigned textureID);
+	// textures not loaded through LoadTexture() are deleted right away
+	void ReleaseTexture(unsigned textureID);
+
+	// key is normalized as a path, procedural meshes can use any unique string with their parameters in it
+	Mesh* LoadMesh(const std::string& key, const std::function<Mesh*()>& generator);
+	// meshes not loaded through LoadMesh() are deleted right away
+	void ReleaseMesh(Mesh* mesh);
+
+	void SetBudget(size_t bytes);
+	size_t GetBudget() const { return budget; }
+	size_t GetResidentBytes() const { return residentBytes; }
+	unsigned GetTextureCount() const { return static_cast<unsigned>(textures.size()); }
+	unsigned GetMeshCount() const { return static_cast<unsigned>(meshes.size()); }
+
+	// evict every resource with no references left
+	void UnloadUnused();
+	// frees everything regardless of references, call before the GL context is destroyed
+	void Clear();
+
+	static std::string NormalizePath(const std::string& path);
+
+private:
+
+	enum RESOURCE_TYPE {
+		TEXTURE,
+		MESH,
+	};
+
+	struct UnusedResource {
+		RESOURCE_TYPE type;
+		unsigned textureID;
+		Mesh* mesh;
+	};
+
+	struct Entry {
+		std::string key;
+		unsigned refCount = 0;
+		size_t bytes = 0;
+		bool unused = false;
+		std::list<UnusedResource>::iterator unusedIt;
+	};
+
+	std::unordered_map<std::string, unsigned> textureKeys;
+	std::unordered_map<unsigned, Entry> textures;
+
+	std::unordered_map<std::string, Mesh*> meshKeys;
+	std::unordered_map<Mesh*, Entry> meshes;
+
+	// front is the least recently used
+	std::list<UnusedResource> unusedList;
+
+	size_t budget = 256 * 1024 * 1024;
+	size_t residentBytes = 0;
+
+	void MarkUsed(Entry& entry);
+	void MarkUnused(Entry& entry, const UnusedResource& resource);
+	void EvictOverBudget();
+	void Evict(const UnusedResource& resource);
+
+	static size_t QueryTextureBytes(unsigned textureID);
+	static size_t QueryMeshBytes(const Mesh* mesh);
+
+	ResourceManager() = default;
+	~ResourceManager() = default;
+	ResourceManager(const ResourceManager&) = delete;
+	ResourceManager& operator=(const ResourceManager&) = delete;
+};
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+
+// lock free ring buffer for exactly 1 producer thread and 1 consumer thread
+// S must be a power of 2, Push() fails instead of blocking when the queue is full
+template<typename T, size_t S>
+class SPSCQueue {
+public:
+
+    static_assert(S > 0 && (S & (S - 1)) == 0, "SPSCQueue size must be a power of 2");
+
+    // producer only
+    bool Push(const T& item) {
+        size_t currentHead = head.load(std::memory_order_relaxed);
+        if (currentHead - tail.load(std::memory_order_acquire) >= S)
+            return false;
+
+        buffer[currentHead & (S - 1)] = item;
+        head.store(currentHead + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer only
+    bool Pop(T& out_item) {
+        size_t currentTail = tail.load(std::memory_order_relaxed);
+        if (currentTail == head.load(std::memory_order_acquire))
+            return false;
+
+        out_item = buffer[currentTail & (S - 1)];
+        tail.store(currentTail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // approximate when called while the other thread is active
+    size_t size() const { return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire); }
+    bool empty() const { return size() == 0; }
+    static constexpr size_t capacity() { return S; }
+
+private:
+
+    // head and tail on separate cache lines so the 2 threads do not keep invalidating each other
+    alignas(64) std::atomic<size_t> head{ 0 };
+    alignas(64) std::atomic<size_t> tail{ 0 };
+    T buffer[S];
+};
+
+#endif
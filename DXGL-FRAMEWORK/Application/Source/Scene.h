@@ -8,9 +8,23 @@ public:
 	~Scene() {}
 
 	virtual void Init() = 0;
+	// dt is the fixed tick length when Application runs a fixed tick loop, it can then be called 0 or several times per Render()
 	virtual void Update(double dt) = 0;
 	virtual void Render() = 0;
 	virtual void Exit() = 0;
+
+	// set by Application before each Render()
+	// | alpha : 0 - 1, how far the frame is between the last tick and the next one, always 1 without a fixed tick
+	void SetInterpolationAlpha(double alpha) { interpolationAlpha = alpha; }
+	double GetInterpolationAlpha() const { return interpolationAlpha; }
+	// real time of the last frame in seconds, Update()'s dt is not the frame time with a fixed tick
+	void SetFrameTime(double seconds) { frameTime = seconds; }
+	double GetFrameTime() const { return frameTime; }
+
+protected:
+
+	double interpolationAlpha = 1;
+	double frameTime = 0;
 };
 
 #endif
\ No newline at end of file
@@ -1,5 +1,8 @@
 #define _USE_MATH_DEFINES
 #include <cmath>
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
 
 #include "SceneDemo.h"
 
@@ -8,10 +11,10 @@
 //Include GLFW
 #include <GLFW/glfw3.h>
 
-#include <glm\glm.hpp>
-#include <glm\gtc\matrix_transform.hpp>
-#include <glm\gtc\type_ptr.hpp>
-#include <glm\gtc\matrix_inverse.hpp>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/matrix_inverse.hpp>
 
 #include "Light.h"
 #include "shader.hpp"
@@ -20,9 +23,15 @@
 #include "TextureLoader.h"
 #include "MouseController.h"
 #include "KeyboardController.h"
+#include "InputQueue.h"
 #include "AudioManager.h"
+#include "Profiler.h"
+#include "MemoryTracker.h"
+#include "FrameArena.h"
 #include "DataManager.h"
 #include "DialogueManager.h"
+#include "ResourceManager.h"
+#include "JobSystem.h"
 
 #include "Console.h"
 #include "Utils.h"
@@ -36,6 +45,16 @@ using glm::vec3;
 using glm::mat4;
 using std::string;
 
+namespace {
+	// same as calling UpdateModel() on every non physics object of the hierarchy, parents first
+	void UpdateHierarchyModels(const std::shared_ptr<RObj>& obj) {
+		if (!obj->GetPhysics())
+			obj->UpdateModel();
+		for (auto& child : obj->children)
+			UpdateHierarchyModels(child);
+	}
+}
+
 
 /* notes:
 * if you are unsure if a certain function does something, hover over it and see what it does (i added description for most of the functions you might need help to know what it does)
@@ -81,7 +100,7 @@ void SceneDemo::Init() {
 	// audio init
 	{
 		// music init
-		AudioManager::GetInstance().LoadMUS("Wheel_Chill.ogg", 57.7555); // you need to input the total duration of the music in seconds as a double, sdl mixer cannot get the duration itself
+		AudioManager::GetInstance().LoadMUS("Wheel_Chill.ogg"); // duration is read from the ogg itself
 
 		// sfx init
 		AudioManager::GetInstance().LoadSFX(GOOFY_AHH_ASRIEL_STAR_SOUND, "sfx_asriel_star_drop.wav");
@@ -101,25 +120,38 @@ void SceneDemo::Init() {
 
 	// Init VBO here
 	{
+		// textures are shared through the resource manager, loading color.tga again does not decode or upload it again
+		auto& resources = ResourceManager::GetInstance();
+
 		for (int i = 0; i < static_cast<int>(TOTAL); ++i)
 		{
 			meshList[i] = nullptr;
 		}
 		meshList[AXES] = MeshBuilder::GenerateAxes("Axes", 10000.f, 10000.f, 10000.f);
-		meshList[GROUND] = MeshBuilder::GenerateGround("ground", 1000, 5, TextureLoader::LoadTexture("color.tga"));
-		meshList[SKYBOX] = MeshBuilder::GenerateSkybox("skybox", TextureLoader::LoadTexture("skybox.tga"));
+		meshList[GROUND] = MeshBuilder::GenerateGround("ground", 1000, 5, resources.LoadTexture("color.tga"));
+		meshList[SKYBOX] = MeshBuilder::GenerateSkybox("skybox", resources.LoadTexture("skybox.tga"));
 		meshList[LIGHT] = MeshBuilder::GenerateSphere("light", vec3(1));
 		meshList[GROUP] = MeshBuilder::GenerateSphere("group", vec3(1), 0.15f);
 		meshList[DEBUG_LINE] = MeshBuilder::GenerateLine("debug line", 1);
 
-		meshList[FONT_CASCADIA_MONO] = MeshBuilder::GenerateText("cascadia mono font", 16, 16, FontSpacing(FONT_CASCADIA_MONO), TextureLoader::LoadTexture("Cascadia_Mono.tga"));
+		meshList[FONT_CASCADIA_MONO] = MeshBuilder::GenerateText("cascadia mono font", 16, 16, FontSpacing(FONT_CASCADIA_MONO), resources.LoadTexture("Cascadia_Mono.tga"));
+
+		meshList[FLASHLIGHT] = resources.LoadMesh(ModelLoader::GetDirectory() + "flashlight.obj", [&resources] {
+			return MeshBuilder::GenerateOBJMTL("flashlight", "flashlight.obj", "flashlight.mtl", resources.LoadTexture("flashlight_texture.tga"));
+			});
 
-		meshList[FLASHLIGHT] = MeshBuilder::GenerateOBJMTL("flashlight", "flashlight.obj", "flashlight.mtl", TextureLoader::LoadTexture("flashlight_texture.tga"));
+		meshList[PILLAR] = MeshBuilder::GenerateFrustum("pillar", vec3(0.8f), 0.5f, 0.4f, 3);
+		meshList[WALL] = MeshBuilder::GenerateCube("wall", vec3(0.7f), 1);
 
-		meshList[UI_TEST] = MeshBuilder::GenerateQuad("ui test", vec3(1), 1, 1, TextureLoader::LoadTexture("NYP.png"));
-		meshList[UI_TEST_2] = MeshBuilder::GenerateQuad("ui test 2", vec3(1), 1, 1, TextureLoader::LoadTexture("color.tga"));
+		// ui images are packed into 1 texture so the whole ui layer binds once
+		uiAtlas.Add("nyp", "NYP.png");
+		uiAtlas.Add("color", "color.tga");
+		if (!uiAtlas.Build())
+			Error("SceneDemo::Init(): ui atlas failed to build, ui quads will have no texture");
+		meshList[UI_TEST] = MeshBuilder::GenerateQuad("ui test", vec3(1), 1, 1, uiAtlas, "nyp");
+		meshList[UI_TEST_2] = MeshBuilder::GenerateQuad("ui test 2", vec3(1), 1, 1, uiAtlas, "color");
 
-		meshList[PHYSICS_BALL] = MeshBuilder::GenerateSphere("physics ball", vec3(1.f), 0.5f, 16, 8, TextureLoader::LoadTexture("color.tga"));
+		meshList[PHYSICS_BALL] = MeshBuilder::GenerateSphere("physics ball", vec3(1.f), 0.5f, 16, 8, resources.LoadTexture("color.tga"));
 		meshList[PHYSICS_BOX] = MeshBuilder::GenerateCube("physics box", vec3(1.f), 1);
 		meshList[TRIGGER_BOX] = MeshBuilder::GenerateCube("trigger box", vec3(1.f), 1);
 	}
@@ -161,6 +193,7 @@ void SceneDemo::Init() {
 			});
 		RObj::setDefaultStat.Subscribe(SKYBOX, [](const std::shared_ptr<RObj>& obj) {
 			obj->material.Set(Material::BRIGHT); // affected by light, tho the material is set in a way so that it is always bright, just like NO_LIGHT (this makes sure fog can still be casted on it while be bright at times without fog)
+			obj->castShadows = false; // lit, but it is wrapped around everything else
 			});
 		RObj::setDefaultStat.Subscribe(LIGHT, [](const std::shared_ptr<RObj>& obj) {
 			obj->material.Set(Material::NEON); // bright when shinned with light directly and and still be rather bright when not shinned
@@ -176,6 +209,13 @@ void SceneDemo::Init() {
 			});
 		RObj::setDefaultStat.Subscribe(FLASHLIGHT, [](const std::shared_ptr<RObj>& obj) {
 			});
+		RObj::setDefaultStat.Subscribe(PILLAR, [](const std::shared_ptr<RObj>& obj) {
+			obj->material.Set(Material::MATT);
+			});
+		RObj::setDefaultStat.Subscribe(WALL, [](const std::shared_ptr<RObj>& obj) {
+			obj->material.Set(Material::MATT);
+			obj->occluder = true;
+			});
 		RObj::setDefaultStat.Subscribe(UI_TEST, [](const std::shared_ptr<RObj>& obj) {
 			obj->relativeTrl = true;
 			obj->hasTransparency = true;
@@ -267,6 +307,7 @@ void SceneDemo::Init() {
 				// spot light variables (yes, these are the only 2 you need to change manually)
 				lightProperties.cosCutoff = 31.f;
 				lightProperties.cosInner = 29.f;
+				lightProperties.castShadows = true;
 				UpdateLightUniform(newLightObj);
 			}
 		}
@@ -317,20 +358,7 @@ void SceneDemo::Update(double dt) {
 	BaseScene::Update(dt);
 	ClearDebugText();
 
-	// fps calculation
 	const float fpsUpdateTime = 0.5f;
-	static float avgFps = 0;
-	{
-		static float timer = 0;
-		static int frameCount = 0;
-		timer += dt;
-		frameCount++;
-		if (timer >= fpsUpdateTime) {
-			avgFps = frameCount / timer;
-			timer = 0;
-			frameCount = 0;
-		}
-	}
   
 	// Temporary for now
 	// When the Game State handler, the code snippet below will be stored properly
@@ -342,7 +370,7 @@ void SceneDemo::Update(double dt) {
 	}
 	debugPhysicsTimer += dt;
 
-	// simulation fps calculation
+	// simulation fps calculation, this is the tick rate when Application runs a fixed tick
 	static float simAvgFps = 0;
 	{
 		static float timer = 0;
@@ -355,7 +383,27 @@ void SceneDemo::Update(double dt) {
 			frameCount = 0;
 		}
 	}
-	AddDebugText("average fps: " + std::to_string(avgFps) + ", simulation average fps: " + std::to_string(simAvgFps));
+	AddDebugTextF("average fps: %f, simulation average fps: %f", avgFps, simAvgFps);
+	// 0 until Application measures it, see InputQueue::SetMeasureLatency()
+	InputQueue& inputQueue = InputQueue::GetInstance();
+	AddDebugTextF("input latency: %.1f ms, p50 %.1f ms, p95 %.1f ms", inputQueue.GetLastLatencyMs(), inputQueue.GetLatencyPercentile(50), inputQueue.GetLatencyPercentile(95));
+	const LightClusters::Stats& clusterStats = lightClusters.GetStats();
+	AddDebugTextF("lights: %u of %u visible, %u cluster entries, max %u per cluster, binned in %.2f ms", clusterStats.visibleLights, clusterStats.lights, clusterStats.indices, clusterStats.maxLightsPerCluster, clusterStats.buildMs);
+	// counted by the previous Render(), Update() runs before it
+	const auto& shadingLods = GetShadingLodCounts();
+	AddDebugTextF("shading %s: %u per pixel, %u reduced, %u per vertex", GetShadingQualityName(GetShadingQuality()), shadingLods[0], shadingLods[1], shadingLods[2]);
+	const auto& meshLods = GetMeshLodCounts();
+	AddDebugTextF("mesh lod %s: %u / %u / %u / %u / %u draws per level, %llu triangles", GetMeshLod() ? "on" : "off", meshLods[0], meshLods[1], meshLods[2], meshLods[3], meshLods[4], GetDrawnTriangles());
+	AddDebugTextF("depth pre-pass %s: %llu shaded samples, %u pre-pass draws", GetDepthPrePass() ? "on" : "off", GetShadedSamples(), GetDepthPrePassDraws());
+	const OcclusionCuller::Stats& occlusionStats = GetOcclusionStats();
+	AddDebugTextF("occlusion %s%s: %u of %u culled, %u occluders, depth %u frames old, %.2f ms", OcclusionCuller::GetModeName(GetOcclusionMode()),
+		GetOcclusionMode() != OcclusionCuller::MODE_OFF && !occlusionStats.active ? " (waiting)" : "", occlusionStats.culled, occlusionStats.tested, occlusionStats.occluders, occlusionStats.age, occlusionStats.cpuMs);
+	const ShadowAtlas::Stats& shadowStats = shadowAtlas.GetStats();
+	AddDebugTextF("shadows: %u maps, %u static / %u dynamic casters, %u static redraws, %u draws, %.2f ms", shadowStats.maps, shadowStats.staticCasters, shadowStats.dynamicCasters, shadowStats.staticRedraws, shadowStats.staticDraws + shadowStats.dynamicDraws, shadowStats.cpuMs);
+	const PostProcess::Settings& postSettings = GetPostProcessSettings();
+	const PostProcess::Stats& postStats = GetPostProcessStats();
+	AddDebugTextF("post %s: aa %s, bloom %s, %ux%u (%.0f%%%s), scene gpu %.2f ms", postSettings.enabled ? "on" : "off", PostProcess::GetAntiAliasingName(postSettings.antiAliasing),
+		postSettings.bloom ? "on" : "off", postStats.renderWidth, postStats.renderHeight, postStats.renderScale * 100, postSettings.dynamicResolution ? " dynamic" : "", postStats.gpuMs);
 
 	auto& lightList = LightObject::lightList;
 	auto& worldList = RObj::worldList;
@@ -407,8 +455,6 @@ void SceneDemo::Update(double dt) {
 
 		}
 
-		if (!obj->GetPhysics())
-			obj->UpdateModel(); // detects changes in trl, rot and scl automatically to update its hierarchy's model
 		i++;
 	}
 
@@ -430,11 +476,20 @@ void SceneDemo::Update(double dt) {
 
 		}
 
-		if (!obj->GetPhysics())
-			obj->UpdateModel();
 		i++;
 	}
 
+	// transforms, UpdateModel() detects changes in trl, rot and scl automatically to update its hierarchy's model
+	// it also writes every descendant's model, so the jobs are split by subtree (children of a root) and not by list entry
+	JobSystem& jobs = JobSystem::GetInstance();
+	JobCounter transformJobs, lightJobs;
+	for (std::shared_ptr<RObj> root : { worldRoot, viewRoot }) {
+		jobs.ParallelFor(static_cast<unsigned>(root->children.size()), 1, [root](unsigned begin, unsigned end) {
+			for (unsigned i = begin; i < end; i++)
+				UpdateHierarchyModels(root->children[i]);
+			}, &transformJobs);
+	}
+
 	// screen render objects
 	for (unsigned i = 0; i < screenList.size(); ) {
 		if (screenList[i].expired()) {
@@ -474,49 +529,64 @@ void SceneDemo::Update(double dt) {
 		i++;
 	}
 
-	// light update
+	// light update, expired lights are removed first since the jobs cannot erase from the list
 	for (unsigned i = 0; i < lightList.size(); ) {
 		if (lightList[i].expired()) {
 			lightList.erase(lightList.begin() + i);
 			continue;
 		}
-		auto obj = lightList[i].lock();
-		obj->allowRender = debug;
-		Light& properties = obj->lightProperties;
+		i++;
+	}
+	const mat4 inversedView = glm::inverse(viewStack.Top());
+	jobs.ParallelFor(static_cast<unsigned>(lightList.size()), 4, [&](unsigned begin, unsigned end) {
+		for (unsigned i = begin; i < end; i++) {
+			auto obj = lightList[i].lock();
+			obj->allowRender = debug;
+			Light& properties = obj->lightProperties;
 
 
 
-		if (debug) {
+			if (debug) {
 
-		}
+			}
 
-		obj->UpdateModel();
+			obj->UpdateModel();
 
-		// update light's position and possibly rotation with model
-		if (obj->renderType == RObj::VIEW || obj->renderType == RObj::WORLD) {
-			mat4 lightModel = obj->model;
+			// update light's position and possibly rotation with model
+			if (obj->renderType == RObj::VIEW || obj->renderType == RObj::WORLD) {
+				mat4 lightModel = obj->model;
 
-			// find world space model
-			if (obj->renderType == RObj::VIEW) {
-				mat4 inversedView = glm::inverse(viewStack.Top());
-				lightModel = inversedView * lightModel; // world_space_model = view_space_model / view_mat, / view_mat == inverseView
+				// find world space model
+				if (obj->renderType == RObj::VIEW)
+					lightModel = inversedView * lightModel; // world_space_model = view_space_model / view_mat, / view_mat == inverseView
+				properties.position = getPosFromModel(lightModel);
+				if (properties.type == Light::LIGHT_SPOT)
+					properties.spotDirection = rotateScaleWithModel(lightModel, obj->initialDire);
+			}
+			else {
+				properties.power = 0;
 			}
-			properties.position = getPosFromModel(lightModel);
-			if (properties.type == Light::LIGHT_SPOT)
-				properties.spotDirection = rotateScaleWithModel(lightModel, obj->initialDire);
-		}
-		else {
-			properties.power = 0;
 		}
+		}, &lightJobs, &transformJobs);
 
-		UpdateLightUniform(obj);
-		i++;
+	{
+		PROFILE_ZONE("Transform and light jobs");
+		jobs.Wait(transformJobs);
+		jobs.Wait(lightJobs);
 	}
 
+	// uniforms stay on this thread, it owns the GL context
+	for (auto& light : lightList)
+		UpdateLightUniform(light.lock());
+
 	// update physics
 	PhysicsEventListener& eventListener = PhysicsManager::GetInstance().GetEventListener();
-	eventListener.UpdateEventValidity(PhysicsManager::GetInstance().GetWorld());
-	PhysicsManager::GetInstance().UpdatePhysics(dt);
+	{
+		PROFILE_ZONE("Physics step");
+		MEMORY_TAG(MemoryTracker::PHYSICS);
+		eventListener.UpdateEventValidity(PhysicsManager::GetInstance().GetWorld());
+		PhysicsManager::GetInstance().UpdatePhysics(dt);
+	}
 
 	const auto& debugRenderer = PhysicsManager::GetInstance().GetDebugRenderer();
 	if (ALLOW_PHYSICS_DEBUG && renderDebugPhysics && debugRenderer && debugPhysicsTimer >= fpsUpdateTime) {
@@ -566,84 +636,208 @@ void SceneDemo::Update(double dt) {
 	// camera
 	camera.Update(dt); // this must be right after player's block of code to make sure it is sync
 
+	// positional voices are updated from this in AudioManager::Update()
+	AudioManager::GetInstance().SetListener(camera.GetFinalPosition(), camera.GetFinalTarget() - camera.GetFinalPosition());
+
 	// yah you can do this to add text, but this must be called every frame since it gets refreshed every frame
 	// you can call AddDebugText() at anywhere after calling BaseScene::Update(); and before calling renderObjectList(RObj::screenList, true); and itll work
-	AddDebugText("camera.basePosition: " + VecToString(camera.basePosition)); // VecToString supports vec2, vec3 and vec4 (idfk why i didt that but why not ig)
-	AddDebugText("camera.finalPosition: " + VecToString(camera.GetPlainPosition()));
-	AddDebugText("player.physics.postion: " + VecToString(player.renderGroup.lock()->GetPhysics()->GetPosition()));
-	AddDebugText("player.physics.velocity: " + VecToString(player.renderGroup.lock()->GetPhysics()->GetVelocity()));
+	MEMORY_TAG(MemoryTracker::TEXT);
+	// AddDebugTextF() takes printf formats, same output as AddDebugText("..." + VecToString(vec)) without the temporary strings
+	vec3 cameraBase = camera.basePosition;
+	vec3 cameraFinal = camera.GetPlainPosition();
+	vec3 playerPosition = player.renderGroup.lock()->GetPhysics()->GetPosition();
+	vec3 playerVelocity = player.renderGroup.lock()->GetPhysics()->GetVelocity();
+	AddDebugTextF("camera.basePosition: [%f, %f, %f] ", cameraBase.x, cameraBase.y, cameraBase.z);
+	AddDebugTextF("camera.finalPosition: [%f, %f, %f] ", cameraFinal.x, cameraFinal.y, cameraFinal.z);
+	AddDebugTextF("player.physics.postion: [%f, %f, %f] ", playerPosition.x, playerPosition.y, playerPosition.z);
+	AddDebugTextF("player.physics.velocity: [%f, %f, %f] ", playerVelocity.x, playerVelocity.y, playerVelocity.z);
+
+#ifdef ENABLE_PROFILER
+	if (debug) {
+		for (const auto& line : Profiler::GetInstance().GetOverlayLines())
+			AddDebugText(line);
+	}
+#endif
+#ifdef ENABLE_MEMORY_TRACKER
+	if (debug) {
+		for (const auto& line : MemoryTracker::GetInstance().GetOverlayLines())
+			AddDebugText(line);
+	}
+#endif
 
 }
 
 
 void SceneDemo::Render() {
 	BaseScene::Render();
+
+	// fps calculation, here since Update() may run 0 or several times per frame
+	{
+		static float timer = 0;
+		static int frameCount = 0;
+		timer += GetFrameTime();
+		frameCount++;
+		if (timer >= 0.5f) {
+			avgFps = frameCount / timer;
+			timer = 0;
+			frameCount = 0;
+		}
+	}
 	
 	// render scene
 	struct ListInfo {
 		std::shared_ptr<RObj> obj;
 		mat4 model;
 		float depth;
-		ListInfo(std::shared_ptr<RObj> obj, mat4 model, float depth)
-			: obj(obj), model(model), depth(depth) {}
+		// submission order, keeps equal depths in the order the old insertion sort gave them
+		unsigned order;
+		// shader variant, opaque objects are drawn grouped by it
+		unsigned variant;
+		ListInfo(std::shared_ptr<RObj> obj, const mat4& model, float depth, unsigned order, unsigned variant = 0)
+			: obj(std::move(obj)), model(model), depth(depth), order(order), variant(variant) {}
 	};
-	std::vector<ListInfo> transparencyList;
-	transparencyList.reserve(40);
-
-	auto insert2TransparencyList = [&](const std::shared_ptr<RObj>& obj, const mat4& model, float depth) {
-
-		unsigned insertPosition = 0;
-
+	// arena backed, the lists live for this Render() only and the arena is reset next frame
+	FrameVector<ListInfo> transparencyList;
+	transparencyList.reserve(RObj::worldList.size() + RObj::viewList.size());
+	FrameVector<ListInfo> opaqueList;
+	opaqueList.reserve(std::max(RObj::worldList.size(), RObj::viewList.size()));
+
+	auto insert2TransparencyList = [&](std::shared_ptr<RObj> obj, const mat4& model, float depth) {
+		transparencyList.emplace_back(std::move(obj), model, depth, static_cast<unsigned>(transparencyList.size()));
+		};
+	auto renderTransparencyList = [&]() {
+		// back to front, sorted once instead of an insertion per object
+		std::sort(transparencyList.begin(), transparencyList.end(), [](const ListInfo& a, const ListInfo& b) {
+			if (a.depth != b.depth)
+				return a.depth > b.depth;
+			return a.order > b.order;
+			});
 		for (auto& info : transparencyList) {
-			if (info.depth > depth)
-				insertPosition++;
-			else
-				break;
+			modelStack.PushMatrix();
+			modelStack.LoadMatrix(info.model);
+			RenderObj(info.obj);
+			modelStack.PopMatrix();
 		}
+		};
 
-		transparencyList.emplace(transparencyList.begin() + insertPosition, obj, model, depth);
+	// camera space squared distance, front to back
+	auto renderOpaqueList = [&]() {
+		auto frontToBack = [](const ListInfo& a, const ListInfo& b) {
+			if (a.depth != b.depth)
+				return a.depth < b.depth;
+			return a.order < b.order;
+			};
+
+		// depth only, front to back, so the shaded draws below only pass where they are the closest surface
+		if (enabledDepthPrePass && !opaqueList.empty()) {
+			PROFILE_ZONE("Depth pre-pass");
+			std::sort(opaqueList.begin(), opaqueList.end(), frontToBack);
+			BeginDepthPrePass();
+			for (auto& info : opaqueList) {
+				if (info.obj->allowRender)
+					RenderDepth(meshList[info.obj->geometryType], projectionStack.Top() * viewStack.Top() * info.model, info.obj->lodLevel);
+			}
+			EndDepthPrePass();
+		}
+
+		// 1 bucket per shader variant so each program is bound once per list, front to back inside a bucket for early z
+		std::sort(opaqueList.begin(), opaqueList.end(), [&frontToBack](const ListInfo& a, const ListInfo& b) {
+			if (a.variant != b.variant)
+				return a.variant < b.variant;
+			return frontToBack(a, b);
+			});
+		for (auto& info : opaqueList) {
+			modelStack.PushMatrix();
+			modelStack.LoadMatrix(info.model);
+			RenderObj(info.obj);
+			modelStack.PopMatrix();
+		}
+		if (enabledDepthPrePass && !opaqueList.empty())
+			EndDepthEqualPass();
+		opaqueList.clear();
 		};
-	auto renderTransparencyList = [&]() {
-		for (auto& info : transparencyList) {
+
+	// the skybox, after every opaque object and at the far plane, so it only shades the pixels nothing else covered
+	FrameVector<ListInfo> backgroundList;
+	auto renderBackgroundList = [&]() {
+		if (backgroundList.empty())
+			return;
+		glDepthRange(1, 1);
+		glDepthFunc(GL_LEQUAL);
+		glDepthMask(GL_FALSE);
+		for (auto& info : backgroundList) {
 			modelStack.PushMatrix();
 			modelStack.LoadMatrix(info.model);
 			RenderObj(info.obj);
 			modelStack.PopMatrix();
 		}
+		glDepthMask(GL_TRUE);
+		glDepthFunc(GL_LESS);
+		glDepthRange(0, 1);
+		backgroundList.clear();
 		};
 
-	auto renderObjectList = [&](const std::vector<std::weak_ptr<RObj>>& list, bool ignoreTransparency = false) {
+	// ignoreTransparency lists are drawn in list order, the screen list is sorted by layer
+	// testOcclusion skips objects BaseScene::IsOccluded() says are hidden, before anything is uploaded or drawn for them, the pre-pass included
+	auto renderObjectList = [&](const std::vector<std::weak_ptr<RObj>>& list, bool ignoreTransparency = false, bool testOcclusion = false) {
 		for (auto& obj_wptr : list) {
 			auto obj = obj_wptr.lock();
+			// text is laid out past its mesh's bounds, the skybox is around the camera anyway
+			if (testOcclusion && obj->allowRender && obj->geometryType != SKYBOX && !std::dynamic_pointer_cast<TextObject>(obj) && IsOccluded(obj, obj->model))
+				continue;
 			modelStack.PushMatrix();
 			modelStack.LoadMatrix(obj->model);
+			// once per frame, the pre-pass and the shaded draw must use the same level
+			if (!ignoreTransparency)
+				obj->lodLevel = SelectLod(meshList[obj->geometryType], viewStack.Top() * modelStack.Top(), obj->lodLevel);
 
 			if (obj->hasTransparency && !ignoreTransparency) {
 				vec3 obj_worldPos = vec3(modelStack.Top()[3]);
 				vec3 obj2CameraPos = camera.GetFinalPosition() - obj_worldPos;
 				float depthSqr = obj2CameraPos.x * obj2CameraPos.x + obj2CameraPos.y * obj2CameraPos.y + obj2CameraPos.z * obj2CameraPos.z;
-				insert2TransparencyList(obj, modelStack.Top(), depthSqr);
+				insert2TransparencyList(std::move(obj), modelStack.Top(), depthSqr);
+			}
+			else if (!ignoreTransparency && obj->geometryType == SKYBOX) {
+				backgroundList.emplace_back(std::move(obj), modelStack.Top(), 0.f, static_cast<unsigned>(backgroundList.size()));
+			}
+			else if (!ignoreTransparency) {
+				unsigned variant = GetShaderVariant(obj, modelStack.Top());
+				vec3 position_cameraspace = vec3(viewStack.Top() * modelStack.Top()[3]);
+				float depthSqr = glm::dot(position_cameraspace, position_cameraspace);
+				opaqueList.emplace_back(std::move(obj), modelStack.Top(), depthSqr, static_cast<unsigned>(opaqueList.size()), variant);
 			}
 			else
 				RenderObj(obj);
 
 			modelStack.PopMatrix();
 		}
+		renderOpaqueList();
+		renderBackgroundList();
 		};
 
 
-	renderObjectList(RObj::worldList);
-
-	glEnable(GL_BLEND);
-	glDepthMask(GL_FALSE);
-	renderTransparencyList();
-	transparencyList.clear();
-	glDepthMask(GL_TRUE);
-	glDisable(GL_BLEND);
+	// the pre-pass is left out, so with it on this is about 1 shaded sample per covered pixel
+	BeginShadedSamples();
+	{
+		PROFILE_ZONE("World list");
+		PROFILE_GPU_ZONE("World");
+		renderObjectList(RObj::worldList, false, GetOcclusionStats().active);
+		// the opaque world is all in the depth buffer now, the flashlight in the view list would hide everything behind it
+		CaptureOcclusionDepth();
+
+		glEnable(GL_BLEND);
+		glDepthMask(GL_FALSE);
+		renderTransparencyList();
+		transparencyList.clear();
+		glDepthMask(GL_TRUE);
+		glDisable(GL_BLEND);
+	}
 
 	// render debug physics
 	if (ALLOW_PHYSICS_DEBUG && renderDebugPhysics && debugPhysicsWorld) {
 		modelStack.Clear();
+		// vertex colored lines
+		UseShaderVariant(0);
 		glm::mat4 MVP = projectionStack.Top() * viewStack.Top() * modelStack.Top();
 		glUniformMatrix4fv(m_parameters[U_MVP], 1, GL_FALSE, glm::value_ptr(MVP));
 
@@ -653,14 +847,22 @@ void SceneDemo::Render() {
 	viewStack.PushMatrix();
 	viewStack.LoadIdentity();
 
-	renderObjectList(RObj::viewList);
+	{
+		PROFILE_ZONE("View list");
+		PROFILE_GPU_ZONE("View");
+		renderObjectList(RObj::viewList);
+
+		glEnable(GL_BLEND);
+		glDepthMask(GL_FALSE);
+		renderTransparencyList();
+		transparencyList.clear();
+		glDepthMask(GL_TRUE);
+		glDisable(GL_BLEND);
+	}
+	EndShadedSamples();
 
-	glEnable(GL_BLEND);
-	glDepthMask(GL_FALSE);
-	renderTransparencyList();
-	transparencyList.clear();
-	glDepthMask(GL_TRUE);
-	glDisable(GL_BLEND);
+	// HDR scene onto the screen, the UI below is drawn at full resolution after the tone map
+	ResolveScene();
 
 
 	glDisable(GL_DEPTH_TEST);
@@ -668,12 +870,16 @@ void SceneDemo::Render() {
 	projectionStack.PushMatrix();
 	projectionStack.LoadMatrix(ortho);
 
-	glEnable(GL_BLEND);
-	glDepthMask(GL_FALSE);
-	RObj::SortScreenList();
-	renderObjectList(RObj::screenList, true);
-	glDepthMask(GL_TRUE);
-	glDisable(GL_BLEND);
+	{
+		PROFILE_ZONE("Screen list");
+		PROFILE_GPU_ZONE("Screen");
+		glEnable(GL_BLEND);
+		glDepthMask(GL_FALSE);
+		RObj::SortScreenList();
+		renderObjectList(RObj::screenList, true);
+		glDepthMask(GL_TRUE);
+		glDisable(GL_BLEND);
+	}
 
 	projectionStack.PopMatrix();
 	viewStack.PopMatrix();
@@ -686,6 +892,8 @@ void SceneDemo::Render() {
 void SceneDemo::Exit() {
 	BaseScene::Exit();
 
+	uiAtlas.Release();
+
 
 }
 
@@ -711,6 +919,10 @@ void SceneDemo::HandleKeyPress() {
 	// debug keys
 	if (KeyboardController::GetInstance()->IsKeyPressed(GLFW_KEY_GRAVE_ACCENT)) {
 		debug = !debug;
+		// the sample query and the latency wait only run while the numbers are on screen
+		SetCountShadedSamples(debug);
+		InputQueue::GetInstance().SetMeasureLatency(debug);
+		InputQueue::GetInstance().ResetLatency();
 		renderDebugPhysics = false;
 		camera.Set(Cam::MODE::FIRST_PERSON);
 		player.allowControl = true;
@@ -730,6 +942,69 @@ void SceneDemo::HandleKeyPress() {
 		if (KeyboardController::GetInstance()->IsKeyPressed(GLFW_KEY_P)) {
 			renderDebugPhysics = !renderDebugPhysics;
 		}
+
+		if (KeyboardController::GetInstance()->IsKeyPressed(GLFW_KEY_X)) {
+			SetDepthPrePass(!GetDepthPrePass());
+			Print(std::string("SceneDemo: depth pre-pass ") + (GetDepthPrePass() ? "on" : "off"), 1);
+		}
+
+		// none, MSAA, FXAA, back to none
+		if (KeyboardController::GetInstance()->IsKeyPressed(GLFW_KEY_M)) {
+			PostProcess::Settings settings = GetPostProcessSettings();
+			settings.antiAliasing = static_cast<PostProcess::ANTI_ALIASING>((settings.antiAliasing + 1) % PostProcess::AA_TOTAL);
+			SetPostProcessSettings(settings);
+			Print(std::string("SceneDemo: anti-aliasing ") + PostProcess::GetAntiAliasingName(settings.antiAliasing), 1);
+		}
+		if (KeyboardController::GetInstance()->IsKeyPressed(GLFW_KEY_B)) {
+			PostProcess::Settings settings = GetPostProcessSettings();
+			settings.bloom = !settings.bloom;
+			SetPostProcessSettings(settings);
+			Print(std::string("SceneDemo: bloom ") + (settings.bloom ? "on" : "off"), 1);
+		}
+		if (KeyboardController::GetInstance()->IsKeyPressed(GLFW_KEY_N)) {
+			PostProcess::Settings settings = GetPostProcessSettings();
+			settings.dynamicResolution = !settings.dynamicResolution;
+			SetPostProcessSettings(settings);
+			Print(std::string("SceneDemo: dynamic resolution ") + (settings.dynamicResolution ? "on" : "off"), 1);
+		}
+
+		if (KeyboardController::GetInstance()->IsKeyPressed(GLFW_KEY_K)) {
+			SetMeshLod(!GetMeshLod());
+			Print(std::string("SceneDemo: mesh lod ") + (GetMeshLod() ? "on" : "off"), 1);
+		}
+		// off, gpu, cpu, back to off
+		if (KeyboardController::GetInstance()->IsKeyPressed(GLFW_KEY_O)) {
+			SetOcclusionMode(static_cast<OcclusionCuller::MODE>((GetOcclusionMode() + 1) % OcclusionCuller::MODE_TOTAL));
+			Print(std::string("SceneDemo: occlusion culling ") + OcclusionCuller::GetModeName(GetOcclusionMode()), 1);
+		}
+
+		// high, medium, low, vertex, back to high
+		if (KeyboardController::GetInstance()->IsKeyPressed(GLFW_KEY_L)) {
+			SetShadingQuality(static_cast<SHADING_QUALITY>((GetShadingQuality() + 1) % SHADING_QUALITY_TOTAL));
+			Print(std::string("SceneDemo: shading quality ") + GetShadingQualityName(GetShadingQuality()), 1);
+		}
+
+#ifdef ENABLE_PROFILER
+		if (KeyboardController::GetInstance()->IsKeyPressed(GLFW_KEY_T)) {
+			Profiler::GetInstance().ExportChromeTrace("profile.json");
+		}
+#endif
+
+		// the recording replays with Benchmark --replay input_recording.txt
+		if (KeyboardController::GetInstance()->IsKeyPressed(GLFW_KEY_R)) {
+			InputQueue& input = InputQueue::GetInstance();
+			if (!input.IsRecording()) {
+				input.StartRecording();
+				Print("SceneDemo: recording input", 1);
+			}
+			else {
+				input.StopRecording();
+				if (input.SaveRecording("input_recording.txt"))
+					Print("SceneDemo: " + std::to_string(input.GetRecording().size()) + " input events saved to input_recording.txt", 1);
+				else
+					Error("SceneDemo: Impossible to open input_recording.txt");
+			}
+		}
 	}
 
 	if (KeyboardController::GetInstance()->IsKeyPressed(GLFW_KEY_LEFT_ALT)) {
@@ -851,7 +1126,7 @@ void SceneDemo::HandleKeyPress() {
 /*********************************************************************************************************************************************************************************/
 
 
-void SceneDemo::RenderObj(const std::shared_ptr<RObj> obj) {
+void SceneDemo::RenderObj(const std::shared_ptr<RObj>& obj) {
 
 	if (!obj->allowRender)
 		return;
@@ -866,6 +1141,8 @@ void SceneDemo::RenderObj(const std::shared_ptr<RObj> obj) {
 	}
 
 	if (auto textObj = std::dynamic_pointer_cast<TextObject>(obj)) {
+		PROFILE_ZONE("Text");
+		MEMORY_TAG(MemoryTracker::TEXT);
 		modelStack.PushMatrix();
 
 		const auto& text = textObj->text;
@@ -873,13 +1150,10 @@ void SceneDemo::RenderObj(const std::shared_ptr<RObj> obj) {
 
 		glDisable(GL_CULL_FACE);
 
-		glUniform1i(m_parameters[U_TEXT_ENABLED], 1);
+		UseShaderVariant(ShaderVariants::TEXT);
 		glUniform3fv(m_parameters[U_TEXT_COLOR], 1, &textObj->color.r);
-		glUniform1i(m_parameters[U_COLOR_TEXTURE_ENABLED], 1);
 
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, mesh->textureID);
-		glUniform1i(m_parameters[U_COLOR_TEXTURE], 0);
+		BindTexture(mesh->textureID);
 
 		// offset
 		float spacing = FontSpacing(static_cast<GEOMETRY_TYPE>(textObj->geometryType));
@@ -898,31 +1172,36 @@ void SceneDemo::RenderObj(const std::shared_ptr<RObj> obj) {
 		if (cullFaceActive)
 			glEnable(GL_CULL_FACE);
 
-		glBindTexture(GL_TEXTURE_2D, 0);
-		glUniform1i(m_parameters[U_TEXT_ENABLED], 0);
-
 		modelStack.PopMatrix();
 	}
 	else {
-		RenderMesh(static_cast<GEOMETRY_TYPE>(obj->geometryType), enableLight);
+		unsigned shadingLod = 0;
+		if (enableLight) {
+			shadingLod = GetShadingLod(meshList[obj->geometryType], viewStack.Top() * modelStack.Top());
+			CountShadingLod(shadingLod);
+		}
+		RenderMesh(static_cast<GEOMETRY_TYPE>(obj->geometryType), enableLight, shadingLod, obj->material.type == Material::NEON ? 1.f : 0.f, obj->lodLevel);
 	}
 
 	meshList[obj->geometryType]->material = meshMaterial;
 
 }
 
-void SceneDemo::RenderMesh(GEOMETRY_TYPE type, bool enableLight) {
+void SceneDemo::RenderMesh(GEOMETRY_TYPE type, bool enableLight, unsigned shadingLod, float bloom, unsigned meshLod) {
 
 	Mesh* mesh = meshList[static_cast<int>(type)];
+	UseShaderVariant(GetShaderVariant(mesh, enableLight, shadingLod));
+
 	glm::mat4 MVP, modelView, modelView_inverse_transpose;
 	MVP = projectionStack.Top() * viewStack.Top() * modelStack.Top();
 	glUniformMatrix4fv(m_parameters[U_MVP], 1, GL_FALSE, glm::value_ptr(MVP));
 	modelView = viewStack.Top() * modelStack.Top();
 	glUniformMatrix4fv(m_parameters[U_MODELVIEW], 1, GL_FALSE, glm::value_ptr(modelView));
+	// every draw sets it, the programs are shared between glowing and plain meshes
+	glUniform1f(m_parameters[U_BLOOM], bloom);
 
 	if (enableLight)
 	{
-		glUniform1i(m_parameters[U_LIGHT_ENABLED], 1);
 		modelView_inverse_transpose = glm::inverseTranspose(modelView);
 		glUniformMatrix4fv(m_parameters[U_MODELVIEW_INVERSE_TRANSPOSE], 1, GL_FALSE, glm::value_ptr(modelView_inverse_transpose));
 
@@ -932,34 +1211,38 @@ void SceneDemo::RenderMesh(GEOMETRY_TYPE type, bool enableLight) {
 		glUniform3fv(m_parameters[U_MATERIAL_SPECULAR], 1, &mesh->material.kSpecular.r);
 		glUniform1f(m_parameters[U_MATERIAL_SHININESS], mesh->material.kShininess);
 	}
-	else
-	{
-		glUniform1i(m_parameters[U_LIGHT_ENABLED], 0);
-	}
 
 	if (mesh->textureID > 0)
-	{
-		glUniform1i(m_parameters[U_COLOR_TEXTURE_ENABLED], 1);
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, mesh->textureID);
-		glUniform1i(m_parameters[U_COLOR_TEXTURE], 0);
-	}
-	else
-	{
-		glUniform1i(m_parameters[U_COLOR_TEXTURE_ENABLED], 0);
-	}
+		BindTexture(mesh->textureID);
+
+	CountMeshLod(meshLod);
+	mesh->RenderLod(meshLod);
+}
 
-	mesh->Render();
+unsigned SceneDemo::GetShaderVariant(const std::shared_ptr<RObj>& obj, const mat4& model) const {
+	if (std::dynamic_pointer_cast<TextObject>(obj))
+		return ShaderVariants::TEXT | ShaderVariants::COLOR_TEXTURE;
+
+	bool enableLight = obj->material.type != Material::NO_LIGHT && obj->renderType != RObj::SCREEN;
+	const Mesh* mesh = meshList[obj->geometryType];
+	unsigned shadingLod = enableLight ? GetShadingLod(mesh, viewStack.Top() * model) : 0;
+	return GetShaderVariant(mesh, enableLight, shadingLod);
+}
 
+unsigned SceneDemo::GetShaderVariant(const Mesh* mesh, bool enableLight, unsigned shadingLod) const {
+	unsigned mask = 0;
+	if (enableLight)
+		mask |= ShaderVariants::LIGHTING | shadingLod;
+	if (enableLight && enabledAtmosphere)
+		mask |= ShaderVariants::ATMOSPHERE;
 	if (mesh->textureID > 0)
-	{
-		glBindTexture(GL_TEXTURE_2D, 0);
-	}
+		mask |= ShaderVariants::COLOR_TEXTURE;
+	return ShaderVariants::Normalize(mask);
 }
 
 void SceneDemo::InitDebugText(GEOMETRY_TYPE font) {
 	auto& newObj = RObj::newObject;
-	for (int i = 0; i < 10; i++) {
+	for (int i = 0; i < 16; i++) {
 		screenRoot->NewChild(TextObject::Create("_debugtxt_" + std::to_string(i), "", vec3(0, 1, 0), font, false, 99));
 		newObj->relativeTrl = true;
 		newObj->trl = vec3(-0.98f, 0.95f - i * 0.05f, 0);
@@ -988,6 +1271,34 @@ bool SceneDemo::AddDebugText(const std::string& text, int index) {
 	return true;
 }
 
+bool SceneDemo::AddDebugTextF(const char* format, ...) {
+	va_list args;
+	va_start(args, format);
+	va_list sizeArgs;
+	va_copy(sizeArgs, args);
+	int length = std::vsnprintf(nullptr, 0, format, sizeArgs);
+	va_end(sizeArgs);
+	if (length < 0) {
+		va_end(args);
+		return false;
+	}
+
+	char* text = FrameArena::GetInstance().Allocate<char>(length + 1);
+	std::vsnprintf(text, length + 1, format, args);
+	va_end(args);
+
+	for (auto& obj_weak : debugTextList) {
+		auto textObj = std::static_pointer_cast<TextObject>(obj_weak.lock());
+
+		if (textObj->text.empty()) {
+			// ClearDebugText() keeps the capacity, so after the first frames this copy does not allocate either
+			textObj->text.assign(text, length);
+			return true;
+		}
+	}
+	return false;
+}
+
 void SceneDemo::ClearDebugText() {
 	for (auto& obj_weak : debugTextList)
 		std::dynamic_pointer_cast<TextObject>(obj_weak.lock())->text = "";
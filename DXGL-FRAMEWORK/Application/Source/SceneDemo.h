@@ -2,6 +2,7 @@
 #define SCENE_DEMO_H
 
 #include "BaseScene.h"
+#include "TextureAtlas.h"
 
 
 class SceneDemo : public BaseScene
@@ -21,6 +22,10 @@ public:
 
 		// add more variables here
 		FLASHLIGHT,
+		// 360 slice frustum, the mesh LOD showcase
+		PILLAR,
+		// unit cube to be scaled into walls, an occluder for OcclusionCuller's cpu mode
+		WALL,
 
 		UI_TEST,
 		UI_TEST_2,
@@ -57,8 +62,15 @@ private:
 
 	void HandleKeyPress();
 
-	void RenderMesh(GEOMETRY_TYPE type, bool enableLight);
-	void RenderObj(const std::shared_ptr<RenderObject> obj);
+	// | shadingLod : BaseScene::GetShadingLod() of the mesh, only used when enableLight
+	// | bloom : 1 to glow, see PostProcess
+	// | meshLod : Mesh::RenderLod() level, BaseScene::SelectLod() of the object
+	void RenderMesh(GEOMETRY_TYPE type, bool enableLight, unsigned shadingLod = 0, float bloom = 0, unsigned meshLod = 0);
+	void RenderObj(const std::shared_ptr<RenderObject>& obj);
+	// ShaderVariants mask RenderObj() / RenderMesh() will use, normalized
+	// | model : the matrix obj is drawn with, picks its shading LOD
+	unsigned GetShaderVariant(const std::shared_ptr<RenderObject>& obj, const glm::mat4& model) const;
+	unsigned GetShaderVariant(const Mesh* mesh, bool enableLight, unsigned shadingLod = 0) const;
 
 	// debug
 	bool debug = false;
@@ -69,6 +81,8 @@ private:
 	// returns success
 	// does not work in Init()
 	bool AddDebugText(const std::string& text, int index = -1);
+	// printf style, formats into the frame arena instead of building temporary strings
+	bool AddDebugTextF(const char* format, ...);
 	void ClearDebugText();
 
 	bool cullFaceActive = true;
@@ -77,6 +91,9 @@ private:
 	bool renderDebugPhysics = false;
 	Mesh* debugPhysicsWorld;
 	double debugPhysicsTimer = 0;
+	float avgFps = 0;
+
+	TextureAtlas uiAtlas{ "ui" };
 	
 };
 
@@ -0,0 +1,102 @@
+#include "ShaderVariants.h"
+
+#include <GL/glew.h>
+
+#include <chrono>
+
+#include "shader.hpp"
+#include "Console.h"
+
+ShaderVariants::~ShaderVariants() {
+	for (unsigned programID : programs) {
+		if (programID != 0) {
+			Error("ShaderVariants: destroyed without Release(), its programs leaked");
+			break;
+		}
+	}
+}
+
+bool ShaderVariants::Load(const char* vertex_file_path, const char* fragment_file_path, const char* cacheDirectory) {
+	Release();
+	stats = Stats();
+	ShaderLoadStats before = GetShaderLoadStats();
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	bool success = true;
+	for (unsigned variant : GetVariants()) {
+		std::string defines = GetDefines(variant);
+		GLuint programID = LoadShaders(vertex_file_path, fragment_file_path, defines.c_str(), cacheDirectory);
+		GLint linked = GL_FALSE;
+		if (programID != 0)
+			glGetProgramiv(programID, GL_LINK_STATUS, &linked);
+		if (linked != GL_TRUE) {
+			Error("ShaderVariants: variant " + std::to_string(variant) + " failed to build with\n" + defines);
+			if (programID != 0)
+				glDeleteProgram(programID);
+			success = false;
+			continue;
+		}
+		programs[variant] = programID;
+	}
+
+	const ShaderLoadStats& after = GetShaderLoadStats();
+	stats.compiled = after.compiled - before.compiled;
+	stats.cached = after.cached - before.cached;
+	stats.rejected = after.rejected - before.rejected;
+	stats.compileMs = after.compileMs - before.compileMs;
+	stats.loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	Print("ShaderVariants: " + std::to_string(GetVariants().size()) + " programs in " + std::to_string(stats.loadMs) + " ms, "
+		+ std::to_string(stats.compiled) + " compiled in " + std::to_string(stats.compileMs) + " ms, "
+		+ std::to_string(stats.cached) + " from cache, " + std::to_string(stats.rejected) + " stale binaries", 1);
+	return success;
+}
+
+void ShaderVariants::Release() {
+	for (unsigned& programID : programs) {
+		if (programID != 0)
+			glDeleteProgram(programID);
+		programID = 0;
+	}
+}
+
+const std::vector<unsigned>& ShaderVariants::GetVariants() {
+	static const std::vector<unsigned> variants = [] {
+		std::vector<unsigned> result;
+		for (unsigned mask = 0; mask < MASK_COUNT; mask++) {
+			if (Normalize(mask) == mask)
+				result.push_back(mask);
+		}
+		return result;
+	}();
+	return variants;
+}
+
+unsigned ShaderVariants::Normalize(unsigned mask) {
+	mask &= MASK_COUNT - 1;
+	// text is flat colored glyphs, the font texture only gives it alpha
+	if (mask & TEXT)
+		mask = TEXT | COLOR_TEXTURE;
+	// fog is mixed by how lit a fragment is, without lights there is nothing to mix, and nothing to shade cheaper either
+	if (!(mask & LIGHTING))
+		mask &= ~(ATMOSPHERE | REDUCED_SHADING | VERTEX_SHADING);
+	if (mask & VERTEX_SHADING)
+		mask &= ~REDUCED_SHADING;
+	return mask;
+}
+
+std::string ShaderVariants::GetDefines(unsigned mask) {
+	std::string defines;
+	if (mask & LIGHTING)
+		defines += "#define LIGHTING\n";
+	if (mask & COLOR_TEXTURE)
+		defines += "#define COLOR_TEXTURE\n";
+	if (mask & TEXT)
+		defines += "#define TEXT\n";
+	if (mask & ATMOSPHERE)
+		defines += "#define ATMOSPHERE\n";
+	if (mask & REDUCED_SHADING)
+		defines += "#define REDUCED_SHADING\n";
+	if (mask & VERTEX_SHADING)
+		defines += "#define VERTEX_SHADING\n";
+	return defines;
+}
@@ -0,0 +1,78 @@
+#ifndef SHADER_VARIANTS_H
+#define SHADER_VARIANTS_H
+
+#include <array>
+#include <string>
+#include <vector>
+
+/* how to use | ShaderVariants:
+* || setup, BaseScene does this in Init()
+* shaderVariants.Load("Shader//Texture.vertexshader", "Shader//Text_Atmospheric.fragmentshader", "ShaderCache"); // compiles or loads every variant once
+* for (unsigned variant : shaderVariants.GetVariants())
+*	glGetUniformLocation(shaderVariants.GetProgram(variant), "MVP"); // locations differ per program, look them up for each one
+*
+* || drawing
+* unsigned programID = shaderVariants.GetProgram(ShaderVariants::LIGHTING | ShaderVariants::COLOR_TEXTURE);
+* BaseScene::UseShaderVariant(mask) does the glUseProgram and swaps m_parameters, and skips both when the variant did not change
+*
+* notes:
+* - every FEATURE bit becomes a #define right after the #version line, the shader uses #ifdef instead of bool uniforms,
+*   so a variant never runs or branches over code for a feature it does not have
+* - Normalize() folds masks that would compile to the same program: TEXT implies COLOR_TEXTURE and drops LIGHTING,
+*   ATMOSPHERE and the shading LOD bits need LIGHTING, VERTEX_SHADING already has everything REDUCED_SHADING leaves out
+* - REDUCED_SHADING and VERTEX_SHADING are the cheaper shading LODs BaseScene::GetShadingLod() picks for small objects
+* - cacheDirectory goes to LoadShaders(), which keeps program binaries there, see shader.hpp
+*/
+
+class ShaderVariants {
+public:
+
+	enum FEATURE : unsigned {
+		LIGHTING = 1 << 0,
+		COLOR_TEXTURE = 1 << 1,
+		TEXT = 1 << 2,
+		ATMOSPHERE = 1 << 3,
+		// per pixel, diffuse only and the first SHADING_LOD_LIGHTS of the cluster's lights
+		REDUCED_SHADING = 1 << 4,
+		// Gouraud, lit per vertex with the same limits as REDUCED_SHADING and no shadows
+		VERTEX_SHADING = 1 << 5,
+	};
+	static constexpr unsigned MASK_COUNT = 1 << 6;
+
+	struct Stats {
+		unsigned compiled = 0;
+		// loaded from cacheDirectory without compiling
+		unsigned cached = 0;
+		// cached binaries of older sources or another driver, compiled again
+		unsigned rejected = 0;
+		double compileMs = 0;
+		// every variant, compiled and cached
+		double loadMs = 0;
+	};
+
+	ShaderVariants() = default;
+	~ShaderVariants();
+	ShaderVariants(const ShaderVariants&) = delete;
+	ShaderVariants& operator=(const ShaderVariants&) = delete;
+
+	// | cacheDirectory : created if missing, nullptr to always compile
+	// returns false if any variant failed to compile, the ones that did are still usable
+	bool Load(const char* vertex_file_path, const char* fragment_file_path, const char* cacheDirectory);
+	void Release();
+
+	unsigned GetProgram(unsigned mask) const { return programs[Normalize(mask)]; }
+	// every mask Normalize() can return, ascending
+	static const std::vector<unsigned>& GetVariants();
+	static unsigned Normalize(unsigned mask);
+	// "#define LIGHTING\n..." for the bits in mask
+	static std::string GetDefines(unsigned mask);
+
+	const Stats& GetStats() const { return stats; }
+
+private:
+
+	std::array<unsigned, MASK_COUNT> programs = {};
+	Stats stats;
+};
+
+#endif
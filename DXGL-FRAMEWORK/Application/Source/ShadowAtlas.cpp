@@ -0,0 +1,387 @@
+#include "ShadowAtlas.h"
+
+#include <GL/glew.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#include "Mesh.h"
+#include "Frustum.h"
+#include "shader.hpp"
+#include "Console.h"
+
+namespace {
+	// the cascade box is this much bigger than the frustum slice, the slack is what lets it stay put while the camera moves
+	const float CASCADE_PADDING = 1.25f;
+	// how far behind a cascade, towards the light, casters are still drawn into it
+	const float CASTER_EXTENT = 200.f;
+	// log / uniform blend of the cascade splits, 1 is fully logarithmic
+	const float SPLIT_LAMBDA = 0.75f;
+	const float SPOT_NEAR = 0.1f;
+	// spot lights without a range, e.g. no attenuation
+	const float SPOT_FAR = 200.f;
+	const float DEPTH_BIAS = 0.0002f;
+
+	uint64_t Hash(const void* data, size_t size, uint64_t hash) {
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		for (size_t i = 0; i < size; i++) {
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	glm::vec3 GetUp(const glm::vec3& direction) {
+		return std::abs(direction.y) > 0.99f ? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0);
+	}
+}
+
+ShadowAtlas::~ShadowAtlas() {
+	if (target.textureID != 0)
+		Error("ShadowAtlas: destroyed without Destroy(), its textures leaked");
+}
+
+void ShadowAtlas::Create(unsigned uniformBinding) {
+	Destroy();
+
+	CreateTarget(staticTarget, false);
+	CreateTarget(target, true);
+
+	programID = LoadShaders("Shader//Depth.vertexshader", "Shader//Depth.fragmentshader", "", "ShaderCache");
+	mvpLocation = glGetUniformLocation(programID, "MVP");
+
+	block.Create(uniformBinding);
+	float scale = 1.f / TILES_PER_ROW;
+	float halfTexel = 0.5f / ATLAS_SIZE;
+	for (unsigned i = 0; i < MAX_MAPS; i++) {
+		float x = (i % TILES_PER_ROW) * scale;
+		float y = (i / TILES_PER_ROW) * scale;
+		block.Set(block.Get().tileRects[i], glm::vec4(x + halfTexel, y + halfTexel, x + scale - halfTexel, y + scale - halfTexel));
+	}
+	block.Set(block.Get().parameters, glm::vec4(1.f / ATLAS_SIZE, DEPTH_BIAS, 0, 0));
+
+	casterStates.clear();
+	frame = 0;
+	Invalidate();
+}
+
+void ShadowAtlas::Destroy() {
+	DestroyTarget(staticTarget);
+	DestroyTarget(target);
+	if (programID != 0)
+		glDeleteProgram(programID);
+	programID = 0;
+	block.Destroy();
+}
+
+void ShadowAtlas::Invalidate() {
+	for (Tile& tile : tiles) {
+		tile.used = false;
+		tile.staticHash = 0;
+		tile.cascadeHalfSize = 0;
+	}
+}
+
+void ShadowAtlas::Bind(unsigned unit) const {
+	glActiveTexture(GL_TEXTURE0 + unit);
+	glBindTexture(GL_TEXTURE_2D, target.textureID);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+
+/********************************* render *********************************/
+
+void ShadowAtlas::Render(const glm::mat4& view, const glm::mat4& projection, std::vector<ShadowLight>& lights, const std::vector<Caster>& casters) {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	stats = Stats();
+	frame++;
+
+	UpdateCasterStates(casters);
+
+	// hand out tiles, lights that ask after the atlas is full go without
+	glm::mat4 inverseView = glm::inverse(view);
+	float nearDepth = projection[3][2] / (projection[2][2] - 1.f);
+	float farDepth = std::max(shadowDistance, nearDepth * 2);
+	glm::vec4 splits;
+	unsigned next = 0;
+	bool hasCascades = false;
+	for (ShadowLight& light : lights) {
+		light.slot = -1;
+		if (light.directional) {
+			if (hasCascades || next + SHADOW_CASCADES > MAX_MAPS)
+				continue;
+			hasCascades = true;
+			light.slot = next;
+
+			float previousSplit = nearDepth;
+			for (unsigned i = 0; i < SHADOW_CASCADES; i++) {
+				float t = static_cast<float>(i + 1) / SHADOW_CASCADES;
+				float split = SPLIT_LAMBDA * nearDepth * std::pow(farDepth / nearDepth, t) + (1 - SPLIT_LAMBDA) * (nearDepth + (farDepth - nearDepth) * t);
+				splits[i] = split;
+
+				Tile& tile = tiles[next];
+				if (!tile.used || tile.lightIndex != light.lightIndex)
+					tile.cascadeHalfSize = 0;
+				tile.used = true;
+				tile.lightIndex = light.lightIndex;
+				PlaceCascade(tile, inverseView, projection, previousSplit, split, glm::normalize(light.direction));
+				previousSplit = split;
+				next++;
+			}
+		}
+		else {
+			if (next >= MAX_MAPS)
+				continue;
+			light.slot = next;
+			Tile& tile = tiles[next];
+			tile.used = true;
+			tile.lightIndex = light.lightIndex;
+			tile.viewProjection = GetSpotViewProjection(light);
+			next++;
+		}
+	}
+	// a tile that comes back later has to be drawn from scratch
+	for (unsigned i = next; i < MAX_MAPS; i++) {
+		tiles[i].used = false;
+		tiles[i].staticHash = 0;
+	}
+	stats.maps = next;
+
+	for (unsigned char isStatic : casterStatic)
+		isStatic ? stats.staticCasters++ : stats.dynamicCasters++;
+
+	if (next > 0) {
+		// everything the scene had bound comes back at the end
+		GLint previousDraw = 0, previousRead = 0, previousProgram = 0;
+		GLint previousViewport[4];
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousDraw);
+		glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previousRead);
+		glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+		glGetIntegerv(GL_VIEWPORT, previousViewport);
+		GLboolean cullFace = glIsEnabled(GL_CULL_FACE);
+		GLboolean blend = glIsEnabled(GL_BLEND);
+
+		glUseProgram(programID);
+		// multi material meshes set their material per draw, the depth program has none
+		Mesh::SetMaterialLoc(static_cast<unsigned>(-1), static_cast<unsigned>(-1), static_cast<unsigned>(-1), static_cast<unsigned>(-1));
+		glEnable(GL_DEPTH_TEST);
+		glDepthMask(GL_TRUE);
+		glDepthFunc(GL_LESS);
+		// planes and open meshes cast from both sides
+		glDisable(GL_CULL_FACE);
+		glDisable(GL_BLEND);
+		glEnable(GL_POLYGON_OFFSET_FILL);
+		glPolygonOffset(2.f, 4.f);
+		// blits and clears stay inside the tile
+		glEnable(GL_SCISSOR_TEST);
+
+		for (unsigned i = 0; i < next; i++) {
+			Tile& tile = tiles[i];
+			GLint x = (i % TILES_PER_ROW) * TILE_SIZE;
+			GLint y = (i / TILES_PER_ROW) * TILE_SIZE;
+			glViewport(x, y, TILE_SIZE, TILE_SIZE);
+			glScissor(x, y, TILE_SIZE, TILE_SIZE);
+
+			// culling, and the hash of the static casters the tile would hold
+			Frustum frustum(tile.viewProjection);
+			visible.clear();
+			uint64_t staticHash = Hash(&tile.viewProjection, sizeof(tile.viewProjection), 14695981039346656037ull);
+			staticHash = Hash(&tile.lightIndex, sizeof(tile.lightIndex), staticHash);
+			bool hasDynamic = false;
+			for (unsigned c = 0; c < casters.size(); c++) {
+				const Caster& caster = casters[c];
+				if (!frustum.Intersects(caster.center, caster.radius)) {
+					stats.culled++;
+					continue;
+				}
+				visible.push_back(c);
+				if (casterStatic[c]) {
+					staticHash = Hash(&caster.id, sizeof(caster.id), staticHash);
+					staticHash = Hash(&caster.model[3], sizeof(caster.model[3]), staticHash);
+				}
+				else
+					hasDynamic = true;
+			}
+
+			bool redrawStatic = staticHash != tile.staticHash;
+			if (redrawStatic) {
+				glBindFramebuffer(GL_FRAMEBUFFER, staticTarget.framebufferID);
+				glClear(GL_DEPTH_BUFFER_BIT);
+				DrawCasters(tile, casters, true);
+				tile.staticHash = staticHash;
+				stats.staticRedraws++;
+			}
+
+			// the shader reads target, it already has the static casters unless they or last frame's dynamic ones changed it
+			if (redrawStatic || hasDynamic || tile.hadDynamic) {
+				glBindFramebuffer(GL_READ_FRAMEBUFFER, staticTarget.framebufferID);
+				glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target.framebufferID);
+				glBlitFramebuffer(x, y, x + TILE_SIZE, y + TILE_SIZE, x, y, x + TILE_SIZE, y + TILE_SIZE, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+				if (hasDynamic)
+					DrawCasters(tile, casters, false);
+			}
+			tile.hadDynamic = hasDynamic;
+
+			block.Set(block.Get().matrices[i], GetTileMatrix(i) * tile.viewProjection * inverseView);
+		}
+
+		glDisable(GL_SCISSOR_TEST);
+		glDisable(GL_POLYGON_OFFSET_FILL);
+		if (cullFace)
+			glEnable(GL_CULL_FACE);
+		if (blend)
+			glEnable(GL_BLEND);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, previousDraw);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, previousRead);
+		glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+		glUseProgram(previousProgram);
+	}
+
+	block.Set(block.Get().cascadeSplits, hasCascades ? splits : glm::vec4(0));
+	block.Upload();
+
+	stats.cpuMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void ShadowAtlas::DrawCasters(const Tile& tile, const std::vector<Caster>& casters, bool drawStatic) {
+	for (unsigned c : visible) {
+		if (static_cast<bool>(casterStatic[c]) != drawStatic)
+			continue;
+		const Caster& caster = casters[c];
+		glm::mat4 MVP = tile.viewProjection * caster.model;
+		glUniformMatrix4fv(mvpLocation, 1, GL_FALSE, glm::value_ptr(MVP));
+		caster.mesh->RenderLod(caster.lod);
+		drawStatic ? stats.staticDraws++ : stats.dynamicDraws++;
+	}
+}
+
+
+/********************************* helpers *********************************/
+
+void ShadowAtlas::UpdateCasterStates(const std::vector<Caster>& casters) {
+	casterStatic.resize(casters.size());
+	for (unsigned i = 0; i < casters.size(); i++) {
+		const Caster& caster = casters[i];
+		CasterState& state = casterStates[caster.id];
+		if (state.lastSeen == 0 || state.model != caster.model || state.lod != caster.lod) {
+			state.model = caster.model;
+			state.lod = caster.lod;
+			state.stillFrames = 0;
+		}
+		else if (state.stillFrames < STATIC_AFTER_FRAMES) {
+			state.stillFrames++;
+		}
+		state.lastSeen = frame;
+		casterStatic[i] = state.stillFrames >= STATIC_AFTER_FRAMES;
+	}
+
+	// objects that are gone, now and then so the map is not walked every frame
+	if (frame % 120 == 0) {
+		for (auto it = casterStates.begin(); it != casterStates.end(); ) {
+			if (it->second.lastSeen != frame)
+				it = casterStates.erase(it);
+			else
+				++it;
+		}
+	}
+}
+
+void ShadowAtlas::PlaceCascade(Tile& tile, const glm::mat4& inverseView, const glm::mat4& projection, float nearDepth, float farDepth, const glm::vec3& direction) {
+	// bounding sphere of this cascade's slice of the camera frustum, its size only depends on the projection so it does not swim
+	glm::vec3 corners[8];
+	float tanX = 1.f / projection[0][0];
+	float tanY = 1.f / projection[1][1];
+	glm::vec3 center(0);
+	for (unsigned i = 0; i < 8; i++) {
+		float depth = i < 4 ? nearDepth : farDepth;
+		glm::vec4 corner((i & 1 ? 1 : -1) * depth * tanX, (i & 2 ? 1 : -1) * depth * tanY, -depth, 1);
+		corners[i] = glm::vec3(inverseView * corner);
+		center += corners[i] / 8.f;
+	}
+	float radius = 0;
+	for (const glm::vec3& corner : corners)
+		radius = std::max(radius, glm::length(corner - center));
+	radius = std::ceil(radius * 16.f) / 16.f;
+
+	glm::mat4 lightRotation = glm::lookAt(glm::vec3(0), direction, GetUp(direction));
+	glm::vec3 sliceCenter = glm::vec3(lightRotation * glm::vec4(center, 1));
+	float halfSize = radius * CASCADE_PADDING;
+
+	bool inside = std::abs(sliceCenter.x - tile.cascadeCenter.x) + radius <= tile.cascadeHalfSize
+		&& std::abs(sliceCenter.y - tile.cascadeCenter.y) + radius <= tile.cascadeHalfSize
+		&& std::abs(sliceCenter.z - tile.cascadeCenter.z) + radius <= tile.cascadeHalfSize;
+	if (!inside || halfSize != tile.cascadeHalfSize || direction != tile.cascadeDirection) {
+		// whole texels, so a cascade that does move does not make the edges crawl
+		float texel = 2 * halfSize / TILE_SIZE;
+		tile.cascadeCenter = glm::vec3(std::floor(sliceCenter.x / texel) * texel, std::floor(sliceCenter.y / texel) * texel, sliceCenter.z);
+		tile.cascadeHalfSize = halfSize;
+		tile.cascadeDirection = direction;
+	}
+
+	const glm::vec3& c = tile.cascadeCenter;
+	float h = tile.cascadeHalfSize;
+	// light space looks down -z, the box reaches CASTER_EXTENT further towards the light for casters outside the view
+	glm::mat4 ortho = glm::ortho(c.x - h, c.x + h, c.y - h, c.y + h, -(c.z + h + CASTER_EXTENT), -(c.z - h));
+	tile.viewProjection = ortho * lightRotation;
+}
+
+glm::mat4 ShadowAtlas::GetSpotViewProjection(const ShadowLight& light) {
+	glm::vec3 direction = glm::normalize(light.direction);
+	glm::mat4 view = glm::lookAt(light.position, light.position + direction, GetUp(direction));
+	// a little wider than the cone so the filter taps at its edge still land on the map
+	float fov = std::min(glm::radians(light.coneAngle) * 1.1f, glm::radians(170.f));
+	float range = light.range > SPOT_NEAR ? light.range : SPOT_FAR;
+	return glm::perspective(fov, 1.f, SPOT_NEAR, range) * view;
+}
+
+glm::mat4 ShadowAtlas::GetTileMatrix(unsigned tile) {
+	// clip space to the tile's part of the atlas, depth to 0 - 1
+	float scale = 1.f / TILES_PER_ROW;
+	float x = (tile % TILES_PER_ROW + 0.5f) * scale;
+	float y = (tile / TILES_PER_ROW + 0.5f) * scale;
+	return glm::translate(glm::mat4(1), glm::vec3(x, y, 0.5f)) * glm::scale(glm::mat4(1), glm::vec3(0.5f * scale, 0.5f * scale, 0.5f));
+}
+
+void ShadowAtlas::CreateTarget(Target& renderTarget, bool comparison) {
+	glGenTextures(1, &renderTarget.textureID);
+	glBindTexture(GL_TEXTURE_2D, renderTarget.textureID);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, ATLAS_SIZE, ATLAS_SIZE, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	if (comparison) {
+		// sampler2DShadow, linear filtering compares 4 texels for free
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	}
+	else {
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenFramebuffers(1, &renderTarget.framebufferID);
+	glBindFramebuffer(GL_FRAMEBUFFER, renderTarget.framebufferID);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, renderTarget.textureID, 0);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		Error("ShadowAtlas: depth framebuffer is incomplete");
+	// every tile starts out as far away as it gets
+	glClear(GL_DEPTH_BUFFER_BIT);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void ShadowAtlas::DestroyTarget(Target& renderTarget) {
+	if (renderTarget.framebufferID != 0)
+		glDeleteFramebuffers(1, &renderTarget.framebufferID);
+	if (renderTarget.textureID != 0)
+		glDeleteTextures(1, &renderTarget.textureID);
+	renderTarget = Target();
+}
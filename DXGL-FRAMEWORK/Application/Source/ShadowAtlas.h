@@ -0,0 +1,174 @@
+#ifndef SHADOW_ATLAS_H
+#define SHADOW_ATLAS_H
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "UniformBuffer.h"
+
+class Mesh;
+
+/* how to use | ShadowAtlas:
+* || setup, BaseScene does this in Init()
+* shadowAtlas.Create(UBO_SHADOW); // atlas textures, framebuffers, the depth-only program and the ShadowBlock uniform block
+* UniformBuffer::BindBlock(programID, "ShadowBlock", UBO_SHADOW);
+* glUniform1i(glGetUniformLocation(programID, "shadowAtlas"), SHADOW_ATLAS_UNIT);
+*
+* || every frame, BaseScene::Render() before anything is drawn
+* std::vector<ShadowAtlas::ShadowLight> lights; // Light::castShadows lights, directional and spot only
+* std::vector<ShadowAtlas::Caster> casters; // world space bounding spheres of everything that may cast
+* shadowAtlas.Render(view, projection, lights, casters); // fills lights[i].slot, -1 if it got no map
+* shadowAtlas.Bind(SHADOW_ATLAS_UNIT);
+*
+* notes:
+* - 1 depth atlas of TILES_PER_ROW * TILES_PER_ROW tiles, the first directional light takes SHADOW_CASCADES tiles, every spot light 1,
+*   lights past the last free tile get no shadows
+* - casters that have not moved for STATIC_AFTER_FRAMES frames are static, they are drawn into a second atlas that is only redrawn
+*   when a tile's light, its cascade placement or its set of static casters changes,
+*   every frame that tile is copied over and only the dynamic casters are drawn on top
+* - cascades only move when the camera's slice of the frustum leaves them, so walking around does not redraw the static atlas every frame
+* - every caster is culled against each tile's frustum before it is drawn
+* - plain GL 3.3, depth textures, blits and sampler2DShadow, so it also runs on llvmpipe
+*/
+
+class ShadowAtlas {
+public:
+
+	static constexpr unsigned ATLAS_SIZE = 2048;
+	static constexpr unsigned TILES_PER_ROW = 4;
+	static constexpr unsigned TILE_SIZE = ATLAS_SIZE / TILES_PER_ROW;
+	static constexpr unsigned MAX_MAPS = TILES_PER_ROW * TILES_PER_ROW;
+	static constexpr unsigned SHADOW_CASCADES = 3;
+	static constexpr unsigned STATIC_AFTER_FRAMES = 30;
+
+	struct ShadowLight {
+		// only used to tell lights apart between frames
+		unsigned lightIndex;
+		bool directional;
+		glm::vec3 position;
+		// the way the light travels, world space
+		glm::vec3 direction;
+		// spot only, full cone angle in degrees and distance the light reaches
+		float coneAngle;
+		float range;
+		// out, first tile of this light, cascades take the tiles after it
+		int slot = -1;
+	};
+
+	struct Caster {
+		// stays the same for the same object every frame, its address is fine
+		const void* id;
+		Mesh* mesh;
+		glm::mat4 model;
+		// world space bounding sphere
+		glm::vec3 center;
+		float radius;
+		// Mesh::RenderLod() level, a change redraws the tiles it was cached in
+		unsigned lod = 0;
+	};
+
+	struct Stats {
+		unsigned maps = 0;
+		unsigned staticCasters = 0;
+		unsigned dynamicCasters = 0;
+		// tiles whose static casters were drawn again this frame
+		unsigned staticRedraws = 0;
+		unsigned staticDraws = 0;
+		unsigned dynamicDraws = 0;
+		// caster and tile pairs skipped by the frustum test
+		unsigned culled = 0;
+		double cpuMs = 0;
+	};
+
+	// std140 copy of ShadowBlock in Text_Atmospheric.fragmentshader
+	struct ShadowBlock {
+		// camera space to atlas uv and depth
+		glm::mat4 matrices[MAX_MAPS];
+		// min uv, max uv of each tile, inset by half a texel so filtering never reads the next tile
+		glm::vec4 tileRects[MAX_MAPS];
+		// far view depth of every cascade
+		glm::vec4 cascadeSplits;
+		// 1 / ATLAS_SIZE, depth bias
+		glm::vec4 parameters;
+	};
+	static_assert(sizeof(ShadowBlock) == (64 + 16) * MAX_MAPS + 32, "ShadowBlock does not match the std140 ShadowBlock");
+
+	ShadowAtlas() = default;
+	~ShadowAtlas();
+	ShadowAtlas(const ShadowAtlas&) = delete;
+	ShadowAtlas& operator=(const ShadowAtlas&) = delete;
+
+	void Create(unsigned uniformBinding);
+	void Destroy();
+
+	// | projection : the camera's perspective projection, cascades split its near plane to shadowDistance
+	// leaves the framebuffer, viewport and program that were bound before, but not the program's uniforms
+	void Render(const glm::mat4& view, const glm::mat4& projection, std::vector<ShadowLight>& lights, const std::vector<Caster>& casters);
+	// leaves GL_TEXTURE0 active
+	void Bind(unsigned unit) const;
+
+	// cascades cover the camera frustum up to this view depth, past it directional lights do not shadow
+	void SetShadowDistance(float distance) { shadowDistance = distance; }
+	float GetShadowDistance() const { return shadowDistance; }
+	// forget the cached static atlas, e.g. after loading a level
+	void Invalidate();
+
+	const Stats& GetStats() const { return stats; }
+
+private:
+
+	struct Target {
+		unsigned textureID = 0;
+		unsigned framebufferID = 0;
+	};
+
+	struct Tile {
+		bool used = false;
+		unsigned lightIndex = 0;
+		glm::mat4 viewProjection;
+		uint64_t staticHash = 0;
+		bool hadDynamic = false;
+		// cascades only, light space placement kept between frames
+		glm::vec3 cascadeCenter;
+		float cascadeHalfSize = 0;
+		glm::vec3 cascadeDirection;
+	};
+
+	struct CasterState {
+		glm::mat4 model;
+		unsigned lod = 0;
+		unsigned stillFrames = 0;
+		unsigned long long lastSeen = 0;
+	};
+
+	// static casters are drawn into staticTarget, copied into target, then dynamic casters go on top, target is what the shader reads
+	Target staticTarget, target;
+	unsigned programID = 0;
+	int mvpLocation = -1;
+
+	UniformBlock<ShadowBlock> block;
+	float shadowDistance = 120.f;
+
+	Tile tiles[MAX_MAPS];
+	std::unordered_map<const void*, CasterState> casterStates;
+	unsigned long long frame = 0;
+
+	// reused every frame
+	std::vector<unsigned char> casterStatic;
+	std::vector<unsigned> visible;
+
+	Stats stats;
+
+	void CreateTarget(Target& renderTarget, bool comparison);
+	void DestroyTarget(Target& renderTarget);
+	void UpdateCasterStates(const std::vector<Caster>& casters);
+	void PlaceCascade(Tile& tile, const glm::mat4& inverseView, const glm::mat4& projection, float nearDepth, float farDepth, const glm::vec3& direction);
+	static glm::mat4 GetSpotViewProjection(const ShadowLight& light);
+	static glm::mat4 GetTileMatrix(unsigned tile);
+	void DrawCasters(const Tile& tile, const std::vector<Caster>& casters, bool drawStatic);
+};
+
+#endif
@@ -0,0 +1,292 @@
+#include "TextureAtlas.h"
+
+#include <GL/glew.h>
+
+#include <fstream>
+#include <algorithm>
+
+#include <nlohmann/json.hpp>
+
+#include "ResourceManager.h"
+#include "Console.h"
+
+using nlohmann::json;
+
+TextureAtlas::TextureAtlas(const std::string& name) : name(name)
+{
+}
+
+TextureAtlas::~TextureAtlas()
+{
+	Release();
+}
+
+bool TextureAtlas::Add(const std::string& regionName, const char* file_path)
+{
+	PendingImage pending;
+	pending.regionName = regionName;
+	if (!TextureLoader::DecodeImage(file_path, pending.image))
+		return false;
+
+	pendingImages.push_back(std::move(pending));
+	return true;
+}
+
+bool TextureAtlas::Build(unsigned maxSize, unsigned padding)
+{
+	if (pendingImages.empty()) {
+		Error("TextureAtlas::Build(): nothing to pack in " + name);
+		return false;
+	}
+
+	// smallest power of 2 square that fits, then halve the height if the bottom half is unused
+	std::vector<glm::uvec2> positions;
+	unsigned size = 64;
+	while (!Pack(size, padding, positions)) {
+		size *= 2;
+		if (size > maxSize) {
+			Error("TextureAtlas::Build(): images in " + name + " do not fit in " + std::to_string(maxSize) + "x" + std::to_string(maxSize));
+			return false;
+		}
+	}
+	width = size;
+	height = size;
+	unsigned usedHeight = 0;
+	for (unsigned i = 0; i < pendingImages.size(); i++)
+		usedHeight = std::max(usedHeight, positions[i].y + pendingImages[i].image.height + padding);
+	while (height > 64 && usedHeight <= height / 2)
+		height /= 2;
+
+	packedPixels.assign(static_cast<size_t>(width) * height * 4, 0);
+	regions.clear();
+
+	for (unsigned i = 0; i < pendingImages.size(); i++) {
+		const TextureLoader::Image& image = pendingImages[i].image;
+		glm::uvec2 position = positions[i];
+
+		// copy with the border pixels repeated into the padding, clamped so the padding never leaves the atlas
+		int x0 = static_cast<int>(position.x) - static_cast<int>(padding);
+		int y0 = static_cast<int>(position.y) - static_cast<int>(padding);
+		int x1 = static_cast<int>(position.x + image.width + padding);
+		int y1 = static_cast<int>(position.y + image.height + padding);
+		for (int y = std::max(y0, 0); y < std::min(y1, static_cast<int>(height)); y++) {
+			int srcY = glm::clamp(y - static_cast<int>(position.y), 0, static_cast<int>(image.height) - 1);
+			for (int x = std::max(x0, 0); x < std::min(x1, static_cast<int>(width)); x++) {
+				int srcX = glm::clamp(x - static_cast<int>(position.x), 0, static_cast<int>(image.width) - 1);
+				const unsigned char* src = &image.pixels[(static_cast<size_t>(srcY) * image.width + srcX) * 4];
+				unsigned char* dst = &packedPixels[(static_cast<size_t>(y) * width + x) * 4];
+				std::copy(src, src + 4, dst);
+			}
+		}
+
+		Region& region = regions[pendingImages[i].regionName];
+		region.offset = glm::vec2(position) / glm::vec2(width, height);
+		region.scale = glm::vec2(image.width, image.height) / glm::vec2(width, height);
+	}
+	pendingImages.clear();
+
+	Release();
+	textureID = Upload(packedPixels.data());
+	// a taken key leaves the texture unmanaged, and Release() would not be the only one deleting it
+	if (!ResourceManager::GetInstance().AddTexture("atlas:" + name, textureID)) {
+		Error("TextureAtlas::Build(): atlas:" + name + " is still used by another atlas, atlas names have to be unique");
+		glDeleteTextures(1, &textureID);
+		textureID = 0;
+		return false;
+	}
+
+	Print("TextureAtlas: packed " + std::to_string(regions.size()) + " images into " + name + " (" + std::to_string(width) + "x" + std::to_string(height) + ")\n");
+	return textureID != 0;
+}
+
+bool TextureAtlas::Pack(unsigned size, unsigned padding, std::vector<glm::uvec2>& out_positions) const
+{
+	// shelf packing, tallest first so each shelf wastes as little height as possible
+	std::vector<unsigned> order(pendingImages.size());
+	for (unsigned i = 0; i < order.size(); i++)
+		order[i] = i;
+	std::sort(order.begin(), order.end(), [this](unsigned a, unsigned b) {
+		return pendingImages[a].image.height > pendingImages[b].image.height;
+		});
+
+	out_positions.assign(pendingImages.size(), glm::uvec2(0));
+	unsigned shelfX = 0, shelfY = 0, shelfHeight = 0;
+
+	for (unsigned i : order) {
+		unsigned paddedWidth = pendingImages[i].image.width + padding * 2;
+		unsigned paddedHeight = pendingImages[i].image.height + padding * 2;
+		if (paddedWidth > size)
+			return false;
+
+		if (shelfX + paddedWidth > size) {
+			shelfY += shelfHeight;
+			shelfX = 0;
+			shelfHeight = 0;
+		}
+		if (shelfY + paddedHeight > size)
+			return false;
+
+		out_positions[i] = glm::uvec2(shelfX + padding, shelfY + padding);
+		shelfX += paddedWidth;
+		shelfHeight = std::max(shelfHeight, paddedHeight);
+	}
+	return true;
+}
+
+unsigned TextureAtlas::Upload(const unsigned char* pixels) const
+{
+	GLuint texture = 0;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	glGenerateMipmap(GL_TEXTURE_2D);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	// regions are not allowed to repeat, and clamping keeps the edges of the atlas from sampling the other side
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	float maxAnisotropy = 1.f;
+	glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &maxAnisotropy);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, (GLint)maxAnisotropy);
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+	return texture;
+}
+
+bool TextureAtlas::Save(const char* image_path, const char* manifest_path) const
+{
+	if (packedPixels.empty()) {
+		Error("TextureAtlas::Save(): " + name + " has not been built");
+		return false;
+	}
+
+	std::string imagePath = TextureLoader::GetDirectory() + image_path;
+	std::ofstream imageStream(imagePath, std::ios::binary);
+	if (!imageStream.is_open()) {
+		Error("TextureAtlas::Save(): Impossible to open " + imagePath);
+		return false;
+	}
+
+	// uncompressed 32 bit TGA, bottom left origin so the rows can be written as they are
+	unsigned char header[18] = {};
+	header[2] = 2;
+	header[12] = width & 0xFF;
+	header[13] = (width >> 8) & 0xFF;
+	header[14] = height & 0xFF;
+	header[15] = (height >> 8) & 0xFF;
+	header[16] = 32;
+	header[17] = 8;
+	imageStream.write((const char*)header, sizeof(header));
+
+	std::vector<unsigned char> bgra(packedPixels.size());
+	for (size_t i = 0; i < packedPixels.size(); i += 4) {
+		bgra[i] = packedPixels[i + 2];
+		bgra[i + 1] = packedPixels[i + 1];
+		bgra[i + 2] = packedPixels[i];
+		bgra[i + 3] = packedPixels[i + 3];
+	}
+	imageStream.write((const char*)bgra.data(), bgra.size());
+	imageStream.close();
+
+	json manifest;
+	manifest["image"] = image_path;
+	manifest["width"] = width;
+	manifest["height"] = height;
+	for (const auto& pair : regions) {
+		manifest["regions"][pair.first] = {
+			{ "offset", { pair.second.offset.x, pair.second.offset.y } },
+			{ "scale", { pair.second.scale.x, pair.second.scale.y } },
+		};
+	}
+
+	std::string manifestPath = TextureLoader::GetDirectory() + manifest_path;
+	std::ofstream manifestStream(manifestPath);
+	if (!manifestStream.is_open()) {
+		Error("TextureAtlas::Save(): Impossible to open " + manifestPath);
+		return false;
+	}
+	manifestStream << manifest.dump(4);
+	return true;
+}
+
+bool TextureAtlas::Load(const char* manifest_path)
+{
+	std::string manifestPath = TextureLoader::GetDirectory() + manifest_path;
+	std::ifstream manifestStream(manifestPath);
+	if (!manifestStream.is_open()) {
+		Error("TextureAtlas::Load(): Impossible to open " + manifestPath);
+		return false;
+	}
+
+	json manifest;
+	try { manifestStream >> manifest; }
+	catch (const std::exception& foundException) {
+		Error("TextureAtlas::Load(): JSON parser error in " + manifestPath + ": " + foundException.what());
+		return false;
+	}
+
+	if (!manifest.contains("image") || !manifest["image"].is_string() || !manifest.contains("regions") || !manifest["regions"].is_object()) {
+		Error("TextureAtlas::Load(): " + manifestPath + " is missing \"image\" or \"regions\"");
+		return false;
+	}
+
+	std::string imagePath = manifest["image"].get<std::string>();
+	std::string key = TextureLoader::GetDirectory() + imagePath;
+
+	// another atlas object may have loaded the same baked atlas already
+	unsigned loadedID = ResourceManager::GetInstance().FindTexture(key);
+	if (loadedID == 0) {
+		TextureLoader::Image image;
+		if (!TextureLoader::DecodeImage(imagePath.c_str(), image))
+			return false;
+
+		width = image.width;
+		height = image.height;
+		loadedID = Upload(image.pixels.data());
+		ResourceManager::GetInstance().AddTexture(key, loadedID);
+	}
+	else {
+		width = manifest.value("width", 0u);
+		height = manifest.value("height", 0u);
+	}
+
+	Release();
+	textureID = loadedID;
+	packedPixels.clear();
+
+	regions.clear();
+	for (const auto& item : manifest["regions"].items()) {
+		const json& entry = item.value();
+		Region& region = regions[item.key()];
+		region.offset = glm::vec2(entry["offset"][0].get<float>(), entry["offset"][1].get<float>());
+		region.scale = glm::vec2(entry["scale"][0].get<float>(), entry["scale"][1].get<float>());
+	}
+	return textureID != 0;
+}
+
+const TextureAtlas::Region* TextureAtlas::GetRegion(const std::string& regionName) const
+{
+	auto it = regions.find(regionName);
+	if (it == regions.end()) {
+		Error("TextureAtlas::GetRegion(): " + regionName + " is not in " + name);
+		return nullptr;
+	}
+	return &it->second;
+}
+
+unsigned TextureAtlas::AcquireTexture() const
+{
+	ResourceManager::GetInstance().AcquireTexture(textureID);
+	return textureID;
+}
+
+void TextureAtlas::Release()
+{
+	if (textureID == 0)
+		return;
+
+	ResourceManager::GetInstance().ReleaseTexture(textureID);
+	textureID = 0;
+}
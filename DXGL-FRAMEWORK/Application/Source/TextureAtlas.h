@@ -0,0 +1,83 @@
+#ifndef TEXTURE_ATLAS_H
+#define TEXTURE_ATLAS_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "TextureLoader.h"
+
+/* how to use | TextureAtlas:
+* || runtime packing
+* TextureAtlas uiAtlas("ui");
+* uiAtlas.Add("nyp", "NYP.png"); // decodes only, paths follow TextureLoader's directory
+* uiAtlas.Add("color", "color.tga");
+* uiAtlas.Build(); // packs everything into 1 texture and uploads it once
+*
+* || offline packing
+* uiAtlas.Save("ui_atlas.tga", "ui_atlas.json"); // after Build(), writes the packed image and its regions next to the other images
+* uiAtlas.Load("ui_atlas.json"); // in later runs, 1 decode and 1 upload instead of 1 per image
+*
+* || use
+* meshList[UI_TEST] = MeshBuilder::GenerateQuad("ui test", vec3(1), 1, 1, uiAtlas, "nyp"); // uv gets remapped into the region, all meshes built from the same atlas share 1 texture binding
+*
+* notes:
+* - atlas regions cannot repeat, so only images that use uv 0 - 1 should be packed (ui, props with 1 texture each)
+* - the atlas keeps 1 reference on its texture in ResourceManager, every mesh built from it holds another
+* - building an atlas again replaces the texture left by an earlier atlas of the same name once nothing references it,
+*   Build() fails while another atlas of that name is alive
+*/
+
+class TextureAtlas {
+public:
+
+	// uv_in_atlas = offset + uv * scale
+	struct Region {
+		glm::vec2 offset = glm::vec2(0);
+		glm::vec2 scale = glm::vec2(1);
+
+		glm::vec2 Remap(glm::vec2 uv) const { return offset + uv * scale; }
+	};
+
+	TextureAtlas(const std::string& name);
+	~TextureAtlas();
+
+	bool Add(const std::string& regionName, const char* file_path);
+	// padding is the number of border pixels repeated around each image so mipmaps do not bleed into neighbours
+	bool Build(unsigned maxSize = 4096, unsigned padding = 4);
+
+	bool Save(const char* image_path, const char* manifest_path) const;
+	bool Load(const char* manifest_path);
+
+	const Region* GetRegion(const std::string& regionName) const;
+	unsigned GetTextureID() const { return textureID; }
+	// for meshes that take ownership of a reference, see ResourceManager
+	unsigned AcquireTexture() const;
+
+	void Release();
+
+private:
+
+	struct PendingImage {
+		std::string regionName;
+		TextureLoader::Image image;
+	};
+
+	std::string name;
+	unsigned textureID = 0;
+	unsigned width = 0;
+	unsigned height = 0;
+
+	std::vector<PendingImage> pendingImages;
+	std::unordered_map<std::string, Region> regions;
+	// kept after Build() only so Save() can write it out
+	std::vector<unsigned char> packedPixels;
+
+	bool Pack(unsigned size, unsigned padding, std::vector<glm::uvec2>& out_positions) const;
+	unsigned Upload(const unsigned char* pixels) const;
+};
+
+#endif
@@ -1,7 +1,7 @@
 
 #include <iostream>
 #include <fstream>
-#include <GL\glew.h>
+#include <GL/glew.h>
 
 #include "Console.h"
 
@@ -39,20 +39,46 @@ GLuint TextureLoader::LoadTexture(const char* file_path) {
 }
 
 GLuint TextureLoader::LoadTGA(const char *file_path)				// load TGA file to memory
+{
+	GLuint		texture = 0;
+	unsigned	width, height, bytesPerPixel;
+	std::vector<GLubyte> data;
+
+	if (!ReadTGA(file_path, width, height, bytesPerPixel, data))
+		return 0;
+
+	glGenTextures(1, &texture);
+	glGenerateMipmap(GL_TEXTURE_2D);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	if(bytesPerPixel == 3)
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_BGR, GL_UNSIGNED_BYTE, data.data());
+	else //bytesPerPixel == 4
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_BGRA, GL_UNSIGNED_BYTE, data.data());
+
+	//to do: modify the texture parameters code from here
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	float maxAnisotropy = 1.f;
+	glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &maxAnisotropy);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, (GLint)maxAnisotropy);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	//end of modifiable code
+
+	return texture;						
+}
+
+bool TextureLoader::ReadTGA(const char* file_path, unsigned& width, unsigned& height, unsigned& bytesPerPixel, std::vector<unsigned char>& data)
 {
 	std::string actualFilePath = directory + file_path;
 	std::ifstream fileStream(actualFilePath, std::ios::binary);
 	if(!fileStream.is_open()) {
 		Error("TextureLoader::LoadTGA(): Impossible to open " + actualFilePath + ". Are you in the right directory?");
-		return 0;
+		return false;
 	}
 
 	GLubyte		header[ 18 ];									// first 6 useful header bytes
-	GLuint		bytesPerPixel;								    // number of bytes per pixel in TGA gile
 	GLuint		imageSize;									    // for setting memory
-	GLubyte *	data;
-	GLuint		texture = 0;
-	unsigned	width, height;
 
 	fileStream.read((char*)header, 18);
 	width = header[12] + header[13] * 256;
@@ -64,38 +90,62 @@ GLuint TextureLoader::LoadTGA(const char *file_path)				// load TGA file to memo
 	{
 		fileStream.close();							// close file on failure
 		Error("TextureLoader::LoadTGA(): File header error.");
-		return 0;										
+		return false;
 	}
 
 	bytesPerPixel	= header[16] / 8;						//divide by 8 to get bytes per pixel
 	imageSize		= width * height * bytesPerPixel;	// calculate memory required for TGA data
 	
-	data = new GLubyte[ imageSize ];
+	data.resize(imageSize);
 	fileStream.seekg(18, std::ios::beg);
-	fileStream.read((char *)data, imageSize);
+	fileStream.read((char *)data.data(), imageSize);
 	fileStream.close();	
 
-	glGenTextures(1, &texture);
-	glGenerateMipmap(GL_TEXTURE_2D);
-	glBindTexture(GL_TEXTURE_2D, texture);
-	if(bytesPerPixel == 3)
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_BGR, GL_UNSIGNED_BYTE, data);
-	else //bytesPerPixel == 4
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_BGRA, GL_UNSIGNED_BYTE, data);
+	return true;
+}
 
-	//to do: modify the texture parameters code from here
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	float maxAnisotropy = 1.f;
-	glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &maxAnisotropy);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, (GLint)maxAnisotropy);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	//end of modifiable code
+bool TextureLoader::DecodeImage(const char* file_path, Image& out_image)
+{
+	std::string filePath(file_path);
 
-	delete []data;
+	if (filePath.find(".tga") != std::string::npos || filePath.find(".TGA") != std::string::npos) {
+		unsigned bytesPerPixel;
+		std::vector<unsigned char> data;
+		if (!ReadTGA(file_path, out_image.width, out_image.height, bytesPerPixel, data))
+			return false;
+
+		// BGR(A) -> RGBA
+		out_image.pixels.resize(out_image.width * out_image.height * 4);
+		for (unsigned i = 0, j = 0; i < data.size(); i += bytesPerPixel, j += 4) {
+			out_image.pixels[j] = data[i + 2];
+			out_image.pixels[j + 1] = data[i + 1];
+			out_image.pixels[j + 2] = data[i];
+			out_image.pixels[j + 3] = bytesPerPixel == 4 ? data[i + 3] : 255;
+		}
+		return true;
+	}
 
-	return texture;						
+	if (filePath.find(".png") != std::string::npos || filePath.find(".PNG") != std::string::npos) {
+		std::string actualFilePath = directory + file_path;
+
+		stbi_set_flip_vertically_on_load(true);
+
+		int width, height, channels;
+		unsigned char* img = stbi_load(actualFilePath.c_str(), &width, &height, &channels, 4);
+		if (img == nullptr) {
+			Error("TextureLoader::DecodeImage(): Failed to load PNG: " + actualFilePath + "\nReason: " + stbi_failure_reason());
+			return false;
+		}
+
+		out_image.width = width;
+		out_image.height = height;
+		out_image.pixels.assign(img, img + width * height * 4);
+		stbi_image_free(img);
+		return true;
+	}
+
+	Error("TextureLoader::DecodeImage(): invalid file extension: " + filePath);
+	return false;
 }
 
 GLuint TextureLoader::LoadPNG(const char* filename)
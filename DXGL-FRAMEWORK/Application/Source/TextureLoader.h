@@ -3,6 +3,7 @@
 
 #include <string>
 #include <map>
+#include <vector>
 
 class TextureLoader {
 
@@ -11,11 +12,24 @@ class TextureLoader {
 	static GLuint LoadTGA(const char* file_path);
 	static GLuint LoadPNG(const char* filename);
 
+	static bool ReadTGA(const char* file_path, unsigned& width, unsigned& height, unsigned& bytesPerPixel, std::vector<unsigned char>& data);
+
 public:
 
+	// decoded pixels kept on the cpu, always RGBA with the bottom row first (same as what glTexImage2D expects)
+	struct Image {
+		unsigned width = 0;
+		unsigned height = 0;
+		std::vector<unsigned char> pixels;
+	};
+
 	static void SetDirectory(const std::string& directoryPath);
+	static const std::string& GetDirectory() { return directory; }
 
 	static GLuint LoadTexture(const char* file_path);
+
+	// decode only, does not create a texture, used for packing images into an atlas
+	static bool DecodeImage(const char* file_path, Image& out_image);
 };
 
 
@@ -0,0 +1,83 @@
+#include "UniformBuffer.h"
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "Console.h"
+
+bool UniformBuffer::BindBlock(unsigned programID, const char* blockName, unsigned binding) {
+	GLuint blockIndex = glGetUniformBlockIndex(programID, blockName);
+	if (blockIndex == GL_INVALID_INDEX)
+		return false;
+
+	glUniformBlockBinding(programID, blockIndex, binding);
+	return true;
+}
+
+UniformBuffer::~UniformBuffer() {
+	if (bufferID != 0)
+		Error("UniformBuffer: destroyed without Destroy(), buffer " + std::to_string(bufferID) + " leaked");
+}
+
+void UniformBuffer::Create(unsigned char* mirror, size_t size, unsigned binding) {
+	Destroy();
+	this->mirror = mirror;
+	this->size = size;
+	this->binding = binding;
+
+	glGenBuffers(1, &bufferID);
+	glBindBuffer(GL_UNIFORM_BUFFER, bufferID);
+	glBufferData(GL_UNIFORM_BUFFER, size, mirror, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, binding, bufferID);
+
+	dirtyBegin = dirtyEnd = 0;
+	uploadCount = 0;
+	uploadedBytes = 0;
+}
+
+void UniformBuffer::Destroy() {
+	if (bufferID == 0)
+		return;
+
+	glDeleteBuffers(1, &bufferID);
+	bufferID = 0;
+	dirtyBegin = dirtyEnd = 0;
+}
+
+void UniformBuffer::Write(size_t offset, const void* data, size_t size) {
+	if (offset + size > this->size) {
+		Error("UniformBuffer: write of " + std::to_string(size) + " bytes at " + std::to_string(offset) + " is outside the " + std::to_string(this->size) + " byte block");
+		return;
+	}
+	// most writes are the same value as last frame, those cost a compare and no upload
+	if (std::memcmp(mirror + offset, data, size) == 0)
+		return;
+
+	std::memcpy(mirror + offset, data, size);
+	if (dirtyBegin >= dirtyEnd) {
+		dirtyBegin = offset;
+		dirtyEnd = offset + size;
+	}
+	else {
+		dirtyBegin = std::min(dirtyBegin, offset);
+		dirtyEnd = std::max(dirtyEnd, offset + size);
+	}
+}
+
+size_t UniformBuffer::Upload() {
+	if (bufferID == 0 || dirtyBegin >= dirtyEnd)
+		return 0;
+
+	size_t bytes = dirtyEnd - dirtyBegin;
+	glBindBuffer(GL_UNIFORM_BUFFER, bufferID);
+	glBufferSubData(GL_UNIFORM_BUFFER, dirtyBegin, bytes, mirror + dirtyBegin);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	uploadCount++;
+	uploadedBytes += bytes;
+	dirtyBegin = dirtyEnd = 0;
+	return bytes;
+}
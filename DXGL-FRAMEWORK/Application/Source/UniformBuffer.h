@@ -0,0 +1,89 @@
+#ifndef UNIFORM_BUFFER_H
+#define UNIFORM_BUFFER_H
+
+#include <cstddef>
+
+/* how to use | UniformBlock:
+* || declaring
+* struct FrameData { glm::mat4 view; glm::vec4 cameraPosition; }; // members laid out by std140 rules, vec3 followed by a float packs into 16 bytes
+* UniformBlock<FrameData> frameBlock;
+* frameBlock.Create(UBO_FRAME); // allocates the buffer and binds it to binding point UBO_FRAME
+* UniformBuffer::BindBlock(programID, "FrameBlock", UBO_FRAME); // once per program, the block is matched by name
+*
+* || writing
+* frameBlock.Set(frameBlock.Get().view, view); // writes the cpu copy only, and only marks the bytes dirty if they changed
+* frameBlock.Upload(); // 1 glBufferSubData over everything written since the last Upload(), nothing when nothing changed
+*
+* notes:
+* - Get() is read only, writes have to go through Set() so the dirty range stays correct
+* - the dirty range is a single span, writing the first and last member uploads everything in between, which is still 1 call
+* - GL context thread only for Create(), Upload() and Destroy(), Set() touches no GL
+*/
+
+class UniformBuffer {
+public:
+
+	// returns false if the program has no active block by that name, glsl drops blocks that nothing reads
+	static bool BindBlock(unsigned programID, const char* blockName, unsigned binding);
+
+	void Destroy();
+
+	// | offset, size : in bytes, inside the block
+	void Write(size_t offset, const void* data, size_t size);
+	// returns the number of bytes uploaded
+	size_t Upload();
+
+	unsigned GetBufferID() const { return bufferID; }
+	unsigned GetBinding() const { return binding; }
+	bool IsDirty() const { return dirtyBegin < dirtyEnd; }
+	// since Create()
+	unsigned long long GetUploadCount() const { return uploadCount; }
+	unsigned long long GetUploadedBytes() const { return uploadedBytes; }
+
+protected:
+
+	UniformBuffer() = default;
+	~UniformBuffer();
+	UniformBuffer(const UniformBuffer&) = delete;
+	UniformBuffer& operator=(const UniformBuffer&) = delete;
+
+	// | mirror : the cpu copy, owned by the derived UniformBlock
+	void Create(unsigned char* mirror, size_t size, unsigned binding);
+
+	const unsigned char* GetMirror() const { return mirror; }
+
+private:
+
+	unsigned char* mirror = nullptr;
+	size_t size = 0;
+	unsigned bufferID = 0;
+	unsigned binding = 0;
+
+	// [dirtyBegin, dirtyEnd), empty when begin >= end
+	size_t dirtyBegin = 0;
+	size_t dirtyEnd = 0;
+
+	unsigned long long uploadCount = 0;
+	unsigned long long uploadedBytes = 0;
+};
+
+template<typename T>
+class UniformBlock : public UniformBuffer {
+public:
+
+	void Create(unsigned binding) { UniformBuffer::Create(reinterpret_cast<unsigned char*>(&data), sizeof(T), binding); }
+
+	const T& Get() const { return data; }
+
+	// | field : a member of Get()
+	template<typename V>
+	void Set(const V& field, const V& value) {
+		Write(reinterpret_cast<const unsigned char*>(&field) - GetMirror(), &value, sizeof(V));
+	}
+
+private:
+
+	T data = T();
+};
+
+#endif
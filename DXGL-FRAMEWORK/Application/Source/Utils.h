@@ -3,8 +3,8 @@
 #define UTILS_H
 
 #include <reactphysics3d/reactphysics3d.h>
-#include <glm\glm.hpp>
-#include <glm\gtc\quaternion.hpp>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
 #include <string>
 
 
@@ -4,20 +4,137 @@
 #include <iostream>
 #include <fstream>
 #include <algorithm>
+#include <chrono>
 using namespace std;
 
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#define mkdir(path, mode) _mkdir(path)
+#else
+#include <sys/stat.h>
+#endif
 
 #include <GL/glew.h>
 
 #include "shader.hpp"
 
-GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path){
+static ShaderLoadStats LoadStats;
 
-	// Create the shaders
-	GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
-	GLuint FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
+const ShaderLoadStats& GetShaderLoadStats(){
+	return LoadStats;
+}
+
+void ResetShaderLoadStats(){
+	LoadStats = ShaderLoadStats();
+}
+
+static double MsSince(std::chrono::steady_clock::time_point Start){
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - Start).count();
+}
+
+// FNV-1a, stable across runs and compilers unlike std::hash
+static uint64_t Hash(const std::string& Text, uint64_t Value = 14695981039346656037ull){
+	for (unsigned char c : Text){
+		Value ^= c;
+		Value *= 1099511628211ull;
+	}
+	return Value;
+}
+
+// a binary only loads on the driver that wrote it, so the driver is part of the key
+static std::string GetDriverString(){
+	std::string Driver;
+	const GLenum Names[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+	for (GLenum Name : Names){
+		const GLubyte* Value = glGetString(Name);
+		if (Value)
+			Driver += reinterpret_cast<const char*>(Value);
+		Driver += "\n";
+	}
+	return Driver;
+}
+
+struct BinaryHeader {
+	char Magic[4];
+	uint32_t Format;
+	uint64_t Key;
+	uint32_t Length;
+	uint32_t Padding;
+};
+static const char BinaryMagic[4] = { 'D', 'X', 'S', 'B' };
+
+// returns 0 if there is no binary, it was written for other sources or another driver, or the driver rejects it
+static GLuint LoadProgramBinary(const std::string& CachePath, uint64_t Key){
+	std::ifstream CacheStream(CachePath, std::ios::in | std::ios::binary);
+	if (!CacheStream.is_open())
+		return 0;
+
+	BinaryHeader Header;
+	if (!CacheStream.read(reinterpret_cast<char*>(&Header), sizeof(Header)) || memcmp(Header.Magic, BinaryMagic, sizeof(BinaryMagic)) != 0 || Header.Key != Key){
+		LoadStats.rejected++;
+		return 0;
+	}
+	std::vector<char> Binary(Header.Length);
+	if (!CacheStream.read(Binary.data(), Binary.size())){
+		LoadStats.rejected++;
+		return 0;
+	}
+
+	GLuint ProgramID = glCreateProgram();
+	glProgramBinary(ProgramID, Header.Format, Binary.data(), static_cast<GLsizei>(Binary.size()));
+	GLint Result = GL_FALSE;
+	glGetProgramiv(ProgramID, GL_LINK_STATUS, &Result);
+	if (Result != GL_TRUE){
+		glDeleteProgram(ProgramID);
+		LoadStats.rejected++;
+		return 0;
+	}
+	return ProgramID;
+}
+
+static void SaveProgramBinary(const std::string& CachePath, uint64_t Key, GLuint ProgramID){
+	GLint Length = 0;
+	glGetProgramiv(ProgramID, GL_PROGRAM_BINARY_LENGTH, &Length);
+	if (Length <= 0)
+		return;
+
+	std::vector<char> Binary(Length);
+	GLenum Format = 0;
+	glGetProgramBinary(ProgramID, Length, NULL, &Format, Binary.data());
+
+	BinaryHeader Header = {};
+	memcpy(Header.Magic, BinaryMagic, sizeof(BinaryMagic));
+	Header.Format = Format;
+	Header.Key = Key;
+	Header.Length = static_cast<uint32_t>(Length);
+
+	std::ofstream CacheStream(CachePath, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!CacheStream.is_open()){
+		printf("Impossible to write %s\n", CachePath.c_str());
+		return;
+	}
+	CacheStream.write(reinterpret_cast<const char*>(&Header), sizeof(Header));
+	CacheStream.write(Binary.data(), Binary.size());
+}
+
+// #version has to stay the first line, the defines go right below it
+static void InsertDefines(std::string& ShaderCode, const char * defines){
+	if (defines == NULL || defines[0] == '\0')
+		return;
+	size_t VersionLine = ShaderCode.find("#version");
+	size_t Insert = VersionLine == std::string::npos ? 0 : ShaderCode.find('\n', VersionLine);
+	if (Insert == std::string::npos)
+		Insert = ShaderCode.size();
+	ShaderCode.insert(Insert, std::string("\n") + defines);
+}
+
+GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path,const char * defines,const char * cache_directory){
+
+	std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
 
 	// Read the Vertex Shader code from the file
 	std::string VertexShaderCode;
@@ -43,7 +160,32 @@ GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path
 		FragmentShaderStream.close();
 	}
 
+	InsertDefines(VertexShaderCode, defines);
+	InsertDefines(FragmentShaderCode, defines);
+
+	// Look for a binary of the same sources built by the same driver, binaries are a GL 4.1 feature so plain 3.3 drivers always compile
+	bool UseCache = cache_directory != NULL && GLEW_ARB_get_program_binary;
+	std::string CachePath;
+	uint64_t CacheKey = 0;
+	if (UseCache){
+		// 1 file per shader pair and defines, so an edited shader overwrites its old binary instead of piling up next to it
+		char FileName[32];
+		snprintf(FileName, sizeof(FileName), "%016llx.bin", static_cast<unsigned long long>(Hash(defines ? defines : "", Hash(fragment_file_path, Hash(vertex_file_path)))));
+		mkdir(cache_directory, 0755);
+		CachePath = std::string(cache_directory) + "/" + FileName;
+		CacheKey = Hash(GetDriverString(), Hash(FragmentShaderCode, Hash(VertexShaderCode)));
 
+		GLuint ProgramID = LoadProgramBinary(CachePath, CacheKey);
+		if (ProgramID != 0){
+			LoadStats.cached++;
+			LoadStats.cacheMs += MsSince(Start);
+			return ProgramID;
+		}
+	}
+
+	// Create the shaders
+	GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
+	GLuint FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
 
 	GLint Result = GL_FALSE;
 	int InfoLogLength;
@@ -89,6 +231,9 @@ GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path
 	GLuint ProgramID = glCreateProgram();
 	glAttachShader(ProgramID, VertexShaderID);
 	glAttachShader(ProgramID, FragmentShaderID);
+	// lets the binary be read back with glGetProgramBinary
+	if (UseCache)
+		glProgramParameteri(ProgramID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 	glLinkProgram(ProgramID);
 
 	// Check the program
@@ -103,6 +248,11 @@ GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path
 	glDeleteShader(VertexShaderID);
 	glDeleteShader(FragmentShaderID);
 
+	if (UseCache && Result == GL_TRUE)
+		SaveProgramBinary(CachePath, CacheKey, ProgramID);
+
+	LoadStats.compiled++;
+	LoadStats.compileMs += MsSince(Start);
 	return ProgramID;
 }
 
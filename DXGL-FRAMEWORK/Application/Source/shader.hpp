@@ -1,6 +1,21 @@
 #ifndef SHADER_HPP
 #define SHADER_HPP
 
-GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path);
+// | defines : inserted after the #version line of both shaders, "#define NAME\n" per line, see ShaderVariants
+// | cache_directory : when the driver has GL_ARB_get_program_binary the linked program is kept there,
+//   the next call with the same sources on the same driver loads it with glProgramBinary instead of compiling
+GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path,const char * defines = "",const char * cache_directory = NULL);
+
+// totals of every LoadShaders() call since the last reset
+struct ShaderLoadStats {
+	unsigned compiled = 0;
+	unsigned cached = 0;
+	// binaries that were there but did not match the sources or driver, or that the driver refused
+	unsigned rejected = 0;
+	double compileMs = 0;
+	double cacheMs = 0;
+};
+const ShaderLoadStats& GetShaderLoadStats();
+void ResetShaderLoadStats();
 
 #endif
@@ -0,0 +1,165 @@
+#include "SceneBenchmark.h"
+
+#include <algorithm>
+
+#include "Application.h"
+#include "Console.h"
+
+using RObj = RenderObject;
+
+using glm::vec3;
+
+SceneBenchmark::SceneBenchmark(const Settings& settings)
+	: settings(settings), random(settings.seed) {
+}
+
+SceneBenchmark::~SceneBenchmark() {
+}
+
+void SceneBenchmark::Init() {
+	SceneDemo::Init();
+	enabledShadows = settings.shadows;
+	SetShadingQuality(settings.shading);
+	SetDepthPrePass(settings.depthPrePass);
+	SetCountShadedSamples(settings.countShadedSamples);
+	SetPostProcessSettings(settings.post);
+	SetMeshLod(settings.meshLod);
+	SetLodPixelError(settings.lodPixelError);
+	SetOcclusionMode(settings.occlusion);
+	Populate();
+}
+
+void SceneBenchmark::Update(double dt) {
+	if (!groups.empty()) {
+		unsigned animated = static_cast<unsigned>(groups.size() * settings.animatedGroups);
+		std::uniform_int_distribution<unsigned> pick(0, static_cast<unsigned>(groups.size()) - 1);
+		for (unsigned i = 0; i < animated; i++) {
+			if (auto group = groups[pick(random)].lock())
+				group->rot.y += static_cast<float>(30 * dt);
+		}
+	}
+
+	SceneDemo::Update(dt);
+}
+
+void SceneBenchmark::Populate() {
+	auto& newObj = RObj::newObject;
+	std::uniform_real_distribution<float> spread(-100, 100);
+	std::uniform_real_distribution<float> local(-4, 4);
+	std::uniform_real_distribution<float> chance(0, 1);
+
+	// objects, in groups so each group is its own transform job
+	unsigned groupSize = std::max(settings.groupSize, 1u);
+	std::shared_ptr<RObj> group;
+	for (unsigned i = 0; i < settings.objects; i++) {
+		if (i % groupSize == 0) {
+			worldRoot->NewChild(MeshObject::Create(GROUP));
+			group = newObj;
+			group->name = "bench_group";
+			group->trl = vec3(spread(random), 0, spread(random));
+			groups.push_back(group);
+		}
+
+		// without pillars nothing extra is drawn from random, so the boxes land where they always did
+		if (settings.pillars > 0 && chance(random) < settings.pillars) {
+			group->NewChild(MeshObject::Create(PILLAR));
+		}
+		else {
+			// PHYSICS_BOX has a rendered mesh, its default stat adds a body that the plain objects do not want
+			group->NewChild(MeshObject::Create(PHYSICS_BOX));
+			newObj->RemovePhysics();
+		}
+		newObj->name = "bench_object";
+		newObj->trl = vec3(local(random), 0.5f + local(random) * 0.25f + 2, local(random));
+	}
+
+	// rooms, walls on every grid line around the objects' area, each cut in 2 by a doorway, without random draws so the rest lands where it did
+	if (settings.interior) {
+		const float room = 20, height = 5, thickness = 0.5f, doorway = 4;
+		const int lines = 12;
+		float piece = (room - doorway) / 2;
+		for (int axis = 0; axis < 2; axis++) {
+			for (int line = 0; line < lines; line++) {
+				// the lines sit halfway between room centres, 0 is a room centre
+				float across = (line - lines / 2) * room + room / 2;
+				for (int segment = 0; segment + 1 < lines; segment++) {
+					float start = (segment - lines / 2) * room + room / 2;
+					for (float along : { start + piece / 2, start + room - piece / 2 }) {
+						worldRoot->NewChild(MeshObject::Create(WALL));
+						newObj->name = "bench_wall";
+						newObj->trl = axis == 0 ? vec3(across, height / 2, along) : vec3(along, height / 2, across);
+						newObj->scl = axis == 0 ? vec3(thickness, height, piece) : vec3(piece, height, thickness);
+					}
+				}
+			}
+		}
+	}
+
+	// lights
+	std::uniform_real_distribution<float> color(0.3f, 1);
+	for (unsigned i = 0; i < settings.lights; i++) {
+		auto light = LightObject::Create(LIGHT);
+		if (!light)
+			break;
+		worldRoot->NewChild(light);
+		light->name = "bench_light";
+		light->trl = vec3(spread(random), 6, spread(random));
+		Light& properties = light->lightProperties;
+		properties.type = i % 4 == 3 ? Light::LIGHT_SPOT : Light::LIGHT_POINT;
+		properties.color = vec3(color(random), color(random), color(random));
+		properties.power = 1;
+		properties.kC = 1;
+		properties.kL = 0.2f;
+		properties.kQ = 0.5f;
+		UpdateLightUniform(light);
+		createdLights++;
+	}
+	// shadow casters, a sun for the cascades and spot lights looking down on the groups
+	for (unsigned i = 0; i < settings.shadowLights; i++) {
+		auto light = LightObject::Create(LIGHT);
+		if (!light)
+			break;
+		worldRoot->NewChild(light);
+		light->name = "bench_shadow_light";
+		Light& properties = light->lightProperties;
+		properties.castShadows = true;
+		if (i == 0) {
+			// SceneDemo::Update() takes a directional light's direction from its position
+			properties.type = Light::LIGHT_DIRECTIONAL;
+			light->trl = vec3(40, 100, 30);
+			properties.power = 0.5f;
+		}
+		else {
+			properties.type = Light::LIGHT_SPOT;
+			light->trl = vec3(spread(random), 25, spread(random));
+			properties.power = 1;
+			properties.kL = 0.05f;
+			properties.kQ = 0.005f;
+			properties.cosCutoff = 35.f;
+			properties.cosInner = 30.f;
+		}
+		properties.color = vec3(color(random), color(random), color(random));
+		UpdateLightUniform(light);
+		createdShadowLights++;
+	}
+
+	if (createdLights < settings.lights)
+		Print("SceneBenchmark: only " + std::to_string(createdLights) + " of " + std::to_string(settings.lights) + " lights fit in MAX_LIGHT", 1);
+
+	// physics bodies, dropped from above so they collide and settle during the run
+	std::uniform_real_distribution<float> height(2, 30);
+	for (unsigned i = 0; i < settings.bodies; i++) {
+		worldRoot->NewChild(MeshObject::Create(i % 2 ? PHYSICS_BOX : PHYSICS_BALL));
+		newObj->name = "bench_body";
+		newObj->GetPhysics()->SetPosition(vec3(spread(random) * 0.2f, height(random), spread(random) * 0.2f));
+	}
+
+	// text
+	for (unsigned i = 0; i < settings.textLines; i++) {
+		screenRoot->NewChild(TextObject::Create("bench_text_" + std::to_string(i), "benchmark line " + std::to_string(i) + " the quick brown fox jumps over the lazy dog", vec3(1), FONT_CASCADIA_MONO));
+		newObj->trl = vec3(20, Application::SCREEN_HEIGHT - 40 - i * 20.f, 0);
+		newObj->scl = vec3(16, 16, 1);
+	}
+
+	RObj::newObject.reset();
+}
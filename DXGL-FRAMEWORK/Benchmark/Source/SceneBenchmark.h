@@ -0,0 +1,79 @@
+#ifndef SCENE_BENCHMARK_H
+#define SCENE_BENCHMARK_H
+
+#include "SceneDemo.h"
+
+#include <random>
+
+/* how to use | SceneBenchmark:
+* SceneBenchmark::Settings settings;
+* settings.objects = 2000;
+* Scene* scene = new SceneBenchmark(settings);
+* scene->Init(); // everything SceneDemo has, plus the synthetic content below
+*
+* notes:
+* - objects are boxes (or pillars, see Settings::pillars) without physics, grouped under GROUP parents so transforms can be split into jobs
+* - every frame a fraction of the groups is turned so the transform update always has work to do
+* - lights are capped by what is left of BaseScene::MAX_LIGHT, GetCreatedLights() says how many were made
+* - lights are small (about 20 units of influence) and every 4th one is a spot light, so clustering has something to cull
+* - shadowLights adds a shadow casting sun and shadowLights - 1 shadow casting spot lights over the groups, on top of lights
+* - interior walls the whole area into 20 unit rooms with a doorway in every wall, the camera starts in the middle room,
+*   so nearly everything is behind a wall, what occlusion culling has to work on
+* - the same seed always builds the same scene
+*/
+
+class SceneBenchmark : public SceneDemo
+{
+public:
+
+	struct Settings {
+		unsigned objects = 1000;
+		unsigned lights = 8;
+		unsigned bodies = 100;
+		unsigned textLines = 20;
+		// objects per group
+		unsigned groupSize = 16;
+		// 0 - 1, groups turned every frame
+		float animatedGroups = 0.25f;
+		unsigned seed = 1;
+		// BaseScene::enabledShadows, off also skips the demo spot light's shadow
+		bool shadows = true;
+		unsigned shadowLights = 0;
+		BaseScene::SHADING_QUALITY shading = BaseScene::SHADING_MEDIUM;
+		bool depthPrePass = true;
+		// GL_SAMPLES_PASSED of the shaded passes, see BaseScene::GetShadedSamples()
+		bool countShadedSamples = false;
+		// anti-aliasing, bloom and dynamic resolution, see BaseScene::SetPostProcessSettings()
+		PostProcess::Settings post;
+		// 0 - 1, objects that are 360 slice PILLARs instead of boxes, what mesh LODs have to work on
+		float pillars = 0;
+		bool meshLod = true;
+		float lodPixelError = 1.f;
+		// WALLs between the objects, see BaseScene::SetOcclusionMode()
+		bool interior = false;
+		OcclusionCuller::MODE occlusion = OcclusionCuller::MODE_OFF;
+	};
+
+	SceneBenchmark(const Settings& settings);
+	~SceneBenchmark();
+
+	void Init() override;
+	void Update(double dt) override;
+
+	unsigned GetCreatedLights() const { return createdLights; }
+	unsigned GetCreatedShadowLights() const { return createdShadowLights; }
+	const LightClusters::Stats& GetLightClusterStats() const { return lightClusters.GetStats(); }
+
+private:
+
+	Settings settings;
+	std::mt19937 random;
+
+	std::vector<std::weak_ptr<RenderObject>> groups;
+	unsigned createdLights = 0;
+	unsigned createdShadowLights = 0;
+
+	void Populate();
+};
+
+#endif
@@ -0,0 +1,882 @@
+//Include GLEW
+#include <GL/glew.h>
+
+//Include GLFW
+#include <GLFW/glfw3.h>
+
+#include <SDL.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#define chdir _chdir
+#else
+#include <unistd.h>
+#endif
+
+#include <nlohmann/json.hpp>
+
+#include "Application.h"
+#include "SceneBenchmark.h"
+#include "AudioManager.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+#include "MemoryTracker.h"
+#include "FrameArena.h"
+#include "InputQueue.h"
+#include "ResourceManager.h"
+#include "Mesh.h"
+#include "Console.h"
+
+using nlohmann::json;
+
+/* how to use | Benchmark:
+* Benchmark.exe [options], run from Application/ so Shader/ and SceneDemo/ are found (or pass --assets)
+*
+* --scenario scene|jobs|audio|lights|shadows|shading|prepass|post|lod|occlusion|all   default all, which is scene, jobs and audio
+* --frames 600 --warmup 60          fixed frames, each steps the scene by exactly 1/60s
+* --objects 1000 --lights 8 --bodies 100 --text 20 --seed 1
+* --shadow-lights 0                 shadow casting lights added, a sun then spot lights
+* --no-shadows                      turn the shadow pass off
+* --shading high|medium|low|vertex  shading quality tier, default medium, see BaseScene::SHADING_QUALITY
+* --no-depth-prepass                draw opaques shaded straight away
+* --count-samples                   count the samples that pass the depth test in the shaded passes
+* --aa none|msaa|fxaa               anti-aliasing of the offscreen scene, default msaa
+* --no-bloom                        no glow around NEON materials
+* --no-post                         draw the scene straight into the window, no HDR, anti-aliasing or bloom
+* --render-scale 1                  fixed share of the window's resolution the scene is drawn at, 0.5 - 1
+* --dynamic-resolution 16.7         let the render scale follow a gpu budget of this many ms per frame
+* --pillars 0                       share of the objects that are 360 slice pillars instead of boxes, 0 - 1
+* --no-lod                          draw every mesh at full detail
+* --lod-error 1                     pixels of error a mesh LOD level may show before a finer one is drawn
+* --interior                        wall the objects into rooms, the camera in the middle one
+* --occlusion off|gpu|cpu           occlusion culling of the world list, default off, see BaseScene::SetOcclusionMode()
+* --workers -1                      JobSystem workers for the scene, -1 = hardware threads - 1
+* --max-threads 0                   highest thread count of the jobs sweep, 0 = hardware threads
+* --no-render                       skip Render(), the GL context is still needed by Init()
+* --assert-no-alloc                 fail the run if a measured frame allocates, needs ENABLE_MEMORY_TRACKER
+* --headless                        GLFW null platform with an OSMesa context (llvmpipe), no display needed
+* --assets <dir>                    working directory to load assets from
+* --replay <file>                   input recorded in SceneDemo (debug mode, R), fed in by simulated time from the first frame
+* --out <file>                      JSON report, printed to stdout without it
+*
+* the report has per phase ms (avg, p50, p95, max), heap allocations per frame (total and per MemoryTracker tag),
+* draw calls per frame, the profiler zone averages, the jobs scaling curve and PlaySFX() cost with 0 - 500 voices playing
+* the lights scenario runs the scene again with 16 - 1024 lights and reports render / gpu time and light cluster stats for each
+* the shading scenario runs the scene once per shading quality tier and reports render / gpu time and the draws per shading LOD
+* the prepass scenario runs the scene with the depth pre-pass off and on, counting samples, and reports shaded samples and times for both
+* the post scenario runs the scene with post processing off, then with each anti-aliasing mode, then with FXAA and dynamic resolution
+* against --dynamic-resolution's budget (default 16.7 ms), and reports times, the render scale and the post process gpu time
+* the lod scenario runs the scene with mesh LODs off and on, with at least half the objects pillars, and reports times,
+* triangles and the draws per LOD level
+* the occlusion scenario runs the --interior scene with occlusion culling off, gpu and cpu, and reports times, draw calls
+* and the boxes tested and culled per frame
+* the shadows scenario runs the scene with the shadow pass off, then on with --shadow-lights (at least 4) casting lights, and reports both
+*/
+
+namespace {
+
+	/********************************* allocation counting *********************************/
+
+	struct AllocationSample {
+		unsigned long long count;
+		unsigned long long bytes;
+		static AllocationSample Now() {
+			MemoryTracker::TagStats total = MemoryTracker::GetInstance().GetTotalStats();
+			return { total.allocations, total.bytes };
+		}
+	};
+
+
+	/********************************* options *********************************/
+
+	struct Options {
+		std::string scenario = "all";
+		unsigned frames = 600;
+		unsigned warmup = 60;
+		SceneBenchmark::Settings scene;
+		int workers = -1;
+		unsigned maxThreads = 0;
+		bool render = true;
+		bool headless = false;
+		bool assertNoAlloc = false;
+		std::string assets;
+		std::string replay;
+		std::string out;
+	};
+
+	bool ParseOptions(int argc, char* argv[], Options& options) {
+		for (int i = 1; i < argc; i++) {
+			std::string arg = argv[i];
+			auto next = [&]() -> const char* {
+				if (i + 1 >= argc) {
+					Error("Benchmark: " + arg + " needs a value");
+					return nullptr;
+				}
+				return argv[++i];
+			};
+			auto nextUnsigned = [&](unsigned& out) {
+				const char* value = next();
+				if (value)
+					out = static_cast<unsigned>(std::strtoul(value, nullptr, 10));
+				return value != nullptr;
+			};
+
+			bool ok = true;
+			if (arg == "--scenario") { const char* value = next(); ok = value; if (value) options.scenario = value; }
+			else if (arg == "--frames") ok = nextUnsigned(options.frames);
+			else if (arg == "--warmup") ok = nextUnsigned(options.warmup);
+			else if (arg == "--objects") ok = nextUnsigned(options.scene.objects);
+			else if (arg == "--lights") ok = nextUnsigned(options.scene.lights);
+			else if (arg == "--bodies") ok = nextUnsigned(options.scene.bodies);
+			else if (arg == "--text") ok = nextUnsigned(options.scene.textLines);
+			else if (arg == "--seed") ok = nextUnsigned(options.scene.seed);
+			else if (arg == "--shadow-lights") ok = nextUnsigned(options.scene.shadowLights);
+			else if (arg == "--no-shadows") options.scene.shadows = false;
+			else if (arg == "--no-depth-prepass") options.scene.depthPrePass = false;
+			else if (arg == "--count-samples") options.scene.countShadedSamples = true;
+			else if (arg == "--no-bloom") options.scene.post.bloom = false;
+			else if (arg == "--no-post") options.scene.post.enabled = false;
+			else if (arg == "--pillars") { const char* value = next(); ok = value; if (value) options.scene.pillars = std::strtof(value, nullptr); }
+			else if (arg == "--no-lod") options.scene.meshLod = false;
+			else if (arg == "--interior") options.scene.interior = true;
+			else if (arg == "--occlusion") {
+				const char* value = next();
+				ok = false;
+				for (int mode = 0; value && mode < OcclusionCuller::MODE_TOTAL; mode++) {
+					if (std::strcmp(value, OcclusionCuller::GetModeName(static_cast<OcclusionCuller::MODE>(mode))) == 0) {
+						options.scene.occlusion = static_cast<OcclusionCuller::MODE>(mode);
+						ok = true;
+					}
+				}
+				if (value && !ok)
+					Error("Benchmark: unknown occlusion mode " + std::string(value));
+			}
+			else if (arg == "--lod-error") { const char* value = next(); ok = value; if (value) options.scene.lodPixelError = std::strtof(value, nullptr); }
+			else if (arg == "--render-scale") { const char* value = next(); ok = value; if (value) options.scene.post.renderScale = std::strtof(value, nullptr); }
+			else if (arg == "--dynamic-resolution") {
+				const char* value = next();
+				ok = value;
+				if (value) {
+					options.scene.post.dynamicResolution = true;
+					options.scene.post.frameBudgetMs = std::strtof(value, nullptr);
+				}
+			}
+			else if (arg == "--aa") {
+				const char* value = next();
+				ok = false;
+				for (int mode = 0; value && mode < PostProcess::AA_TOTAL; mode++) {
+					if (std::strcmp(value, PostProcess::GetAntiAliasingName(static_cast<PostProcess::ANTI_ALIASING>(mode))) == 0) {
+						options.scene.post.antiAliasing = static_cast<PostProcess::ANTI_ALIASING>(mode);
+						ok = true;
+					}
+				}
+				if (value && !ok)
+					Error("Benchmark: unknown anti-aliasing " + std::string(value));
+			}
+			else if (arg == "--shading") {
+				const char* value = next();
+				ok = false;
+				for (int quality = 0; value && quality < BaseScene::SHADING_QUALITY_TOTAL; quality++) {
+					if (std::strcmp(value, BaseScene::GetShadingQualityName(static_cast<BaseScene::SHADING_QUALITY>(quality))) == 0) {
+						options.scene.shading = static_cast<BaseScene::SHADING_QUALITY>(quality);
+						ok = true;
+					}
+				}
+				if (value && !ok)
+					Error("Benchmark: unknown shading quality " + std::string(value));
+			}
+			else if (arg == "--workers") { const char* value = next(); ok = value; if (value) options.workers = std::atoi(value); }
+			else if (arg == "--max-threads") ok = nextUnsigned(options.maxThreads);
+			else if (arg == "--no-render") options.render = false;
+			else if (arg == "--headless") options.headless = true;
+			else if (arg == "--assert-no-alloc") options.assertNoAlloc = true;
+			else if (arg == "--assets") { const char* value = next(); ok = value; if (value) options.assets = value; }
+			else if (arg == "--replay") { const char* value = next(); ok = value; if (value) options.replay = value; }
+			else if (arg == "--out") { const char* value = next(); ok = value; if (value) options.out = value; }
+			else {
+				Error("Benchmark: unknown option " + arg);
+				ok = false;
+			}
+			if (!ok)
+				return false;
+		}
+		return true;
+	}
+
+
+	/********************************* helpers *********************************/
+
+	using Clock = std::chrono::steady_clock;
+
+	double MsSince(Clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	json Summarise(std::vector<double> samples) {
+		if (samples.empty())
+			return { { "avg", 0 }, { "p50", 0 }, { "p95", 0 }, { "max", 0 } };
+
+		double total = 0;
+		for (double sample : samples)
+			total += sample;
+		std::sort(samples.begin(), samples.end());
+		auto percentile = [&](double p) { return samples[static_cast<size_t>(p / 100.0 * (samples.size() - 1) + 0.5)]; };
+		return { { "avg", total / samples.size() }, { "p50", percentile(50) }, { "p95", percentile(95) }, { "max", samples.back() } };
+	}
+
+	GLFWwindow* CreateContext(const Options& options) {
+		if (options.headless)
+			glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+		if (!glfwInit()) {
+			Error("Benchmark: glfwInit() failed");
+			return nullptr;
+		}
+
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+		if (options.headless)
+			glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+
+		GLFWwindow* window = glfwCreateWindow(static_cast<int>(Application::SCREEN_WIDTH), static_cast<int>(Application::SCREEN_HEIGHT), "benchmark", NULL, NULL);
+		if (!window) {
+			Error("Benchmark: could not create a GL 3.3 core context");
+			glfwTerminate();
+			return nullptr;
+		}
+		glfwMakeContextCurrent(window);
+		// the benchmark measures work, not the display
+		glfwSwapInterval(0);
+
+		glewExperimental = true;
+		GLenum err = glewInit();
+		// glewInit() also wants GLX/WGL, which an OSMesa context does not have, the GL functions are loaded either way
+		if (err != GLEW_OK && glewContextInit() != GLEW_OK) {
+			Error(std::string("Benchmark: ") + reinterpret_cast<const char*>(glewGetErrorString(err)));
+			glfwDestroyWindow(window);
+			glfwTerminate();
+			return nullptr;
+		}
+		return window;
+	}
+
+
+	/********************************* scenarios *********************************/
+
+	json RunScene(const Options& options, GLFWwindow* window) {
+		JobSystem::GetInstance().Init(options.workers);
+
+		InputQueue& input = InputQueue::GetInstance();
+		if (!options.replay.empty()) {
+			if (!input.LoadRecording(options.replay)) {
+				Error("Benchmark: Impossible to read " + options.replay);
+				return json::object();
+			}
+			input.StartReplay();
+		}
+
+		SceneBenchmark* scene = new SceneBenchmark(options.scene);
+		AllocationSample initStart = AllocationSample::Now();
+		Clock::time_point initTime = Clock::now();
+		scene->Init();
+		double initMs = MsSince(initTime);
+		AllocationSample initEnd = AllocationSample::Now();
+
+		const double dt = 1.0 / 60.0;
+		std::vector<double> updateMs, audioMs, renderMs, finishMs, frameMs;
+		std::vector<double> updateAllocations, renderAllocations, frameAllocations, frameBytes, drawCalls;
+		std::vector<double> clusterBuildMs, clusterIndices, clusterVisibleLights, clusterMaxLights;
+		std::vector<double> shaderSwitches;
+		std::vector<double> shadingPerPixel, shadingReduced, shadingPerVertex;
+		std::vector<double> shadedSamples, depthPrePassDraws;
+		std::vector<double> renderScale, postGpuMs, postPasses;
+		std::vector<double> triangles, meshLodDraws[Mesh::MAX_LODS];
+		std::vector<double> occlusionTested, occlusionCulled, occlusionOccluders, occlusionMs, occlusionActive;
+		std::vector<double> shadowMs, shadowMaps, shadowStaticCasters, shadowDynamicCasters, shadowStaticRedraws, shadowDraws, shadowCulled;
+		std::vector<double> tagAllocations[MemoryTracker::TAG_COUNT], tagBytes[MemoryTracker::TAG_COUNT];
+		MemoryTracker& memory = MemoryTracker::GetInstance();
+
+		for (unsigned frame = 0; frame < options.warmup + options.frames; frame++) {
+			bool measured = frame >= options.warmup;
+			if (frame == options.warmup) {
+				// the peaks of the measured frames only, Init() and the warmup grow every pool once
+				memory.ResetPeaks();
+				memory.SetAssertNoAlloc(options.assertNoAlloc);
+			}
+			Clock::time_point frameStart = Clock::now();
+			AllocationSample allocationStart = AllocationSample::Now();
+
+			PROFILE_BEGIN_FRAME();
+			MEMORY_BEGIN_FRAME();
+			FrameArena::GetInstance().Reset();
+
+			scene->SetFrameTime(dt);
+			Clock::time_point phaseStart = Clock::now();
+			{
+				PROFILE_ZONE("Update");
+				MEMORY_TAG(MemoryTracker::SCENE);
+				// a replay goes by simulated time, so every run sees the same input on the same frame
+				input.NextSnapshot(options.replay.empty() ? InputQueue::Now() : frame * dt);
+				scene->Update(dt);
+			}
+			double update = MsSince(phaseStart);
+			AllocationSample afterUpdate = AllocationSample::Now();
+
+			phaseStart = Clock::now();
+			{
+				PROFILE_ZONE("Audio");
+				MEMORY_TAG(MemoryTracker::AUDIO);
+				AudioManager::GetInstance().Update();
+			}
+			double audio = MsSince(phaseStart);
+
+			double render = 0, finish = 0;
+			unsigned long long drawCallsStart = Mesh::drawCalls;
+			AllocationSample beforeRender = AllocationSample::Now();
+			if (options.render) {
+				phaseStart = Clock::now();
+				{
+					PROFILE_ZONE("Render");
+					MEMORY_TAG(MemoryTracker::RENDER);
+					scene->Render();
+				}
+				render = MsSince(phaseStart);
+
+				// without this the gpu work would land in whichever later call happens to block
+				phaseStart = Clock::now();
+				{
+					PROFILE_ZONE("GPU finish");
+					glFinish();
+				}
+				finish = MsSince(phaseStart);
+				glfwSwapBuffers(window);
+			}
+			AllocationSample afterRender = AllocationSample::Now();
+
+			MEMORY_END_FRAME();
+			PROFILE_END_FRAME();
+			glfwPollEvents();
+
+			if (!measured)
+				continue;
+			updateMs.push_back(update);
+			audioMs.push_back(audio);
+			renderMs.push_back(render);
+			finishMs.push_back(finish);
+			frameMs.push_back(MsSince(frameStart));
+			updateAllocations.push_back(static_cast<double>(afterUpdate.count - allocationStart.count));
+			renderAllocations.push_back(static_cast<double>(afterRender.count - beforeRender.count));
+			frameAllocations.push_back(static_cast<double>(afterRender.count - allocationStart.count));
+			frameBytes.push_back(static_cast<double>(afterRender.bytes - allocationStart.bytes));
+			drawCalls.push_back(static_cast<double>(Mesh::drawCalls - drawCallsStart));
+			if (options.render) {
+				const LightClusters::Stats& clusters = scene->GetLightClusterStats();
+				clusterBuildMs.push_back(clusters.buildMs);
+				clusterIndices.push_back(clusters.indices);
+				clusterVisibleLights.push_back(clusters.visibleLights);
+				clusterMaxLights.push_back(clusters.maxLightsPerCluster);
+				shaderSwitches.push_back(scene->GetShaderSwitches());
+				// 2 frames late, the first 2 measured frames still count the warmup
+				shadedSamples.push_back(static_cast<double>(scene->GetShadedSamples()));
+				depthPrePassDraws.push_back(scene->GetDepthPrePassDraws());
+				const auto& shadingLods = scene->GetShadingLodCounts();
+				shadingPerPixel.push_back(shadingLods[0]);
+				shadingReduced.push_back(shadingLods[1]);
+				shadingPerVertex.push_back(shadingLods[2]);
+				const ShadowAtlas::Stats& shadows = scene->GetShadowStats();
+				shadowMs.push_back(shadows.cpuMs);
+				shadowMaps.push_back(shadows.maps);
+				shadowStaticCasters.push_back(shadows.staticCasters);
+				shadowDynamicCasters.push_back(shadows.dynamicCasters);
+				shadowStaticRedraws.push_back(shadows.staticRedraws);
+				shadowDraws.push_back(shadows.staticDraws + shadows.dynamicDraws);
+				shadowCulled.push_back(shadows.culled);
+				// the gpu time is TIMER_FRAMES old, 0 until the first one comes back
+				const PostProcess::Stats& post = scene->GetPostProcessStats();
+				renderScale.push_back(post.renderScale);
+				postGpuMs.push_back(post.gpuMs);
+				postPasses.push_back(post.passes);
+				triangles.push_back(static_cast<double>(scene->GetDrawnTriangles()));
+				const auto& meshLods = scene->GetMeshLodCounts();
+				for (unsigned level = 0; level < Mesh::MAX_LODS; level++)
+					meshLodDraws[level].push_back(meshLods[level]);
+				const OcclusionCuller::Stats& occlusion = scene->GetOcclusionStats();
+				occlusionTested.push_back(occlusion.tested);
+				occlusionCulled.push_back(occlusion.culled);
+				occlusionOccluders.push_back(occlusion.occluders);
+				occlusionMs.push_back(occlusion.cpuMs);
+				occlusionActive.push_back(occlusion.active ? 1 : 0);
+			}
+			const MemoryTracker::FrameStats& memoryFrame = memory.GetLastFrame();
+			for (int tag = 0; tag < MemoryTracker::TAG_COUNT; tag++) {
+				tagAllocations[tag].push_back(static_cast<double>(memoryFrame.tagAllocations[tag]));
+				tagBytes[tag].push_back(static_cast<double>(memoryFrame.tagBytes[tag]));
+			}
+		}
+		memory.SetAssertNoAlloc(false);
+
+		// per subsystem, high-water marks are of the live bytes during the measured frames
+		json memoryTags = json::object();
+		for (int tag = 0; tag < MemoryTracker::TAG_COUNT; tag++) {
+			MemoryTracker::TagStats stats = memory.GetTagStats(static_cast<MemoryTracker::TAG>(tag));
+			memoryTags[MemoryTracker::GetTagName(static_cast<MemoryTracker::TAG>(tag))] = {
+				{ "allocations_per_frame", Summarise(tagAllocations[tag]) }, { "bytes_per_frame", Summarise(tagBytes[tag]) },
+				{ "live_bytes", stats.liveBytes }, { "peak_bytes", stats.peakBytes },
+			};
+		}
+
+		// zones of the last frame, averaged over the frames the profiler still remembers
+		json zones = json::object();
+		json gpuZones = json::object();
+		unsigned zoneFrames = std::min(options.frames, Profiler::FRAME_HISTORY - 1);
+		if (const Profiler::Frame* last = Profiler::GetInstance().GetLastFrame()) {
+			for (const Profiler::Zone& zone : last->zones)
+				(zone.gpu ? gpuZones : zones)[zone.name] = Profiler::GetInstance().GetZoneAverage(zone.name, zone.gpu, zoneFrames);
+		}
+
+		json meshLodLevels = json::array();
+		for (unsigned level = 0; level < Mesh::MAX_LODS; level++)
+			meshLodLevels.push_back(Summarise(meshLodDraws[level]));
+
+		json report = {
+			{ "settings", {
+				{ "frames", options.frames }, { "warmup", options.warmup }, { "objects", options.scene.objects },
+				{ "lights_requested", options.scene.lights }, { "lights_created", scene->GetCreatedLights() },
+				{ "bodies", options.scene.bodies }, { "text_lines", options.scene.textLines }, { "seed", options.scene.seed },
+				{ "shadows", options.scene.shadows }, { "shadow_lights", scene->GetCreatedShadowLights() },
+				{ "shading", BaseScene::GetShadingQualityName(options.scene.shading) }, { "depth_prepass", options.scene.depthPrePass },
+				{ "post", scene->GetPostProcessSettings().enabled }, { "aa", PostProcess::GetAntiAliasingName(scene->GetPostProcessSettings().antiAliasing) },
+				{ "bloom", scene->GetPostProcessSettings().bloom }, { "dynamic_resolution", scene->GetPostProcessSettings().dynamicResolution },
+				{ "frame_budget_ms", scene->GetPostProcessSettings().frameBudgetMs },
+				{ "pillars", options.scene.pillars }, { "mesh_lod", options.scene.meshLod }, { "lod_pixel_error", options.scene.lodPixelError },
+				{ "interior", options.scene.interior }, { "occlusion", OcclusionCuller::GetModeName(scene->GetOcclusionMode()) },
+				{ "threads", JobSystem::GetInstance().GetThreadCount() }, { "render", options.render }, { "replay", options.replay },
+			} },
+			{ "init_ms", initMs },
+			{ "init_allocations", initEnd.count - initStart.count },
+			{ "phases_ms", {
+				{ "update", Summarise(updateMs) }, { "audio", Summarise(audioMs) }, { "render", Summarise(renderMs) },
+				{ "gpu_finish", Summarise(finishMs) }, { "frame", Summarise(frameMs) },
+			} },
+			{ "zones_ms", zones },
+			{ "gpu_zones_ms", gpuZones },
+			{ "allocations_per_frame", {
+				{ "update", Summarise(updateAllocations) }, { "render", Summarise(renderAllocations) },
+				{ "frame", Summarise(frameAllocations) }, { "frame_bytes", Summarise(frameBytes) },
+			} },
+			{ "memory", {
+				{ "tags", memoryTags },
+				{ "peak_bytes", memory.GetTotalStats().peakBytes },
+				{ "worst_frame_allocations", memory.GetWorstFrame().allocations },
+				{ "assert_no_alloc", options.assertNoAlloc },
+				{ "failed_frames", memory.GetFailedFrames() },
+			} },
+			{ "frame_arena", {
+				{ "peak_bytes", FrameArena::GetInstance().GetPeakBytes() },
+				{ "capacity", FrameArena::GetInstance().GetCapacity() },
+				{ "overflow_frames", FrameArena::GetInstance().GetOverflowCount() },
+			} },
+			{ "draw_calls_per_frame", Summarise(drawCalls) },
+			{ "light_clusters", {
+				{ "build_ms", Summarise(clusterBuildMs) }, { "indices", Summarise(clusterIndices) },
+				{ "visible_lights", Summarise(clusterVisibleLights) }, { "max_lights_per_cluster", Summarise(clusterMaxLights) },
+				{ "dropped_indices", scene->GetLightClusterStats().droppedIndices },
+			} },
+			{ "shader_variants", {
+				{ "switches_per_frame", Summarise(shaderSwitches) },
+				{ "compiled", scene->GetShaderStats().compiled }, { "cached", scene->GetShaderStats().cached },
+				{ "rejected", scene->GetShaderStats().rejected }, { "compile_ms", scene->GetShaderStats().compileMs },
+				{ "load_ms", scene->GetShaderStats().loadMs },
+			} },
+			{ "depth_prepass", {
+				{ "draws", Summarise(depthPrePassDraws) },
+				{ "shaded_samples", options.scene.countShadedSamples ? Summarise(shadedSamples) : json() },
+			} },
+			{ "shading_lods", {
+				{ "per_pixel", Summarise(shadingPerPixel) }, { "reduced", Summarise(shadingReduced) }, { "per_vertex", Summarise(shadingPerVertex) },
+			} },
+			{ "shadows", {
+				{ "cpu_ms", Summarise(shadowMs) }, { "maps", Summarise(shadowMaps) },
+				{ "static_casters", Summarise(shadowStaticCasters) }, { "dynamic_casters", Summarise(shadowDynamicCasters) },
+				{ "static_redraws", Summarise(shadowStaticRedraws) }, { "draws", Summarise(shadowDraws) }, { "culled", Summarise(shadowCulled) },
+			} },
+			{ "post_process", {
+				{ "render_scale", Summarise(renderScale) }, { "scene_gpu_ms", Summarise(postGpuMs) }, { "passes", Summarise(postPasses) },
+				{ "scale_changes", scene->GetPostProcessStats().scaleChanges },
+			} },
+			{ "mesh_lods", {
+				{ "triangles_per_frame", Summarise(triangles) }, { "draws_per_level", meshLodLevels },
+			} },
+			{ "occlusion", {
+				{ "tested", Summarise(occlusionTested) }, { "culled", Summarise(occlusionCulled) }, { "occluders", Summarise(occlusionOccluders) },
+				{ "cpu_ms", Summarise(occlusionMs) }, { "active_share", Summarise(occlusionActive)["avg"] },
+			} },
+		};
+
+		scene->Exit();
+		delete scene;
+		return report;
+	}
+
+	// same split as SceneDemo::Update(), 1 job per child of the root
+	void UpdateHierarchyModels(const std::shared_ptr<RenderObject>& obj) {
+		obj->UpdateModel();
+		for (auto& child : obj->children)
+			UpdateHierarchyModels(child);
+	}
+
+	json RunJobs(const Options& options) {
+		unsigned maxThreads = options.maxThreads ? options.maxThreads : std::max(std::thread::hardware_concurrency(), 1u);
+		const unsigned groupSize = std::max(options.scene.groupSize, 1u);
+		const unsigned repetitions = 50;
+
+		// plain RenderObjects, the transform maths does not need GL
+		auto root = std::make_shared<RenderObject>();
+		root->RootInit(RenderObject::WORLD, 0);
+		std::mt19937 random(options.scene.seed);
+		std::uniform_real_distribution<float> spread(-100, 100);
+		for (unsigned i = 0; i < options.scene.objects; i += groupSize) {
+			root->NewChild(std::make_shared<RenderObject>());
+			auto group = RenderObject::newObject;
+			group->trl = glm::vec3(spread(random), 0, spread(random));
+			for (unsigned j = i; j < std::min(i + groupSize, options.scene.objects); j++) {
+				group->NewChild(std::make_shared<RenderObject>());
+				RenderObject::newObject->trl = glm::vec3(spread(random), spread(random), spread(random)) * 0.05f;
+				RenderObject::newObject->rot = glm::vec3(spread(random), spread(random), 0);
+			}
+		}
+		RenderObject::newObject.reset();
+
+		json results = json::array();
+		double singleThreadMs = 0;
+		for (unsigned threads = 1; threads <= maxThreads; threads++) {
+			JobSystem& jobs = JobSystem::GetInstance();
+			jobs.Init(static_cast<int>(threads) - 1);
+
+			std::vector<double> samples;
+			for (unsigned repetition = 0; repetition < repetitions + 5; repetition++) {
+				for (auto& group : root->children)
+					group->isDirty = true;
+
+				Clock::time_point start = Clock::now();
+				JobCounter counter;
+				jobs.ParallelFor(static_cast<unsigned>(root->children.size()), 1, [&root](unsigned begin, unsigned end) {
+					for (unsigned i = begin; i < end; i++)
+						UpdateHierarchyModels(root->children[i]);
+					}, &counter);
+				jobs.Wait(counter);
+				if (repetition >= 5)
+					samples.push_back(MsSince(start));
+			}
+
+			json summary = Summarise(samples);
+			double average = summary["avg"];
+			if (threads == 1)
+				singleThreadMs = average;
+			results.push_back({ { "threads", threads }, { "ms", summary }, { "speedup", average > 0 ? singleThreadMs / average : 0 } });
+		}
+
+		// the objects are gone, their list entries would only be expired pointers
+		root.reset();
+		RenderObject::worldList.clear();
+		JobSystem::GetInstance().Init(options.workers);
+		return { { "objects", options.scene.objects }, { "group_size", groupSize }, { "scaling", results } };
+	}
+
+	// the scene scenario again per light count, only what lighting changes is kept
+	json RunLights(const Options& options, GLFWwindow* window) {
+		json results = json::array();
+		for (unsigned lights : { 16u, 64u, 256u, 1024u }) {
+			Options sweep = options;
+			sweep.scene.lights = lights;
+			sweep.replay.clear();
+			json scene = RunScene(sweep, window);
+			if (scene.empty())
+				continue;
+			results.push_back({
+				{ "lights_requested", lights }, { "lights_created", scene["settings"]["lights_created"] },
+				{ "render_ms", scene["phases_ms"]["render"] }, { "gpu_finish_ms", scene["phases_ms"]["gpu_finish"] },
+				{ "frame_ms", scene["phases_ms"]["frame"] }, { "light_clusters", scene["light_clusters"] },
+				});
+		}
+		return results;
+	}
+
+	// the scene scenario with the shadow pass off and on, the cost of shadows is the difference
+	json RunShadows(const Options& options, GLFWwindow* window) {
+		json results = json::array();
+		for (bool shadows : { false, true }) {
+			Options run = options;
+			run.scene.shadows = shadows;
+			run.scene.shadowLights = std::max(options.scene.shadowLights, 4u);
+			run.replay.clear();
+			json scene = RunScene(run, window);
+			if (scene.empty())
+				continue;
+			results.push_back({
+				{ "shadows", shadows }, { "shadow_lights", scene["settings"]["shadow_lights"] },
+				{ "render_ms", scene["phases_ms"]["render"] }, { "gpu_finish_ms", scene["phases_ms"]["gpu_finish"] },
+				{ "frame_ms", scene["phases_ms"]["frame"] }, { "draw_calls_per_frame", scene["draw_calls_per_frame"] },
+				{ "shadow_stats", scene["shadows"] },
+				});
+		}
+		return results;
+	}
+
+	// the scene scenario with the depth pre-pass off and on, shaded samples counted in both
+	json RunPrePass(const Options& options, GLFWwindow* window) {
+		json results = json::array();
+		for (bool prePass : { false, true }) {
+			Options run = options;
+			run.scene.depthPrePass = prePass;
+			run.scene.countShadedSamples = true;
+			run.replay.clear();
+			json scene = RunScene(run, window);
+			if (scene.empty())
+				continue;
+			results.push_back({
+				{ "depth_prepass", prePass }, { "shaded_samples", scene["depth_prepass"]["shaded_samples"] },
+				{ "render_ms", scene["phases_ms"]["render"] }, { "gpu_finish_ms", scene["phases_ms"]["gpu_finish"] },
+				{ "frame_ms", scene["phases_ms"]["frame"] }, { "draw_calls_per_frame", scene["draw_calls_per_frame"] },
+				});
+		}
+		return results;
+	}
+
+	// the scene scenario without post processing, with each anti-aliasing mode, and with FXAA under dynamic resolution
+	json RunPost(const Options& options, GLFWwindow* window) {
+		json results = json::array();
+		for (int run = -1; run <= PostProcess::AA_TOTAL; run++) {
+			Options post = options;
+			post.scene.post.enabled = run >= 0;
+			post.scene.post.dynamicResolution = run == PostProcess::AA_TOTAL;
+			post.scene.post.antiAliasing = run >= 0 && run < PostProcess::AA_TOTAL ? static_cast<PostProcess::ANTI_ALIASING>(run) : PostProcess::AA_FXAA;
+			post.replay.clear();
+			json scene = RunScene(post, window);
+			if (scene.empty())
+				continue;
+			results.push_back({
+				{ "post", scene["settings"]["post"] }, { "aa", scene["settings"]["aa"] }, { "dynamic_resolution", scene["settings"]["dynamic_resolution"] },
+				{ "render_ms", scene["phases_ms"]["render"] }, { "gpu_finish_ms", scene["phases_ms"]["gpu_finish"] },
+				{ "frame_ms", scene["phases_ms"]["frame"] }, { "post_process", scene["post_process"] },
+				});
+		}
+		return results;
+	}
+
+	// the scene scenario with mesh LODs off and on, over a scene with enough round props for them to matter
+	json RunLod(const Options& options, GLFWwindow* window) {
+		json results = json::array();
+		for (bool meshLod : { false, true }) {
+			Options run = options;
+			run.scene.meshLod = meshLod;
+			run.scene.pillars = std::max(options.scene.pillars, 0.5f);
+			run.replay.clear();
+			json scene = RunScene(run, window);
+			if (scene.empty())
+				continue;
+			results.push_back({
+				{ "mesh_lod", meshLod }, { "mesh_lods", scene["mesh_lods"] },
+				{ "render_ms", scene["phases_ms"]["render"] }, { "gpu_finish_ms", scene["phases_ms"]["gpu_finish"] },
+				{ "frame_ms", scene["phases_ms"]["frame"] }, { "draw_calls_per_frame", scene["draw_calls_per_frame"] },
+				});
+		}
+		return results;
+	}
+
+	// the scene scenario walled into rooms, with each occlusion mode
+	json RunOcclusion(const Options& options, GLFWwindow* window) {
+		json results = json::array();
+		for (int mode = 0; mode < OcclusionCuller::MODE_TOTAL; mode++) {
+			Options run = options;
+			run.scene.interior = true;
+			run.scene.occlusion = static_cast<OcclusionCuller::MODE>(mode);
+			run.replay.clear();
+			json scene = RunScene(run, window);
+			if (scene.empty())
+				continue;
+			results.push_back({
+				{ "occlusion", scene["settings"]["occlusion"] }, { "culling", scene["occlusion"] },
+				{ "render_ms", scene["phases_ms"]["render"] }, { "gpu_finish_ms", scene["phases_ms"]["gpu_finish"] },
+				{ "frame_ms", scene["phases_ms"]["frame"] }, { "draw_calls_per_frame", scene["draw_calls_per_frame"] },
+				});
+		}
+		return results;
+	}
+
+	// the scene scenario once per shading quality tier
+	json RunShading(const Options& options, GLFWwindow* window) {
+		json results = json::array();
+		for (int quality = 0; quality < BaseScene::SHADING_QUALITY_TOTAL; quality++) {
+			Options run = options;
+			run.scene.shading = static_cast<BaseScene::SHADING_QUALITY>(quality);
+			run.replay.clear();
+			json scene = RunScene(run, window);
+			if (scene.empty())
+				continue;
+			results.push_back({
+				{ "shading", scene["settings"]["shading"] },
+				{ "render_ms", scene["phases_ms"]["render"] }, { "gpu_finish_ms", scene["phases_ms"]["gpu_finish"] },
+				{ "frame_ms", scene["phases_ms"]["frame"] }, { "shading_lods", scene["shading_lods"] },
+				{ "switches_per_frame", scene["shader_variants"]["switches_per_frame"] },
+				});
+		}
+		return results;
+	}
+
+	json RunAudio(const Options& options) {
+		AudioManager& audio = AudioManager::GetInstance();
+		const unsigned key = 1000;
+		audio.LoadSFX(key, "sfx_asriel_star_drop.wav", true);
+
+		// hot sfx are decoded on another thread
+		Clock::time_point loadStart = Clock::now();
+		while (audio.GetSFXDuration(key) < 0 && MsSince(loadStart) < 5000) {
+			audio.Update();
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		if (audio.GetSFXDuration(key) < 0) {
+			Error("Benchmark: sfx_asriel_star_drop.wav did not load, skipping the audio scenario");
+			return json::object();
+		}
+
+		std::mt19937 random(options.scene.seed);
+		std::uniform_real_distribution<float> spread(-50, 50);
+		json results = json::array();
+		for (unsigned voices : { 0u, 64u, 256u, 500u }) {
+			std::vector<unsigned> background;
+			for (unsigned i = 0; i < voices; i++)
+				background.push_back(audio.PlaySFX3D(key, glm::vec3(spread(random), 0, spread(random)), 0, -1));
+			audio.Update();
+			audio.ResetStats();
+
+			// 1 burst of plays per simulated frame, like a busy scene
+			std::vector<double> playUs, updateMs;
+			for (unsigned frame = 0; frame < 60; frame++) {
+				for (unsigned i = 0; i < 8; i++) {
+					Clock::time_point start = Clock::now();
+					unsigned voice = audio.PlaySFX(key, -1, 0, 1);
+					playUs.push_back(MsSince(start) * 1000);
+					audio.StopVoice(voice);
+				}
+				Clock::time_point start = Clock::now();
+				audio.Update();
+				updateMs.push_back(MsSince(start));
+			}
+
+			const AudioManager::Stats& stats = audio.GetStats();
+			results.push_back({
+				{ "background_voices", voices }, { "play_us", Summarise(playUs) }, { "update_ms", Summarise(updateMs) },
+				{ "commands", stats.commands }, { "flushes", stats.flushes }, { "max_queue_depth", stats.maxQueueDepth }, { "finished_overflows", stats.finishedOverflows },
+				});
+
+			for (unsigned voice : background)
+				audio.StopVoice(voice);
+			audio.Update();
+		}
+
+		audio.UnloadSFX(key);
+		return results;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Options options;
+	if (!ParseOptions(argc, argv, options))
+		return EXIT_FAILURE;
+#ifndef ENABLE_MEMORY_TRACKER
+	if (options.assertNoAlloc) {
+		Error("Benchmark: --assert-no-alloc needs a build with ENABLE_MEMORY_TRACKER");
+		return EXIT_FAILURE;
+	}
+#endif
+
+	if (!options.assets.empty() && chdir(options.assets.c_str()) != 0) {
+		Error("Benchmark: Impossible to open " + options.assets);
+		return EXIT_FAILURE;
+	}
+
+	// a CI box has no sound card, the dummy driver still runs the mixer thread
+	if (options.headless)
+		SDL_setenv("SDL_AUDIODRIVER", "dummy", 0);
+
+	GLFWwindow* window = CreateContext(options);
+	if (!window)
+		return EXIT_FAILURE;
+
+	AudioManager::GetInstance().InitSystem();
+	AudioManager::GetInstance().OpenMixer();
+	JobSystem::GetInstance().Init(options.workers);
+
+	json report;
+	report["context"] = {
+		{ "renderer", reinterpret_cast<const char*>(glGetString(GL_RENDERER)) },
+		{ "version", reinterpret_cast<const char*>(glGetString(GL_VERSION)) },
+		{ "headless", options.headless },
+	};
+
+	bool all = options.scenario == "all";
+	if (all || options.scenario == "scene")
+		report["scene"] = RunScene(options, window);
+	if (all || options.scenario == "jobs")
+		report["jobs"] = RunJobs(options);
+	if (all || options.scenario == "audio")
+		report["audio"] = RunAudio(options);
+	// not part of all, it is 4 scene runs
+	if (options.scenario == "lights")
+		report["lights"] = RunLights(options, window);
+	if (options.scenario == "shadows")
+		report["shadows"] = RunShadows(options, window);
+	if (options.scenario == "shading")
+		report["shading"] = RunShading(options, window);
+	if (options.scenario == "prepass")
+		report["prepass"] = RunPrePass(options, window);
+	if (options.scenario == "post")
+		report["post"] = RunPost(options, window);
+	if (options.scenario == "lod")
+		report["lod"] = RunLod(options, window);
+	if (options.scenario == "occlusion")
+		report["occlusion"] = RunOcclusion(options, window);
+
+	if (options.out.empty()) {
+		std::cout << report.dump(2) << std::endl;
+	}
+	else {
+		std::ofstream file(options.out);
+		if (!file.is_open()) {
+			Error("Benchmark: Impossible to open " + options.out);
+			return EXIT_FAILURE;
+		}
+		file << report.dump(2);
+		Print("Benchmark: report written to " + options.out, 1);
+	}
+
+	// checked before anything is torn down, the report is still written so the offending tags can be looked at
+	bool failed = MemoryTracker::GetInstance().GetFailedFrames() > 0;
+	if (failed)
+		Error("Benchmark: " + std::to_string(MemoryTracker::GetInstance().GetFailedFrames()) + " measured frames allocated with --assert-no-alloc");
+
+	JobSystem::GetInstance().Shutdown();
+	AudioManager::GetInstance().CloseMixer();
+	AudioManager::GetInstance().ExitSystem();
+	ResourceManager::GetInstance().Clear();
+	Profiler::GetInstance().Clear();
+	FrameArena::GetInstance().Release();
+
+	glfwDestroyWindow(window);
+	glfwTerminate();
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
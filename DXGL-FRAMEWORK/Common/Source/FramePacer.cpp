@@ -0,0 +1,131 @@
+#include "FramePacer.h"
+
+#include <thread>
+#include <cmath>
+#include <algorithm>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <timeapi.h>
+#pragma comment(lib, "winmm.lib")
+#endif
+
+FramePacer::FramePacer()
+{
+#ifdef _WIN32
+	// the default scheduler tick is ~15.6ms, which makes sleep_for(1ms) useless for pacing
+	TIMECAPS caps;
+	if (timeGetDevCaps(&caps, sizeof(TIMECAPS)) == TIMERR_NOERROR) {
+		timerResolution = std::min(std::max(1u, static_cast<unsigned>(caps.wPeriodMin)), static_cast<unsigned>(caps.wPeriodMax));
+		timeBeginPeriod(timerResolution);
+	}
+#endif
+	Start();
+}
+
+FramePacer::~FramePacer()
+{
+#ifdef _WIN32
+	if (timerResolution)
+		timeEndPeriod(timerResolution);
+#endif
+}
+
+void FramePacer::SetMode(MODE mode)
+{
+	this->mode = mode;
+	deadline = Clock::now();
+}
+
+void FramePacer::SetTargetRate(double framesPerSecond)
+{
+	if (framesPerSecond <= 0) {
+		SetMode(UNCAPPED);
+		return;
+	}
+	targetFrameMs = 1000.0 / framesPerSecond;
+}
+
+void FramePacer::Start()
+{
+	frameStart = Clock::now();
+	deadline = frameStart;
+}
+
+double FramePacer::WaitForNextFrame()
+{
+	if (mode == CAPPED) {
+		auto target = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(targetFrameMs));
+		deadline += target;
+
+		// more than a frame behind (breakpoint, loading), start a new grid instead of rushing to catch up
+		Clock::time_point now = Clock::now();
+		if (now > deadline + target)
+			deadline = now;
+		else
+			PreciseSleepUntil(deadline);
+	}
+
+	Clock::time_point now = Clock::now();
+	lastFrameMs = std::chrono::duration<double, std::milli>(now - frameStart).count();
+	frameStart = now;
+	frameCount++;
+
+	unsigned bucket = static_cast<unsigned>(lastFrameMs / HISTOGRAM_BUCKET_MS);
+	histogram[std::min(bucket, HISTOGRAM_BUCKETS - 1)]++;
+
+	return lastFrameMs;
+}
+
+void FramePacer::PreciseSleepUntil(Clock::time_point time)
+{
+	// sleep while there is clearly enough time left for another sleep, then spin the rest
+	while (true) {
+		double remainingMs = std::chrono::duration<double, std::milli>(time - Clock::now()).count();
+		if (remainingMs <= sleepEstimateMs)
+			break;
+
+		Clock::time_point sleepStart = Clock::now();
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		double sleptMs = std::chrono::duration<double, std::milli>(Clock::now() - sleepStart).count();
+
+		// 1 outlier (a context switch) should not make every later frame spin for longer, so cap what 1 sample can add
+		sleptMs = std::min(sleptMs, sleepMeanMs * 4 + 1);
+		sleepCount++;
+		double delta = sleptMs - sleepMeanMs;
+		sleepMeanMs += delta / sleepCount;
+		sleepM2 += delta * (sleptMs - sleepMeanMs);
+		double stddevMs = sleepCount > 1 ? std::sqrt(sleepM2 / (sleepCount - 1)) : 0;
+		sleepEstimateMs = sleepMeanMs + stddevMs;
+	}
+
+	while (Clock::now() < time)
+		std::this_thread::yield();
+}
+
+double FramePacer::GetHistogramPercentile(double percentile) const
+{
+	unsigned long long total = 0;
+	for (unsigned count : histogram)
+		total += count;
+	if (total == 0)
+		return 0;
+
+	unsigned long long target = static_cast<unsigned long long>(std::ceil(std::max(0.0, std::min(percentile, 100.0)) / 100.0 * total));
+	unsigned long long seen = 0;
+	for (unsigned i = 0; i < HISTOGRAM_BUCKETS; i++) {
+		seen += histogram[i];
+		if (seen >= target && seen > 0)
+			return (i + 1) * HISTOGRAM_BUCKET_MS;
+	}
+	return HISTOGRAM_BUCKETS * HISTOGRAM_BUCKET_MS;
+}
+
+void FramePacer::ResetHistogram()
+{
+	histogram.fill(0);
+	frameCount = 0;
+}
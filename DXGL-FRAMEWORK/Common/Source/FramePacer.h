@@ -0,0 +1,85 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <array>
+#include <chrono>
+
+/* how to use | FramePacer:
+* FramePacer pacer;
+* pacer.SetTargetRate(60); // 16.667ms, not 16ms
+* pacer.SetMode(FramePacer::UNCAPPED); // or VSYNC, the caller sets the swap interval to match (Application does)
+* pacer.Start();
+* while (running) {
+*     ...
+*     pacer.WaitForNextFrame(); // sleeps most of the remaining time, spins the last bit
+* }
+* pacer.GetHistogramPercentile(99); // frame time in ms
+*
+* notes:
+* - deadlines are kept on a fixed grid, so a late frame is made up for by the next ones instead of drifting
+* - the spin window adapts to how long sleep_for(1ms) actually takes on this machine
+*/
+
+class FramePacer
+{
+public:
+
+	enum MODE {
+		CAPPED,
+		UNCAPPED,
+		// does not wait, the swap blocks instead
+		VSYNC,
+	};
+
+	static constexpr unsigned HISTOGRAM_BUCKETS = 80;
+	static constexpr double HISTOGRAM_BUCKET_MS = 0.5;
+
+	FramePacer();
+	~FramePacer();
+
+	void SetMode(MODE mode);
+	MODE GetMode() const { return mode; }
+	void SetTargetRate(double framesPerSecond);
+	double GetTargetFrameMs() const { return targetFrameMs; }
+
+	void Start();
+	// waits for the target frame time in CAPPED mode, returns the length of the frame that just ended in ms
+	double WaitForNextFrame();
+
+	double GetLastFrameMs() const { return lastFrameMs; }
+	unsigned long long GetFrameCount() const { return frameCount; }
+
+	// bucket i counts frames from i * HISTOGRAM_BUCKET_MS up to the next bucket, the last bucket counts everything longer
+	const std::array<unsigned, HISTOGRAM_BUCKETS>& GetHistogram() const { return histogram; }
+	// | percentile : 0 - 100, returns the upper edge of the bucket it falls into in ms
+	double GetHistogramPercentile(double percentile) const;
+	void ResetHistogram();
+
+private:
+
+	using Clock = std::chrono::steady_clock;
+
+	MODE mode = CAPPED;
+	double targetFrameMs = 1000.0 / 60.0;
+
+	Clock::time_point frameStart;
+	Clock::time_point deadline;
+
+	double lastFrameMs = 0;
+	unsigned long long frameCount = 0;
+	std::array<unsigned, HISTOGRAM_BUCKETS> histogram = {};
+
+	// running estimate of how long sleep_for(1ms) really takes (Welford mean and variance)
+	double sleepEstimateMs = 1;
+	double sleepMeanMs = 1;
+	double sleepM2 = 0;
+	unsigned long long sleepCount = 0;
+
+	void PreciseSleepUntil(Clock::time_point time);
+
+#ifdef _WIN32
+	unsigned timerResolution = 0;
+#endif
+};
+
+#endif
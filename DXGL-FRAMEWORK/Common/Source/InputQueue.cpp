@@ -0,0 +1,258 @@
+#include "InputQueue.h"
+
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+
+namespace {
+	// same limits the old MouseController had
+	const double MAX_SCROLL = 3.0;
+
+	const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+}
+
+double InputQueue::Now() {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+
+/********************************* producing *********************************/
+
+void InputQueue::Push(InputEvent::TYPE type, int code, int action, double x, double y) {
+	Push(InputEvent{ type, code, action, x, y, Now() });
+}
+
+void InputQueue::Push(const InputEvent& event) {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (replaying)
+		return;
+
+	queue.push_back(event);
+	if (recording) {
+		recorded.push_back(event);
+		recorded.back().time -= recordingStart;
+	}
+}
+
+
+/********************************* consuming *********************************/
+
+const InputSnapshot& InputQueue::NextSnapshot(double time) {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	const InputSnapshot& previous = snapshots[current];
+	InputSnapshot& next = snapshots[1 - current];
+
+	// state carries over, edges and deltas start from nothing
+	next.index = previous.index + 1;
+	next.time = time;
+	next.keysDown = previous.keysDown;
+	next.keysPressed.reset();
+	next.keysReleased.reset();
+	next.buttonsDown = previous.buttonsDown;
+	next.buttonsPressed.reset();
+	next.buttonsReleased.reset();
+	next.mouseX = previous.mouseX;
+	next.mouseY = previous.mouseY;
+	next.mouseDeltaX = next.mouseDeltaY = 0;
+	next.scrollX = next.scrollY = 0;
+
+	if (replaying) {
+		if (replayStart < 0)
+			replayStart = time;
+		for (; replayIndex < replay.size() && replay[replayIndex].time <= time - replayStart; replayIndex++)
+			Apply(next, replay[replayIndex]);
+		if (replayIndex >= replay.size())
+			replaying = false;
+	}
+	else {
+		size_t consumed = 0;
+		for (; consumed < queue.size() && queue[consumed].time <= time; consumed++)
+			Apply(next, queue[consumed]);
+		// the queue is in time order, so the first one is the oldest
+		if (consumed > 0 && pendingInputTime < 0)
+			pendingInputTime = queue.front().time;
+		queue.erase(queue.begin(), queue.begin() + consumed);
+	}
+
+	current = 1 - current;
+	return next;
+}
+
+InputSnapshot InputQueue::CopySnapshot() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return snapshots[current];
+}
+
+void InputQueue::Reset() {
+	std::lock_guard<std::mutex> lock(mutex);
+	queue.clear();
+	unsigned long long index = snapshots[current].index;
+	snapshots[0] = snapshots[1] = InputSnapshot();
+	snapshots[current].index = index;
+	firstMove = true;
+}
+
+void InputQueue::Apply(InputSnapshot& snapshot, const InputEvent& event) {
+	switch (event.type) {
+	case InputEvent::KEY:
+		if (event.code < 0 || event.code >= InputSnapshot::MAX_KEYS)
+			break;
+		// repeats are not edges, and a press of a key that is already down is not one either
+		if (event.action == GLFW_PRESS && !snapshot.keysDown.test(event.code)) {
+			snapshot.keysDown.set(event.code);
+			snapshot.keysPressed.set(event.code);
+		}
+		else if (event.action == GLFW_RELEASE && snapshot.keysDown.test(event.code)) {
+			snapshot.keysDown.reset(event.code);
+			snapshot.keysReleased.set(event.code);
+		}
+		break;
+
+	case InputEvent::MOUSE_BUTTON:
+		if (event.code < 0 || event.code >= InputSnapshot::MAX_BUTTONS)
+			break;
+		if (event.action == GLFW_PRESS && !snapshot.buttonsDown.test(event.code)) {
+			snapshot.buttonsDown.set(event.code);
+			snapshot.buttonsPressed.set(event.code);
+		}
+		else if (event.action == GLFW_RELEASE && snapshot.buttonsDown.test(event.code)) {
+			snapshot.buttonsDown.reset(event.code);
+			snapshot.buttonsReleased.set(event.code);
+		}
+		break;
+
+	case InputEvent::MOUSE_MOVE:
+		// the first position only places the cursor, a delta from 0, 0 would jerk the camera
+		if (!firstMove) {
+			snapshot.mouseDeltaX += event.x - snapshot.mouseX;
+			snapshot.mouseDeltaY += snapshot.mouseY - event.y;
+		}
+		firstMove = false;
+		snapshot.mouseX = event.x;
+		snapshot.mouseY = event.y;
+		break;
+
+	case InputEvent::MOUSE_SCROLL:
+		snapshot.scrollX = std::max(-MAX_SCROLL, std::min(snapshot.scrollX + event.x, MAX_SCROLL));
+		snapshot.scrollY = std::max(-MAX_SCROLL, std::min(snapshot.scrollY + event.y, MAX_SCROLL));
+		break;
+	}
+}
+
+
+/********************************* latency *********************************/
+
+void InputQueue::MarkPresented(double time) {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (pendingInputTime < 0)
+		return;
+
+	lastLatencyMs = (time - pendingInputTime) * 1000.0;
+	latencySamples[latencySampleCount % LATENCY_HISTORY] = lastLatencyMs;
+	latencySampleCount++;
+	pendingInputTime = -1;
+}
+
+double InputQueue::GetLatencyPercentile(double percentile) const {
+	std::lock_guard<std::mutex> lock(mutex);
+	size_t count = static_cast<size_t>(std::min<unsigned long long>(latencySampleCount, LATENCY_HISTORY));
+	if (count == 0)
+		return 0;
+
+	std::array<double, LATENCY_HISTORY> sorted = latencySamples;
+	size_t index = static_cast<size_t>(std::max(0.0, std::min(percentile, 100.0)) / 100.0 * (count - 1) + 0.5);
+	std::nth_element(sorted.begin(), sorted.begin() + index, sorted.begin() + count);
+	return sorted[index];
+}
+
+void InputQueue::ResetLatency() {
+	std::lock_guard<std::mutex> lock(mutex);
+	latencySampleCount = 0;
+	lastLatencyMs = 0;
+	pendingInputTime = -1;
+}
+
+
+/********************************* recording *********************************/
+
+void InputQueue::StartRecording() {
+	std::lock_guard<std::mutex> lock(mutex);
+	recorded.clear();
+	recordingStart = Now();
+	recording = true;
+}
+
+void InputQueue::StopRecording() {
+	std::lock_guard<std::mutex> lock(mutex);
+	recording = false;
+}
+
+bool InputQueue::SaveRecording(const std::string& file_path) const {
+	std::ofstream file(file_path);
+	if (!file.is_open())
+		return false;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	// 1 event per line: time type code action x y
+	char line[128];
+	for (const InputEvent& event : recorded) {
+		std::snprintf(line, sizeof(line), "%.6f %d %d %d %.3f %.3f\n", event.time, static_cast<int>(event.type), event.code, event.action, event.x, event.y);
+		file << line;
+	}
+	return true;
+}
+
+bool InputQueue::LoadRecording(const std::string& file_path) {
+	std::ifstream file(file_path);
+	if (!file.is_open())
+		return false;
+
+	std::vector<InputEvent> events;
+	InputEvent event;
+	int type;
+	while (file >> event.time >> type >> event.code >> event.action >> event.x >> event.y) {
+		if (type < InputEvent::KEY || type > InputEvent::MOUSE_SCROLL)
+			return false;
+		event.type = static_cast<InputEvent::TYPE>(type);
+		events.push_back(event);
+	}
+	if (!file.eof())
+		return false;
+
+	std::stable_sort(events.begin(), events.end(), [](const InputEvent& a, const InputEvent& b) { return a.time < b.time; });
+
+	std::lock_guard<std::mutex> lock(mutex);
+	recorded.swap(events);
+	return true;
+}
+
+
+/********************************* replaying *********************************/
+
+void InputQueue::StartReplay() {
+	std::lock_guard<std::mutex> lock(mutex);
+	replay = recorded;
+	replayIndex = 0;
+	replayStart = -1;
+	replaying = true;
+	recording = false;
+	queue.clear();
+}
+
+void InputQueue::StartReplay(const std::vector<InputEvent>& events) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		recorded = events;
+	}
+	StartReplay();
+}
+
+void InputQueue::StopReplay() {
+	std::lock_guard<std::mutex> lock(mutex);
+	replaying = false;
+	replay.clear();
+}
@@ -0,0 +1,175 @@
+#ifndef INPUT_QUEUE_H
+#define INPUT_QUEUE_H
+
+#include <array>
+#include <bitset>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/* how to use | InputQueue:
+* || producing, the GLFW callbacks in Application.cpp do this
+* InputQueue::GetInstance().Push(InputEvent::KEY, key, action);
+* InputQueue::GetInstance().Push(InputEvent::MOUSE_MOVE, 0, 0, x, y);
+*
+* || consuming, once per Update(), from whichever thread runs the simulation
+* const InputSnapshot& input = InputQueue::GetInstance().NextSnapshot(InputQueue::Now());
+* input.IsKeyPressed(GLFW_KEY_SPACE); // KeyboardController / MouseController answer from this same snapshot
+*
+* || latency
+* InputQueue::GetInstance().SetMeasureLatency(true); // SceneDemo turns it on with the debug overlay
+* glfwSwapBuffers(window); glFinish(); // Application does this while measuring or when LATE_LATCH is on
+* InputQueue::GetInstance().MarkPresented(InputQueue::Now()); // oldest event consumed since the last call -> now is 1 sample
+* InputQueue::GetInstance().GetLatencyPercentile(95); // in ms, over the last LATENCY_HISTORY presented frames with input
+*
+* || recording and replaying
+* InputQueue::GetInstance().StartRecording();
+* ...
+* InputQueue::GetInstance().StopRecording();
+* InputQueue::GetInstance().SaveRecording("input.txt");
+*
+* InputQueue::GetInstance().LoadRecording("input.txt"); // replaces GetRecording()
+* InputQueue::GetInstance().StartReplay(); // replays GetRecording(), live events are ignored until it ran out
+* NextSnapshot(time); // recorded events are fed in at the same offsets from the first NextSnapshot() of the replay
+*
+* notes:
+* - pressed / released are edges since the previous snapshot, a press and release inside 1 snapshot sets both while down stays false
+* - Push() and NextSnapshot() can be called from different threads, snapshots are only rebuilt by NextSnapshot()
+* - times are in seconds from InputQueue::Now(), a replay with a fixed dt per NextSnapshot() is fully deterministic
+* - events are stamped when glfwPollEvents() hands them over, the time they spent in the os queue before that is not seen
+*/
+
+struct InputEvent {
+	enum TYPE {
+		KEY,
+		MOUSE_BUTTON,
+		// x, y : cursor position
+		MOUSE_MOVE,
+		// x, y : wheel offset
+		MOUSE_SCROLL,
+	};
+
+	TYPE type;
+	// key or button
+	int code;
+	// GLFW_PRESS, GLFW_RELEASE or GLFW_REPEAT
+	int action;
+	double x;
+	double y;
+	double time;
+};
+
+struct InputSnapshot {
+	static const int MAX_KEYS = 348;
+	static const int MAX_BUTTONS = 8;
+
+	unsigned long long index = 0;
+	double time = 0;
+
+	// state at the end of the snapshot, and edges since the previous one
+	std::bitset<MAX_KEYS> keysDown, keysPressed, keysReleased;
+	std::bitset<MAX_BUTTONS> buttonsDown, buttonsPressed, buttonsReleased;
+
+	double mouseX = 0, mouseY = 0;
+	// y is flipped so moving the mouse up is positive
+	double mouseDeltaX = 0, mouseDeltaY = 0;
+	double scrollX = 0, scrollY = 0;
+
+	bool IsKeyDown(int key) const { return key >= 0 && key < MAX_KEYS && keysDown.test(key); }
+	bool IsKeyPressed(int key) const { return key >= 0 && key < MAX_KEYS && keysPressed.test(key); }
+	bool IsKeyReleased(int key) const { return key >= 0 && key < MAX_KEYS && keysReleased.test(key); }
+	bool IsButtonDown(int button) const { return button >= 0 && button < MAX_BUTTONS && buttonsDown.test(button); }
+	bool IsButtonPressed(int button) const { return button >= 0 && button < MAX_BUTTONS && buttonsPressed.test(button); }
+	bool IsButtonReleased(int button) const { return button >= 0 && button < MAX_BUTTONS && buttonsReleased.test(button); }
+};
+
+class InputQueue
+{
+public:
+
+	static InputQueue& GetInstance() {
+		static InputQueue inputQueue;
+		return inputQueue;
+	}
+
+	// seconds since the program started, the clock every event and snapshot is stamped with
+	static double Now();
+
+	void Push(InputEvent::TYPE type, int code, int action, double x = 0, double y = 0);
+	void Push(const InputEvent& event);
+
+	// folds every event stamped up to time into a new snapshot
+	// the returned one is left untouched by the next call too, so a reader on another thread has a whole snapshot to finish with it
+	const InputSnapshot& NextSnapshot(double time);
+	// the last snapshot NextSnapshot() returned, read by KeyboardController and MouseController
+	const InputSnapshot& GetSnapshot() const { return snapshots[current]; }
+	// a copy that is safe to read from any thread
+	InputSnapshot CopySnapshot() const;
+
+	// drops queued events and clears every key and button, used when focus is lost
+	void Reset();
+
+	void StartRecording();
+	void StopRecording();
+	bool IsRecording() const { return recording; }
+	// event times are relative to StartRecording()
+	const std::vector<InputEvent>& GetRecording() const { return recorded; }
+	bool SaveRecording(const std::string& file_path) const;
+	bool LoadRecording(const std::string& file_path);
+
+	// call once the frame built from the consumed snapshots is on screen, replayed events are not counted
+	void MarkPresented(double time);
+	// | percentile : 0 - 100, returns input to present latency in ms, 0 before the first sample
+	double GetLatencyPercentile(double percentile) const;
+	double GetLastLatencyMs() const { return lastLatencyMs; }
+	void ResetLatency();
+	// Application only waits for the gpu after the swap and calls MarkPresented() while this is on,
+	// off by default, the wait costs the cpu / gpu overlap and every other timing with it
+	void SetMeasureLatency(bool enabled) { measureLatency = enabled; }
+	bool GetMeasureLatency() const { return measureLatency; }
+
+	static const unsigned LATENCY_HISTORY = 240;
+
+	void StartReplay();
+	void StartReplay(const std::vector<InputEvent>& events);
+	void StopReplay();
+	bool IsReplaying() const { return replaying; }
+
+private:
+
+	// guards queue, recorded and the swap of current
+	mutable std::mutex mutex;
+	// sorted by time, Push() only appends so it stays sorted unless the caller stamps events itself
+	std::vector<InputEvent> queue;
+	// the other one is filled by the next NextSnapshot(), a reader of GetSnapshot() is never written under
+	InputSnapshot snapshots[2];
+	unsigned current = 0;
+	bool firstMove = true;
+
+	bool recording = false;
+	double recordingStart = 0;
+	std::vector<InputEvent> recorded;
+
+	// oldest live event folded into a snapshot since the last MarkPresented(), -1 = none
+	double pendingInputTime = -1;
+	// ring buffer, latencySamples[i % LATENCY_HISTORY]
+	std::array<double, LATENCY_HISTORY> latencySamples;
+	unsigned long long latencySampleCount = 0;
+	double lastLatencyMs = 0;
+	bool measureLatency = false;
+
+	bool replaying = false;
+	// -1 until the first NextSnapshot() of the replay
+	double replayStart = -1;
+	size_t replayIndex = 0;
+	std::vector<InputEvent> replay;
+
+	void Apply(InputSnapshot& snapshot, const InputEvent& event);
+
+	InputQueue() = default;
+	~InputQueue() = default;
+	InputQueue(const InputQueue&) = delete;
+	InputQueue& operator=(const InputQueue&) = delete;
+};
+
+#endif
@@ -42,85 +42,53 @@ void KeyboardController::PreUpdate(void)
 
 
 /**
-@brief Perform post-update operations
-*/
-void KeyboardController::PostUpdate(void)
-{
-	// Copy the entire currStatus to prevStatus. Note that this method will not compare 
-	// the current and previous status correctly for IsKeyPressed and IsKeyReleased
-	prevStatus = currStatus;
-}
-
-/**
- @brief Perform update operation for a key
+ @brief Queue a key event, it is applied by the next InputQueue::NextSnapshot()
  */
 void KeyboardController::Update(const int key, const int action)
 {
-	if ((key >= 0) && (key < MAX_KEYS) && (action != 2))
-	{
-		// Backup the curStatus to prevStatus
-		prevStatus.set(key, currStatus[key]);
-		// Set the new status to curStatus
-		currStatus.set(key, action);
-	}
+	InputQueue::GetInstance().Push(InputEvent::KEY, key, action);
 }
 
 /**
  @brief Check if a key is pressed down
- @param int A const int variable to check in the currStatus array
+ @param int A const int variable to check in the current snapshot
  */
 bool KeyboardController::IsKeyDown(const int key)
 {
-	return currStatus.test(key);
+	return InputQueue::GetInstance().GetSnapshot().IsKeyDown(key);
 }
 
 /**
  @brief Check if a key is up a.k.a. not pressed down
- @param int A const int variable to check in the currStatus array
+ @param int A const int variable to check in the current snapshot
  */
 bool KeyboardController::IsKeyUp(const int key)
 {
-	return !currStatus.test(key);
+	return !IsKeyDown(key);
 }
 
 /**
- @brief Check if a key is pressed down and held down
- @param int A const int variable to check in the currStatus and prevStatus array
+ @brief Check if a key went down since the previous snapshot, also true for a tap that was released again within it
+ @param int A const int variable to check in the current snapshot
  */
 bool KeyboardController::IsKeyPressed(const int key)
 {
-	return IsKeyDown(key) && !prevStatus.test(key);
+	return InputQueue::GetInstance().GetSnapshot().IsKeyPressed(key);
 }
 
 /**
- @brief Check if a key is released after being held down
- @param int A const int variable to check in the currStatus array
+ @brief Check if a key was released since the previous snapshot
+ @param int A const int variable to check in the current snapshot
  */
 bool KeyboardController::IsKeyReleased(const int key)
 {
-	return IsKeyUp(key) && prevStatus.test(key);
-}
-
-/**
- @brief Reset a key
- @param int A const int variable to reset a key in the currStatus and prevStatus array
- */
-void KeyboardController::ResetKey(const int key)
-{
-	currStatus[key] = false;
-	prevStatus[key] = false;
+	return InputQueue::GetInstance().GetSnapshot().IsKeyReleased(key);
 }
 
 /**
- @brief Reset all keys
- @param int A const int variable to reset a key in the currStatus and prevStatus array
+ @brief Reset all keys, drops the queued events too
  */
 void KeyboardController::Reset(void)
 {
-	for (int key = 0; key < MAX_KEYS; key++)
-	{
-		currStatus[key] = false;
-		prevStatus[key] = false;
-	}
+	InputQueue::GetInstance().Reset();
 }
-
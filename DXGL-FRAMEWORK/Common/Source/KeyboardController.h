@@ -1,14 +1,10 @@
-
-#define NOMINMAX
-
 /**
  KeyboardController
  Referenced: CKeyboardController by Toh Da Jun (Mar 2020)
  */
 #ifndef KEYBOARD_H
 #define KEYBOARD_H
-#include <bitset>
-#include <windows.h>
+#include "InputQueue.h"
 
 class KeyboardController
 {
@@ -17,25 +13,20 @@ public:
 	static void DestroyInstance(void);
 
 	// Constant to indicate how many keys will be processed
-	const static int MAX_KEYS = 348;
+	const static int MAX_KEYS = InputSnapshot::MAX_KEYS;
 
 	// Perform pre-update operations
 	void PreUpdate(void);
 
-	// Perform update operation for a key
+	// Queue a key event, it shows up in the next InputQueue snapshot
 	void Update(const int key, const int action);
 
-	// Perform post-update operations
-	void PostUpdate(void);
-
-	// User Interface
+	// User Interface, answered from InputQueue's current snapshot
 	bool IsKeyDown(const int key);
 	bool IsKeyUp(const int key);
 	bool IsKeyPressed(const int key);
 	bool IsKeyReleased(const int key);
 
-	// Reset a key
-	void ResetKey(const int key);
 	// Reset all keys
 	void Reset(void);
 
@@ -44,9 +35,6 @@ private:
 	~KeyboardController(void);
 
 	static KeyboardController* m_instance;
-
-	// Bitset to store information about current and previous keypress statuses
-	std::bitset<MAX_KEYS> currStatus, prevStatus;
 };
 #endif
 
@@ -1,6 +1,6 @@
 #include "MouseController.h"
-#include <iostream>
-using namespace std;
+
+#include <GLFW/glfw3.h>
 
 MouseController* MouseController::m_instance = nullptr;
 
@@ -8,14 +8,8 @@ MouseController* MouseController::m_instance = nullptr;
  @brief Constructor
  */
 MouseController::MouseController()
-	: curr_posX(0.0), curr_posY(0.0)
-	, prev_posX(0.0), prev_posY(0.0)
-	, delta_posX(0.0), delta_posY(0.0)
-	, currBtnStatus(0), prevBtnStatus(0)
-	, WheelOffset_X(0), WheelOffset_Y(0)
-	, bKeepMouseCentered(false)
+	: bKeepMouseCentered(false)
 	, bMouseEnabled(true)
-	, bFirstUpdate(true)
 {
 }
 
@@ -45,83 +39,41 @@ void MouseController::DestroyInstance()
 
 /// Update this class istance
 /**
- @brief Update the mouse position
+ @brief Queue the new mouse position, the snapshot turns it into a delta
  @param _x A const double variable containing the new mouse position in the x-axis
  @param _y A const double variable containing the new mouse position in the y-axis
  */
 void MouseController::UpdateMousePosition(const double _x, const double _y)
 {
-	if (bFirstUpdate)
-	{
-		prev_posX = _x;
-		prev_posY = _y;
-		bFirstUpdate = false;
-	}
-
-	// Store the current positions to the previous positions
-	prev_posX = curr_posX;
-	prev_posY = curr_posY;
-
-	// Update the current positions
-	curr_posX = _x;
-	curr_posY = _y;
-
-	// Update the position delta
-	delta_posX = curr_posX - prev_posX;
-	delta_posY = prev_posY - curr_posY;
+	InputQueue::GetInstance().Push(InputEvent::MOUSE_MOVE, 0, 0, _x, _y);
 }
 
 /**
- @brief Update a mouse button when it is pressed down
+ @brief Queue a mouse button press
  @param _slot A const int variable which stores the button ID
  */
 void MouseController::UpdateMouseButtonPressed(const int _slot)
 {
-	currBtnStatus |= 1 << _slot;
+	InputQueue::GetInstance().Push(InputEvent::MOUSE_BUTTON, _slot, GLFW_PRESS);
 }
 
 /**
- @brief Update a mouse button when it is released
+ @brief Queue a mouse button release
  @param _slot A const int variable which stores the button ID
  */
 void MouseController::UpdateMouseButtonReleased(const int _slot)
 {
-	currBtnStatus &= ~(1 << _slot);
+	InputQueue::GetInstance().Push(InputEvent::MOUSE_BUTTON, _slot, GLFW_RELEASE);
 }
 
 /**
- @brief Update the mouse scroll status
+ @brief Queue a mouse scroll, the snapshot adds them up and clamps to -3 - 3
  @param WheelOffset_X A const double variable which stores the amount of offset in the x-axis
  @param WheelOffset_Y A const double variable which stores the amount of offset in the y-axis
  */
 void MouseController::UpdateMouseScroll(const double WheelOffset_X, const double WheelOffset_Y)
 {
-	this->WheelOffset_X += WheelOffset_X;
-	if (this->WheelOffset_X > 3.0)
-		this->WheelOffset_X = 3.0;
-	else if (this->WheelOffset_X < -3.0)
-		this->WheelOffset_X = -3.0;
-	this->WheelOffset_Y += WheelOffset_Y;
-	if (this->WheelOffset_Y > 3.0)
-		this->WheelOffset_Y = 3.0;
-	else if (this->WheelOffset_Y < -3.0)
-		this->WheelOffset_Y = -3.0;
-}
-
-/**
-@brief Do a post update for this class instance
-*/
-void MouseController::PostUpdate(void)
-{
-	// Update the position delta
-	delta_posX = 0.0;
-	delta_posY = 0.0;
-
-	prevBtnStatus = currBtnStatus;
-
-	// Update Wheel Scroll Status
-	WheelOffset_X = 0.0;
-	WheelOffset_Y = 0.0;
+	InputQueue::GetInstance().Push(InputEvent::MOUSE_SCROLL, 0, 0, WheelOffset_X, WheelOffset_Y);
 }
 
 /**
@@ -130,7 +82,7 @@ void MouseController::PostUpdate(void)
  */
 bool MouseController::IsButtonDown(const unsigned char _slot)
 {
-	return (currBtnStatus & (1 << _slot)) != 0;
+	return InputQueue::GetInstance().GetSnapshot().IsButtonDown(_slot);
 }
 
 /**
@@ -143,24 +95,21 @@ bool MouseController::IsButtonUp(const unsigned char _slot)
 }
 
 /**
-@brief Check if a button is pressed and held down
+@brief Check if a button went down since the previous snapshot, also true for a click that was released again within it
 @param _slot A const int variable which stores the button ID
 */
 bool MouseController::IsButtonPressed(const unsigned char _slot)
 {
-	//cout << IsButtonDown(_slot) << ", " << !(prevBtnStatus & (1 << _slot)) << endl;
-	// True if currently button is down, previously is up
-	return IsButtonDown(_slot) && !(prevBtnStatus & (1 << _slot));
+	return InputQueue::GetInstance().GetSnapshot().IsButtonPressed(_slot);
 }
 
 /**
- @brief Check if a button is released
+ @brief Check if a button was released since the previous snapshot
  @param _slot A const int variable which stores the button ID
  */
 bool MouseController::IsButtonReleased(const unsigned char _slot)
 {
-	// True if currently button is up, previously is down
-	return IsButtonUp(_slot) && (prevBtnStatus & (1 << _slot));
+	return InputQueue::GetInstance().GetSnapshot().IsButtonReleased(_slot);
 }
 
 /**
@@ -170,13 +119,14 @@ bool MouseController::IsButtonReleased(const unsigned char _slot)
 */
 double MouseController::GetMouseScrollStatus(const SCROLL_TYPE _scrolltype) const
 {
+	const InputSnapshot& snapshot = InputQueue::GetInstance().GetSnapshot();
 	if (_scrolltype == SCROLL_TYPE_XOFFSET)
 	{
-		return WheelOffset_X;
+		return snapshot.scrollX;
 	}
 	else if (_scrolltype == SCROLL_TYPE_YOFFSET)
 	{
-		return WheelOffset_Y;
+		return snapshot.scrollY;
 	}
 	else
 	{
@@ -190,7 +140,7 @@ double MouseController::GetMouseScrollStatus(const SCROLL_TYPE _scrolltype) cons
  */
 double MouseController::GetMousePositionX(void) const
 {
-	return curr_posX;
+	return InputQueue::GetInstance().GetSnapshot().mouseX;
 }
 
 /**
@@ -199,7 +149,7 @@ double MouseController::GetMousePositionX(void) const
  */
 double MouseController::GetMousePositionY(void) const
 {
-	return curr_posY;
+	return InputQueue::GetInstance().GetSnapshot().mouseY;
 }
 
 /**
@@ -208,7 +158,7 @@ double MouseController::GetMousePositionY(void) const
  */
 double MouseController::GetMouseDeltaX(void) const
 {
-	return delta_posX;
+	return InputQueue::GetInstance().GetSnapshot().mouseDeltaX;
 }
 
 /**
@@ -217,5 +167,5 @@ double MouseController::GetMouseDeltaX(void) const
  */
 double MouseController::GetMouseDeltaY(void) const
 {
-	return delta_posY;
-}
\ No newline at end of file
+	return InputQueue::GetInstance().GetSnapshot().mouseDeltaY;
+}
@@ -8,6 +8,8 @@
 #ifndef MOUSE_H
 #define MOUSE_H
 
+#include "InputQueue.h"
+
 class MouseController
 {
 public:
@@ -28,14 +30,13 @@ public:
 		NUM_SCROLL_TYPE
 	};
 
-	// Update this class istance
+	// Queue mouse events, they show up in the next InputQueue snapshot
 	void UpdateMousePosition(const double _x, const double _y);
 	void UpdateMouseButtonPressed(const int _slot);
 	void UpdateMouseButtonReleased(const int _slot);
 	void UpdateMouseScroll(const double WheelOffset_X, const double WheelOffset_Y);
-	void PostUpdate(void);
 
-	// Check the button and scroll wheel statuses
+	// Check the button and scroll wheel statuses, answered from InputQueue's current snapshot
 	bool IsButtonDown(const unsigned char _slot);
 	bool IsButtonUp(const unsigned char _slot);
 	bool IsButtonPressed(const unsigned char _slot);
@@ -64,18 +65,10 @@ protected:
 
 	static MouseController* m_instance;
 
-	double	curr_posX, curr_posY,
-		prev_posX, prev_posY,
-		delta_posX, delta_posY;
-	unsigned char currBtnStatus, prevBtnStatus;
-	double WheelOffset_X, WheelOffset_Y;
-
 	// Boolean flag to indicate if the mouse will be kept centered
 	bool bKeepMouseCentered;
 	// Boolean flag to indicate if the mouse is enabled
 	bool bMouseEnabled;
-	// Boolean flag to indicate that this class instance is waiting for its first update
-	bool bFirstUpdate;
 };
 
 #endif
@@ -1,64 +1,40 @@
 #include "timer.h"
 
+#include <thread>
+
 StopWatch::StopWatch()
 {    
-    QueryPerformanceFrequency( &frequency ) ;
-
-    #define TARGET_RESOLUTION 1         // 1-millisecond target resolution
-    TIMECAPS tc;
-    
-
-    if (timeGetDevCaps(&tc, sizeof(TIMECAPS)) != TIMERR_NOERROR) 
-    {
-        // Error; application can't continue.
-    }
-
-    auto clamp = [](float value, float min, float max) {
-        if (value < min)
-            return min;
-        else if (value > max)
-            return max;
-        return value;
-    };
-
-    wTimerRes = clamp(TARGET_RESOLUTION, tc.wPeriodMin, tc.wPeriodMax);
-    timeBeginPeriod(wTimerRes); 
+    prevTime = Clock::now();
 }
 
 StopWatch::~StopWatch()
 {
-    timeEndPeriod(wTimerRes);
 }
-
-double StopWatch::LIToSecs( LARGE_INTEGER & L) {
-     return ((double)L.QuadPart /(double)frequency.QuadPart) ;
- }
  
 void StopWatch::startTimer( )
 {
-    QueryPerformanceCounter(&prevTime) ;
+    prevTime = Clock::now();
 }
  
 double StopWatch::getElapsedTime() 
 {
-    LARGE_INTEGER time;
-    QueryPerformanceCounter(&currTime) ;
-    time.QuadPart = currTime.QuadPart - prevTime.QuadPart;
+    Clock::time_point currTime = Clock::now();
+    double time = std::chrono::duration<double>(currTime - prevTime).count();
     prevTime = currTime;
-    return LIToSecs( time) ;
+    return time;
 }
 
-void StopWatch::waitUntil(long long time)
+void StopWatch::waitUntil(double time)
 {
-    LARGE_INTEGER nowTime;
-    LONGLONG timeElapsed;
+    auto deadline = prevTime + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(time));
     while (true)
     {
-        QueryPerformanceCounter(&nowTime);
-        timeElapsed = ((nowTime.QuadPart - prevTime.QuadPart) * 1000 / frequency.QuadPart);
-        if (timeElapsed > time)
+        auto remaining = deadline - Clock::now();
+        if (remaining <= Clock::duration::zero())
             return;
-        else if (time - timeElapsed > 1)
-            Sleep(1);
+        else if (remaining > std::chrono::milliseconds(2))
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        else
+            std::this_thread::yield();
     }
-}
\ No newline at end of file
+}
@@ -1,28 +1,24 @@
-
-#define NOMINMAX
-
 #ifndef _TIMER_H
 #define _TIMER_H
 
-#include <windows.h>
+#include <chrono>
 
 class StopWatch
 {
  
  private:
-     
-    LARGE_INTEGER frequency;
-    LARGE_INTEGER prevTime, currTime;
-    double LIToSecs( LARGE_INTEGER & L) ;
-    UINT     wTimerRes;
+
+    using Clock = std::chrono::steady_clock;
+
+    Clock::time_point prevTime;
 
  public:
      StopWatch() ;
      ~StopWatch();
      void startTimer();
      double getElapsedTime(); // get time in seconds since the last call to this function
-     void waitUntil(long long time);  // wait until this time in milliseconds has passed
+     void waitUntil(double time);  // wait until this time in milliseconds has passed, use FramePacer for frame limiting
  };
 
 
-#endif // _TIMER_H
\ No newline at end of file
+#endif // _TIMER_H